@@ -0,0 +1,561 @@
+/*	nonamed - caching name daemon
+ *
+ * Usage: nonamed [-d] [-p port] [server[:port] ...]
+ *
+ * Nonamed answers the DNS queries sent to the domain port of this host.
+ * What it doesn't know it asks the servers given as arguments, or else the
+ * nameservers in /etc/resolv.conf that aren't this host.  Answers are kept
+ * in a hash table for as long as their TTL says, negative answers (no such
+ * name, no such data) for as long as the SOA record that comes with them
+ * says.  The resolver library asks nonamed first if its pid is found in
+ * /etc/nonamed.pid.
+ *
+ * A server may be a stand-in on this host, e.g. "nonamed -p 5300
+ * 127.0.0.1:5301", so nonamed can be tried out without a network.
+ */
+
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/select.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <net/hton.h>
+#include <net/netlib.h>
+#include <net/gen/in.h>
+#include <net/gen/inet.h>
+#include <net/gen/netdb.h>
+#include <net/gen/nameser.h>
+#include <net/gen/resolv.h>
+#include <net/gen/udp.h>
+#include <net/gen/udp_hdr.h>
+#include <net/gen/udp_io.h>
+
+#define NSERVERS	4		/* servers to pass queries on to */
+#define CACHE_NR	128		/* cached answers */
+#define HASH_NR		64		/* hash chains, a power of two */
+#define PEND_NR		16		/* queries waiting for a server */
+#define RETRY_TIME	2		/* seconds before the next server */
+#define GIVEUP_TIME	10		/* seconds before a query is dropped */
+#define TTL_MAX		(24*60*60L)	/* longest time an answer is kept */
+#define NEG_TTL_MAX	(60*60L)	/* same for a negative answer */
+
+#define HDRSZ		sizeof(dns_hdr_t)
+#define IOHDRSZ		sizeof(udp_io_hdr_t)
+
+typedef struct cache {
+	struct cache *next;		/* hash chain */
+	char *name;			/* lower case, NULL if free */
+	unsigned type, class;
+	time_t expire;			/* answer is stale from then on */
+	time_t lastuse;
+	u8_t *ans;			/* the reply of the server */
+	unsigned len;
+} cache_t;
+
+typedef struct pend {
+	int inuse;
+	u16_t id;			/* id used toward the servers */
+	u16_t cl_id;			/* id of the client */
+	ipaddr_t cl_addr;
+	udpport_t cl_port;
+	int server;			/* server asked last */
+	time_t start, sent;
+	u8_t *query;
+	unsigned len;
+} pend_t;
+
+cache_t cache[CACHE_NR];
+cache_t *hash[HASH_NR];
+pend_t pend[PEND_NR];
+
+ipaddr_t srv_addr[NSERVERS];
+udpport_t srv_port[NSERVERS];
+int nservers;
+
+int udp_fd;
+ipaddr_t my_addr;
+u16_t next_id;
+int debug;
+time_t now;
+
+/* Room for one packet behind the UDP I/O header. */
+u8_t pkt[IOHDRSZ + PACKETSZ];
+
+void usage(void);
+void add_server(char *arg, udpport_t dport);
+void read_resolvconf(udpport_t dport);
+void write_pid(void);
+void onterm(int sig);
+void packet(udp_io_hdr_t *io, u8_t *msg, unsigned len);
+void query(udp_io_hdr_t *io, u8_t *msg, unsigned len);
+void reply(udp_io_hdr_t *io, u8_t *msg, unsigned len);
+void timeouts(void);
+int question(u8_t *msg, unsigned len, char *name, unsigned *type,
+							unsigned *class);
+long walk_rrs(u8_t *msg, unsigned len, long newttl);
+unsigned hashval(char *name, unsigned type);
+cache_t *lookup(char *name, unsigned type, unsigned class);
+void enter(char *name, unsigned type, unsigned class, long ttl,
+						u8_t *msg, unsigned len);
+void uncache(cache_t *cp);
+void send_to(ipaddr_t addr, udpport_t port, u8_t *msg, unsigned len);
+void send_pend(pend_t *pp);
+
+int main(int argc, char **argv)
+{
+	nwio_udpopt_t udpopt;
+	struct servent *servent;
+	udpport_t dport, lport;
+	char *dev_name;
+	fd_set rfds;
+	struct timeval tv;
+	int i, n;
+
+	if ((servent= getservbyname("domain", "udp")) == NULL) {
+		fprintf(stderr, "nonamed: \"domain\": unknown service\n");
+		exit(1);
+	}
+	dport= lport= servent->s_port;
+
+	i= 1;
+	while (i < argc && argv[i][0] == '-') {
+		char *opt= argv[i++] + 1;
+
+		if (opt[0] == '-' && opt[1] == 0) break;
+		while (*opt != 0) switch (*opt++) {
+		case 'd':
+			debug= 1;
+			break;
+		case 'p':
+			if (*opt == 0) {
+				if (i == argc) usage();
+				opt= argv[i++];
+			}
+			lport= htons(strtoul(opt, &opt, 10));
+			if (*opt != 0) usage();
+			break;
+		default:
+			usage();
+		}
+	}
+	while (i < argc) add_server(argv[i++], dport);
+
+	if ((dev_name= getenv("UDP_DEVICE")) == NULL) dev_name= UDP_DEVICE;
+	if ((udp_fd= open(dev_name, O_RDWR)) < 0) {
+		fprintf(stderr, "nonamed: %s: %s\n", dev_name, strerror(errno));
+		exit(1);
+	}
+	udpopt.nwuo_flags= NWUO_EXCL | NWUO_LP_SET | NWUO_EN_LOC
+		| NWUO_DI_BROAD | NWUO_RP_ANY | NWUO_RA_ANY | NWUO_RWDATALL
+		| NWUO_DI_IPOPT;
+	udpopt.nwuo_locport= lport;
+	if (ioctl(udp_fd, NWIOSUDPOPT, &udpopt) < 0
+				|| ioctl(udp_fd, NWIOGUDPOPT, &udpopt) < 0) {
+		fprintf(stderr, "nonamed: unable to use port %u: %s\n",
+			ntohs(lport), strerror(errno));
+		exit(1);
+	}
+	my_addr= udpopt.nwuo_locaddr;
+
+	if (nservers == 0) read_resolvconf(dport);
+	if (nservers == 0) {
+		fprintf(stderr, "nonamed: no name servers to ask\n");
+		exit(1);
+	}
+
+	signal(SIGTERM, onterm);
+	write_pid();
+	next_id= (u16_t) (time(NULL) ^ getpid());
+
+	for (;;) {
+		/* Wake up every second while queries are waiting. */
+		for (i= 0; i < PEND_NR && !pend[i].inuse; i++) {}
+		tv.tv_sec= 1;
+		tv.tv_usec= 0;
+
+		FD_ZERO(&rfds);
+		FD_SET(udp_fd, &rfds);
+		n= select(udp_fd + 1, &rfds, NULL, NULL,
+						i < PEND_NR ? &tv : NULL);
+		if (n < 0 && errno != EINTR) {
+			fprintf(stderr, "nonamed: select: %s\n",
+							strerror(errno));
+			exit(1);
+		}
+		now= time(NULL);
+
+		if (n > 0) {
+			n= read(udp_fd, pkt, sizeof(pkt));
+			if (n >= (int) (IOHDRSZ + HDRSZ)) {
+				packet((udp_io_hdr_t *) pkt, pkt + IOHDRSZ,
+							n - IOHDRSZ);
+			}
+		}
+		timeouts();
+	}
+}
+
+void usage(void)
+{
+	fprintf(stderr, "Usage: nonamed [-d] [-p port] [server[:port] ...]\n");
+	exit(1);
+}
+
+void add_server(char *arg, udpport_t dport)
+/* Add a server "a.b.c.d" or "a.b.c.d:port" to the list. */
+{
+	char *colon;
+	ipaddr_t addr;
+	udpport_t port;
+
+	port= dport;
+	if ((colon= strchr(arg, ':')) != NULL) {
+		*colon= 0;
+		port= htons(strtoul(colon + 1, NULL, 10));
+	}
+	if (!inet_aton(arg, &addr)) {
+		fprintf(stderr, "nonamed: %s: bad address\n", arg);
+		exit(1);
+	}
+	if (nservers == NSERVERS) return;
+	srv_addr[nservers]= addr;
+	srv_port[nservers]= port;
+	nservers++;
+}
+
+void read_resolvconf(udpport_t dport)
+/* Use the nameservers of resolv.conf, except this host itself. */
+{
+	FILE *fp;
+	char line[128];
+	char *cp;
+	ipaddr_t addr;
+
+	if ((fp= fopen(_PATH_RESCONF, "r")) == NULL) return;
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (strncmp(line, "nameserver", 10) != 0) continue;
+		for (cp= line + 10; *cp == ' ' || *cp == '\t'; cp++) {}
+		if (!inet_aton(cp, &addr)) continue;
+		if ((ntohl(addr) >> 24) == 127 || addr == my_addr) continue;
+		if (nservers == NSERVERS) break;
+		srv_addr[nservers]= addr;
+		srv_port[nservers]= dport;
+		nservers++;
+	}
+	fclose(fp);
+}
+
+void write_pid(void)
+{
+	FILE *fp;
+
+	if ((fp= fopen(_PATH_NONAMED, "w")) == NULL) {
+		fprintf(stderr, "nonamed: %s: %s\n", _PATH_NONAMED,
+							strerror(errno));
+		return;
+	}
+	fprintf(fp, "%d\n", (int) getpid());
+	fclose(fp);
+}
+
+void onterm(int sig)
+{
+	unlink(_PATH_NONAMED);
+	exit(0);
+}
+
+void packet(udp_io_hdr_t *io, u8_t *msg, unsigned len)
+{
+	dns_hdr_t *dp= (dns_hdr_t *) msg;
+
+	/* Drop a packet that is shorter than the UDP header says it is. */
+	if (len < io->uih_data_len || io->uih_data_len > PACKETSZ) return;
+	if (io->uih_data_len < HDRSZ) return;
+	len= io->uih_data_len;
+
+	if (dp->dh_flag1 & DHF_QR)
+		reply(io, msg, len);
+	else
+		query(io, msg, len);
+}
+
+void query(udp_io_hdr_t *io, u8_t *msg, unsigned len)
+/* A client asks a question.  Answer it from the cache, or pass it on. */
+{
+	dns_hdr_t *dp= (dns_hdr_t *) msg;
+	char name[MAXDNAME];
+	unsigned type, class;
+	cache_t *cp;
+	pend_t *pp;
+	int i;
+
+	if ((dp->dh_flag1 & DHF_OPCODE) != (QUERY << 3)) return;
+	if (!question(msg, len, name, &type, &class)) return;
+
+	if ((cp= lookup(name, type, class)) != NULL) {
+		if (debug) printf("nonamed: %s %u cached\n", name, type);
+		cp->lastuse= now;
+		memcpy(pkt + IOHDRSZ, cp->ans, cp->len);
+		((dns_hdr_t *) (pkt + IOHDRSZ))->dh_id= dp->dh_id;
+		walk_rrs(pkt + IOHDRSZ, cp->len, (long) (cp->expire - now));
+		send_to(io->uih_src_addr, io->uih_src_port,
+						pkt + IOHDRSZ, cp->len);
+		return;
+	}
+
+	for (i= 0; i < PEND_NR && pend[i].inuse; i++) {}
+	if (i == PEND_NR) return;
+	pp= &pend[i];
+	if ((pp->query= malloc(len)) == NULL) return;
+
+	if (debug) printf("nonamed: %s %u passed on\n", name, type);
+	memcpy(pp->query, msg, len);
+	pp->len= len;
+	pp->inuse= 1;
+	pp->id= htons(next_id++);
+	pp->cl_id= dp->dh_id;
+	pp->cl_addr= io->uih_src_addr;
+	pp->cl_port= io->uih_src_port;
+	pp->server= 0;
+	pp->start= now;
+	((dns_hdr_t *) pp->query)->dh_id= pp->id;
+	send_pend(pp);
+}
+
+void reply(udp_io_hdr_t *io, u8_t *msg, unsigned len)
+/* A server answers.  Remember the answer and send it to the client. */
+{
+	dns_hdr_t *dp= (dns_hdr_t *) msg;
+	char name[MAXDNAME];
+	unsigned type, class, rcode;
+	pend_t *pp;
+	long ttl;
+	int i;
+
+	for (i= 0; i < PEND_NR; i++) {
+		pp= &pend[i];
+		if (pp->inuse && pp->id == dp->dh_id
+			&& io->uih_src_addr == srv_addr[pp->server]
+			&& io->uih_src_port == srv_port[pp->server]) break;
+	}
+	if (i == PEND_NR) return;
+
+	if (question(msg, len, name, &type, &class)
+					&& !(dp->dh_flag1 & DHF_TC)) {
+		/* Answers and negative answers are cached, errors not. */
+		ttl= -1;
+		rcode= dp->dh_flag2 & DHF_RCODE;
+		if (rcode == NOERROR || rcode == NXDOMAIN)
+			ttl= walk_rrs(msg, len, -1L);
+		if (ttl > 0) enter(name, type, class, ttl, msg, len);
+	}
+
+	dp->dh_id= pp->cl_id;
+	send_to(pp->cl_addr, pp->cl_port, msg, len);
+	free(pp->query);
+	pp->inuse= 0;
+}
+
+void timeouts(void)
+/* Ask the next server for queries that weren't answered in time. */
+{
+	pend_t *pp;
+
+	for (pp= pend; pp < pend + PEND_NR; pp++) {
+		if (!pp->inuse) continue;
+		if (now - pp->start >= GIVEUP_TIME) {
+			free(pp->query);
+			pp->inuse= 0;
+			continue;
+		}
+		if (now - pp->sent >= RETRY_TIME) {
+			pp->server= (pp->server + 1) % nservers;
+			send_pend(pp);
+		}
+	}
+}
+
+int question(u8_t *msg, unsigned len, char *name, unsigned *type,
+							unsigned *class)
+/* Extract the one question of a message. */
+{
+	dns_hdr_t *dp= (dns_hdr_t *) msg;
+	u8_t *cp, *eom= msg + len;
+	int n;
+
+	if (ntohs(dp->dh_qdcount) != 1) return 0;
+	cp= msg + HDRSZ;
+	n= dn_expand(msg, eom, cp, (u8_t *) name, MAXDNAME);
+	if (n < 0 || cp + n + QFIXEDSZ > eom) return 0;
+	cp += n;
+	*type= _getshort(cp);
+	*class= _getshort(cp + 2);
+
+	for (; *name != 0; name++) {
+		if (*name >= 'A' && *name <= 'Z') *name += 'a' - 'A';
+	}
+	return 1;
+}
+
+long walk_rrs(u8_t *msg, unsigned len, long newttl)
+/* Walk the resource records of a reply.  Return the smallest TTL of the
+ * answer section, or if it is empty the negative TTL of the SOA record in
+ * the authority section, or -1 if there is neither.  If newttl isn't -1
+ * then every TTL is set to newttl on the way.
+ */
+{
+	dns_hdr_t *dp= (dns_hdr_t *) msg;
+	u8_t *cp, *eom= msg + len;
+	char name[MAXDNAME];
+	unsigned ancount, nscount, nrr, type, rdlen;
+	long ttl, minttl, negttl;
+	int n;
+
+	ancount= ntohs(dp->dh_ancount);
+	nscount= ntohs(dp->dh_nscount);
+	nrr= ancount + nscount + ntohs(dp->dh_arcount);
+
+	cp= msg + HDRSZ;
+	for (n= ntohs(dp->dh_qdcount); n > 0; n--) {
+		int l= dn_expand(msg, eom, cp, (u8_t *) name, MAXDNAME);
+		if (l < 0) return -1;
+		cp += l + QFIXEDSZ;
+	}
+
+	minttl= negttl= -1;
+	for (n= 0; n < nrr; n++) {
+		int l= dn_expand(msg, eom, cp, (u8_t *) name, MAXDNAME);
+		if (l < 0 || cp + l + RRFIXEDSZ > eom) return -1;
+		cp += l;
+		type= _getshort(cp);
+		ttl= _getlong(cp + 4);
+		rdlen= _getshort(cp + 8);
+		if (newttl != -1) __putlong(newttl, cp + 4);
+		cp += RRFIXEDSZ;
+		if (cp + rdlen > eom) return -1;
+
+		if (n < ancount) {
+			if (minttl == -1 || ttl < minttl) minttl= ttl;
+		} else
+		if (n < ancount + nscount && type == T_SOA && negttl == -1) {
+			/* The negative TTL is the smaller of the TTL of
+			 * the SOA and its minimum field (RFC 2308).
+			 */
+			u8_t *rp= cp;
+
+			l= dn_expand(msg, eom, rp, (u8_t *) name, MAXDNAME);
+			if (l < 0) return -1;
+			rp += l;
+			l= dn_expand(msg, eom, rp, (u8_t *) name, MAXDNAME);
+			if (l < 0 || rp + l + 5*4 > cp + rdlen) return -1;
+			rp += l;
+			negttl= _getlong(rp + 4*4);
+			if (ttl < negttl) negttl= ttl;
+		}
+		cp += rdlen;
+	}
+	if (ancount > 0) return minttl > TTL_MAX ? TTL_MAX : minttl;
+	return negttl > NEG_TTL_MAX ? NEG_TTL_MAX : negttl;
+}
+
+unsigned hashval(char *name, unsigned type)
+{
+	unsigned h= type;
+
+	while (*name != 0) h= (h << 3) ^ (h >> 13) ^ (u8_t) *name++;
+	return h & (HASH_NR - 1);
+}
+
+cache_t *lookup(char *name, unsigned type, unsigned class)
+/* Find a fresh answer in the cache.  Stale ones are thrown out. */
+{
+	cache_t *cp, *next;
+
+	for (cp= hash[hashval(name, type)]; cp != NULL; cp= next) {
+		next= cp->next;
+		if (cp->type != type || cp->class != class
+				|| strcmp(cp->name, name) != 0) continue;
+		if (cp->expire > now) return cp;
+		uncache(cp);
+		return NULL;
+	}
+	return NULL;
+}
+
+void enter(char *name, unsigned type, unsigned class, long ttl,
+						u8_t *msg, unsigned len)
+/* Cache an answer, in a free slot or else in the one used longest ago. */
+{
+	cache_t *cp, *oldest;
+	cache_t **hp;
+
+	if ((cp= lookup(name, type, class)) != NULL) uncache(cp);
+
+	oldest= cache;
+	for (cp= cache; cp < cache + CACHE_NR; cp++) {
+		if (cp->name == NULL) break;
+		if (cp->lastuse < oldest->lastuse) oldest= cp;
+	}
+	if (cp == cache + CACHE_NR) {
+		cp= oldest;
+		uncache(cp);
+	}
+
+	if ((cp->name= malloc(strlen(name) + 1)) == NULL) return;
+	if ((cp->ans= malloc(len)) == NULL) {
+		free(cp->name);
+		cp->name= NULL;
+		return;
+	}
+	strcpy(cp->name, name);
+	memcpy(cp->ans, msg, len);
+	cp->len= len;
+	cp->type= type;
+	cp->class= class;
+	cp->expire= now + ttl;
+	cp->lastuse= now;
+
+	hp= &hash[hashval(name, type)];
+	cp->next= *hp;
+	*hp= cp;
+}
+
+void uncache(cache_t *cp)
+{
+	cache_t **hp;
+
+	for (hp= &hash[hashval(cp->name, cp->type)]; *hp != cp;
+							hp= &(*hp)->next) {}
+	*hp= cp->next;
+	free(cp->name);
+	free(cp->ans);
+	cp->name= NULL;
+}
+
+void send_to(ipaddr_t addr, udpport_t port, u8_t *msg, unsigned len)
+{
+	static u8_t out[IOHDRSZ + PACKETSZ];
+	udp_io_hdr_t *io= (udp_io_hdr_t *) out;
+
+	if (len > PACKETSZ) return;
+	io->uih_dst_addr= addr;
+	io->uih_dst_port= port;
+	io->uih_ip_opt_len= 0;
+	io->uih_data_len= len;
+	memcpy(out + IOHDRSZ, msg, len);
+	(void) write(udp_fd, out, IOHDRSZ + len);
+}
+
+void send_pend(pend_t *pp)
+{
+	send_to(srv_addr[pp->server], srv_port[pp->server], pp->query,
+								pp->len);
+	pp->sent= now;
+}
@@ -7,7 +7,11 @@
 #define NR_FILPS         128	/* # slots in filp table */
 #define NR_INODES         64	/* # slots in "in core" inode table */
 #define NR_SUPERS          8	/* # slots in super block table */
-#define NR_LOCKS           8	/* # slots in the file locking table */
+#if _WORD_SIZE == 2
+#define NR_LOCKS          32	/* # slots in the file locking table */
+#else
+#define NR_LOCKS         128	/* # slots in the file locking table */
+#endif
 
 /* The type of sizeof may be (unsigned) long.  Use the following macro for
  * taking the sizes of small objects so that there are no surprises like
@@ -36,6 +40,7 @@
 #define XOPEN  (-NR_TASKS-2)	/* used in fp_task when susp'd on open */
 #define XLOCK  (-NR_TASKS-3)	/* used in fp_task when susp'd on lock */
 #define XPOPEN (-NR_TASKS-4)	/* used in fp_task when susp'd on pipe open */
+#define XSELECT (-NR_TASKS-5)	/* used in fp_task when susp'd on select */
 
 #define NO_BIT   ((bit_t) 0)	/* returned by alloc_bit() to signal failure */
 
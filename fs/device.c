@@ -280,8 +280,8 @@ message *mess_ptr;		/* pointer to message for task */
 
   while ((r = sendrec(task_nr, mess_ptr)) == ELOCKED) {
 	/* sendrec() failed to avoid deadlock. The task 'task_nr' is
-	 * trying to send a REVIVE message for an earlier request.
-	 * Handle it and go try again.
+	 * trying to send a REVIVE message for an earlier request, or a
+	 * DEV_READY for a select.  Handle it and go try again.
 	 */
 	if ((r = receive(task_nr, &local_m)) != OK) break;
 
@@ -289,6 +289,10 @@ message *mess_ptr;		/* pointer to message for task */
 	 * sent a completion reply, ignore the reply and abort the cancel
 	 * request. The caller will do the revive for the process. 
 	 */
+	if (local_m.m_type == DEV_READY) {
+		select_dev(local_m.m_source, local_m.DEVICE);
+		continue;
+	}
 	if (mess_ptr->m_type == CANCEL && local_m.REP_PROC_NR == proc_nr)
 		return;
 
@@ -304,12 +308,18 @@ message *mess_ptr;		/* pointer to message for task */
 	revive(local_m.REP_PROC_NR, local_m.REP_STATUS);
   }
 
-  /* The message received may be a reply to this call, or a REVIVE for some
-   * other process.
+  /* The message received may be a reply to this call, a REVIVE for some
+   * other process, or a DEV_READY for a select.
    */
   for (;;) {
 	if (r != OK) panic("call_task: can't send/receive", NO_NUM);
 
+	if (mess_ptr->m_type == DEV_READY) {
+		select_dev(mess_ptr->m_source, mess_ptr->DEVICE);
+		r = receive(task_nr, mess_ptr);
+		continue;
+	}
+
   	/* Did the process we did the sendrec() for get a result? */
   	if (mess_ptr->REP_PROC_NR == proc_nr) break;
 
@@ -24,8 +24,18 @@ EXTERN struct fproc {
   char fp_sesldr;		/* true if proc is a session leader */
   pid_t fp_pid;			/* process id */
   long fp_cloexec;		/* bit map for POSIX Table 6-2 FD_CLOEXEC */
+  char fp_selecting;		/* set while a select call is in progress */
+  char fp_selready;		/* a device got ready while select looked */
+  int fp_selnfds;		/* number of descriptors select checks */
+  long fp_selfds[3];		/* read, write and exception sets of select */
+  char *fp_selptr[3];		/* where the caller wants the sets back */
+  clock_t fp_seltime;		/* uptime at which select times out, or 0 */
+  off_t fp_lockfirst;		/* first byte of the lock being waited for */
+  off_t fp_locklast;		/* last byte of the lock being waited for */
 } fproc[NR_PROCS];
 
+#define NIL_FPROC (struct fproc *) 0	/* indicates absence of a process */
+
 /* Field values. */
 #define NOT_SUSPENDED      0	/* process is not suspended on pipe or task */
 #define SUSPENDED          1	/* process is suspended on pipe or task */
@@ -9,6 +9,7 @@ EXTERN struct fproc *fp;	/* pointer to caller's fproc struct */
 EXTERN int super_user;		/* 1 if caller is super_user, else 0 */
 EXTERN int dont_reply;		/* normally 0; set to 1 to inhibit reply */
 EXTERN int susp_count;		/* number of procs suspended on pipe */
+EXTERN int sel_count;		/* number of procs suspended in select */
 EXTERN int nr_locks;		/* number of locks currently in place */
 EXTERN int reviving;		/* number of pipe processes to be revived */
 EXTERN off_t rdahedpos;		/* position to read ahead */
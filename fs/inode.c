@@ -21,6 +21,7 @@
 #include "file.h"
 #include "fproc.h"
 #include "inode.h"
+#include "pipe.h"
 #include "super.h"
 
 FORWARD _PROTOTYPE( void old_icopy, (struct inode *rip, d1_inode *dip,
@@ -46,7 +47,7 @@ int numb;			/* inode number (ANSI: may not be unshort) */
   xp = NIL_INODE;
   for (rip = &inode[0]; rip < &inode[NR_INODES]; rip++) {
 	if (rip->i_count > 0) { /* only check used slots for (dev, numb) */
-		if (rip->i_dev == dev && rip->i_num == numb) {
+		if (dev != NO_DEV && rip->i_dev == dev && rip->i_num == numb) {
 			/* This is the inode that we are looking for. */
 			rip->i_count++;
 			return(rip);	/* (dev, numb) found */
@@ -86,6 +87,16 @@ register struct inode *rip;	/* pointer to inode to be released */
 
   if (rip == NIL_INODE) return;	/* checking here is easier than in caller */
   if (--rip->i_count == 0) {	/* i_count == 0 means no one is using it now */
+#if NR_PIPE_BUFS > 0
+	if (rip->i_pbuf != NIL_PBUF) {
+		put_pipe_buf(rip);	/* pipe data is gone with the last user */
+		if (rip->i_dev == NO_DEV) {
+			/* Unnamed in-core pipe, nothing on disk to release. */
+			rip->i_pipe = NO_PIPE;
+			return;
+		}
+	}
+#endif
 	if ((rip->i_nlinks & BYTE) == 0) {
 		/* i_nlinks == 0 means free the inode. */
 		truncate(rip);	/* return all the disk blocks */
@@ -241,6 +252,12 @@ int rw_flag;			/* READING or WRITING */
   d2_inode *dip2;
   block_t b, offset;
 
+  /* An unnamed in-core pipe has no disk inode behind it. */
+  if (rip->i_dev == NO_DEV) {
+	rip->i_dirt = CLEAN;
+	return;
+  }
+
   /* Get the block where the inode resides. */
   sp = get_super(rip->i_dev);	/* get pointer to super block */
   rip->i_sp = sp;		/* inode must contain super block pointer */
@@ -31,6 +31,8 @@ EXTERN struct inode {
   char i_mount;			/* this bit is set if file mounted on */
   char i_seek;			/* set on LSEEK, cleared on READ/WRITE */
   char i_update;		/* the ATIME, CTIME, and MTIME bits are here */
+  struct pipe_buf *i_pbuf;	/* in-core data of a pipe, see pipe.h */
+  struct file_lock *i_lock;	/* advisory locks on the file, see lock.h */
 } inode[NR_INODES];
 
 
@@ -1,7 +1,13 @@
 /* This file handles advisory file locking as required by POSIX.
+ *
+ * The locks on a file are kept in a list hanging off its inode, so only the
+ * locks of the file itself have to be looked at.  Unused slots of the lock
+ * table are kept on a free list.
  *
  * The entry points into this file are
- *   lock_op:	perform locking operations for FCNTL system call
+ *   lock_init:	 put all slots of the lock table on the free list
+ *   lock_op:	 perform locking operations for FCNTL system call
+ *   lock_release: release the locks of the caller on a file being closed
  *   lock_revive: revive processes when a lock is released
  */
 
@@ -14,6 +20,22 @@
 #include "lock.h"
 #include "param.h"
 
+FORWARD _PROTOTYPE( void free_lock_slot, (struct file_lock *flp)	);
+
+/*===========================================================================*
+ *				lock_init				     *
+ *===========================================================================*/
+PUBLIC void lock_init()
+{
+/* Put all slots of the lock table on the free list. */
+
+  struct file_lock *flp;
+
+  free_lock = NIL_LOCK;
+  for (flp = &file_lock[NR_LOCKS - 1]; flp >= &file_lock[0]; flp--)
+	free_lock_slot(flp);
+}
+
 /*===========================================================================*
  *				lock_op					     *
  *===========================================================================*/
@@ -23,12 +45,13 @@ int req;			/* either F_SETLK or F_SETLKW */
 {
 /* Perform the advisory locking required by POSIX. */
 
-  int r, ltype, i, conflict = 0, unlocking = 0;
+  int r, ltype, conflict = 0, unlocking = 0;
   mode_t mo;
   off_t first, last;
   struct flock flock;
   vir_bytes user_flock;
-  struct file_lock *flp, *flp2, *empty;
+  struct inode *rip;
+  struct file_lock *flp, *flp2, **linkp;
 
   /* Fetch the flock structure from user space. */
   user_flock = (vir_bytes) name1;
@@ -39,9 +62,10 @@ int req;			/* either F_SETLK or F_SETLKW */
   /* Make some error checks. */
   ltype = flock.l_type;
   mo = f->filp_mode;
+  rip = f->filp_ino;
   if (ltype != F_UNLCK && ltype != F_RDLCK && ltype != F_WRLCK) return(EINVAL);
   if (req == F_GETLK && ltype == F_UNLCK) return(EINVAL);
-  if ( (f->filp_ino->i_mode & I_TYPE) != I_REGULAR) return(EINVAL);
+  if ( (rip->i_mode & I_TYPE) != I_REGULAR) return(EINVAL);
   if (req != F_GETLK && ltype == F_RDLCK && (mo & R_BIT) == 0) return(EBADF);
   if (req != F_GETLK && ltype == F_WRLCK && (mo & W_BIT) == 0) return(EBADF);
 
@@ -49,7 +73,7 @@ int req;			/* either F_SETLK or F_SETLKW */
   switch (flock.l_whence) {
 	case SEEK_SET:	first = 0; break;
 	case SEEK_CUR:	first = f->filp_pos; break;
-	case SEEK_END:	first = f->filp_ino->i_size; break;
+	case SEEK_END:	first = rip->i_size; break;
 	default:	return(EINVAL);
   }
   /* Check for overflow. */
@@ -62,18 +86,16 @@ int req;			/* either F_SETLK or F_SETLKW */
   if (flock.l_len == 0) last = MAX_FILE_POS;
   if (last < first) return(EINVAL);
 
-  /* Check if this region conflicts with any existing lock. */
-  empty = (struct file_lock *) 0;
-  for (flp = &file_lock[0]; flp < & file_lock[NR_LOCKS]; flp++) {
-	if (flp->lock_type == 0) {
-		if (empty == (struct file_lock *) 0) empty = flp;
-		continue;	/* 0 means unused slot */
+  /* Check if this region conflicts with any existing lock on the file. */
+  linkp = &rip->i_lock;
+  while ((flp = *linkp) != NIL_LOCK) {
+	if (last < flp->lock_first			/* new one is in front */
+	    || first > flp->lock_last			/* new one is afterwards */
+	    || (ltype == F_RDLCK && flp->lock_type == F_RDLCK)
+	    || (ltype != F_UNLCK && flp->lock_pid == fp->fp_pid)) {
+		linkp = &flp->lock_next;
+		continue;
 	}
-	if (flp->lock_inode != f->filp_ino) continue;	/* different file */
-	if (last < flp->lock_first) continue;	/* new one is in front */
-	if (first > flp->lock_last) continue;	/* new one is afterwards */
-	if (ltype == F_RDLCK && flp->lock_type == F_RDLCK) continue;
-	if (ltype != F_UNLCK && flp->lock_pid == fp->fp_pid) continue;
   
 	/* There might be a conflict.  Process it. */
 	conflict = 1;
@@ -85,7 +107,11 @@ int req;			/* either F_SETLK or F_SETLKW */
 			/* For F_SETLK, just report back failure. */
 			return(EAGAIN);
 		} else {
-			/* For F_SETLKW, suspend the process. */
+			/* For F_SETLKW, suspend the process.  Remember the
+			 * region, only an unlock touching it can help.
+			 */
+			fp->fp_lockfirst = first;
+			fp->fp_locklast = last;
 			suspend(XLOCK);
 			return(0);
 		}
@@ -94,36 +120,37 @@ int req;			/* either F_SETLK or F_SETLKW */
 	/* We are clearing a lock and we found something that overlaps. */
 	unlocking = 1;
 	if (first <= flp->lock_first && last >= flp->lock_last) {
-		flp->lock_type = 0;	/* mark slot as unused */
-		nr_locks--;		/* number of locks is now 1 less */
+		*linkp = flp->lock_next;	/* remove lock from the list */
+		free_lock_slot(flp);
 		continue;
 	}
 
 	/* Part of a locked region has been unlocked. */
 	if (first <= flp->lock_first) {
 		flp->lock_first = last + 1;
-		continue;
-	}
-
+	} else
 	if (last >= flp->lock_last) {
 		flp->lock_last = first - 1;
-		continue;
+	} else {
+		/* Bad luck. A lock has been split in two by unlocking the
+		 * middle.  The second half goes right after the first.
+		 */
+		if ((flp2 = free_lock) == NIL_LOCK) return(ENOLCK);
+		free_lock = flp2->lock_next;
+		flp2->lock_type = flp->lock_type;
+		flp2->lock_pid = flp->lock_pid;
+		flp2->lock_inode = flp->lock_inode;
+		flp2->lock_first = last + 1;
+		flp2->lock_last = flp->lock_last;
+		flp2->lock_next = flp->lock_next;
+		flp->lock_last = first - 1;
+		flp->lock_next = flp2;
+		nr_locks++;
+		flp = flp2;
 	}
-	
-	/* Bad luck. A lock has been split in two by unlocking the middle. */
-	if (nr_locks == NR_LOCKS) return(ENOLCK);
-	for (i = 0; i < NR_LOCKS; i++)
-		if (file_lock[i].lock_type == 0) break;
-	flp2 = &file_lock[i];
-	flp2->lock_type = flp->lock_type;
-	flp2->lock_pid = flp->lock_pid;
-	flp2->lock_inode = flp->lock_inode;
-	flp2->lock_first = last + 1;
-	flp2->lock_last = flp->lock_last;
-	flp->lock_last = first - 1;
-	nr_locks++;
+	linkp = &flp->lock_next;
   }
-  if (unlocking) lock_revive();
+  if (unlocking) lock_revive(rip, first, last);
 
   if (req == F_GETLK) {
 	if (conflict) {
@@ -148,37 +175,86 @@ int req;			/* either F_SETLK or F_SETLKW */
   if (ltype == F_UNLCK) return(OK);	/* unlocked a region with no locks */
 
   /* There is no conflict.  If space exists, store new lock in the table. */
-  if (empty == (struct file_lock *) 0) return(ENOLCK);	/* table full */
-  empty->lock_type = ltype;
-  empty->lock_pid = fp->fp_pid;
-  empty->lock_inode = f->filp_ino;
-  empty->lock_first = first;
-  empty->lock_last = last;
+  if ((flp = free_lock) == NIL_LOCK) return(ENOLCK);	/* table full */
+  free_lock = flp->lock_next;
+  flp->lock_type = ltype;
+  flp->lock_pid = fp->fp_pid;
+  flp->lock_inode = rip;
+  flp->lock_first = first;
+  flp->lock_last = last;
+  flp->lock_next = rip->i_lock;
+  rip->i_lock = flp;
   nr_locks++;
   return(OK);
 }
 
+/*===========================================================================*
+ *				lock_release				     *
+ *===========================================================================*/
+PUBLIC void lock_release(rip)
+struct inode *rip;		/* file being closed */
+{
+/* The caller closes a file descriptor for 'rip'.  POSIX says that all of its
+ * locks on the file are gone then.  Wake up those waiting on the region.
+ */
+
+  struct file_lock *flp, **linkp;
+  off_t first, last;
+
+  first = MAX_FILE_POS;
+  last = 0;
+  linkp = &rip->i_lock;
+  while ((flp = *linkp) != NIL_LOCK) {
+	if (flp->lock_pid != fp->fp_pid) {
+		linkp = &flp->lock_next;
+		continue;
+	}
+	if (flp->lock_first < first) first = flp->lock_first;
+	if (flp->lock_last > last) last = flp->lock_last;
+	*linkp = flp->lock_next;
+	free_lock_slot(flp);
+  }
+  if (first <= last) lock_revive(rip, first, last);	/* lock released */
+}
+
 /*===========================================================================*
  *				lock_revive				     *
  *===========================================================================*/
-PUBLIC void lock_revive()
+PUBLIC void lock_revive(rip, first, last)
+struct inode *rip;		/* file on which locks were released */
+off_t first;			/* first byte of the released region */
+off_t last;			/* last byte of the released region */
 {
-/* Go find all the processes that are waiting for any kind of lock and 
- * revive them all.  The ones that are still blocked will block again when 
- * they run.  The others will complete.  This strategy is a space-time 
- * tradeoff.  Figuring out exactly which ones to unblock now would take 
- * extra code, and the only thing it would win would be some performance in 
- * extremely rare circumstances (namely, that somebody actually used 
- * locking).
+/* Revive the processes waiting for a lock on 'rip' whose region overlaps the
+ * one just released.  They will retry the lock, and block again if another
+ * lock is still in the way.  Waiters on other files or other parts of this
+ * file are not bothered.
  */
 
   int task;
   struct fproc *fptr;
+  struct filp *f;
 
   for (fptr = &fproc[INIT_PROC_NR + 1]; fptr < &fproc[NR_PROCS]; fptr++){
 	task = -fptr->fp_task;
-	if (fptr->fp_suspended == SUSPENDED && task == XLOCK) {
-		revive( (int) (fptr - fproc), 0);
-	}
+	if (fptr->fp_suspended != SUSPENDED || task != XLOCK) continue;
+	f = fptr->fp_filp[fptr->fp_fd >> 8];
+	if (f == NIL_FILP || f->filp_ino != rip) continue;
+	if (fptr->fp_locklast < first || fptr->fp_lockfirst > last) continue;
+	revive( (int) (fptr - fproc), 0);
   }
 }
+
+/*===========================================================================*
+ *				free_lock_slot				     *
+ *===========================================================================*/
+PRIVATE void free_lock_slot(flp)
+struct file_lock *flp;
+{
+/* Return a slot to the free list of the lock table. */
+
+  if (flp->lock_type != 0) nr_locks--;
+  flp->lock_type = 0;		/* mark slot as unused */
+  flp->lock_next = free_lock;
+  free_lock = flp;
+}
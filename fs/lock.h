@@ -1,5 +1,7 @@
 /* This is the file locking table.  Like the filp table, it points to the
- * inode table, however, in this case to achieve advisory locking.
+ * inode table, however, in this case to achieve advisory locking.  The locks
+ * on a file are linked together from i_lock in its inode, the unused slots
+ * are linked together from free_lock.
  */
 EXTERN struct file_lock {
   short lock_type;		/* F_RDLOCK or F_WRLOCK; 0 means unused slot */
@@ -7,4 +9,9 @@ EXTERN struct file_lock {
   struct inode *lock_inode;	/* pointer to the inode locked */
   off_t lock_first;		/* offset of first byte locked */
   off_t lock_last;		/* offset of last byte locked */
+  struct file_lock *lock_next;	/* next lock on the file, or next free slot */
 } file_lock[NR_LOCKS];
+
+EXTERN struct file_lock *free_lock;	/* list of unused slots */
+
+#define NIL_LOCK (struct file_lock *) 0
@@ -53,6 +53,12 @@ PUBLIC void main()
   while (TRUE) {
 	get_work();		/* sets who and fs_call */
 
+	/* The synchronous alarm is only used to time out selects. */
+	if (who == SYN_ALRM_TASK) {
+		select_timeout();
+		continue;
+	}
+
 	fp = &fproc[who];	/* pointer to proc table struct */
 	super_user = (fp->fp_effuid == SU_UID ? TRUE : FALSE);   /* su? */
 	dont_reply = FALSE;	/* in other words, do reply is default */
@@ -139,6 +145,7 @@ PRIVATE void fs_init()
   who = FS_PROC_NR;
 
   buf_pool();			/* initialize buffer pool */
+  lock_init();			/* initialize the file locking table */
   get_boot_parameters();	/* get the parameters from the menu */
   load_ram();			/* init RAM disk, load if it is root */
   load_super(ROOT_DEV);		/* load super block for root device */
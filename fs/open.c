@@ -314,6 +314,9 @@ register int oflags;
 	release(rip, CREAT, susp_count);
   }
   rip->i_pipe = I_PIPE; 
+#if NR_PIPE_BUFS > 0
+  get_pipe_buf(rip);		/* keep the data in core if possible */
+#endif
 
   return(OK);
 }
@@ -328,8 +331,7 @@ PUBLIC int do_close()
 
   register struct filp *rfilp;
   register struct inode *rip;
-  struct file_lock *flp;
-  int rw, mode_word, major, task, lock_count;
+  int rw, mode_word, major, task;
   dev_t dev;
 
   /* First locate the inode that belongs to the file descriptor. */
@@ -363,8 +365,12 @@ PUBLIC int do_close()
   if (rip->i_pipe == I_PIPE) {
 	rw = (rfilp->filp_mode & R_BIT ? WRITE : READ);
 	release(rip, rw, NR_PROCS);
+	select_inode(rip);
   }
 
+  /* Check to see if the file is locked.  If so, release all locks. */
+  if (rip->i_lock != NIL_LOCK) lock_release(rip);
+
   /* If a write has been done, the inode is already marked as DIRTY. */
   if (--rfilp->filp_count == 0) {
 	if (rip->i_pipe == I_PIPE && rip->i_count > 1) {
@@ -382,18 +388,6 @@ PUBLIC int do_close()
 
   fp->fp_cloexec &= ~(1L << fd);	/* turn off close-on-exec bit */
   fp->fp_filp[fd] = NIL_FILP;
-
-  /* Check to see if the file is locked.  If so, release all locks. */
-  if (nr_locks == 0) return(OK);
-  lock_count = nr_locks;	/* save count of locks */
-  for (flp = &file_lock[0]; flp < &file_lock[NR_LOCKS]; flp++) {
-	if (flp->lock_type == 0) continue;	/* slot not in use */
-	if (flp->lock_inode == rip && flp->lock_pid == fp->fp_pid) {
-		flp->lock_type = 0;
-		nr_locks--;
-	}
-  }
-  if (nr_locks < lock_count) lock_revive();	/* lock released */
   return(OK);
 }
 
@@ -31,6 +31,12 @@
 #define pid	      m.m1_i3
 #define pro	      m.m1_i1
 #define rd_only	      m.m1_i3
+#define sel_exfds     m.m1_p3
+#define sel_msec      m.m1_i3
+#define sel_nfds      m.m1_i1
+#define sel_rdfds     m.m1_p1
+#define sel_sec	      m.m1_i2
+#define sel_wrfds     m.m1_p2
 #define real_user_id  m.m1_i2
 #define request       m.m1_i2
 #define sig	      m.m1_i2
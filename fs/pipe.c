@@ -7,6 +7,9 @@
  * The entry points into this file are
  *   do_pipe:	  perform the PIPE system call
  *   pipe_check:  check to see that a read or write on a pipe is feasible now
+ *   get_pipe_buf: give a pipe an in-core buffer if one is free
+ *   put_pipe_buf: return the in-core buffer of a pipe
+ *   pipe_rw:	  read or write a pipe that has an in-core buffer
  *   suspend:	  suspend a process that cannot do a requested read or write
  *   release:	  check to see if a suspended process can be released and do it
  *   revive:	  mark a suspended process as able to run again
@@ -24,9 +27,14 @@
 #include "fproc.h"
 #include "inode.h"
 #include "param.h"
+#include "pipe.h"
 
 PRIVATE message mess;
 
+#if NR_PIPE_BUFS > 0
+FORWARD _PROTOTYPE( struct fproc *pipe_reader, (struct inode *rip)	);
+#endif
+
 /*===========================================================================*
  *				do_pipe					     *
  *===========================================================================*/
@@ -39,6 +47,9 @@ PUBLIC int do_pipe()
   int r;
   struct filp *fil_ptr0, *fil_ptr1;
   int fil_des[2];		/* reply goes here */
+#if NR_PIPE_BUFS > 0
+  struct pipe_buf *pb;
+#endif
 
   /* Acquire two file descriptors. */
   rfp = fp;
@@ -53,16 +64,36 @@ PUBLIC int do_pipe()
   rfp->fp_filp[fil_des[1]] = fil_ptr1;
   fil_ptr1->filp_count = 1;
 
-  /* Make the inode on the pipe device. */
-  if ( (rip = alloc_inode(PIPE_DEV, I_REGULAR) ) == NIL_INODE) {
-	rfp->fp_filp[fil_des[0]] = NIL_FILP;
-	fil_ptr0->filp_count = 0;
-	rfp->fp_filp[fil_des[1]] = NIL_FILP;
-	fil_ptr1->filp_count = 0;
-	return(err_code);
-  }
+#if NR_PIPE_BUFS > 0
+  /* If an in-core buffer is free the pipe is kept entirely in memory and
+   * nothing needs to be allocated on the pipe device.  The inode slot is not
+   * backed by a disk inode, it is numbered after its buffer.
+   */
+  for (pb = &pipe_buf[0]; pb < &pipe_buf[NR_PIPE_BUFS]; pb++)
+	if (pb->pb_inode == NIL_INODE) break;
+  if (pb < &pipe_buf[NR_PIPE_BUFS] &&
+	(rip = get_inode(NO_DEV, (int) (pb - pipe_buf) + 1)) != NIL_INODE) {
+	rip->i_mode = I_REGULAR;
+	rip->i_nlinks = (nlink_t) 0;
+	rip->i_uid = rfp->fp_effuid;
+	rip->i_gid = rfp->fp_effgid;
+	rip->i_sp = get_super(PIPE_DEV);  /* for the times */
+	wipe_inode(rip);
+	get_pipe_buf(rip);
+  } else
+#endif
+  {
+	/* Make the inode on the pipe device. */
+	if ( (rip = alloc_inode(PIPE_DEV, I_REGULAR) ) == NIL_INODE) {
+		rfp->fp_filp[fil_des[0]] = NIL_FILP;
+		fil_ptr0->filp_count = 0;
+		rfp->fp_filp[fil_des[1]] = NIL_FILP;
+		fil_ptr1->filp_count = 0;
+		return(err_code);
+	}
 
-  if (read_only(rip) != OK) panic("pipe device is read only", NO_NUM);
+	if (read_only(rip) != OK) panic("pipe device is read only", NO_NUM);
+  }
  
   rip->i_pipe = I_PIPE;
   rip->i_mode &= ~I_REGULAR;
@@ -158,6 +189,200 @@ int *canwrite;			/* return: number of bytes we can write */
 }
 
 
+#if NR_PIPE_BUFS > 0
+/*===========================================================================*
+ *				get_pipe_buf				     *
+ *===========================================================================*/
+PUBLIC void get_pipe_buf(rip)
+register struct inode *rip;	/* the inode of the pipe */
+{
+/* Give an empty pipe an in-core buffer, if there is one left.  A pipe that
+ * does not get one keeps its data on the pipe device as it always did.
+ */
+
+  register struct pipe_buf *pb;
+
+  if (rip->i_pbuf != NIL_PBUF || rip->i_size != 0) return;
+  for (pb = &pipe_buf[0]; pb < &pipe_buf[NR_PIPE_BUFS]; pb++) {
+	if (pb->pb_inode == NIL_INODE) {
+		pb->pb_inode = rip;
+		pb->pb_rd = 0;
+		pb->pb_count = 0;
+		rip->i_pbuf = pb;
+		return;
+	}
+  }
+}
+
+
+/*===========================================================================*
+ *				put_pipe_buf				     *
+ *===========================================================================*/
+PUBLIC void put_pipe_buf(rip)
+register struct inode *rip;	/* the inode of the pipe */
+{
+/* The last user of a pipe is gone, so is any data left in it. */
+
+  rip->i_pbuf->pb_inode = NIL_INODE;
+  rip->i_pbuf = NIL_PBUF;
+  rip->i_size = 0;
+}
+
+
+/*===========================================================================*
+ *				pipe_rw					     *
+ *===========================================================================*/
+PUBLIC int pipe_rw(rip, rw_flag, oflags)
+register struct inode *rip;	/* the inode of the pipe */
+int rw_flag;			/* READING or WRITING */
+int oflags;			/* flags set by open or fcntl */
+{
+/* Read or write a pipe whose data is in an in-core buffer.  The rules are
+ * those of pipe_check() and read_write(), but the data is copied straight
+ * between the user and the ring buffer.  A writer that finds the pipe empty
+ * and a reader waiting hands its data directly to the reader instead.
+ */
+
+  register struct pipe_buf *pb;
+  register struct fproc *rfp;
+  unsigned off, chunk, n, cum_io;
+  int r, proc_nr;
+
+  pb = rip->i_pbuf;
+
+  if (rw_flag == READING) {
+	if (pb->pb_count == 0) {
+		/* Process is reading from an empty pipe. */
+		r = 0;
+		if (find_filp(rip, W_BIT) != NIL_FILP) {
+			/* Writer exists */
+			if (oflags & O_NONBLOCK)
+				r = EAGAIN;
+			else
+				suspend(XPIPE);	/* block reader */
+
+			/* If need be, activate sleeping writers. */
+			if (susp_count > 0) release(rip, WRITE, susp_count);
+		}
+		return(r);
+	}
+
+	/* Copy out of the ring, in two pieces if it wraps. */
+	cum_io = MIN((unsigned) nbytes, pb->pb_count);
+	for (n = cum_io; n > 0; n -= chunk) {
+		off = pb->pb_rd;
+		chunk = MIN(n, PIPE_BUF_SIZE - off);
+		r = sys_copy(FS_PROC_NR, D, (phys_bytes) (pb->pb_data + off),
+			who, D, (phys_bytes) buffer, (phys_bytes) chunk);
+		if (r != OK) return(r);
+		buffer += chunk;
+		pb->pb_rd = (off + chunk) % PIPE_BUF_SIZE;
+		pb->pb_count -= chunk;
+	}
+	if (pb->pb_count == 0) pb->pb_rd = 0;
+	rip->i_size = pb->pb_count;
+	rip->i_update |= ATIME;
+
+	/* There is room now, let writers try again. */
+	if (susp_count > 0) release(rip, WRITE, susp_count);
+	select_inode(rip);
+	return((int) cum_io);
+  }
+
+  /* Process is writing to a pipe.  cum_io is only nonzero when a write
+   * larger than the pipe is continued after a partial transfer.
+   */
+  cum_io = fp->fp_cum_io_partial;
+  fp->fp_cum_io_partial = 0;
+  if (find_filp(rip, R_BIT) == NIL_FILP) {
+	/* Tell kernel to generate a SIGPIPE signal. */
+	sys_kill((int)(fp - fproc), SIGPIPE);
+	return(EPIPE);
+  }
+  rip->i_update |= CTIME | MTIME;
+
+  /* Hand the data to waiting readers as long as the pipe is empty. */
+  while (pb->pb_count == 0 && nbytes > 0
+				&& (rfp = pipe_reader(rip)) != NIL_FPROC) {
+	proc_nr = (int) (rfp - fproc);
+	n = MIN((unsigned) nbytes, (unsigned) rfp->fp_nbytes);
+	r = sys_copy(who, D, (phys_bytes) buffer,
+			proc_nr, D, (phys_bytes) rfp->fp_buffer, (phys_bytes) n);
+	if (r != OK) return(r);
+	buffer += n;
+	nbytes -= n;
+	cum_io += n;
+	rfp->fp_suspended = NOT_SUSPENDED;
+	susp_count--;
+	rfp->fp_filp[rfp->fp_fd >> 8]->filp_ino->i_update |= ATIME;
+	reply(proc_nr, (int) n);
+  }
+  if (nbytes == 0) return((int) cum_io);
+
+  /* A write of at most PIPE_BUF bytes goes in all at once or not at all. */
+  n = PIPE_BUF_SIZE - pb->pb_count;
+  if (nbytes <= PIPE_BUF && nbytes > n) n = 0;
+  if (n > (unsigned) nbytes) n = nbytes;
+
+  /* Copy into the ring, in two pieces if it wraps. */
+  while (n > 0) {
+	off = (pb->pb_rd + pb->pb_count) % PIPE_BUF_SIZE;
+	chunk = MIN(n, PIPE_BUF_SIZE - off);
+	r = sys_copy(who, D, (phys_bytes) buffer,
+		FS_PROC_NR, D, (phys_bytes) (pb->pb_data + off),
+		(phys_bytes) chunk);
+	if (r != OK) return(r);
+	buffer += chunk;
+	nbytes -= chunk;
+	cum_io += chunk;
+	pb->pb_count += chunk;
+	n -= chunk;
+  }
+  rip->i_size = pb->pb_count;
+
+  /* Search for suspended readers. */
+  if (pb->pb_count > 0) {
+	if (susp_count > 0) release(rip, READ, susp_count);
+	select_inode(rip);
+  }
+
+  if (nbytes == 0) return((int) cum_io);
+  if (oflags & O_NONBLOCK) return(cum_io > 0 ? (int) cum_io : EAGAIN);
+
+  /* Stop writer -- pipe full.  Buffer and nbytes are saved for the retry. */
+  fp->fp_cum_io_partial = cum_io;
+  suspend(XPIPE);
+  return(0);
+}
+
+
+/*===========================================================================*
+ *				pipe_reader				     *
+ *===========================================================================*/
+PRIVATE struct fproc *pipe_reader(rip)
+struct inode *rip;		/* the inode of the pipe */
+{
+/* Find a process that is suspended reading the pipe and is not already being
+ * revived to try again.
+ */
+
+  register struct fproc *rp;
+
+  if (susp_count == 0) return(NIL_FPROC);
+  for (rp = &fproc[0]; rp < &fproc[NR_PROCS]; rp++) {
+	if (rp->fp_suspended == SUSPENDED &&
+			rp->fp_revived == NOT_REVIVING &&
+			-rp->fp_task == XPIPE &&
+			(rp->fp_fd & BYTE) == READ &&
+			rp->fp_filp[rp->fp_fd>>8]->filp_ino == rip) {
+		return(rp);
+	}
+  }
+  return(NIL_FPROC);
+}
+#endif /* NR_PIPE_BUFS > 0 */
+
+
 /*===========================================================================*
  *				suspend					     *
  *===========================================================================*/
@@ -238,10 +463,11 @@ int bytes;			/* if hanging on task, how many bytes read */
    * must be restarted so it can try again.
    */
   task = -rfp->fp_task;
-  if (task == XPIPE || task == XLOCK) {
-	/* Revive a process suspended on a pipe or lock. */
+  if (task == XPIPE || task == XLOCK || task == XSELECT) {
+	/* Revive a process suspended on a pipe, lock or select. */
+	if (task == XSELECT) sel_count--;
 	rfp->fp_revived = REVIVING;
-	reviving++;		/* process was waiting on pipe or lock */
+	reviving++;		/* process was waiting on pipe, lock or select */
   } else {
 	rfp->fp_suspended = NOT_SUSPENDED;
 	if (task == XPOPEN) /* process blocked in open or create */
@@ -278,6 +504,7 @@ PUBLIC int do_unpause()
 
   switch(task) {
 	case XPIPE:		/* process trying to read or write a pipe */
+		rfp->fp_cum_io_partial = 0;
 		break;
 
 	case XOPEN:		/* process trying to open a special file */
@@ -289,6 +516,17 @@ PUBLIC int do_unpause()
 	case XPOPEN:		/* process trying to open a fifo */
 		break;
 
+	case XSELECT:		/* process waiting in select */
+		/* It may already be on its way to try again. */
+		if (rfp->fp_revived == REVIVING) {
+			rfp->fp_revived = NOT_REVIVING;
+			reviving--;
+		} else {
+			sel_count--;
+		}
+		rfp->fp_selecting = FALSE;
+		break;
+
 	default:		/* process trying to do device I/O (e.g. tty)*/
 		fild = (rfp->fp_fd >> 8) & BYTE;/* extract file descriptor */
 		if (fild < 0 || fild >= OPEN_MAX)panic("unpause err 2",NO_NUM);
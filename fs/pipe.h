@@ -0,0 +1,14 @@
+/* This is the table of in-core pipe buffers.  An unnamed pipe or a FIFO that
+ * owns one of these keeps its data here instead of in blocks on PIPE_DEV.
+ * The data forms a ring: 'pb_count' bytes starting at 'pb_rd'.
+ */
+#if NR_PIPE_BUFS > 0
+EXTERN struct pipe_buf {
+  struct inode *pb_inode;	/* pipe using this buffer, NIL_INODE if free */
+  unsigned pb_rd;		/* offset of the first unread byte */
+  unsigned pb_count;		/* number of unread bytes */
+  char pb_data[PIPE_BUF_SIZE];	/* the data itself */
+} pipe_buf[NR_PIPE_BUFS];
+#endif
+
+#define NIL_PBUF (struct pipe_buf *) 0	/* pipe is kept on PIPE_DEV */
@@ -65,8 +65,11 @@ _PROTOTYPE( int do_rename, (void)					);
 _PROTOTYPE( void truncate, (struct inode *rip)				);
 
 /* lock.c */
+_PROTOTYPE( void lock_init, (void)					);
 _PROTOTYPE( int lock_op, (struct filp *f, int req)			);
-_PROTOTYPE( void lock_revive, (void)					);
+_PROTOTYPE( void lock_release, (struct inode *rip)			);
+_PROTOTYPE( void lock_revive, (struct inode *rip, off_t first,
+							off_t last)	);
 
 /* main.c */
 _PROTOTYPE( void main, (void)						);
@@ -106,6 +109,11 @@ _PROTOTYPE( int do_pipe, (void)						);
 _PROTOTYPE( int do_unpause, (void)					);
 _PROTOTYPE( int pipe_check, (struct inode *rip, int rw_flag,
 			int oflags, int bytes, off_t position, int *canwrite));
+#if NR_PIPE_BUFS > 0
+_PROTOTYPE( void get_pipe_buf, (struct inode *rip)			);
+_PROTOTYPE( int pipe_rw, (struct inode *rip, int rw_flag, int oflags)	);
+_PROTOTYPE( void put_pipe_buf, (struct inode *rip)			);
+#endif
 _PROTOTYPE( void release, (struct inode *ip, int call_nr, int count)	);
 _PROTOTYPE( void revive, (int proc_nr, int bytes)			);
 _PROTOTYPE( void suspend, (int task)					);
@@ -130,6 +138,13 @@ _PROTOTYPE( block_t read_map, (struct inode *rip, off_t position)	);
 _PROTOTYPE( int read_write, (int rw_flag)				);
 _PROTOTYPE( zone_t rd_indir, (struct buf *bp, int index)		);
 
+/* select.c */
+_PROTOTYPE( int do_select, (void)					);
+_PROTOTYPE( int do_devready, (void)					);
+_PROTOTYPE( void select_dev, (int task, int minor)			);
+_PROTOTYPE( void select_inode, (struct inode *rip)			);
+_PROTOTYPE( void select_timeout, (void)					);
+
 /* stadir.c */
 _PROTOTYPE( int do_chdir, (void)					);
 _PROTOTYPE( int do_chroot, (void)					);
@@ -19,6 +19,7 @@
 #include "fproc.h"
 #include "inode.h"
 #include "param.h"
+#include "pipe.h"
 #include "super.h"
 
 #define FD_MASK          077	/* max file descriptor is 63 */
@@ -78,6 +79,9 @@ int rw_flag;			/* READING or WRITING */
   if (position + nbytes < position) return(EINVAL); /* unsigned overflow */
   oflags = f->filp_flags;
   rip = f->filp_ino;
+#if NR_PIPE_BUFS > 0
+  if (rip->i_pbuf != NIL_PBUF) return(pipe_rw(rip, rw_flag, oflags));
+#endif
   f_size = rip->i_size;
   r = OK;
   if (rip->i_pipe == I_PIPE) {
@@ -200,6 +204,7 @@ int rw_flag;			/* READING or WRITING */
 	if (rw_flag == READING) rip->i_update |= ATIME;
 	if (rw_flag == WRITING) rip->i_update |= CTIME | MTIME;
 	rip->i_dirt = DIRTY;		/* inode is thus now dirty */
+	if (rip->i_pipe == I_PIPE) select_inode(rip);
 	if (partial_pipe) {
 		partial_pipe = 0;
 			/* partial write on pipe with */
@@ -0,0 +1,401 @@
+/* This file deals with the SELECT system call.  A process selecting on a set
+ * of file descriptors is told at once which of them can be read or written
+ * without blocking.  If none can, the process is suspended until one of them
+ * becomes ready or the timeout runs out.  FS knows itself whether a pipe is
+ * ready, character special files are asked with a DEV_SELECT request.  A
+ * driver that has nothing to report yet remembers the question and sends a
+ * DEV_READY message as soon as the device becomes ready.  The suspended
+ * process is then revived like a process hanging on a pipe, and simply does
+ * the call again.
+ *
+ * The entry points into this file are
+ *   do_select:	     perform the SELECT system call
+ *   do_devready:    a device asked about earlier has become ready
+ *   select_dev:     revive the processes selecting on a device
+ *   select_inode:   revive the processes selecting on a pipe
+ *   select_timeout: the select alarm went off, revive timed out processes
+ */
+
+#include "fs.h"
+#include <fcntl.h>
+#include <sys/select.h>
+#include <minix/callnr.h>
+#include <minix/com.h>
+#include "dev.h"
+#include "file.h"
+#include "fproc.h"
+#include "inode.h"
+#include "param.h"
+#include "pipe.h"
+
+#define SEL_SETS	3	/* read, write and exception set */
+
+PRIVATE clock_t sel_alarm;	/* uptime the select alarm is set for, or 0 */
+PRIVATE message sel_mess;
+
+FORWARD _PROTOTYPE( int sel_check, (int fild, int ops, int notify)	);
+FORWARD _PROTOTYPE( int sel_waiting, (struct fproc *rfp, struct inode *rip,
+						int task, int minor)	);
+FORWARD _PROTOTYPE( clock_t sel_uptime, (void)				);
+FORWARD _PROTOTYPE( void sel_set_alarm, (clock_t when, clock_t now)	);
+
+
+/*===========================================================================*
+ *				do_select				     *
+ *===========================================================================*/
+PUBLIC int do_select()
+{
+/* Perform the select(nfds, readfds, writefds, exceptfds, timeout) system
+ * call.  The arguments are copied into the process table the first time
+ * around, so that a revived select can find them there.
+ */
+
+  register struct fproc *rfp;
+  int i, r, fild, ops, ready, nready, first, poll;
+  long bit, sets, out[SEL_SETS];
+  clock_t ticks, now;
+
+  rfp = fp;
+  first = !rfp->fp_selecting;
+  poll = FALSE;
+  ticks = 0;
+
+  if (first) {
+	if (sel_nfds < 0 || sel_nfds > FD_SETSIZE) return(EINVAL);
+	rfp->fp_selptr[0] = sel_rdfds;
+	rfp->fp_selptr[1] = sel_wrfds;
+	rfp->fp_selptr[2] = sel_exfds;
+	sets = 0;
+	for (i = 0; i < SEL_SETS; i++) {
+		rfp->fp_selfds[i] = 0;
+		if (rfp->fp_selptr[i] == NIL_PTR) continue;
+		r = sys_copy(who, D, (phys_bytes) rfp->fp_selptr[i],
+			FS_PROC_NR, D, (phys_bytes) &rfp->fp_selfds[i],
+			(phys_bytes) sizeof(long));
+		if (r != OK) return(r);
+
+		/* Descriptors from nfds on are ignored. */
+		if (sel_nfds < FD_SETSIZE)
+			rfp->fp_selfds[i] &= (1L << sel_nfds) - 1;
+		sets |= rfp->fp_selfds[i];
+	}
+
+	/* All the descriptors in the sets must be open. */
+	for (fild = 0; fild < sel_nfds; fild++) {
+		if (!(sets & (1L << fild))) continue;
+		if (fild >= OPEN_MAX || rfp->fp_filp[fild] == NIL_FILP)
+			return(EBADF);
+	}
+	rfp->fp_selnfds = MIN(sel_nfds, OPEN_MAX);
+
+	/* A negative number of seconds means there is no timeout.  So does a
+	 * timeout too long to count in clock ticks.
+	 */
+	rfp->fp_seltime = 0;
+	if (sel_sec >= 0 && sel_sec < LONG_MAX / HZ / 2) {
+		ticks = (clock_t) sel_sec * HZ
+			+ ((clock_t) sel_msec * HZ + 999) / 1000;
+		if (ticks == 0) poll = TRUE;
+	}
+	rfp->fp_selecting = TRUE;
+  }
+
+  /* See which descriptors are ready.  Drivers are asked to tell when they
+   * become ready only as long as nothing is ready yet.  A driver may say it
+   * is ready while the others are still asked, before the caller is
+   * suspended, so then the descriptors are looked at again.
+   */
+  do {
+	rfp->fp_selready = FALSE;
+	nready = 0;
+	for (i = 0; i < SEL_SETS; i++) out[i] = 0;
+	for (fild = 0; fild < rfp->fp_selnfds; fild++) {
+		bit = 1L << fild;
+		ops = 0;
+		if (rfp->fp_selfds[0] & bit) ops |= SEL_RD;
+		if (rfp->fp_selfds[1] & bit) ops |= SEL_WR;
+		if (rfp->fp_selfds[2] & bit) ops |= SEL_ERR;
+		if (ops == 0) continue;
+
+		ready = sel_check(fild, ops, !poll && nready == 0);
+		if (ready & SEL_RD) { out[0] |= bit; nready++; }
+		if (ready & SEL_WR) { out[1] |= bit; nready++; }
+		if (ready & SEL_ERR) { out[2] |= bit; nready++; }
+	}
+  } while (nready == 0 && !poll && rfp->fp_selready);
+
+  if (nready == 0 && !poll) {
+	if (first) {
+		if (ticks > 0) {
+			now = sel_uptime();
+			rfp->fp_seltime = now + ticks;
+			sel_set_alarm(rfp->fp_seltime, now);
+		}
+	} else {
+		/* Revived, maybe because the time is up. */
+		if (rfp->fp_seltime != 0 && sel_uptime() >= rfp->fp_seltime)
+			poll = TRUE;
+	}
+	if (!poll) {
+		suspend(XSELECT);
+		sel_count++;
+		return(OK);
+	}
+  }
+
+  /* Tell the caller which descriptors are ready. */
+  rfp->fp_selecting = FALSE;
+  for (i = 0; i < SEL_SETS; i++) {
+	if (rfp->fp_selptr[i] == NIL_PTR) continue;
+	r = sys_copy(FS_PROC_NR, D, (phys_bytes) &out[i],
+		who, D, (phys_bytes) rfp->fp_selptr[i], (phys_bytes) sizeof(long));
+	if (r != OK) return(r);
+  }
+  return(nready);
+}
+
+
+/*===========================================================================*
+ *				sel_check				     *
+ *===========================================================================*/
+PRIVATE int sel_check(fild, ops, notify)
+int fild;			/* file descriptor to check */
+int ops;			/* SEL_RD, SEL_WR and/or SEL_ERR */
+int notify;			/* ask the driver to report readiness later */
+{
+/* Find out which of the operations 'ops' will not block on descriptor 'fild'.
+ * Regular files are always ready, and so is everything that will give an
+ * error at once.
+ */
+
+  register struct filp *f;
+  register struct inode *rip;
+  int major, ready;
+  long room;
+  dev_t dev;
+
+  f = fp->fp_filp[fild];
+  rip = f->filp_ino;
+
+  if (rip->i_pipe == I_PIPE) {
+	ready = 0;
+
+	/* Readable if there is data, or no writer so read returns EOF. */
+	if ((ops & SEL_RD) && (rip->i_size > f->filp_pos
+			|| find_filp(rip, W_BIT) == NIL_FILP))
+		ready |= SEL_RD;
+
+	/* Writable if a write of PIPE_BUF bytes would go in at once, or if
+	 * there is no reader and a write fails with EPIPE.
+	 */
+	if (ops & SEL_WR) {
+#if NR_PIPE_BUFS > 0
+		if (rip->i_pbuf != NIL_PBUF)
+			room = PIPE_BUF_SIZE - rip->i_pbuf->pb_count;
+		else
+#endif
+			room = PIPE_SIZE - f->filp_pos;
+		if (room >= PIPE_BUF || find_filp(rip, R_BIT) == NIL_FILP)
+			ready |= SEL_WR;
+	}
+	return(ready);
+  }
+
+  if ((rip->i_mode & I_TYPE) != I_CHAR_SPECIAL || f->filp_mode == FILP_CLOSED)
+	return(ops & (SEL_RD | SEL_WR));
+
+  /* Ask the driver. */
+  dev = (dev_t) rip->i_zone[0];
+  major = (dev >> MAJOR) & BYTE;
+  if (major >= max_major) return(ops & (SEL_RD | SEL_WR));
+  sel_mess.m_type = DEV_SELECT;
+  sel_mess.DEVICE = (dev >> MINOR) & BYTE;
+  sel_mess.PROC_NR = who;
+  sel_mess.COUNT = ops | (notify ? SEL_NOTIFY : 0);
+  (*dmap[major].dmap_rw)(dmap[major].dmap_task, &sel_mess);
+
+  /* A driver that knows nothing of select lets the I/O call itself decide. */
+  if (sel_mess.REP_STATUS < 0) return(ops & (SEL_RD | SEL_WR));
+  return(sel_mess.REP_STATUS & ops);
+}
+
+
+/*===========================================================================*
+ *				do_devready				     *
+ *===========================================================================*/
+PUBLIC int do_devready()
+{
+/* A driver tells that a device that had nothing to report to an earlier
+ * select is now ready.  The selecting processes must look again.
+ */
+
+#if !ALLOW_USER_SEND
+  if (who >= LOW_USER) return(EPERM);
+#endif
+
+  select_dev(who, m.DEVICE);
+  dont_reply = TRUE;		/* don't reply to the driver */
+  return(OK);
+}
+
+
+/*===========================================================================*
+ *				select_dev				     *
+ *===========================================================================*/
+PUBLIC void select_dev(task, minor)
+int task;			/* task or server that handles the device */
+int minor;			/* minor device that has become ready */
+{
+/* Revive the processes that are suspended selecting on a minor device of
+ * 'task'.
+ */
+
+  register struct fproc *rp;
+
+  /* The caller of a select still busy looking must look once more. */
+  if (fp->fp_selecting && fp->fp_suspended != SUSPENDED &&
+			sel_waiting(fp, NIL_INODE, task, minor))
+	fp->fp_selready = TRUE;
+
+  if (sel_count == 0) return;
+  for (rp = &fproc[0]; rp < &fproc[NR_PROCS]; rp++) {
+	if (rp->fp_suspended == SUSPENDED &&
+			rp->fp_revived == NOT_REVIVING &&
+			-rp->fp_task == XSELECT &&
+			sel_waiting(rp, NIL_INODE, task, minor)) {
+		revive((int) (rp - fproc), 0);
+	}
+  }
+}
+
+
+/*===========================================================================*
+ *				select_inode				     *
+ *===========================================================================*/
+PUBLIC void select_inode(rip)
+struct inode *rip;		/* pipe that has been read, written or closed */
+{
+/* Revive the processes that are suspended selecting on pipe 'rip'. */
+
+  register struct fproc *rp;
+
+  if (sel_count == 0) return;
+  for (rp = &fproc[0]; rp < &fproc[NR_PROCS]; rp++) {
+	if (rp->fp_suspended == SUSPENDED &&
+			rp->fp_revived == NOT_REVIVING &&
+			-rp->fp_task == XSELECT &&
+			sel_waiting(rp, rip, 0, 0)) {
+		revive((int) (rp - fproc), 0);
+	}
+  }
+}
+
+
+/*===========================================================================*
+ *				sel_waiting				     *
+ *===========================================================================*/
+PRIVATE int sel_waiting(rfp, rip, task, minor)
+struct fproc *rfp;		/* process suspended in select */
+struct inode *rip;		/* pipe, or NIL_INODE for a device */
+int task;			/* task of the device */
+int minor;			/* minor device number */
+{
+/* Check if the suspended select of 'rfp' includes pipe 'rip', or, if 'rip' is
+ * NIL_INODE, minor device 'minor' of 'task'.  /dev/tty is followed to the
+ * controlling terminal, which is the device that reports.
+ */
+
+  register struct inode *ip;
+  int fild, major;
+  long sets;
+  dev_t dev;
+
+  sets = rfp->fp_selfds[0] | rfp->fp_selfds[1] | rfp->fp_selfds[2];
+  for (fild = 0; fild < rfp->fp_selnfds; fild++) {
+	if (!(sets & (1L << fild))) continue;
+	ip = rfp->fp_filp[fild]->filp_ino;
+	if (rip != NIL_INODE) {
+		if (ip == rip) return(TRUE);
+		continue;
+	}
+	if ((ip->i_mode & I_TYPE) != I_CHAR_SPECIAL) continue;
+	dev = (dev_t) ip->i_zone[0];
+	major = (dev >> MAJOR) & BYTE;
+	if (major >= max_major) continue;
+	if (dmap[major].dmap_rw == call_ctty) {
+		dev = rfp->fp_tty;
+		major = (dev >> MAJOR) & BYTE;
+	}
+	if (dmap[major].dmap_task == task && ((dev >> MINOR) & BYTE) == minor)
+		return(TRUE);
+  }
+  return(FALSE);
+}
+
+
+/*===========================================================================*
+ *				select_timeout				     *
+ *===========================================================================*/
+PUBLIC void select_timeout()
+{
+/* The synchronous alarm has gone off.  Revive the selects whose time is up,
+ * and set the alarm again for the first of the others.
+ */
+
+  register struct fproc *rp;
+  clock_t now, next;
+
+  sel_alarm = 0;
+  if (sel_count == 0) return;
+  now = sel_uptime();
+  next = 0;
+  for (rp = &fproc[0]; rp < &fproc[NR_PROCS]; rp++) {
+	if (rp->fp_suspended != SUSPENDED ||
+			rp->fp_revived == REVIVING ||
+			-rp->fp_task != XSELECT ||
+			rp->fp_seltime == 0) continue;
+	if (rp->fp_seltime <= now)
+		revive((int) (rp - fproc), 0);
+	else
+	if (next == 0 || rp->fp_seltime < next)
+		next = rp->fp_seltime;
+  }
+  if (next != 0) sel_set_alarm(next, now);
+}
+
+
+/*===========================================================================*
+ *				sel_uptime				     *
+ *===========================================================================*/
+PRIVATE clock_t sel_uptime()
+{
+/* Ask the clock task for the number of ticks since boot. */
+
+  int r;
+
+  sel_mess.m_type = GET_UPTIME;
+  if ((r = sendrec(CLOCK, &sel_mess)) != OK) panic("sel_uptime err", r);
+  return((clock_t) sel_mess.NEW_TIME);
+}
+
+
+/*===========================================================================*
+ *				sel_set_alarm				     *
+ *===========================================================================*/
+PRIVATE void sel_set_alarm(when, now)
+clock_t when;			/* uptime at which a select times out */
+clock_t now;			/* uptime now */
+{
+/* FS has one synchronous alarm for all selects.  Make sure it goes off no
+ * later than 'when'.
+ */
+
+  int r;
+
+  if (sel_alarm != 0 && sel_alarm <= when) return;
+  sel_alarm = when;
+  sel_mess.m_type = SET_SYNC_AL;
+  sel_mess.CLOCK_PROC_NR = FS_PROC_NR;
+  sel_mess.DELTA_TICKS = when > now ? when - now : 1;
+  if ((r = sendrec(CLOCK, &sel_mess)) != OK) panic("sel_set_alarm err", r);
+}
@@ -13,6 +13,7 @@
 #include "fproc.h"
 #include "inode.h"
 #include "lock.h"
+#include "pipe.h"
 #include "super.h"
 
 PUBLIC _PROTOTYPE (int (*call_vector[NCALLS]), (void) ) = {
@@ -73,7 +74,7 @@ PUBLIC _PROTOTYPE (int (*call_vector[NCALLS]), (void) ) = {
 	do_ioctl,	/* 54 = ioctl	*/
 	do_fcntl,	/* 55 = fcntl	*/
 	no_sys,		/* 56 = (mpx)	*/
-	no_sys,		/* 57 = unused	*/
+	do_select,	/* 57 = select	*/
 	no_sys,		/* 58 = unused	*/
 	do_exec,	/* 59 = execve	*/
 	do_umask,	/* 60 = umask	*/
@@ -86,7 +87,7 @@ PUBLIC _PROTOTYPE (int (*call_vector[NCALLS]), (void) ) = {
 	no_sys, 	/* 66 = unused  */
 	do_revive,	/* 67 = REVIVE	*/
 	no_sys,		/* 68 = TASK_REPLY	*/
-	no_sys,		/* 69 = unused */
+	do_devready,	/* 69 = DEV_READY */
 	no_sys,		/* 70 = unused */
 	no_sys,		/* 71 = SIGACTION */
 	no_sys,		/* 72 = SIGSUSPEND */
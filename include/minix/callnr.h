@@ -44,6 +44,7 @@
 #define SIGNAL		  48
 #define IOCTL		  54
 #define FCNTL		  55
+#define SELECT		  57
 #define EXEC		  59
 #define UMASK		  60 
 #define CHROOT		  61 
@@ -55,6 +56,7 @@
 #define UNPAUSE		  65	/* to MM or FS: check for EINTR */
 #define REVIVE	 	  67	/* to FS: revive a sleeping process */
 #define TASK_REPLY	  68	/* to FS: reply code from tty task */
+#define DEV_READY	  69	/* to FS: a device is ready for select */
 
 /* Posix signal handling. */
 #define SIGACTION	  71
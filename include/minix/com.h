@@ -27,6 +27,7 @@
 #	define SCATTERED_IO 8	/* fcn code for multiple reads/writes */
 #	define TTY_SETPGRP  9	/* fcn code for setpgroup */
 #	define TTY_EXIT	   10	/* a process group leader has exited */	
+#	define DEV_SELECT   11	/* fcn code for select readiness */
 #	define OPTIONAL_IO 16	/* modifier to DEV_* codes within vector */
 #	define SUSPEND	 -998	/* used in interrupts when tty has no data */
 
@@ -38,6 +39,16 @@
 #	define DL_INIT		7
 #	define DL_STOP		8
 #	define DL_GETSTAT	9
+#	define DL_READB		10
+#	define DL_WRITEB	11
+
+/* DL_READB and DL_WRITEB move several frames in one request.  DL_ADDR points
+ * to DL_COUNT iovec_t entries.  Each frame starts with an entry that has the
+ * number of fragments that follow in iov_size.  A DL_READB reply stores the
+ * length of each frame in iov_addr of that entry and the number of frames in
+ * DL_COUNT.  DL_SENT(DL_STAT) of a DL_WRITEB reply is the number of frames
+ * taken.
+ */
 
 /* Message type for data link layer replies. */
 #	define DL_INIT_REPLY	20
@@ -55,6 +66,8 @@
 #	define DL_PACK_SEND	0x01
 #	define DL_PACK_RECV	0x02
 #	define DL_READ_IP	0x04
+#	define DL_SENT_SHIFT	8
+#	define DL_SENT(stat)	(((stat) >> DL_SENT_SHIFT) & 0xff)
 
 /* Bits in `DL_MODE' field of DL requests. */
 #	define DL_NOMODE	0x0
@@ -68,6 +81,7 @@
 #	define NW_WRITE		DEV_WRITE
 #	define NW_IOCTL		DEV_IOCTL
 #	define NW_CANCEL	CANCEL
+#	define NW_SELECT	DEV_SELECT
 
 #define	FBDEV		(CDROM - ENABLE_FBDEV)
 				/* frame buffer device task */
@@ -81,9 +95,12 @@
 #define SCSI		(WINCHESTER - ENABLE_SCSI)
 				/* scsi device task */
 
-#define WINCHESTER	(DL_ETH - ENABLE_WINI)
+#define WINCHESTER	(RTL8139 - ENABLE_WINI)
 				/* winchester (hard) disk class */
 
+#define RTL8139		(DL_ETH - ENABLE_PCI_ETH)
+				/* PCI ethernet task, same messages as DL_ETH */
+
 #define DL_ETH		(SYN_ALRM_TASK - ENABLE_NETWORKING)
 				/* networking task */
 
@@ -155,6 +172,12 @@
 #define POSITION       m2_l1	/* file offset */
 #define ADDRESS        m2_p1	/* core buffer address */
 
+/* Bits in the COUNT field of a DEV_SELECT request and in the reply status. */
+#define SEL_RD		0x01	/* ready for reading */
+#define SEL_WR		0x02	/* ready for writing */
+#define SEL_ERR		0x04	/* exceptional condition pending */
+#define SEL_NOTIFY	0x08	/* send DEV_READY to FS when ready later */
+
 /* Names of message fields for messages to TTY task. */
 #define TTY_LINE       DEVICE	/* message parameter: terminal line */
 #define TTY_REQUEST    COUNT	/* message parameter: ioctl request code */
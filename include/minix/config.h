@@ -60,6 +60,23 @@
 #define NR_BUF_HASH	2048	/* size of buf hash table; MUST BE POWER OF 2*/
 #endif
 
+/* Pipes and FIFOs keep their data in an in-core buffer of the file system
+ * if one is free, otherwise in blocks on PIPE_DEV.  PIPE_BUF_SIZE must be at
+ * least PIPE_BUF from <limits.h>.  Set NR_PIPE_BUFS to 0 to always use disk.
+ */
+#if (MACHINE == IBM_PC && _WORD_SIZE == 2)
+#define NR_PIPE_BUFS       0	/* no room in a 64K FS data segment */
+#endif
+
+#if (MACHINE == IBM_PC && _WORD_SIZE == 4)
+#define NR_PIPE_BUFS       8	/* # in-core pipe buffers */
+#define PIPE_BUF_SIZE  16384	/* bytes per in-core pipe buffer */
+#endif
+
+#ifndef NR_PIPE_BUFS
+#define NR_PIPE_BUFS       0
+#endif
+
 /* Defines for kernel configuration. */
 #define AUTO_BIOS          1	/* xt_wini.c - use Western's autoconfig BIOS */
 #define LINEWRAP           1	/* console.c - wrap lines at column 80 */
@@ -71,6 +88,7 @@
 
 /* Include or exclude device drivers.  Set to 1 to include, 0 to exclude. */
 #define ENABLE_NETWORKING  1	/* enable TCP/IP code */
+#define ENABLE_RTL8139     1	/* enable RTL8139 PCI ethernet driver */
 #define ENABLE_AT_WINI     1	/* enable AT winchester driver */
 #define ENABLE_BIOS_WINI   1	/* enable BIOS winchester driver */
 #define ENABLE_ESDI_WINI   0	/* enable ESDI winchester driver */
@@ -96,6 +114,18 @@
 #define	NR_RS_LINES	   2	/* # rs232 terminals (0, 1, or 2) */
 #define	NR_PTYS		   2	/* # pseudo terminals (0 to 64) */
 
+/* RS232 lines on a 16550A UART use its 16 byte FIFOs.  At 19200 baud and up
+ * the receiver interrupts when RS_FIFO_TRIGGER bytes (1, 4, 8 or 14) have
+ * arrived, slower lines interrupt for each byte to keep echo snappy.
+ * RS_BUFSIZE is the size of both the input and output buffer of a line.
+ */
+#define RS_FIFO_TRIGGER    8
+#if _WORD_SIZE == 2
+#define RS_BUFSIZE      1024
+#else
+#define RS_BUFSIZE      4096
+#endif
+
 #if (MACHINE == ATARI)
 /* The next define says if you have an ATARI ST or TT */
 #define ATARI_TYPE	  TT
@@ -169,6 +199,8 @@
 #define ENABLE_FBDEV	1
 #define ENABLE_CDROM	(ENABLE_MITSUMI_CDROM)
 #define ENABLE_AUDIO	(ENABLE_SB_AUDIO)
+#define ENABLE_PCI	(_WORD_SIZE == 4)
+#define ENABLE_PCI_ETH	(ENABLE_NETWORKING && ENABLE_PCI && ENABLE_RTL8139)
 #endif
 
 #if (MACHINE == ATARI) || (MACHINE == AMIGA) || (MACHINE == MACINTOSH)
@@ -52,7 +52,8 @@
 
 /* Number of tasks. */
 #define NR_TASKS	(9 + ENABLE_WINI + ENABLE_SCSI + ENABLE_CDROM \
-			+ ENABLE_FBDEV + ENABLE_NETWORKING + 2 * ENABLE_AUDIO)
+			+ ENABLE_FBDEV + ENABLE_NETWORKING + ENABLE_PCI_ETH \
+			+ 2 * ENABLE_AUDIO)
 
 /* Memory is allocated in clicks. */
 #if (CHIP == INTEL)
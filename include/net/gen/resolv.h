@@ -29,6 +29,14 @@
 #define _PATH_RESCONF        "/etc/resolv.conf"
 #endif
 
+/*
+ * Process id of the caching name daemon, if it runs.  The resolver then
+ * asks it first.
+ */
+#ifndef _PATH_NONAMED
+#define _PATH_NONAMED        "/etc/nonamed.pid"
+#endif
+
 /*
  * Global defines and variables for resolver stub.
  */
@@ -46,4 +46,11 @@ typedef struct nwio_tcpopt
 	long nwto_flags;
 } nwio_tcpopt_t;
 
+#define NWTO_NOFLAG		0x0000L
+#define NWTO_SND_DELAY_MASK	0x0001L
+#	define NWTO_SND_NODELAY	0x00000001L	/* send small segments
+							 * at once */
+#	define NWTO_SND_DELAY	0x00010000L	/* hold them back while
+							 * data is unacked */
+
 #endif /* __SERVER__IP__GEN__TCP_IO_H__ */
@@ -12,7 +12,10 @@ typedef int asynchio_t;
 
 #define ASYN_NONBLOCK	0x01
 
+#ifndef _STRUCT_TIMEVAL
+#define _STRUCT_TIMEVAL
 struct timeval { long tv_sec, tv_usec; };
+#endif
 
 #define EINPROGRESS	EINTR
 
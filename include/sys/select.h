@@ -0,0 +1,35 @@
+/* The <sys/select.h> header is used by the select() call, which waits until
+ * one of a set of file descriptors is ready for reading or writing.
+ */
+
+#ifndef _SELECT_H
+#define _SELECT_H
+
+/* A file descriptor set is a bit map with one bit per descriptor.  FD_SETSIZE
+ * is larger than OPEN_MAX, so one long is enough.
+ */
+#define FD_SETSIZE	32
+
+typedef struct {
+  unsigned long fds_bits[1];
+} fd_set;
+
+#define FD_ZERO(s)	((s)->fds_bits[0] = 0)
+#define FD_SET(n, s)	((s)->fds_bits[0] |= 1L << (n))
+#define FD_CLR(n, s)	((s)->fds_bits[0] &= ~(1L << (n)))
+#define FD_ISSET(n, s)	(((s)->fds_bits[0] & (1L << (n))) != 0)
+
+#ifndef _STRUCT_TIMEVAL
+#define _STRUCT_TIMEVAL
+struct timeval { long tv_sec, tv_usec; };
+#endif
+
+/* Function Prototypes. */
+#ifndef _ANSI_H
+#include <ansi.h>
+#endif
+
+_PROTOTYPE( int select, (int _nfds, fd_set *_readfds, fd_set *_writefds,
+				fd_set *_exceptfds, struct timeval *_timeout) );
+
+#endif /* _SELECT_H */
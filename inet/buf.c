@@ -19,31 +19,59 @@ extern enqueue_problem;
 
 #define USE_MALLOCS	0
 
-#ifndef BUF512_NR
-#define BUF512_NR	(sizeof(int) == 2 ? 40 : 128)
+/* Packet memory is a single pool, carved up at startup into buffers of a
+ * few size classes.  A request is served by the smallest class that holds
+ * it, so a full ethernet frame gets one contiguous buffer and a header gets
+ * a small one.  Every buffer but the last of a chain holds at least BUF_S
+ * bytes, the contiguity bf_packIffLess() promises.  BUF_MEM is the size of
+ * the pool, with USE_MALLOCS it is halved until malloc succeeds.
+ */
+#ifndef BUF_MEM
+#define BUF_MEM		(sizeof(int) == 2 ? 20*1024L : 96*1024L)
 #endif
 
 #define ACC_NR		200
 #define CLIENT_NR	5
 
-typedef struct buf512
+/* bf_append() copies small pieces together to keep chains short.  Larger
+ * pieces are linked as they are, so data from a user process stays in the
+ * buffers it was copied into until the driver copies it to the card, and
+ * the other way around.
+ */
+#define BF_MERGE_MAX	(BUF_S/4)
+
+typedef struct bf_class
+{
+	size_t bc_size;		/* data bytes in a buffer of this class */
+	int bc_share;		/* share of the pool, in 1/8ths */
+	int bc_nr;		/* number of buffers */
+	buf_t *bc_free;		/* free list, linked through buf_next */
+	int bc_inuse;		/* buffers currently allocated */
+	int bc_maxuse;		/* high water mark of bc_inuse */
+	unsigned long bc_alloc;	/* successful allocations */
+	unsigned long bc_fail;	/* wanted this class, but it was empty */
+} bf_class_t;
+
+PRIVATE unsigned long bf_copied;	/* bytes copied between buffers */
+
+PRIVATE bf_class_t bf_classes[]=
 {
-	buf_t buf_header;
-	char buf_data[512];
-} buf512_t;
+	{ 128,		1 },
+	{ BUF_S,	3 },
+	{ 2048,		4 },	/* a full ethernet frame */
+};
+#define BF_CLASS_NR	(sizeof(bf_classes)/sizeof(bf_classes[0]))
 
 #if USE_MALLOCS
-PRIVATE buf512_t *buffers512;
+PRIVATE char *bf_mem;
 PRIVATE acc_t *accessors;
 #else
-PRIVATE buf512_t buffers512[BUF512_NR];
+PRIVATE char bf_mem[BUF_MEM];
 PRIVATE acc_t accessors[ACC_NR];
 #endif
-
-PRIVATE buf512_t *buf512_free;
+PRIVATE size_t bf_mem_size;
 
 PRIVATE bf_freereq_t freereq[CLIENT_NR];
-PRIVATE size_t bf_buf_gran;
 PRIVATE acc_t *acc_free_list;
 
 PUBLIC size_t bf_free_buffsize;
@@ -67,56 +95,64 @@ PUBLIC char *bf_bufsize_file;
 PUBLIC int bf_bufsize_line;
 #endif
 
-FORWARD acc_t *bf_small_memreq ARGS(( size_t size ));
-FORWARD void bf_512free ARGS(( buf_t *buffer ));
+FORWARD bf_class_t *bf_find_class ARGS(( size_t size ));
+FORWARD buf_t *bf_get_buf ARGS(( size_t size ));
+FORWARD void bf_class_free ARGS(( buf_t *buffer ));
 
 PUBLIC void bf_init()
 {
-	int i;
-	size_t size;
-	size_t buf_s;
-
-	bf_buf_gran= BUF_S;
-	buf_s= 0;
+	int i, c;
+	size_t size, share;
+	char *mem;
+	bf_class_t *bc;
+	buf_t *buf;
 
 #if USE_MALLOCS
-	printf("buf.c: malloc %d 32K-buffers (%dK)\n", BUF32K_NR, 
-		sizeof(*buffers32K) * BUF32K_NR / 1024);
-	buffers32K= malloc(sizeof(*buffers32K) * BUF32K_NR);
-	if (!buffers32K)
-		ip_panic(( "unable to alloc 32K-buffers" ));
-	printf("buf.c: malloc %d 2K-buffers (%dK)\n", BUF2K_NR, 
-		sizeof(*buffers2K) * BUF2K_NR / 1024);
-	buffers2K= malloc(sizeof(*buffers2K) * BUF2K_NR);
-	if (!buffers2K)
-		ip_panic(( "unable to alloc 2K-buffers" ));
-	printf("buf.c: malloc %d 512-buffers (%dK)\n", BUF512_NR, 
-		sizeof(*buffers512) * BUF512_NR / 1024);
-	buffers512= malloc(sizeof(*buffers512) * BUF512_NR);
-	if (!buffers512)
-		ip_panic(( "unable to alloc 512-buffers" ));
-	printf("buf.c: malloc %d accessors (%dK)\n", ACC_NR, 
-		sizeof(*accessors) * ACC_NR / 1024);
+	for (bf_mem_size= BUF_MEM; bf_mem_size >= 4*1024; bf_mem_size /= 2)
+	{
+		bf_mem= malloc(bf_mem_size);
+		if (bf_mem)
+			break;
+	}
+	if (!bf_mem)
+		ip_panic(( "unable to alloc buffer pool" ));
+	printf("buf.c: %dK buffer pool\n", bf_mem_size / 1024);
 	accessors= malloc(sizeof(*accessors) * ACC_NR);
 	if (!accessors)
 		ip_panic(( "unable to alloc accessors" ));
+#else
+	bf_mem_size= sizeof(bf_mem);
 #endif
 
-	for (i=0;i<BUF512_NR;i++)
+	mem= bf_mem;
+	for (c= 0; c<BF_CLASS_NR; c++)
 	{
-		buffers512[i].buf_header.buf_linkC= 0;
-		buffers512[i].buf_header.buf_next= &buffers512[i+1];
-		buffers512[i].buf_header.buf_free= bf_512free;
-		buffers512[i].buf_header.buf_size= sizeof(buffers512[i].
-			buf_data);
-		buffers512[i].buf_header.buf_data_p= buffers512[i].buf_data;
+		bc= &bf_classes[c];
+		size= sizeof(buf_t) + bc->bc_size;
+		share= bf_mem_size / 8 * bc->bc_share;
+		bc->bc_nr= share / size;
+		if (!bc->bc_nr)
+			bc->bc_nr= 1;
+		bc->bc_free= 0;
+		bc->bc_inuse= 0;
+		bc->bc_maxuse= 0;
+		bc->bc_alloc= 0;
+		bc->bc_fail= 0;
+		for (i= 0; i<bc->bc_nr; i++)
+		{
+			if (mem + size > bf_mem + bf_mem_size)
+				break;
+			buf= (buf_t *)mem;
+			mem += size;
+			buf->buf_linkC= 0;
+			buf->buf_free= bf_class_free;
+			buf->buf_size= bc->bc_size;
+			buf->buf_data_p= (char *)(buf+1);
+			buf->buf_next= bc->bc_free;
+			bc->bc_free= buf;
+		}
+		bc->bc_nr= i;
 	}
-	buffers512[i-1].buf_header.buf_next= 0;
-	buf512_free= &buffers512[0];
-	if (sizeof(buffers512[0].buf_data) < bf_buf_gran)
-		bf_buf_gran= sizeof(buffers512[0].buf_data);
-	if (sizeof(buffers512[0].buf_data) > buf_s)
-		buf_s= sizeof(buffers512[0].buf_data);
 
 	for (i=0;i<ACC_NR;i++)
 	{
@@ -129,7 +165,8 @@ PUBLIC void bf_init()
 	for (i=0;i<CLIENT_NR;i++)
 		freereq[i]=0;
 
-	assert (buf_s == BUF_S);
+	assert (bf_classes[1].bc_size == BUF_S && bf_classes[1].bc_nr);
+	assert (bf_classes[BF_CLASS_NR-1].bc_size >= ETH_MAX_PACK_SIZE);
 }
 
 PUBLIC void bf_logon(func)
@@ -198,46 +235,31 @@ assert (size>0);
  { where(); printf("got accessor %d\n", new_acc-accessors); }
 #endif
 		new_acc->acc_linkC= 1;
-		new_acc->acc_buffer= 0;
-
-#if DEBUG & 256
- { where(); printf("looking for 512 byte buffer\n"); }
-#endif
-		if (buf512_free)
-		{
-			buf512_t *buf512;
+		new_acc->acc_buffer= bf_get_buf(size);
 
-#if DEBUG & 256
- { where(); printf("found a 512 byte buffer\n"); }
-#endif
-			buf512= buf512_free;
-			buf512_free= buf512->buf_header.buf_next;
-assert (!buf512->buf_header.buf_linkC);
-			buf512->buf_header.buf_linkC= 1;
-assert (buf512->buf_header.buf_free == bf_512free);
-assert (buf512->buf_header.buf_size == sizeof(buf512->buf_data));
-assert (buf512->buf_header.buf_data_p == buf512->buf_data);
-			new_acc->acc_buffer= &buf512->buf_header;
-			buf512->buf_header.buf_next= buf512;
-		}
-#if DEBUG
-		else
- { where(); printf("unable to find a 512 byte buffer\n"); }
-#endif
 		if (!new_acc->acc_buffer)
 		{
 #if DEBUG
  { where(); printf("freeing buffers\n"); }
 #endif
-			bf_free_buffsize= 0;
-			for (i=0; bf_free_buffsize<size && i<MAX_BUFREQ_PRI;
+			/* Freed buffers of the wrong size do not help, ask
+			 * until a usable one shows up.
+			 */
+			new_acc->acc_next= acc_free_list;
+			acc_free_list= new_acc;
+			for (i=0; !bf_find_class(size) && i<MAX_BUFREQ_PRI;
 				i++)
-				for (j=0; bf_free_buffsize<size && j<CLIENT_NR;
+			{
+				for (j=0; !bf_find_class(size) && j<CLIENT_NR;
 					j++)
+				{
+					bf_free_buffsize= 0;
 					if (freereq[j])
 						(*freereq[j])(i, size);
+				}
+			}
 
-			if (bf_free_buffsize<size)
+			if (!bf_find_class(size))
 				ip_panic(( "not enough buffers freed" ));
 
 			continue;
@@ -268,110 +290,6 @@ bf_chkbuf(head);
 	return head;
 }
 
-/*
-bf_small_memreq
-*/
-
-PRIVATE acc_t *bf_small_memreq(size)
-size_t size;
-{
-	acc_t *head, *tail, *new_acc;
-	int i,j;
-	size_t count;
-
-#if TRACE_ENQUEUE_PROBLEM
- { if (enqueue_problem)
-  { where(); printf("bf_small_memreq(%d) called with enqueue_problem\n", size);
-	} }
-#endif
-#if DEBUG & 256
- { where(); printf("bf_small_memreq(%d)\n", size); }
-#endif
-
-assert (size>0);
-
-	head= NULL;
-	while (size)
-	{
-		if (!acc_free_list)
-		{
-#if DEBUG
- { where(); printf("freeing accessors\n"); }
-#endif
-			for (i=0; !acc_free_list && i<MAX_BUFREQ_PRI; i++)
-			{
-				for (j=0; !acc_free_list && j<CLIENT_NR; j++)
-				{
-					bf_free_buffsize= 0;
-					if (freereq[j])
-						(*freereq[j])(i, BUF_S);
-				}
-			}
-		}
-		new_acc= acc_free_list;
-		if (!new_acc)
-			ip_panic(( "buf.c: out of accessors" ));
-		acc_free_list= new_acc->acc_next;
-#if DEBUG & 256
- { where(); printf("got accessor %d\n", new_acc-accessors); }
-#endif
-		new_acc->acc_linkC= 1;
-
-		if (size >= sizeof(buf512_free->buf_data))
-		{
-			if (buf512_free)
-			{
-				buf512_t *buf512;
-
-#if DEBUG & 256
- { where(); printf("found a 512 byte buffer\n"); }
-#endif
-				buf512= buf512_free;
-				buf512_free= buf512->buf_header.buf_next;
-assert (!buf512->buf_header.buf_linkC);
-				buf512->buf_header.buf_linkC= 1;
-assert (buf512->buf_header.buf_free == bf_512free);
-assert (buf512->buf_header.buf_size == sizeof(buf512->buf_data));
-assert (buf512->buf_header.buf_data_p == buf512->buf_data);
-				new_acc->acc_buffer= &buf512->buf_header;
-				buf512->buf_header.buf_next= buf512;
-			}
-			else
-				break;
-		}
-		else
-			break;
-
-		if (!head)
-			head= new_acc;
-		else
-			tail->acc_next= new_acc;
-		tail= new_acc;
-
-		count= tail->acc_buffer->buf_size;
-		if (count > size)
-			count= size;
-
-		tail->acc_offset= 0;
-		tail->acc_length=  count;
-		size -= count;
-	}
-	if (size)
-	{
-		new_acc->acc_linkC= 0;
-		new_acc->acc_next= acc_free_list;
-		acc_free_list= new_acc;
-		new_acc= bf_memreq(size);
-		if (!head)
-			head= new_acc;
-		else
-			tail->acc_next= new_acc;
-	}
-	else
-		tail->acc_next= 0;
-	return head;
-}
-
 PUBLIC void bf_afree(acc_ptr)
 acc_t *acc_ptr;
 {
@@ -539,6 +457,7 @@ assert (offset_new < acc_ptr_new->acc_length);
 		offset_new += block_size;
 		offset_old += block_size;
 		size -= block_size;
+		bf_copied += block_size;
 	}
 	bf_afree(old_acc);
 	return new_acc;
@@ -702,14 +621,15 @@ acc_t  *data_second;
 	if (!data_second)
 		return head;
 
-	if (tail->acc_length + data_second->acc_length >
+	if (data_second->acc_length > BF_MERGE_MAX ||
+		tail->acc_length + data_second->acc_length >
 		tail->acc_buffer->buf_size)
 	{
 		tail->acc_next= data_second;
 		return head;
 	}
 
-	if (tail->acc_buffer->buf_size == bf_buf_gran && 
+	if (tail->acc_buffer->buf_free == bf_class_free && 
 		tail->acc_buffer->buf_linkC == 1)
 	{
 		if (tail->acc_offset)
@@ -717,10 +637,12 @@ acc_t  *data_second;
 			memmove(tail->acc_buffer->buf_data_p,
 				ptr2acc_data(tail), tail->acc_length);
 			tail->acc_offset= 0;
+			bf_copied += tail->acc_length;
 		}
 		dst_ptr= ptr2acc_data(tail) + tail->acc_length;
 		src_ptr= ptr2acc_data(data_second);
 		memcpy(dst_ptr, src_ptr, data_second->acc_length);
+		bf_copied += data_second->acc_length;
 		tail->acc_length += data_second->acc_length;
 		tail->acc_next= data_second->acc_next;
 		if (data_second->acc_next)
@@ -729,7 +651,17 @@ acc_t  *data_second;
 		return head;
 	}
 
-	new_acc= bf_small_memreq(tail->acc_length+data_second->acc_length);
+	/* The tail is shared, copying both into a new buffer only pays off
+	 * when they are small.
+	 */
+	if (tail->acc_length > BF_MERGE_MAX)
+	{
+		tail->acc_next= data_second;
+		return head;
+	}
+
+	new_acc= bf_memreq(tail->acc_length+data_second->acc_length);
+	bf_copied += tail->acc_length+data_second->acc_length;
 	acc_ptr_new= new_acc;
 	offset_old= 0;
 	offset_new= 0;
@@ -793,14 +725,71 @@ assert (offset_old < data_second->acc_length);
 	return head;
 }
 
-PRIVATE void bf_512free(buffer)
+/*
+bf_find_class
+
+Return the class a buffer for (the next part of) a request of size bytes
+would come from, or 0 if there is none.  The smallest class that holds all
+of it is best.  Failing that, a larger one, and then a smaller one that is
+still at least BUF_S bytes.
+*/
+
+PRIVATE bf_class_t *bf_find_class(size)
+size_t size;
+{
+	int c;
+
+	for (c= 0; c<BF_CLASS_NR-1 && bf_classes[c].bc_size < size; c++)
+		;
+	for (; c<BF_CLASS_NR; c++)
+		if (bf_classes[c].bc_free)
+			return &bf_classes[c];
+	for (c= BF_CLASS_NR-1; c >= 0; c--)
+	{
+		if (bf_classes[c].bc_size < size &&
+			bf_classes[c].bc_size >= BUF_S && bf_classes[c].bc_free)
+			return &bf_classes[c];
+	}
+	return 0;
+}
+
+PRIVATE buf_t *bf_get_buf(size)
+size_t size;
+{
+	bf_class_t *bc, *best;
+	buf_t *buf;
+
+	for (best= bf_classes; best < &bf_classes[BF_CLASS_NR-1] &&
+		best->bc_size < size; best++)
+		;
+	bc= bf_find_class(size);
+	if (bc != best)
+		best->bc_fail++;
+	if (!bc)
+		return 0;
+
+	buf= bc->bc_free;
+	bc->bc_free= buf->buf_next;
+assert (!buf->buf_linkC);
+assert (buf->buf_free == bf_class_free);
+assert (buf->buf_size == bc->bc_size);
+	buf->buf_linkC= 1;
+	buf->buf_next= bc;
+	bc->bc_alloc++;
+	if (++bc->bc_inuse > bc->bc_maxuse)
+		bc->bc_maxuse= bc->bc_inuse;
+	return buf;
+}
+
+PRIVATE void bf_class_free(buffer)
 buf_t *buffer;
 {
-	buf512_t *buf512;
+	bf_class_t *bc;
 
-	buf512= buffer->buf_next;
-	buf512->buf_header.buf_next= buf512_free;
-	buf512_free= buf512;
+	bc= buffer->buf_next;
+	bc->bc_inuse--;
+	buffer->buf_next= bc->bc_free;
+	bc->bc_free= buffer;
 }
 
 PUBLIC void bf_check_all_bufs()
@@ -809,7 +798,8 @@ PUBLIC void bf_check_all_bufs()
 	int accs;
 	acc_t *acc;
 	int bufs;
-	buf512_t *buf512;
+	buf_t *buf;
+	bf_class_t *bc;
 
 	for (j=0; j<CLIENT_NR; j++)
 	{
@@ -822,13 +812,17 @@ PUBLIC void bf_check_all_bufs()
 	for(acc= acc_free_list; acc; acc= acc->acc_next)
 		accs++;
 	printf("number of free accs is %d, expected %d\n", accs, ACC_NR);
+	printf("%lu bytes copied between buffers\n", bf_copied);
 
-	/* Check the number of 512 byte buffers */
-	bufs= 0;
-	for(buf512= buf512_free; buf512; buf512= 
-					(buf512_t *)buf512->buf_header.buf_next)
-		bufs++;
-
-	printf("number of free 512 byte buffers is %d, expected %d\n", bufs, 
-		BUF512_NR);
+	/* Check the number of buffers in each class */
+	for (bc= bf_classes; bc < &bf_classes[BF_CLASS_NR]; bc++)
+	{
+		bufs= 0;
+		for(buf= bc->bc_free; buf; buf= buf->buf_next)
+			bufs++;
+		printf("%d byte buffers: %d free, expected %d, max used %d, ",
+			bc->bc_size, bufs, bc->bc_nr, bc->bc_maxuse);
+		printf("%lu allocated, %lu times empty\n",
+			bc->bc_alloc, bc->bc_fail);
+	}
 }
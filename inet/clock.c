@@ -9,12 +9,43 @@
 
 INIT_PANIC();
 
+/* The timers are kept in a hierarchical timing wheel.  Level 0 has a slot
+ * for every tick of the near future, each following level has slots that
+ * cover a whole turn of the level below it.  When level 0 wraps around, the
+ * current slot of level 1 is cascaded down, and so on.  Setting and
+ * cancelling a timer take constant time.
+ */
+#if _WORD_SIZE == 2
+#define CLCK_L0_BITS	6
+#define CLCK_LN_BITS	4
+#else
+#define CLCK_L0_BITS	8
+#define CLCK_LN_BITS	6
+#endif
+#define CLCK_LN_NR	3	/* number of levels above level 0 */
+
+#define CLCK_L0_SIZE	(1 << CLCK_L0_BITS)
+#define CLCK_LN_SIZE	(1 << CLCK_LN_BITS)
+#define CLCK_L0_MASK	(CLCK_L0_SIZE-1)
+#define CLCK_LN_MASK	(CLCK_LN_SIZE-1)
+#define CLCK_SHIFT(l)	(CLCK_L0_BITS + (l)*CLCK_LN_BITS)
+#define CLCK_MAX_DELTA	((1L << CLCK_SHIFT(CLCK_LN_NR)) - 1)
+
 FORWARD _PROTOTYPE( void clck_fast_release, (timer_t *timer) );
+FORWARD _PROTOTYPE( void clck_insert, (timer_t *timer) );
+FORWARD _PROTOTYPE( void clck_cascade, (int level) );
+FORWARD _PROTOTYPE( void clck_expire, (time_t now) );
+FORWARD _PROTOTYPE( time_t clck_next, (void) );
 FORWARD _PROTOTYPE( void set_timer, (void) );
 
 PRIVATE time_t curr_time;
-PRIVATE timer_t *timer_chain;
 PRIVATE time_t next_timeout;
+PRIVATE time_t wheel_time;	/* next tick to be processed */
+PRIVATE int wheel_count;	/* number of timers set */
+PRIVATE timer_t *wheel_due;	/* set for a tick already processed */
+PRIVATE timer_t *wheel0[CLCK_L0_SIZE];
+PRIVATE timer_t *wheeln[CLCK_LN_NR][CLCK_LN_SIZE];
+PRIVATE int expiring;		/* set_timer() is calling timer functions */
 
 PUBLIC time_t get_time()
 {
@@ -40,9 +71,19 @@ time_t tim;
 
 PUBLIC void clck_init()
 {
+	int i, l;
+
 	curr_time= 0;
 	next_timeout= 0;
-	timer_chain= 0;
+	wheel_time= 0;
+	wheel_count= 0;
+	expiring= FALSE;
+	wheel_due= 0;
+	for (i= 0; i<CLCK_L0_SIZE; i++)
+		wheel0[i]= 0;
+	for (l= 0; l<CLCK_LN_NR; l++)
+		for (i= 0; i<CLCK_LN_SIZE; i++)
+			wheeln[l][i]= 0;
 }
 
 PUBLIC void reset_time()
@@ -56,8 +97,6 @@ time_t timeout;
 timer_func_t func;
 int fd;
 {
-	timer_t *timer_index;
-
 #if DEBUG & 256
  { time_t curr_tim= get_time(); where(); 
 	printf("clck_timer(0x%x, now%c%d HZ, 0x%x, %d)\n", timer, 
@@ -66,28 +105,16 @@ int fd;
 	func, fd); }
 #endif
 	clck_fast_release(timer);
-	timer->tim_next= 0;
 	timer->tim_func= func;
 	timer->tim_ref= fd;
 	timer->tim_time= timeout;
 
-	if (!timer_chain)
-		timer_chain= timer;
-	else if (timeout < timer_chain->tim_time)
-	{
-		timer->tim_next= timer_chain;
-		timer_chain= timer;
-	}
-	else
-	{
-		timer_index= timer_chain;
-		while (timer_index->tim_next &&
-			timer_index->tim_next->tim_time < timeout)
-			timer_index= timer_index->tim_next;
-		timer->tim_next= timer_index->tim_next;
-		timer_index->tim_next= timer;
-	}
-	if (timer_chain->tim_time != next_timeout)
+	if (!wheel_count)
+		wheel_time= get_time();
+	clck_insert(timer);
+
+	/* Only talk to the clock task if the alarm has to go off sooner. */
+	if (timeout <= get_time() || !next_timeout || timeout < next_timeout)
 		set_timer();
 }
 
@@ -104,45 +131,163 @@ message *mess;
 PRIVATE void clck_fast_release (timer)
 timer_t *timer;
 {
-	timer_t *timer_index;
+	if (!timer->tim_prev)
+		return;
+	*timer->tim_prev= timer->tim_next;
+	if (timer->tim_next)
+		timer->tim_next->tim_prev= timer->tim_prev;
+	timer->tim_next= 0;
+	timer->tim_prev= 0;
+	wheel_count--;
+}
+
+PRIVATE void clck_insert (timer)
+timer_t *timer;
+{
+	timer_t **slot;
+	time_t timeout, delta;
+	int l;
 
-	if (timer == timer_chain)
-		timer_chain= timer_chain->tim_next;
+	timeout= timer->tim_time;
+	delta= timeout - wheel_time;
+	if (delta > CLCK_MAX_DELTA)
+	{
+		timeout= wheel_time + CLCK_MAX_DELTA;
+		delta= CLCK_MAX_DELTA;
+	}
+
+	if (delta < 0)
+		slot= &wheel_due;
+	else if (delta < CLCK_L0_SIZE)
+		slot= &wheel0[timeout & CLCK_L0_MASK];
 	else
 	{
-		timer_index= timer_chain;
-		while (timer_index && timer_index->tim_next != timer)
-			timer_index= timer_index->tim_next;
-		if (timer_index)
-			timer_index->tim_next= timer->tim_next;
+		for (l= 0; delta >= (1L << CLCK_SHIFT(l+1)); l++)
+			;
+		slot= &wheeln[l][(timeout >> CLCK_SHIFT(l)) & CLCK_LN_MASK];
+	}
+
+	timer->tim_next= *slot;
+	if (timer->tim_next)
+		timer->tim_next->tim_prev= &timer->tim_next;
+	timer->tim_prev= slot;
+	*slot= timer;
+	wheel_count++;
+}
+
+/*
+clck_cascade
+
+Move the timers in the current slot of a level into the levels below it.
+*/
+
+PRIVATE void clck_cascade (level)
+int level;
+{
+	timer_t *timer, **slot;
+	int i;
+
+	i= (wheel_time >> CLCK_SHIFT(level)) & CLCK_LN_MASK;
+	if (i == 0 && level+1 < CLCK_LN_NR)
+		clck_cascade(level+1);
+
+	slot= &wheeln[level][i];
+	while ((timer= *slot) != 0)
+	{
+		clck_fast_release(timer);
+		clck_insert(timer);
+	}
+}
+
+/*
+clck_expire
+
+Call the functions of all the timers that expired up to now, one slot
+of level 0 at a time.  Timers set for a tick that was already processed
+are kept in wheel_due and go first.
+*/
+
+PRIVATE void clck_expire (now)
+time_t now;
+{
+	timer_t *timer, **slot;
+
+	for (;;)
+	{
+		while ((timer= wheel_due) != 0)
+		{
+			clck_fast_release(timer);
+			(*timer->tim_func)(timer->tim_ref, timer);
+		}
+		if (wheel_time > now)
+			break;
+		if (!wheel_count)
+		{
+			wheel_time= now+1;
+			break;
+		}
+		if (!(wheel_time & CLCK_L0_MASK))
+			clck_cascade(0);
+
+		slot= &wheel0[wheel_time & CLCK_L0_MASK];
+		while ((timer= *slot) != 0)
+		{
+			clck_fast_release(timer);
+#if DEBUG & 256
+ { where(); printf("calling tim_func: 0x%x(%d, ..)\n", 
+	timer->tim_func, timer->tim_ref); }
+#endif
+			(*timer->tim_func)(timer->tim_ref, timer);
+		}
+		wheel_time++;
 	}
 }
 
+/*
+clck_next
+
+Return the tick at which the alarm should go off next: the first used slot
+of level 0, or the moment level 0 wraps around and the next level has to be
+cascaded.  0 means no timers are set.
+*/
+
+PRIVATE time_t clck_next()
+{
+	time_t tick;
+
+	if (!wheel_count)
+		return 0;
+	tick= wheel_time;
+	if (!(tick & CLCK_L0_MASK))
+		return tick;		/* level 1 is due for a cascade */
+	do
+	{
+		if (wheel0[tick & CLCK_L0_MASK])
+			return tick;
+		tick++;
+	} while (tick & CLCK_L0_MASK);
+	return tick;
+}
+
 PRIVATE void set_timer()
 {
 	time_t new_time;
 	time_t curr_time;
-	timer_t *timer_index;
 
 #if DEBUG & 256
  { where(); printf("in set_timer()\n"); }
 #endif
+	/* A timer function that sets a timer gets here again, the outer
+	 * call takes care of it.
+	 */
+	if (expiring)
+		return;
 	curr_time= get_time();
 
-	while (timer_chain && timer_chain->tim_time<=curr_time)
-	{
-		timer_index= timer_chain;
-		timer_chain= timer_chain->tim_next;
-#if DEBUG & 256
- { where(); printf("calling tim_func: 0x%x(%d, ..)\n", 
-	timer_index->tim_func, timer_index->tim_ref); }
-#endif
-		(*timer_index->tim_func)(timer_index->tim_ref, timer_index);
-	}
-	if (timer_chain)
-		new_time= timer_chain->tim_time;
-	else
-		new_time= 0;
+	expiring= TRUE;
+	clck_expire(curr_time);
+	expiring= FALSE;
+	new_time= clck_next();
 	if (new_time != next_timeout)
 	{
 		static message mess;
@@ -166,6 +311,8 @@ PRIVATE void set_timer()
 void clck_untimer (timer)
 timer_t *timer;
 {
+	/* The alarm is left alone, going off early costs less than a
+	 * message to the clock task.
+	 */
 	clck_fast_release (timer);
-	set_timer();
 }
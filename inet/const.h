@@ -26,4 +26,13 @@ Created:	Dec 30, 1991 by Philip Homburg
 
 #define BUF_S		512
 
+/* Number of network interfaces.  Each one has its own eth, ip, tcp and udp
+ * devices.
+ */
+#if _WORD_SIZE == 2
+#define INET_PORT_NR	1
+#else
+#define INET_PORT_NR	2
+#endif
+
 #endif /* INET__CONST_H */
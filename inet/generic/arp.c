@@ -15,11 +15,20 @@ arp.c
 
 INIT_PANIC();
 
-#define ARP_PORT_NR	1
-#define ARP_CACHE1_NR	8
-#define ARP_CACHE2_NR	8
-#define ARP_CACHE3_NR	16
-#define ARP_CACHE_NR	(ARP_CACHE1_NR+ARP_CACHE2_NR+ARP_CACHE3_NR)
+#define ARP_PORT_NR	INET_PORT_NR
+
+/* The cache is hashed on the IP address.  A quarter of the entries is for
+ * hosts that were only heard of (type 1), a quarter for hosts that asked for
+ * our address (type 2), and half for hosts we talk to (type 3).
+ */
+#ifndef ARP_CACHE_NR
+#define ARP_CACHE_NR	(_WORD_SIZE == 2 ? 32 : 256)
+#endif
+#define ARP_CACHE1_NR	(ARP_CACHE_NR/4)
+#define ARP_CACHE2_NR	(ARP_CACHE_NR/4)
+#define ARP_CACHE3_NR	(ARP_CACHE_NR-ARP_CACHE1_NR-ARP_CACHE2_NR)
+#define ARP_HASH_NR	(ARP_CACHE_NR/4)
+#define ARP_REQ_NR	8	/* addresses being resolved at a time */
 #define ARP_TYPE1	1
 #define ARP_TYPE2	2
 #define ARP_TYPE3	3
@@ -73,12 +82,27 @@ typedef struct arp_cache
 	int ac_eth_port;
 	time_t ac_expire;
 	time_t ac_lastuse;
+	struct arp_cache *ac_next;	/* hash chain */
 } arp_cache_t;
 
 #define ACF_EMPTY	0
 #define ACF_NETREQ	1
 #define ACF_NOTRCH	2
 
+typedef struct arp_req
+{
+	int ar_flags;
+	ipaddr_t ar_ipaddr;
+	int ar_count;			/* requests sent */
+	timer_t ar_timer;
+	arp_req_func_t ar_func;
+	int ar_ref;
+} arp_req_t;
+
+#define ARF_EMPTY	0
+#define ARF_INUSE	1
+#define ARF_WRITE	2		/* a request has to be sent */
+
 typedef struct arp_port
 {
 	int ap_flags;
@@ -92,10 +116,7 @@ typedef struct arp_port
 	ether_addr_t ap_write_ethaddr;
 	ipaddr_t ap_write_ipaddr;
 	int ap_write_code;
-	ipaddr_t ap_req_ipaddr;
-	arp_req_func_t ap_req_func;
-	int ap_req_ref;
-	int ap_req_count;
+	arp_req_t ap_req[ARP_REQ_NR];
 	rarp_func_t ap_rarp_func;
 	int ap_rarp_ref;
 } arp_port_t;
@@ -109,9 +130,7 @@ typedef struct arp_port
 #define APF_ARP_WR_SP	0x20
 #define APF_INADDR_SET	0x100
 #define APF_MORE2WRITE	0x200
-#define APF_CLIENTREQ	0x400
 #define APF_RARPREQ	0x800
-#define APF_CLIENTWRITE	0x1000
 
 #define APS_EMPTY	0
 #define APS_STATMASK	0xff
@@ -136,31 +155,60 @@ FORWARD void ipaddr_set ARGS(( arp_port_t *port ));
 FORWARD void setup_write ARGS(( arp_port_t *port ));
 FORWARD void setup_read ARGS(( arp_port_t *port ));
 FORWARD void process_arp_req ARGS(( arp_port_t *port, acc_t *data ));
-FORWARD void client_reply ARGS(( arp_port_t *port,
+FORWARD void client_reply ARGS(( arp_port_t *port, arp_req_t *req,
 	ether_addr_t *ethaddr ));
+FORWARD arp_req_t *find_req ARGS(( arp_port_t *port, ipaddr_t ipaddr ));
 FORWARD arp_cache_t *find_cache_ent ARGS(( int eth_port, ipaddr_t ipaddr,
-	int level, arp_cache_t **new_ent ));
+	int level ));
+FORWARD arp_cache_t *new_cache_ent ARGS(( int eth_port, ipaddr_t ipaddr,
+	int level ));
+FORWARD int arp_hash ARGS(( ipaddr_t ipaddr ));
 FORWARD void rarp_read_setup ARGS(( arp_port_t *port ));
 FORWARD void print_arp_cache ARGS(( void ));
 
 PRIVATE arp_port_t arp_port_table[ARP_PORT_NR];
 PRIVATE arp_port_t *arp_port;
 PRIVATE	arp_cache_t arp_cache[ARP_CACHE_NR];
+PRIVATE arp_cache_t *arp_cache_hash[ARP_HASH_NR];
 
 PUBLIC void arp_init()
 {
-	int i;
+	int i, j;
+	arp_cache_t *cache;
 
 	assert (BUF_S >= sizeof(struct nwio_ethstat));
 	assert (BUF_S >= sizeof(struct nwio_ethopt));
 	assert (BUF_S >= sizeof(rarp46_t));
 	assert (BUF_S >= sizeof(arp46_t));
-	arp_port_table[0].ap_eth_port= ETH0;
+
+	/* An entry is on the hash chain of its address once it has one.
+	 * Unused entries, with ac_eth_port -1, are on no chain.
+	 */
+	for (i=0; i<ARP_HASH_NR; i++)
+		arp_cache_hash[i]= 0;
+	for (i=0, cache= arp_cache; i<ARP_CACHE_NR; i++, cache++)
+	{
+		cache->ac_flags= ACF_EMPTY;
+		cache->ac_ipaddr= 0;
+		cache->ac_eth_port= -1;
+		cache->ac_expire= 0;
+		cache->ac_lastuse= 0;
+		if (i < ARP_CACHE1_NR)
+			cache->ac_type= ARP_TYPE1;
+		else if (i < ARP_CACHE1_NR+ARP_CACHE2_NR)
+			cache->ac_type= ARP_TYPE2;
+		else
+			cache->ac_type= ARP_TYPE3;
+		cache->ac_next= 0;
+	}
 
 	for (i=0, arp_port= arp_port_table; i<ARP_PORT_NR; i++, arp_port++)
 	{
+		arp_port->ap_eth_port= ETH0+i;
 		arp_port->ap_state= APS_EMPTY;
 		arp_port->ap_flags= APF_EMPTY;
+		for (j=0; j<ARP_REQ_NR; j++)
+			arp_port->ap_req[j].ar_flags= ARF_EMPTY;
 		arp_main(arp_port);
 	}
 }
@@ -297,26 +345,6 @@ arp_port_t *port;
 		port->ap_state= (port->ap_state &
 			~(APS_STATMASK|APS_SUSPEND)) | APS_ARPPROTO;
 
-		{
-			arp_cache_t *cache;
-			int i;
-
-			cache= arp_cache;
-			for (i=0; i<ARP_CACHE_NR; i++, cache++)
-			{
-				cache->ac_flags= ACF_EMPTY;
-				cache->ac_expire= 0;
-				cache->ac_lastuse= 0;
-			}
-
-			cache= arp_cache;
-			for (i=0; i<ARP_CACHE1_NR; i++, cache++)
-				cache->ac_type= 1;
-			for (i=0; i<ARP_CACHE2_NR; i++, cache++)
-				cache->ac_type= 2;
-			for (i=0; i<ARP_CACHE3_NR; i++, cache++)
-				cache->ac_type= 3;
-		}
 		result= eth_ioctl (port->ap_eth_fd, NWIOSETHOPT);
 
 		if (result==NW_SUSPEND)
@@ -719,16 +747,23 @@ PRIVATE void setup_write(port)
 arp_port_t *port;
 {
 	int i, result;
+	arp_req_t *req;
 
 	while (port->ap_flags & APF_MORE2WRITE)
 	{
-		if (port->ap_flags & APF_CLIENTWRITE)
+		for (i=0, req= port->ap_req; i<ARP_REQ_NR; i++, req++)
+		{
+			if (req->ar_flags & ARF_WRITE)
+				break;
+		}
+		if (i<ARP_REQ_NR)
 		{
-			port->ap_flags &= ~APF_CLIENTWRITE;
-			port->ap_write_ipaddr= port->ap_req_ipaddr;
+			req->ar_flags &= ~ARF_WRITE;
+			port->ap_write_ipaddr= req->ar_ipaddr;
 			port->ap_write_code= ARP_REQUEST;
-			clck_timer(&port->ap_timer, get_time() + ARP_TIMEOUT,
-				arp_timeout, port-arp_port_table);
+			clck_timer(&req->ar_timer, get_time() + ARP_TIMEOUT,
+				arp_timeout, (port-arp_port_table)*ARP_REQ_NR +
+				i);
 		}
 		else
 		{
@@ -778,7 +813,8 @@ arp_port_t *port;
 acc_t *data;
 {
 	arp46_t *arp;
-	arp_cache_t *prim, *sec;
+	arp_cache_t *prim;
+	arp_req_t *req;
 	int level;
 	time_t curr_tim;
 	ipaddr_t spa, tpa;
@@ -814,7 +850,8 @@ acc_t *data;
  { where(); printf("arp.c: a46_tpa= 0x%lx, ap_ipaddr= 0x%lx\n",
 	arp->a46_tpa, port->ap_ipaddr); }
 #endif
-	if ((port->ap_flags & APF_CLIENTREQ) && (spa == port->ap_req_ipaddr))
+	req= find_req(port, spa);
+	if (req)
 		level= ARP_TYPE3;
 	else if (arp->a46_op == htons(ARP_REQUEST) && (tpa ==
 		port->ap_ipaddr))
@@ -825,19 +862,9 @@ acc_t *data;
 #if DEBUG & 256
  { where(); printf("arp.c: level= %d\n", level); }
 #endif
-	prim= find_cache_ent(port->ap_eth_port, spa, level, &sec);
+	prim= find_cache_ent(port->ap_eth_port, spa, level);
 	if (!prim)
-	{
-		prim= sec;
-		prim->ac_flags= ACF_EMPTY;
-		prim->ac_ipaddr= spa;
-		prim->ac_eth_port= port->ap_eth_port;
-	}
-	else if (prim->ac_type < level)
-	{
-		sec->ac_type= prim->ac_type;
-		prim->ac_type= level;
-	}
+		prim= new_cache_ent(port->ap_eth_port, spa, level);
 	prim->ac_ethaddr= arp->a46_sha;
 	curr_tim= get_time();
 	prim->ac_expire= curr_tim+ ARP_EXP_TIME;
@@ -853,46 +880,132 @@ acc_t *data;
 	} else if (level== ARP_TYPE3)
 	{
 		prim->ac_lastuse= curr_tim + ARP_INUSE_OFFSET;
-		client_reply(port, &arp->a46_sha);
+		client_reply(port, req, &arp->a46_sha);
 	}
 #if DEBUG & 256
  { where(); print_arp_cache(); }
 #endif
 }
 
-PRIVATE void client_reply (port, ethaddr)
+PRIVATE void client_reply (port, req, ethaddr)
 arp_port_t *port;
+arp_req_t *req;
 ether_addr_t *ethaddr;
 {
-	port->ap_flags &= ~(APF_CLIENTREQ|APF_CLIENTWRITE);
-	clck_untimer(&port->ap_timer);
-	(*port->ap_req_func)(port->ap_req_ref, ethaddr);
+	clck_untimer(&req->ar_timer);
+	req->ar_flags= ARF_EMPTY;
+	(*req->ar_func)(req->ar_ref, req->ar_ipaddr, ethaddr);
 }
 
-PRIVATE arp_cache_t *find_cache_ent (eth_port, ipaddr, level, new_ent)
+PRIVATE arp_req_t *find_req (port, ipaddr)
+arp_port_t *port;
+ipaddr_t ipaddr;
+{
+	arp_req_t *req;
+	int i;
+
+	for (i=0, req= port->ap_req; i<ARP_REQ_NR; i++, req++)
+	{
+		if ((req->ar_flags & ARF_INUSE) && req->ar_ipaddr == ipaddr)
+			return req;
+	}
+	return 0;
+}
+
+/*
+find_cache_ent
+
+Look up the entry for ipaddr.  An entry that is used at a higher level
+trades places with the least recently used entry of that level.
+*/
+
+PRIVATE arp_cache_t *find_cache_ent (eth_port, ipaddr, level)
 int eth_port;
 ipaddr_t ipaddr;
 int level;
-arp_cache_t **new_ent;
 {
-	arp_cache_t *cache, *prim, *sec;
+	arp_cache_t *cache, *sec;
 	int i;
 
-	cache= arp_cache;
-	prim= 0;
-	sec= 0;
-	for (i=0; i<ARP_CACHE_NR; i++, cache++)
+	for (cache= arp_cache_hash[arp_hash(ipaddr)]; cache;
+		cache= cache->ac_next)
 	{
 		if (cache->ac_eth_port == eth_port &&
 			cache->ac_ipaddr == ipaddr)
-			prim= cache;
+		{
+			break;
+		}
+	}
+	if (!cache || cache->ac_type >= level)
+		return cache;
+
+	sec= 0;
+	for (i=0; i<ARP_CACHE_NR; i++)
+	{
+		if (arp_cache[i].ac_type == level && (!sec ||
+			arp_cache[i].ac_lastuse < sec->ac_lastuse))
+		{
+			sec= &arp_cache[i];
+		}
+	}
+	assert(sec);
+	sec->ac_type= cache->ac_type;
+	cache->ac_type= level;
+	return cache;
+}
+
+/*
+new_cache_ent
+
+Take the least recently used entry of a level for ipaddr.
+*/
+
+PRIVATE arp_cache_t *new_cache_ent (eth_port, ipaddr, level)
+int eth_port;
+ipaddr_t ipaddr;
+int level;
+{
+	arp_cache_t *cache, *sec, **chain;
+	int i;
+
+	sec= 0;
+	for (i=0, cache= arp_cache; i<ARP_CACHE_NR; i++, cache++)
+	{
 		if (cache->ac_type == level && (!sec || cache->ac_lastuse <
 			sec->ac_lastuse))
+		{
 			sec= cache;
+		}
 	}
 	assert(sec);
-	*new_ent= sec;
-	return prim;
+
+	if (sec->ac_eth_port != -1)
+	{
+		for (chain= &arp_cache_hash[arp_hash(sec->ac_ipaddr)];
+			*chain != sec; chain= &(*chain)->ac_next)
+		{
+			assert(*chain);
+		}
+		*chain= sec->ac_next;
+	}
+	chain= &arp_cache_hash[arp_hash(ipaddr)];
+	sec->ac_next= *chain;
+	*chain= sec;
+
+	sec->ac_flags= ACF_EMPTY;
+	sec->ac_ipaddr= ipaddr;
+	sec->ac_eth_port= eth_port;
+	return sec;
+}
+
+PRIVATE int arp_hash (ipaddr)
+ipaddr_t ipaddr;
+{
+	u32_t h;
+
+	/* The host part is at the end, whatever the byte order. */
+	h= ntohl(ipaddr);
+	return (int)((h ^ (h >> 8)) % ARP_HASH_NR);
 }
 
 PRIVATE void rarp_read_setup (port)
@@ -970,7 +1083,8 @@ arp_req_func_t func;
 {
 	arp_port_t *port;
 	int i;
-	arp_cache_t *prim, *sec;
+	arp_cache_t *prim;
+	arp_req_t *req;
 
 #if DEBUG & 256
  { where(); printf("sending arp_req for: "); writeIpAddr(ipaddr);
@@ -982,47 +1096,42 @@ arp_req_func_t func;
 			break;
 	if (i>=ARP_PORT_NR)
 		return EGENERIC;
-	if ((port->ap_state & APS_STATMASK) != APS_ARPMAIN)
-	{
-		port->ap_flags |= APF_CLIENTREQ|APF_MORE2WRITE |
-			APF_CLIENTWRITE;
-		port->ap_req_func= func;
-		port->ap_req_ref= ref;
-		port->ap_req_ipaddr= ipaddr;
-		port->ap_req_count= 0;
-		return NW_SUSPEND;
-	}
 
-	prim= find_cache_ent (eth_port, ipaddr, ARP_TYPE3, &sec);
-	if (prim)
+	if ((port->ap_state & APS_STATMASK) == APS_ARPMAIN)
 	{
-		if (prim->ac_type < ARP_TYPE3)
+		prim= find_cache_ent (eth_port, ipaddr, ARP_TYPE3);
+		if (prim && prim->ac_expire >= get_time())
 		{
-			sec->ac_type= prim->ac_type;
-			prim->ac_type= ARP_TYPE3;
+			prim->ac_lastuse= get_time();
+			if (prim->ac_flags & ACF_NOTRCH)
+				return EDSTNOTRCH;
+			(*func)(ref, ipaddr, &prim->ac_ethaddr);
+			return NW_OK;
 		}
-		if (prim->ac_expire < get_time())
-			prim= 0;
 	}
-	if (!prim)
-	{
-		port->ap_flags |= APF_CLIENTREQ|APF_MORE2WRITE|APF_CLIENTWRITE;
-		port->ap_req_func= func;
-		port->ap_req_ref= ref;
-		port->ap_req_ipaddr= ipaddr;
-		port->ap_req_count= 0;
-		if (!(port->ap_flags & APF_ARP_WR_IP))
-			setup_write(port);
+
+	/* Requests for different addresses go out side by side. */
+	if (find_req(port, ipaddr))
 		return NW_SUSPEND;
+	for (i=0, req= port->ap_req; i<ARP_REQ_NR; i++, req++)
+	{
+		if (!(req->ar_flags & ARF_INUSE))
+			break;
 	}
-	prim->ac_lastuse= get_time();
-	if (prim->ac_flags & ACF_NOTRCH)
-		return EDSTNOTRCH;
-	else
+	if (i>=ARP_REQ_NR)
+		return EGENERIC;
+	req->ar_flags= ARF_INUSE|ARF_WRITE;
+	req->ar_ipaddr= ipaddr;
+	req->ar_count= 0;
+	req->ar_func= func;
+	req->ar_ref= ref;
+	port->ap_flags |= APF_MORE2WRITE;
+	if ((port->ap_state & APS_STATMASK) == APS_ARPMAIN &&
+		!(port->ap_flags & APF_ARP_WR_IP))
 	{
-		client_reply (port, &prim->ac_ethaddr);
-		return NW_OK;
+		setup_write(port);
 	}
+	return NW_SUSPEND;
 }
 
 PUBLIC int arp_ip_eth_nonbl (eth_port, ipaddr, ethaddr)
@@ -1032,7 +1141,7 @@ ether_addr_t *ethaddr;
 {
 	arp_port_t *port;
 	int i;
-	arp_cache_t *prim, *sec;
+	arp_cache_t *prim;
 
 #if DEBUG & 256
  { where(); printf("got a arp_ip_eth_nonbl(%d, ", eth_port);
@@ -1052,17 +1161,9 @@ ether_addr_t *ethaddr;
 		return NW_SUSPEND;
 	}
 
-	prim= find_cache_ent (eth_port, ipaddr, ARP_TYPE3, &sec);
-	if (prim)
-	{
-		if (prim->ac_type < ARP_TYPE3)
-		{
-			sec->ac_type= prim->ac_type;
-			prim->ac_type= ARP_TYPE3;
-		}
-		if (prim->ac_expire < get_time())
-			prim= 0;
-	}
+	prim= find_cache_ent (eth_port, ipaddr, ARP_TYPE3);
+	if (prim && prim->ac_expire < get_time())
+		prim= 0;
 	if (!prim)
 	{
 #if DEBUG & 256
@@ -1096,43 +1197,39 @@ int fd;
 timer_t *timer;
 {
 	arp_port_t *port;
-	arp_cache_t *prim, *sec;
-	int level;
+	arp_cache_t *prim;
+	arp_req_t *req;
 	time_t curr_tim;
 
-	port= &arp_port_table[fd];
+	port= &arp_port_table[fd / ARP_REQ_NR];
+	req= &port->ap_req[fd % ARP_REQ_NR];
 
-	assert (timer == &port->ap_timer);
+	assert (timer == &req->ar_timer);
+	assert (req->ar_flags & ARF_INUSE);
 
-	if (++port->ap_req_count < MAX_ARP_RETRIES)
+	if (++req->ar_count < MAX_ARP_RETRIES)
 	{
-		port->ap_flags |= APF_CLIENTWRITE|APF_MORE2WRITE;
+		req->ar_flags |= ARF_WRITE;
+		port->ap_flags |= APF_MORE2WRITE;
 		if (!(port->ap_flags & APF_ARP_WR_IP))
 			setup_write(port);
 	}
 	else
 	{
-		level= ARP_TYPE3;
-		prim= find_cache_ent(port->ap_eth_port, port->ap_req_ipaddr,
-			level, &sec);
+		/* Remember that the host does not answer. */
+		prim= find_cache_ent(port->ap_eth_port, req->ar_ipaddr,
+			ARP_TYPE3);
 		if (!prim)
 		{
-			prim= sec;
-			prim->ac_flags= ACF_EMPTY;
-			prim->ac_ipaddr= port->ap_req_ipaddr;
-		}
-		else if (prim->ac_type < level)
-		{
-			sec->ac_type= prim->ac_type;
-			prim->ac_type= level;
+			prim= new_cache_ent(port->ap_eth_port,
+				req->ar_ipaddr, ARP_TYPE3);
 		}
 		curr_tim= get_time();
 		prim->ac_expire= curr_tim+ ARP_NOTRCH_EXP_TIME;
 		prim->ac_lastuse= curr_tim + ARP_INUSE_OFFSET;
 		prim->ac_flags |= ACF_NOTRCH;
 
-		(*port->ap_req_func)(port->ap_req_ref,
-			(ether_addr_t *)0);
+		client_reply(port, req, (ether_addr_t *)0);
 	}
 }
 
@@ -20,7 +20,7 @@ int rarp_req ARGS(( int eth_port, int ref,
 int arp_ip_eth_nonbl ARGS(( int eth_port, ipaddr_t ipaddr,
 	ether_addr_t *ethaddr ));
 int arp_ip_eth ARGS(( int eth_port, int ref, ipaddr_t,
-	void (*func)(int fd, ether_addr_t*ethadd) ));
+	void (*func)(int fd, ipaddr_t ipaddr, ether_addr_t*ethadd) ));
 void set_ipaddr ARGS(( int eth_port, ipaddr_t ipaddr ));
 
 #endif /* ARP_H */
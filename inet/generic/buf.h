@@ -17,6 +17,8 @@ buf.h
 
 #define ICMP_PRI_QUEUE		1
 
+#define IP_PRI_ASSBUFS		2
+
 #define TCP_PRI_FRAG2SEND	4
 #define TCP_PRI_CONNwoUSER	6
 #define TCP_PRI_CONN_INUSE	9
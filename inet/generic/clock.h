@@ -12,6 +12,7 @@ typedef void (*timer_func_t) ARGS(( int fd, struct timer *timer ));
 typedef struct timer
 {
 	struct timer *tim_next;
+	struct timer **tim_prev;	/* 0 if the timer is not set */
 	timer_func_t tim_func;
 	int tim_ref;
 	time_t tim_time;
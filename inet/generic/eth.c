@@ -33,6 +33,8 @@ typedef struct eth_fd
 	acc_t *ef_rd_tail;
 	time_t ef_exp_tim;
 	int ef_pack_stat;
+	struct eth_fd **ef_chain;	/* list this fd is on, if any */
+	struct eth_fd *ef_next;
 } eth_fd_t;
 
 #define EFF_FLAGS	0xf
@@ -43,6 +45,12 @@ typedef struct eth_fd
 #		define 	EFF_WRITE_IP	0x4
 #	define EFF_OPTSET       0x8
 
+/* Incoming packets are matched against the fds for their type, found
+ * through a hash table, and against the fds that accept any type.
+ */
+#define ETH_TYPE_HASH_NR	8
+#define ETH_TYPE_HASH(t)	(ntohs(t) & (ETH_TYPE_HASH_NR-1))
+
 FORWARD int eth_checkopt ARGS(( eth_fd_t *eth_fd ));
 FORWARD void eth_buffree ARGS(( int priority, size_t reqsize ));
 FORWARD int ok_for_me ARGS(( eth_fd_t *fd, acc_t *pack ));
@@ -52,10 +60,14 @@ FORWARD void reply_thr_get ARGS(( eth_fd_t *eth_fd,
 FORWARD void reply_thr_put ARGS(( eth_fd_t *eth_fd,
 	size_t result, int for_ioctl ));
 FORWARD void restart_write_fd ARGS(( eth_fd_t *eth_fd ));
+FORWARD void eth_link_fd ARGS(( eth_fd_t *eth_fd ));
+FORWARD void eth_unlink_fd ARGS(( eth_fd_t *eth_fd ));
 
 PUBLIC eth_port_t eth_port_table[ETH_PORT_NR];
 
 PRIVATE eth_fd_t eth_fd_table[ETH_FD_NR];
+PRIVATE eth_fd_t *eth_type_hash[ETH_TYPE_HASH_NR];
+PRIVATE eth_fd_t *eth_any_fds;
 /* PRIVATE message mess, repl_mess; */
 
 PUBLIC void eth_init()
@@ -69,14 +81,19 @@ PUBLIC void eth_init()
 
 
 	for (i=0; i<ETH_FD_NR; i++)
+	{
 		eth_fd_table[i].ef_flags= EFF_EMPTY;
+		eth_fd_table[i].ef_chain= 0;
+	}
+	for (i=0; i<ETH_TYPE_HASH_NR; i++)
+		eth_type_hash[i]= 0;
+	eth_any_fds= 0;
 	for (i=0; i<ETH_PORT_NR; i++)
 		eth_port_table[i].etp_flags= EFF_EMPTY;
 
 	bf_logon(eth_buffree);
 
-	eth_init0();
-	/* eth_init1(); etc */
+	osdep_eth_init();
 }
 
 PUBLIC int eth_open(port, srfd, get_userdata, put_userdata)
@@ -429,6 +446,24 @@ size_t count;
 	return NW_SUSPEND;
 }
 
+PUBLIC int eth_select(fd, operations)
+int fd;
+int operations;
+{
+	eth_fd_t *eth_fd;
+	int ready;
+
+	eth_fd= &eth_fd_table[fd];
+
+	ready= SEL_WR;
+	if (!(eth_fd->ef_flags & EFF_OPTSET) || (eth_fd->ef_rd_buf &&
+		get_time() <= eth_fd->ef_exp_tim))
+	{
+		ready |= SEL_RD;
+	}
+	return ready & operations;
+}
+
 PUBLIC int eth_cancel(fd, which_operation)
 int fd;
 int which_operation;
@@ -471,6 +506,7 @@ int fd;
 
 	assert (eth_fd->ef_flags & EFF_INUSE);
 
+	eth_unlink_fd(eth_fd);
 	eth_fd->ef_flags= EFF_EMPTY;
 	for (acc= eth_fd->ef_rd_buf; acc;)
 	{
@@ -519,9 +555,13 @@ eth_fd_t *eth_fd;
 		if (flags & NWEO_EN_PROMISC)
 			eth_fd->ef_pack_stat |= (EPS_PROMISC|EPS_MULTI|
 				EPS_BROAD);
+		eth_link_fd(eth_fd);
 	}
 	else
+	{
 		eth_fd->ef_flags &= ~EFF_OPTSET;
+		eth_unlink_fd(eth_fd);
+	}
 	
 	for (acc= eth_fd->ef_rd_buf; acc;)
 	{
@@ -543,7 +583,7 @@ eth_port_t *eth_port;
 #if DEBUG & 256
  { where(); printf("eth_get_work called\n"); }
 #endif
-	if (eth_port->etp_wr_pack)
+	if (eth_port->etp_wr_nr >= ETH_WR_NR)
 		return 0;
 	if (!(eth_port->etp_flags & EPF_MORE2WRITE))
 		return 0;
@@ -559,7 +599,7 @@ eth_port_t *eth_port;
  { where(); printf("eth_get_work calling restart_write_fd\n"); }
 #endif
 		restart_write_fd(eth_fd);
-		if (eth_port->etp_wr_pack)
+		if (eth_port->etp_wr_nr >= ETH_WR_NR)
 			return 1;
 	}
 	eth_port->etp_flags &= ~EPF_MORE2WRITE;
@@ -578,7 +618,7 @@ acc_t *pack;
 	ether_type_t type;
 	eth_fd_t *eth_fd, *share_fd;
 	acc_t *acc;
-	int i;
+	int i, any;
 
 #if DEBUG & 256
  { where(); printf("eth_arrive(0x%x, 0x%x) called\n", eth_port, pack); }
@@ -623,15 +663,18 @@ assert(pack->acc_linkC);
 #endif
 
 	share_fd= 0;
-	for (i=0, eth_fd=eth_fd_table; i<ETH_FD_NR; i++, eth_fd++)
+	eth_fd= eth_type_hash[ETH_TYPE_HASH(type)];
+	for (any= FALSE;; eth_fd= eth_fd->ef_next)
 	{
-		if (!(eth_fd->ef_flags & EFF_OPTSET))
+		if (!eth_fd && !any)
 		{
-#if DEBUG & 256
- { where(); printf("fd %d doesn't have EFF_OPTSET\n", i); }
-#endif
-			continue;
+			eth_fd= eth_any_fds;
+			any= TRUE;
 		}
+		if (!eth_fd)
+			break;
+		i= eth_fd-eth_fd_table;
+assert (eth_fd->ef_flags & EFF_OPTSET);
 		if (eth_fd->ef_port != eth_port)
 		{
 #if DEBUG
@@ -873,7 +916,7 @@ eth_fd_t *eth_fd;
 
 	eth_port= eth_fd->ef_port;
 
-	if (eth_port->etp_wr_pack)
+	if (eth_port->etp_wr_nr >= ETH_WR_NR)
 	{
 		eth_port->etp_flags |= EPF_MORE2WRITE;
 		return;
@@ -882,8 +925,6 @@ eth_fd_t *eth_fd;
 assert (eth_fd->ef_flags & EFF_WRITE_IP);
 	eth_fd->ef_flags &= ~EFF_WRITE_IP;
 
-assert (!eth_port->etp_wr_pack);
-
 #if DEBUG & 256
  { where(); printf("calling *get_userdata\n"); }
 #endif
@@ -918,8 +959,14 @@ assert (!eth_port->etp_wr_pack);
 	if (nweo_flags & NWEO_TYPESPEC)
 		eth_hdr->eh_proto= eth_fd->ef_ethopt.nweo_type;
 
-assert (!eth_port->etp_wr_pack);
-	eth_port->etp_wr_pack= user_data;
+	/* Queue the frame, the send queue is linked through acc_ext_link. */
+	user_data->acc_ext_link= 0;
+	if (!eth_port->etp_wr_pack)
+		eth_port->etp_wr_pack= user_data;
+	else
+		eth_port->etp_wr_tail->acc_ext_link= user_data;
+	eth_port->etp_wr_tail= user_data;
+	eth_port->etp_wr_nr++;
 
 	if (!(eth_port->etp_flags & EPF_WRITE_IP))
 	{
@@ -954,3 +1001,44 @@ int for_ioctl;
 		for_ioctl);
 assert(!error);
 }
+
+/*
+eth_link_fd
+
+Put an fd on the list that incoming packets for it are looked up in,
+after taking it off the list it was on.
+*/
+
+PRIVATE void eth_link_fd (eth_fd)
+eth_fd_t *eth_fd;
+{
+	eth_fd_t **chain;
+
+	eth_unlink_fd(eth_fd);
+	if (eth_fd->ef_ethopt.nweo_flags & NWEO_TYPESPEC)
+	{
+		chain= &eth_type_hash[ETH_TYPE_HASH(eth_fd->ef_ethopt.
+			nweo_type)];
+	}
+	else
+		chain= &eth_any_fds;
+	eth_fd->ef_chain= chain;
+	eth_fd->ef_next= *chain;
+	*chain= eth_fd;
+}
+
+PRIVATE void eth_unlink_fd (eth_fd)
+eth_fd_t *eth_fd;
+{
+	eth_fd_t **chain;
+
+	if (!eth_fd->ef_chain)
+		return;
+	for (chain= eth_fd->ef_chain; *chain != eth_fd;
+		chain= &(*chain)->ef_next)
+	{
+		assert(*chain);
+	}
+	*chain= eth_fd->ef_next;
+	eth_fd->ef_chain= 0;
+}
@@ -29,6 +29,7 @@ int eth_ioctl ARGS(( int fd, int req));
 int eth_read ARGS(( int port, size_t count ));
 int eth_write ARGS(( int port, size_t count ));
 int eth_cancel ARGS(( int fd, int which_operation ));
+int eth_select ARGS(( int fd, int operations ));
 void eth_close ARGS(( int fd ));
 
 #endif /* ETH_H */
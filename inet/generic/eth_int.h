@@ -5,13 +5,16 @@ eth_int.h
 #ifndef ETH_INT_H
 #define ETH_INT_H
 
-#define ETH_PORT_NR	1	/* 1 ethernet connection */
+#define ETH_PORT_NR	INET_PORT_NR	/* one per network interface */
 
 typedef struct eth_port
 {
 	int etp_flags;
 	ether_addr_t etp_ethaddr;
-	acc_t *etp_wr_pack, *etp_rd_pack;
+	acc_t *etp_wr_pack, *etp_wr_tail;	/* send queue */
+	int etp_wr_nr;
+	acc_t *etp_rd_pack;			/* receive buffers */
+	int etp_rd_nr;
 
 	osdep_eth_port_t etp_osdep;
 } eth_port_t;
@@ -32,7 +35,7 @@ typedef struct eth_port
 
 extern eth_port_t eth_port_table[ETH_PORT_NR];
 
-void eth_init0 ARGS(( void ));
+void osdep_eth_init ARGS(( void ));
 int eth_get_stat ARGS(( eth_port_t *eth_port, eth_stat_t *eth_stat ));
 void eth_write_port ARGS(( eth_port_t *eth_port ));
 void eth_arrive ARGS(( eth_port_t *port, acc_t *pack ));
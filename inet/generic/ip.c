@@ -23,6 +23,7 @@ INIT_PANIC();
 FORWARD void ip_eth_main ARGS(( ip_port_t *port ));
 FORWARD void ip_close ARGS(( int fd ));
 FORWARD int ip_cancel ARGS(( int fd, int which_operation ));
+FORWARD int ip_select ARGS(( int fd, int operations ));
 FORWARD acc_t *get_eth_data ARGS(( int fd, size_t offset,
 	size_t count, int for_ioctl ));
 FORWARD int put_eth_data ARGS(( int fd, size_t offset,
@@ -30,14 +31,31 @@ FORWARD int put_eth_data ARGS(( int fd, size_t offset,
 FORWARD void rarp_func ARGS(( int fd, ipaddr_t ipaddr ));
 FORWARD void do_eth_read ARGS(( ip_port_t *port ));
 
-#if IP_ROUTER
-FORWARD void ip_route ARGS(( ip_port_t *port, acc_t *pack ));
-#endif /* IP_ROUTER */
-
 PUBLIC ip_port_t ip_port_table[IP_PORT_NR];
 PUBLIC ip_fd_t ip_fd_table[IP_FD_NR];
 PUBLIC ip_ass_t ip_ass_table[IP_ASS_NR];
+PUBLIC ip_ass_t *ip_ass_hash[IP_ASS_HASH_NR];
+PUBLIC ip_fd_t *ip_proto_hash[IP_PROTO_HASH_NR];
+PUBLIC ip_fd_t *ip_any_fds;
+
+
+PRIVATE int ip_select (fd, operations)
+int fd;
+int operations;
+{
+	ip_fd_t *ip_fd;
+	int ready;
 
+	ip_fd= &ip_fd_table[fd];
+
+	ready= SEL_WR;
+	if (!(ip_fd->if_flags & IFF_OPTSET) || (ip_fd->if_rd_buf &&
+		get_time() <= ip_fd->if_exp_tim))
+	{
+		ready |= SEL_RD;
+	}
+	return ready & operations;
+}
 
 PRIVATE int ip_cancel (fd, which_operation)
 int fd;
@@ -92,24 +110,31 @@ PUBLIC void ip_init()
 	assert (BUF_S >= sizeof(nwio_ipopt_t));
 	assert (BUF_S >= sizeof(nwio_route_t));
 
-	ip_port_table[0].ip_dl.dl_eth.de_port= ETH0;
-	ip_port_table[0].ip_dl_type= IPDL_ETH;
-	ip_port_table[0].ip_minor= IP_DEV0;
-
 	for (i=0, ip_ass= ip_ass_table; i<IP_ASS_NR; i++, ip_ass++)
 	{
+		ip_ass->ia_flags= IAF_EMPTY;
 		ip_ass->ia_frags= 0;
 		ip_ass->ia_first_time= 0;
 		ip_ass->ia_port= 0;
 	}
+	for (i=0; i<IP_ASS_HASH_NR; i++)
+		ip_ass_hash[i]= 0;
+	bf_logon(ip_buffree);
 
 	for (i=0, ip_fd= ip_fd_table; i<IP_FD_NR; i++, ip_fd++)
 	{
 		ip_fd->if_flags= IFF_EMPTY;
+		ip_fd->if_chain= 0;
 	}
+	for (i=0; i<IP_PROTO_HASH_NR; i++)
+		ip_proto_hash[i]= 0;
+	ip_any_fds= 0;
 
 	for (i=0, ip_port= ip_port_table; i<IP_PORT_NR; i++, ip_port++)
 	{
+		ip_port->ip_dl.dl_eth.de_port= ETH0+i;
+		ip_port->ip_dl_type= IPDL_ETH;
+		ip_port->ip_minor= IP_DEV(i);
 		ip_port->ip_flags= IPF_EMPTY;
 		switch(ip_port->ip_dl_type)
 		{
@@ -132,7 +157,7 @@ PUBLIC void ip_init()
 
 		result= sr_add_minor(ip_port->ip_minor,
 			ip_port-ip_port_table, ip_open, ip_close,
-			ip_read, ip_write, ip_ioctl, ip_cancel);
+			ip_read, ip_write, ip_ioctl, ip_cancel, ip_select);
 		assert (result>=0);
 
 		switch(ip_port->ip_dl_type)
@@ -156,13 +181,17 @@ ip_port_t *ip_port;
 	{
 	case IES_EMPTY:
 		ip_port->ip_dl.dl_eth.de_wr_ipaddr= (ipaddr_t)0;
+		for (i=0; i<IP_ARPQ_NR; i++)
+			ip_port->ip_dl.dl_eth.de_arpq[i].iq_flags= IQF_EMPTY;
 		ip_port->ip_dl.dl_eth.de_state= IES_SETPROTO;
 		ip_port->ip_dl.dl_eth.de_fd= eth_open(ip_port->
 			ip_dl.dl_eth.de_port, ip_port-ip_port_table,
 			get_eth_data, put_eth_data);
 		if (ip_port->ip_dl.dl_eth.de_fd < 0)
 		{
-			printf("ip.c: unable to open eth port\n");
+			/* A port without a card is disabled, not broken. */
+			if (ip_port->ip_dl.dl_eth.de_fd != EGENERIC)
+				printf("ip.c: unable to open eth port\n");
 			return;
 		}
 
@@ -487,6 +516,7 @@ int fd;
 	assert ((ip_fd->if_flags & IFF_INUSE) &&
 		!(ip_fd->if_flags & IFF_BUSY));
 
+	ip_unlink_fd(ip_fd);
 	ip_fd->if_flags= IFF_EMPTY;
 	if (ip_fd->if_rd_buf)
 	{
@@ -17,13 +17,45 @@ ip.h
 */
 
 #define IP_FD_NR	32
-#define IP_PORT_NR	1
-#define IP_ASS_NR	3
+#define IP_PORT_NR	INET_PORT_NR
+
+/* Datagrams being reassembled are found through a hash table.  Together
+ * they hold at most IP_ASS_MAX_MEM bytes, and a datagram that is not
+ * complete after IP_ASS_TIMEOUT is dropped.
+ */
+#if _WORD_SIZE == 2
+#define IP_ASS_NR	4
+#define IP_ASS_HASH_NR	4
+#define IP_ASS_MAX_MEM	(8*1024L)
+#else
+#define IP_ASS_NR	32
+#define IP_ASS_HASH_NR	16
+#define IP_ASS_MAX_MEM	(32*1024L)
+#endif
+#define IP_ASS_TIMEOUT	(30*HZ)
+
+#define IP_ARPQ_NR	4	/* destinations waiting for ARP */
+#define IP_ARPQ_MAX	4	/* packets queued per destination */
 
 #define IP_SUN_BROADCAST	1	/* hostnumber 0 is also network
 					   broadcast */
-#define IP_ROUTER		0	/* this implementation isn't a
-					   gateway */
+#ifndef IP_ROUTER
+#define IP_ROUTER	(IP_PORT_NR > 1)	/* forward packets between
+						   the ports that are up */
+#endif
+
+typedef struct ip_arpq
+{
+	int iq_flags;
+	ipaddr_t iq_ipaddr;
+	acc_t *iq_head, *iq_tail;
+	int iq_nr;
+	ether_addr_t iq_ethaddr;
+} ip_arpq_t;
+
+#define IQF_EMPTY	0x0
+#define IQF_INUSE	0x1
+#define IQF_COMPL	0x2
 
 typedef struct ip_port
 {
@@ -40,8 +72,7 @@ typedef struct ip_port
 			acc_t *de_wr_frame;
 			ether_addr_t de_wr_ethaddr;
 			ipaddr_t de_wr_ipaddr;
-			acc_t *de_arp_pack;
-			ether_addr_t de_arp_ethaddr;
+			ip_arpq_t de_arpq[IP_ARPQ_NR];
 		} dl_eth;
 	} ip_dl;
 	int ip_minor;
@@ -61,10 +92,6 @@ typedef struct ip_port
 #define IEF_SUSPEND	0x8
 #define IEF_READ_IP	0x10
 #define IEF_READ_SP	0x20
-#define IEF_ARP_MASK	0x1c0
-#	define IEF_ARP_IP	0x40
-#	define IEF_ARP_SP	0x80
-#	define IEF_ARP_COMPL	0x100
 
 #define IPF_EMPTY	0x0
 #define IPF_IPADDRSET	0x1
@@ -74,14 +101,20 @@ typedef struct ip_port
 
 typedef struct ip_ass
 {
+	int ia_flags;
 	acc_t *ia_frags;
 	int ia_min_ttl;
 	ip_port_t *ia_port;
 	time_t ia_first_time;
 	ipaddr_t ia_srcaddr, ia_dstaddr;
 	int ia_proto, ia_id;
+	long ia_size;			/* bytes received so far */
+	struct ip_ass *ia_next;		/* hash chain */
 } ip_ass_t;
 
+#define IAF_EMPTY	0x0
+#define IAF_INUSE	0x1
+
 typedef struct ip_fd
 {
 	int if_flags;
@@ -96,8 +129,15 @@ typedef struct ip_fd
 	ipaddr_t if_wr_dstaddr;
 	size_t if_wr_count;
 	ip_port_t *if_wr_port;
+	struct ip_fd **if_chain;	/* list this fd is on, if any */
+	struct ip_fd *if_next;
 } ip_fd_t;
 
+/* Incoming packets are matched against the fds for their protocol, found
+ * through ip_proto_hash, and against ip_any_fds.
+ */
+#define IP_PROTO_HASH_NR	8
+
 #define IFF_EMPTY	0x0
 #define IFF_INUSE	0x1
 #define IFF_OPTSET	0x2
@@ -115,19 +155,26 @@ typedef struct ip_fd
 ipaddr_t ip_get_netmask ARGS(( ipaddr_t hostaddr ));
 int ip_chk_hdropt ARGS(( u8_t *opt, int optlen ));
 void ip_print_frags ARGS(( acc_t *acc ));
+void ip_link_fd ARGS(( ip_fd_t *ip_fd ));
+void ip_unlink_fd ARGS(( ip_fd_t *ip_fd ));
 
 /* ip_read.c */
 void ip_port_arrive ARGS(( ip_port_t *port, acc_t *pack, ip_hdr_t *ip_hdr ));
 void ip_eth_arrived ARGS(( ip_port_t *port, acc_t *pack ));
 int ip_ok_for_fd ARGS(( ip_fd_t *ip_fd, acc_t *pack ));
 int ip_packet2user ARGS(( ip_fd_t *ip_fd ));
+void ip_buffree ARGS(( int priority, size_t reqsize ));
 
 /* ip_write.c */
 void dll_eth_write_frame ARGS(( ip_port_t *port ));
+void dll_write ARGS(( ip_port_t *port, ipaddr_t dst, acc_t *pack ));
 
 extern ip_fd_t ip_fd_table[IP_FD_NR];
 extern ip_port_t ip_port_table[IP_PORT_NR];
 extern ip_ass_t ip_ass_table[IP_ASS_NR];
+extern ip_ass_t *ip_ass_hash[IP_ASS_HASH_NR];
+extern ip_fd_t *ip_proto_hash[IP_PROTO_HASH_NR];
+extern ip_fd_t *ip_any_fds;
 
 
 #define NWIO_DEFAULT    (NWIO_EN_LOC | NWIO_EN_BROAD | NWIO_REMANY | \
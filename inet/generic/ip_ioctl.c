@@ -376,6 +376,7 @@ ip_fd_t *ip_fd;
 		(en_di_flags & NWIO_RW_MASK))
 	{
 		ip_fd->if_flags |= IFF_OPTSET;
+		ip_link_fd(ip_fd);
 
 		if (ip_fd->if_rd_buf)
 			if (get_time() > ip_fd->if_exp_tim ||
@@ -389,6 +390,7 @@ ip_fd_t *ip_fd;
 	else
 	{
 		ip_fd->if_flags &= ~IFF_OPTSET;
+		ip_unlink_fd(ip_fd);
 		if (ip_fd->if_rd_buf)
 		{
 			bf_afree(ip_fd->if_rd_buf);
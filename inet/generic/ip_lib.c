@@ -170,3 +170,44 @@ assert (acc->acc_length >= IP_MIN_HDR_SIZE);
 			'+' : '\0');
 	}
 }
+
+/*
+ip_link_fd
+
+Put an fd on the list that incoming packets for it are looked up in,
+after taking it off the list it was on.
+*/
+
+PUBLIC void ip_link_fd (ip_fd)
+ip_fd_t *ip_fd;
+{
+	ip_fd_t **chain;
+
+	ip_unlink_fd(ip_fd);
+	if (ip_fd->if_ipopt.nwio_flags & NWIO_PROTOSPEC)
+	{
+		chain= &ip_proto_hash[ip_fd->if_ipopt.nwio_proto %
+			IP_PROTO_HASH_NR];
+	}
+	else
+		chain= &ip_any_fds;
+	ip_fd->if_chain= chain;
+	ip_fd->if_next= *chain;
+	*chain= ip_fd;
+}
+
+PUBLIC void ip_unlink_fd (ip_fd)
+ip_fd_t *ip_fd;
+{
+	ip_fd_t **chain;
+
+	if (!ip_fd->if_chain)
+		return;
+	for (chain= ip_fd->if_chain; *chain != ip_fd;
+		chain= &(*chain)->if_next)
+	{
+		assert(*chain);
+	}
+	*chain= ip_fd->if_next;
+	ip_fd->if_chain= 0;
+}
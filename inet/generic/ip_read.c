@@ -12,12 +12,22 @@ ip_read.c
 #include "io.h"
 #include "ip.h"
 #include "ip_int.h"
+#include "ipr.h"
 
 INIT_PANIC();
 
+PRIVATE long ass_mem;		/* bytes held by the reassembly table */
+PRIVATE time_t ass_exp_tim;	/* ass_timer is set for this time */
+PRIVATE timer_t ass_timer;
+
 FORWARD ip_ass_t *find_ass_ent ARGS(( ip_port_t *port, U16_t id,
 	int proto, ipaddr_t src, ipaddr_t dst ));
 FORWARD acc_t *merge_frags ARGS(( acc_t *first, acc_t *second ));
+FORWARD int ass_hash ARGS(( ipaddr_t src, U16_t id ));
+FORWARD void ass_unlink ARGS(( ip_ass_t *ass_ent ));
+FORWARD void ass_free ARGS(( ip_ass_t *ass_ent, int report ));
+FORWARD ip_ass_t *ass_oldest ARGS(( void ));
+FORWARD void ass_timeout ARGS(( int fd, timer_t *timer ));
 FORWARD int net_broad ARGS(( ipaddr_t hoaddr, ipaddr_t netaddr,
 	ipaddr_t netmask ));
 FORWARD int ip_frag_chk ARGS(( acc_t *pack ));
@@ -25,6 +35,12 @@ FORWARD acc_t *reassemble ARGS(( ip_port_t *port, acc_t *pack,
 	ip_hdr_t *ip_hdr ));
 FORWARD int ok_for_port ARGS(( ip_port_t *port, ipaddr_t ipaddr,
 	int *ref_broad_all ));
+FORWARD void ip_deliver ARGS(( ip_port_t *port, acc_t *pack,
+	ip_hdr_t *ip_hdr ));
+#if IP_ROUTER
+FORWARD void ip_route ARGS(( ip_port_t *port, acc_t *pack,
+	ip_hdr_t *ip_hdr ));
+#endif /* IP_ROUTER */
 
 PUBLIC int ip_read (fd, count)
 int fd;
@@ -83,6 +99,8 @@ ip_hdr_t *pack_hdr;
 	pack_data_len= ntohs(pack_hdr->ih_length)-pack_hdr_len;
 	pack_offset= (pack_flags_fragoff & IH_FRAGOFF_MASK)*8;
 	pack->acc_ext_link= NULL;
+	ass_ent->ia_size += pack_hdr_len + pack_data_len;
+	ass_mem += pack_hdr_len + pack_data_len;
 #if DEBUG & 256
  { where(); ip_print_frags(pack); printf("\n"); }
 #endif
@@ -152,9 +170,7 @@ where();
  { where(); printf("got a complete packet now\n"); }
 #endif
 		first_time= ass_ent->ia_first_time;
-
-		ass_ent->ia_frags= 0;
-		ass_ent->ia_first_time= 0;
+		ass_unlink(ass_ent);
 
 		while (pack->acc_ext_link)
 		{
@@ -168,7 +184,12 @@ where();
 			icmp_frag_ass_tim(pack);
 		else
 			return pack;
+		return NULL;
 	}
+
+	/* Make room by dropping the oldest datagrams, this one included. */
+	while (ass_mem > IP_ASS_MAX_MEM)
+		ass_free(ass_oldest(), TRUE);
 	return NULL;
 }
 
@@ -198,7 +219,10 @@ assert (second->acc_length >= IP_MIN_HDR_SIZE);
 	first_hdr_size= (first_hdr->ih_vers_ihl & IH_IHL_MASK) * 4;
 	first_datasize= ntohs(first_hdr->ih_length) - first_hdr_size;
 
-	for (;;)
+	/* Second and the fragments linked to it follow first.  Absorb
+	 * those that overlap or touch first, free those that first covers.
+	 */
+	while (second)
 	{
 		second_hdr= (ip_hdr_t *)ptr2acc_data(second);
 		second_offset= (ntohs(second_hdr->ih_flags_fragoff) &
@@ -206,18 +230,9 @@ assert (second->acc_length >= IP_MIN_HDR_SIZE);
 		second_hdr_size= (second_hdr->ih_vers_ihl & IH_IHL_MASK) * 4;
 		second_datasize= ntohs(second_hdr->ih_length) - second_hdr_size;
 
-#if DEBUG
- if (second_offset <= first_offset)
- { where(); printf ("first_offset= %u, second_offset= %u\n",
-	first_offset, second_offset);
- printf ("first_hdr_size= %u, second_hdr_size= %u\n",
-	first_hdr_size, second_hdr_size);
- printf ("first_datasize= %u, second_datasize= %u\n",
-	first_datasize, second_datasize); }
-#endif
 assert (first_hdr_size + first_datasize == bf_bufsize(first));
 assert (second_hdr_size + second_datasize == bf_bufsize(second));
-assert (second_offset > first_offset);
+assert (second_offset >= first_offset);
 
 		if (second_offset > first_offset+first_datasize)
 		{
@@ -225,12 +240,13 @@ assert (second_offset > first_offset);
 			return first;
 		}
 
+		tmp_acc= second->acc_ext_link;
 		if (second_offset + second_datasize <= first_offset +
 			first_datasize)
 		{
-			first->acc_ext_link= second->acc_ext_link;
 			bf_afree(second);
-			break;
+			second= tmp_acc;
+			continue;
 		}
 
 		if (!(second_hdr->ih_flags_fragoff & HTONS(IH_MORE_FRAGS)))
@@ -240,7 +256,6 @@ assert (second_offset > first_offset);
 			first_datasize);
 		cut_second= bf_cut(second, second_hdr_size + first_offset+
 			first_datasize-second_offset, second_datasize);
-		tmp_acc= second->acc_ext_link;
 		bf_afree(second);
 		second= tmp_acc;
 
@@ -248,14 +263,10 @@ assert (second_offset > first_offset);
 		first_hdr->ih_length= htons(first_hdr_size + first_datasize);
 
 		first= bf_append (first, cut_second);
-		if (!second)
-		{
-			first->acc_ext_link= NULL;
-			break;
-		}
 assert (first->acc_length >= IP_MIN_HDR_SIZE);
 		first_hdr= (ip_hdr_t *)ptr2acc_data(first);
 	}
+	first->acc_ext_link= NULL;
 assert (first_hdr_size + first_datasize == bf_bufsize(first));
 	return first;
 }
@@ -267,69 +278,191 @@ ipproto_t proto;
 ipaddr_t src;
 ipaddr_t dst;
 {
-	ip_ass_t *new_ass_ent, *tmp_ass_ent;
+	ip_ass_t *ass_ent, **chain;
 	int i;
-	acc_t *tmp_acc, *curr_acc;
 
 #if DEBUG & 256
  { where(); printf("find_ass_ent (.., id= %u, proto= %u, src= ",
 	id, ntohs(proto)); writeIpAddr(src); printf(" dst= ");
 	writeIpAddr(dst); printf(")\n"); }
 #endif
-	new_ass_ent= 0;
-
-	for (i=0, tmp_ass_ent= ip_ass_table; i<IP_ASS_NR; i++,
-		tmp_ass_ent++)
+	chain= &ip_ass_hash[ass_hash(src, id)];
+	for (ass_ent= *chain; ass_ent; ass_ent= ass_ent->ia_next)
 	{
-		if (!tmp_ass_ent->ia_frags && tmp_ass_ent->
-			ia_first_time)
-		{
-#if DEBUG
- { where(); printf("ip.c: strange ip_ass entry (can be a race condition)\n"); }
-#endif
-			continue;
-		}
-
-		if ((tmp_ass_ent->ia_srcaddr == src) &&
-			(tmp_ass_ent->ia_dstaddr == dst) &&
-			(tmp_ass_ent->ia_proto == proto) &&
-			(tmp_ass_ent->ia_id == id) &&
-			(tmp_ass_ent->ia_port == port))
+		if ((ass_ent->ia_srcaddr == src) &&
+			(ass_ent->ia_dstaddr == dst) &&
+			(ass_ent->ia_proto == proto) &&
+			(ass_ent->ia_id == id) &&
+			(ass_ent->ia_port == port))
 		{
 #if DEBUG & 256
  { where(); printf("found an ass_ent\n"); }
 #endif
-			return tmp_ass_ent;
+			return ass_ent;
 		}
-		if (!new_ass_ent || tmp_ass_ent->ia_first_time <
-			new_ass_ent->ia_first_time)
-			new_ass_ent= tmp_ass_ent;
+	}
+
+	for (i=0, ass_ent= ip_ass_table; i<IP_ASS_NR; i++, ass_ent++)
+	{
+		if (!(ass_ent->ia_flags & IAF_INUSE))
+			break;
+	}
+	if (i>=IP_ASS_NR)
+	{
+		ass_ent= ass_oldest();
+		ass_free(ass_ent, TRUE);
 	}
 #if DEBUG & 256
  { where(); printf("made an ass_ent\n"); }
 #endif
-	new_ass_ent->ia_min_ttl= IP_MAX_TTL;
-	new_ass_ent->ia_port= port;
-	new_ass_ent->ia_first_time= get_time();
-	new_ass_ent->ia_srcaddr= src;
-	new_ass_ent->ia_dstaddr= dst;
-	new_ass_ent->ia_proto= proto;
-	new_ass_ent->ia_id= id;
+	ass_ent->ia_flags= IAF_INUSE;
+	ass_ent->ia_frags= 0;
+	ass_ent->ia_min_ttl= IP_MAX_TTL;
+	ass_ent->ia_port= port;
+	ass_ent->ia_first_time= get_time();
+	ass_ent->ia_srcaddr= src;
+	ass_ent->ia_dstaddr= dst;
+	ass_ent->ia_proto= proto;
+	ass_ent->ia_id= id;
+	ass_ent->ia_size= 0;
+	ass_ent->ia_next= *chain;
+	*chain= ass_ent;
+
+	if (!ass_exp_tim)
+	{
+		ass_exp_tim= ass_ent->ia_first_time + IP_ASS_TIMEOUT;
+		clck_timer(&ass_timer, ass_exp_tim, ass_timeout, 0);
+	}
+	return ass_ent;
+}
+
+PRIVATE int ass_hash (src, id)
+ipaddr_t src;
+u16_t id;
+{
+	return (int)((ntohl(src) ^ id) % IP_ASS_HASH_NR);
+}
+
+/*
+ass_unlink
+
+Take an entry out of the reassembly table.  Its fragments, if any, are
+left to the caller.
+*/
+
+PRIVATE void ass_unlink (ass_ent)
+ip_ass_t *ass_ent;
+{
+	ip_ass_t **chain;
+
+	for (chain= &ip_ass_hash[ass_hash(ass_ent->ia_srcaddr,
+		ass_ent->ia_id)]; *chain != ass_ent; chain= &(*chain)->ia_next)
+	{
+		assert(*chain);
+	}
+	*chain= ass_ent->ia_next;
+	ass_mem -= ass_ent->ia_size;
+	ass_ent->ia_flags= IAF_EMPTY;
+	ass_ent->ia_frags= 0;
+	ass_ent->ia_first_time= 0;
+}
+
+PRIVATE void ass_free (ass_ent, report)
+ip_ass_t *ass_ent;
+int report;
+{
+	acc_t *frags, *tmp_acc;
+
+	frags= ass_ent->ia_frags;
+	ass_unlink(ass_ent);
+	if (!frags)
+		return;
+	while (frags->acc_ext_link)
+	{
+		tmp_acc= frags->acc_ext_link;
+		frags->acc_ext_link= tmp_acc->acc_ext_link;
+		bf_afree(tmp_acc);
+	}
+	if (report)
+		icmp_frag_ass_tim(frags);
+	else
+		bf_afree(frags);
+}
+
+PRIVATE ip_ass_t *ass_oldest()
+{
+	ip_ass_t *ass_ent, *oldest;
+	int i;
 
-	if (new_ass_ent->ia_frags)
+	oldest= 0;
+	for (i=0, ass_ent= ip_ass_table; i<IP_ASS_NR; i++, ass_ent++)
 	{
-		curr_acc= new_ass_ent->ia_frags->acc_ext_link;
-		while (curr_acc)
+		if (!(ass_ent->ia_flags & IAF_INUSE))
+			continue;
+		if (!oldest || ass_ent->ia_first_time < oldest->ia_first_time)
+			oldest= ass_ent;
+	}
+	assert(oldest);
+	return oldest;
+}
+
+PRIVATE void ass_timeout (fd, timer)
+int fd;
+timer_t *timer;
+{
+	ip_ass_t *ass_ent;
+	time_t curr_tim;
+	int i;
+
+	assert (timer == &ass_timer);
+
+	curr_tim= get_time();
+	ass_exp_tim= 0;
+	for (i=0, ass_ent= ip_ass_table; i<IP_ASS_NR; i++, ass_ent++)
+	{
+		if (!(ass_ent->ia_flags & IAF_INUSE))
+			continue;
+		if (ass_ent->ia_first_time + IP_ASS_TIMEOUT <= curr_tim)
+		{
+			ass_free(ass_ent, TRUE);
+			continue;
+		}
+		if (!ass_exp_tim || ass_ent->ia_first_time + IP_ASS_TIMEOUT <
+			ass_exp_tim)
 		{
-			tmp_acc= curr_acc->acc_ext_link;
-			bf_afree(curr_acc);
-			curr_acc= tmp_acc;
+			ass_exp_tim= ass_ent->ia_first_time + IP_ASS_TIMEOUT;
 		}
-		curr_acc= new_ass_ent->ia_frags;
-		new_ass_ent->ia_frags= 0;
-		icmp_frag_ass_tim(curr_acc);
 	}
-	return new_ass_ent;
+	if (ass_exp_tim)
+		clck_timer(&ass_timer, ass_exp_tim, ass_timeout, 0);
+}
+
+/*
+ip_buffree
+
+Drop partly reassembled datagrams when the buffers run out.  An entry
+without fragments may be in the middle of reassemble() and is left
+alone.
+*/
+
+PUBLIC void ip_buffree (priority, reqsize)
+int priority;
+size_t reqsize;
+{
+	ip_ass_t *ass_ent;
+	int i;
+
+	if (priority < IP_PRI_ASSBUFS)
+		return;
+
+	for (i=0, ass_ent= ip_ass_table; i<IP_ASS_NR; i++, ass_ent++)
+	{
+		if (!(ass_ent->ia_flags & IAF_INUSE) || !ass_ent->ia_frags)
+			continue;
+		ass_free(ass_ent, FALSE);
+		if (bf_free_buffsize >= reqsize)
+			return;
+	}
 }
 
 PUBLIC void ip_eth_arrived(ip_port, pack)
@@ -412,6 +545,14 @@ assert (ip_acc->acc_length >= IP_MIN_HDR_SIZE);
 	}
 	for_this_port= ok_for_port(ip_port, ip_hdr->ih_dst,
 		&broadcast_allowed);
+#if IP_ROUTER
+	if (!for_this_port && !broadcast_pack)
+	{
+		bf_afree(eth_acc);
+		ip_route(ip_port, ip_acc, ip_hdr);
+		return;
+	}
+#endif /* IP_ROUTER */
 
 	if (!broadcast_allowed && broadcast_pack)
 	{
@@ -424,7 +565,6 @@ assert (ip_acc->acc_length >= IP_MIN_HDR_SIZE);
 		bf_afree(eth_acc);
 		return;
 	}
-#if !IP_ROUTER
 	if (!for_this_port)
 	{
 #if DEBUG
@@ -437,15 +577,22 @@ assert (ip_acc->acc_length >= IP_MIN_HDR_SIZE);
 		bf_afree(eth_acc);
 		return;
 	}
-#else
-	if (!for_this_port)
-	{
-		bf_afree(eth_acc);
-		ip_route(ip_port, ip_acc);
-		return;
-	}
-#endif /* !IP_ROUTER */
 	bf_afree(eth_acc);
+	ip_deliver(ip_port, ip_acc, ip_hdr);
+}
+
+/*
+ip_deliver
+
+Hand a packet for this host to the fds of ip_port, after reassembly if it
+is a fragment.
+*/
+
+PRIVATE void ip_deliver(ip_port, ip_acc, ip_hdr)
+ip_port_t *ip_port;
+acc_t *ip_acc;
+ip_hdr_t *ip_hdr;
+{
 	if (ntohs(ip_hdr->ih_flags_fragoff) & (IH_FRAGOFF_MASK|IH_MORE_FRAGS))
 	{
 #if DEBUG & 256
@@ -461,6 +608,124 @@ assert (!(ntohs(ip_hdr->ih_flags_fragoff) & (IH_FRAGOFF_MASK|IH_MORE_FRAGS)));
 	ip_port_arrive (ip_port, ip_acc, ip_hdr);
 }
 
+#if IP_ROUTER
+/*
+ip_route
+
+Forward a packet that came in on ip_port for another host.  It goes
+straight to the data link layer of the outgoing port, without passing
+through an ip fd.  Only ports that are up take part, and a packet is
+never sent back out of the port it came in on, so nothing is forwarded
+unless two ports are up.  Packets that can't be forwarded are dropped.
+*/
+
+PRIVATE void ip_route(ip_port, pack, ip_hdr)
+ip_port_t *ip_port;
+acc_t *pack;
+ip_hdr_t *ip_hdr;
+{
+	ip_port_t *out_port;
+	acc_t *hdr_pack;
+	ipaddr_t dst, nexthop;
+	u32_t hostdst;
+	int i, port, result, hdr_len;
+	size_t pack_size;
+
+	dst= ip_hdr->ih_dst;
+
+	/* The address of one of the other ports is still for this host. */
+	for (i=0, out_port= ip_port_table; i<IP_PORT_NR; i++, out_port++)
+	{
+		if ((out_port->ip_flags & IPF_IPADDRSET) &&
+			out_port->ip_ipaddr == dst)
+		{
+			ip_deliver(out_port, pack, ip_hdr);
+			return;
+		}
+	}
+
+	/* Loopback, multicast and experimental addresses stay where they
+	 * are, and so do packets from a broadcast address.
+	 */
+	hostdst= ntohl(dst);
+	if (hostdst == 0 || (hostdst >> 24) == 0x7f || (hostdst >> 28) >= 0xe
+		|| ip_hdr->ih_src == (ipaddr_t)-1)
+	{
+		bf_afree(pack);
+		return;
+	}
+	if (ip_hdr->ih_ttl <= 1)
+	{
+		icmp_ttl_exceded(pack);
+		return;
+	}
+
+	/* A directly connected network first, then the routing table. */
+	for (i=0, out_port= ip_port_table; i<IP_PORT_NR; i++, out_port++)
+	{
+		if (!(out_port->ip_flags & IPF_IPADDRSET))
+			continue;
+		if ((dst & out_port->ip_netmask) ==
+			(out_port->ip_ipaddr & out_port->ip_netmask))
+		{
+			break;
+		}
+	}
+	if (i<IP_PORT_NR)
+	{
+		if (net_broad(dst, out_port->ip_ipaddr &
+			out_port->ip_netmask, out_port->ip_netmask))
+		{
+			bf_afree(pack);
+			return;
+		}
+		nexthop= dst;
+	}
+	else
+	{
+		result= iproute_frag(dst, ip_hdr->ih_ttl, &nexthop, &port);
+		if (result <= 0)
+		{
+#if DEBUG
+ { where(); printf("no route to "); writeIpAddr(dst); printf("\n"); }
+#endif
+			bf_afree(pack);
+			return;
+		}
+		out_port= &ip_port_table[port];
+	}
+	if (out_port == ip_port || !(out_port->ip_flags & IPF_IPADDRSET) ||
+		out_port->ip_dl.dl_eth.de_state != IES_MAIN)
+	{
+		bf_afree(pack);
+		return;
+	}
+
+	/* The header is changed, it needs a private copy if the buffer is
+	 * shared with someone else.
+	 */
+	hdr_len= (ip_hdr->ih_vers_ihl & IH_IHL_MASK) << 2;
+	if (pack->acc_linkC != 1 || pack->acc_buffer->buf_linkC != 1)
+	{
+		pack_size= bf_bufsize(pack);
+		hdr_pack= bf_pack(bf_cut(pack, 0, hdr_len));
+		if (pack_size > hdr_len)
+		{
+			hdr_pack->acc_next= bf_cut(pack, hdr_len,
+				pack_size-hdr_len);
+		}
+		bf_afree(pack);
+		pack= hdr_pack;
+		ip_hdr= (ip_hdr_t *)ptr2acc_data(pack);
+	}
+assert (pack->acc_linkC == 1 && pack->acc_buffer->buf_linkC == 1);
+
+	/* ip_split_pack recomputes the header checksum on the way out. */
+	ip_hdr->ih_ttl--;
+	dll_write(out_port, nexthop, pack);
+}
+#endif /* IP_ROUTER */
+
 PRIVATE int ok_for_port (ip_port, ipaddr, ref_broad_all)
 ip_port_t *ip_port;
 ipaddr_t ipaddr;
@@ -668,7 +933,7 @@ ip_hdr_t *ip_hdr;
 	ip_hdr_t *hdr;
 	int port_nr;
 	unsigned long ip_pack_stat;
-	int i;
+	int i, any;
 	ipproto_t proto;
 	time_t exp_tim;
 
@@ -693,23 +958,22 @@ assert (pack->acc_length >= IP_MIN_HDR_SIZE);
 #endif
 
 	share_fd= 0;
-	for (i=0, ip_fd=ip_fd_table; i<IP_FD_NR; i++, ip_fd++)
+	ip_fd= ip_proto_hash[proto % IP_PROTO_HASH_NR];
+	for (any= FALSE;; ip_fd= ip_fd->if_next)
 	{
-		if (!(ip_fd->if_flags & IFF_INUSE))
+		if (!ip_fd && !any)
 		{
-			continue;
+			ip_fd= ip_any_fds;
+			any= TRUE;
 		}
+		if (!ip_fd)
+			break;
+		i= ip_fd-ip_fd_table;
 #if DEBUG & 256
  { where(); printf("ip_fd_table[%d].if_flags= 0x%x\n",
 	ip_fd-ip_fd_table, ip_fd->if_flags); }
 #endif
-		if (!(ip_fd->if_flags & IFF_OPTSET))
-		{
-#if DEBUG & 256
- { where(); printf("%d options not set\n", i); }
-#endif
-			continue;
-		}
+assert (ip_fd->if_flags & IFF_OPTSET);
 		if (ip_fd->if_port != ip_port)
 		{
 #if DEBUG
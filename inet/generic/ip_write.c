@@ -21,13 +21,14 @@ INIT_PANIC();
 FORWARD acc_t *get_packet ARGS(( ip_fd_t *ip_fd,
 	U16_t id /* should be: u16_t id */ ));
 FORWARD int dll_ready ARGS(( ip_port_t *port, ipaddr_t dst ));
-FORWARD void dll_write ARGS(( ip_port_t *port, ipaddr_t dst,
-	acc_t *pack ));
 FORWARD int dll_eth_ready ARGS(( ip_port_t *port, ipaddr_t dst ));
 FORWARD void dll_eth_write ARGS(( ip_port_t *port, ipaddr_t dst,
 	acc_t *pack ));
-FORWARD void dll_eth_arp_func ARGS(( int fd,
+FORWARD void dll_eth_arp_func ARGS(( int fd, ipaddr_t ipaddr,
 	ether_addr_t *ethaddr ));
+FORWARD ip_arpq_t *dll_eth_arpq ARGS(( ip_port_t *ip_port,
+	ipaddr_t dst ));
+FORWARD void dll_eth_arpq_free ARGS(( ip_arpq_t *arpq ));
 FORWARD acc_t *ip_split_pack ARGS(( acc_t **ref_last,
 	int first_size ));
 FORWARD void error_reply ARGS(( ip_fd_t *fd, int error ));
@@ -314,20 +315,31 @@ ipaddr_t dst;
 	}
 assert (result == NW_SUSPEND);
 
-	if (!(port->ip_dl.dl_eth.de_flags & IEF_ARP_IP))
+	/* The packet waits for ARP if there is room in the queue of its
+	 * destination.
+	 */
+	if (dll_eth_arpq(port, dst))
 	{
 #if DEBUG & 256
- { where(); printf("dll_eth_ready: no ARP_IP\n"); }
+ { where(); printf("dll_eth_ready: queued for ARP\n"); }
 #endif
 		return NW_OK;
 	}
 #if DEBUG
- { where(); printf("dll_eth_ready: ARP_IP\n"); }
+ { where(); printf("dll_eth_ready: ARP queue full\n"); }
 #endif
 	return NW_SUSPEND;
 }
 
-PRIVATE void dll_write (port, dst, pack)
+/*
+dll_write
+
+Send a packet to dst over the data link layer of port.  It waits for ARP,
+or behind the packet being sent, if it has to; it is dropped if there is no
+room to wait.
+*/
+
+PUBLIC void dll_write (port, dst, pack)
 ip_port_t *port;
 ipaddr_t dst;
 acc_t *pack;
@@ -349,6 +361,7 @@ ipaddr_t dst;
 acc_t *pack;
 {
 	int result;
+	ip_arpq_t *arpq;
 
 	if (!ip_port->ip_dl.dl_eth.de_wr_frag)
 	{
@@ -380,9 +393,25 @@ acc_t *pack;
 			return;
 		}
 	}
-	assert (!(ip_port->ip_dl.dl_eth.de_flags & IEF_ARP_MASK));
-	ip_port->ip_dl.dl_eth.de_arp_pack= pack;
-	ip_port->ip_dl.dl_eth.de_flags |= IEF_ARP_IP;
+	arpq= dll_eth_arpq(ip_port, dst);
+	if (!arpq)
+	{
+		bf_afree(pack);
+		return;
+	}
+	pack->acc_ext_link= 0;
+	if (arpq->iq_flags & IQF_INUSE)
+	{
+		arpq->iq_tail->acc_ext_link= pack;
+		arpq->iq_tail= pack;
+		arpq->iq_nr++;
+		return;
+	}
+	arpq->iq_flags= IQF_INUSE;
+	arpq->iq_ipaddr= dst;
+	arpq->iq_head= pack;
+	arpq->iq_tail= pack;
+	arpq->iq_nr= 1;
 #if DEBUG & 256
  { where(); printf("ip_write.c: calling arp_ip_eth(...)\n"); }
 #endif
@@ -391,22 +420,55 @@ acc_t *pack;
 #if DEBUG & 256
  { where(); printf("ip_write.c: arp_ip_eth(...)= %d\n", result); }
 #endif
-	if (result == NW_SUSPEND)
-		ip_port->ip_dl.dl_eth.de_flags |= IEF_ARP_SP;
-	else if (result == EDSTNOTRCH)
+	if (result != NW_SUSPEND && result != NW_OK)
+		dll_eth_arpq_free(arpq);
+}
+
+/*
+dll_eth_arpq
+
+Return the ARP queue of dst if it has room for another packet, or else a
+free queue.
+*/
+
+PRIVATE ip_arpq_t *dll_eth_arpq (ip_port, dst)
+ip_port_t *ip_port;
+ipaddr_t dst;
+{
+	ip_arpq_t *arpq, *free_q;
+	int i;
+
+	free_q= 0;
+	for (i=0, arpq= ip_port->ip_dl.dl_eth.de_arpq; i<IP_ARPQ_NR;
+		i++, arpq++)
 	{
-		if (ip_port->ip_dl.dl_eth.de_arp_pack)
+		if (!(arpq->iq_flags & IQF_INUSE))
 		{
-			bf_afree(ip_port->ip_dl.dl_eth.de_arp_pack);
-			ip_port->ip_dl.dl_eth.de_arp_pack= 0;
+			if (!free_q)
+				free_q= arpq;
+			continue;
 		}
-		ip_port->ip_dl.dl_eth.de_flags &= ~IEF_ARP_MASK;
+		if (arpq->iq_ipaddr != dst)
+			continue;
+		if (arpq->iq_nr >= IP_ARPQ_MAX)
+			return 0;
+		return arpq;
 	}
-	else
+	return free_q;
+}
+
+PRIVATE void dll_eth_arpq_free (arpq)
+ip_arpq_t *arpq;
+{
+	acc_t *pack;
+
+	while (arpq->iq_head)
 	{
-		assert (result == NW_OK);
-		assert (ip_port->ip_dl.dl_eth.de_flags & IEF_WRITE_IP);
+		pack= arpq->iq_head;
+		arpq->iq_head= pack->acc_ext_link;
+		bf_afree(pack);
 	}
+	arpq->iq_flags= IQF_EMPTY;
 }
 
 PUBLIC void dll_eth_write_frame (ip_port)
@@ -487,11 +549,14 @@ assert (ip_port->ip_dl.dl_eth.de_wr_frag);
 	ip_port->ip_dl.dl_eth.de_flags &= ~IEF_WRITE_IP;
 }
 
-PRIVATE void dll_eth_arp_func (port, ethaddr)
+PRIVATE void dll_eth_arp_func (port, ipaddr, ethaddr)
 int port;
+ipaddr_t ipaddr;
 ether_addr_t *ethaddr;
 {
 	ip_port_t *ip_port;
+	ip_arpq_t *arpq;
+	int i;
 
 #if DEBUG & 256
  { where(); printf("ip_write.c: dll_eth_arp_func(port= %d, ...)\n",
@@ -499,20 +564,22 @@ ether_addr_t *ethaddr;
 #endif
 	ip_port= &ip_port_table[port];
 
-	if (ethaddr && ip_port->ip_dl.dl_eth.de_arp_pack)
+	for (i=0, arpq= ip_port->ip_dl.dl_eth.de_arpq; i<IP_ARPQ_NR;
+		i++, arpq++)
 	{
-		ip_port->ip_dl.dl_eth.de_arp_ethaddr= *ethaddr;
-		ip_port->ip_dl.dl_eth.de_flags |= IEF_ARP_COMPL;
+		if ((arpq->iq_flags & IQF_INUSE) && arpq->iq_ipaddr == ipaddr)
+			break;
 	}
-	else
+	if (i>=IP_ARPQ_NR)
+		return;
+
+	if (ethaddr)
 	{
-		if (ip_port->ip_dl.dl_eth.de_arp_pack)
-		{
-			bf_afree(ip_port->ip_dl.dl_eth.de_arp_pack);
-			ip_port->ip_dl.dl_eth.de_arp_pack= 0;
-		}
-		ip_port->ip_dl.dl_eth.de_flags &= ~IEF_ARP_MASK;
+		arpq->iq_ethaddr= *ethaddr;
+		arpq->iq_flags |= IQF_COMPL;
 	}
+	else
+		dll_eth_arpq_free(arpq);
 	if (!(ip_port->ip_dl.dl_eth.de_flags & IEF_WRITE_IP))
 		dll_eth_write_frame(ip_port);
 }
@@ -522,6 +589,7 @@ ip_port_t *ip_port;
 {
 	int i;
 	ip_fd_t *ip_fd;
+	ip_arpq_t *arpq;
 
 	if (ip_port->ip_dl.dl_eth.de_wr_frag)
 		return;
@@ -532,18 +600,22 @@ ip_port_t *ip_port;
 		if (ip_port->ip_dl.dl_eth.de_wr_frag)
 			return;
 	}
-	if (ip_port->ip_dl.dl_eth.de_flags & IEF_ARP_COMPL)
+	for (i=0, arpq= ip_port->ip_dl.dl_eth.de_arpq; i<IP_ARPQ_NR;
+		i++, arpq++)
 	{
+		if (!(arpq->iq_flags & IQF_COMPL))
+			continue;
 #if DEBUG & 256
  { where(); printf("processing arp_pack\n"); }
 #endif
-		assert (ip_port->ip_dl.dl_eth.de_arp_pack);
-		ip_port->ip_dl.dl_eth.de_wr_ipaddr= (ipaddr_t)0;
-		ip_port->ip_dl.dl_eth.de_wr_ethaddr= ip_port->ip_dl.
-			dl_eth.de_arp_ethaddr;
-		ip_port->ip_dl.dl_eth.de_wr_frag= ip_port->ip_dl.dl_eth.
-			de_arp_pack;
-		ip_port->ip_dl.dl_eth.de_flags &= ~IEF_ARP_MASK;
+		assert (arpq->iq_head);
+		ip_port->ip_dl.dl_eth.de_wr_ipaddr= arpq->iq_ipaddr;
+		ip_port->ip_dl.dl_eth.de_wr_ethaddr= arpq->iq_ethaddr;
+		ip_port->ip_dl.dl_eth.de_wr_frag= arpq->iq_head;
+		arpq->iq_head= arpq->iq_head->acc_ext_link;
+		ip_port->ip_dl.dl_eth.de_wr_frag->acc_ext_link= 0;
+		if (!--arpq->iq_nr)
+			arpq->iq_flags= IQF_EMPTY;
 		return;
 	}
 	for (i=0, ip_fd= ip_fd_table; i<IP_FD_NR; i++, ip_fd++)
@@ -11,13 +11,51 @@ ipr.c
 
 INIT_PANIC();
 
+/* Routes are found by longest prefix match.  For every prefix length in
+ * use the routes are hashed on their network number, so a lookup probes at
+ * most one chain per prefix length, whatever the size of the table.  Routes
+ * with a netmask that is not a prefix are kept on a separate list.  The
+ * result of a lookup is kept in a small cache that is flushed whenever the
+ * table changes.
+ */
+#if _WORD_SIZE == 2
 #define ROUTE_NR	32
+#define ROUTE_HASH_NR	16
+#define RTC_NR		16
+#else
+#define ROUTE_NR	256
+#define ROUTE_HASH_NR	64
+#define RTC_NR		64
+#endif
 #define DIST_UNREACHABLE	512
 
+typedef struct rtcache
+{
+	ipaddr_t rtc_dest;
+	route_t *rtc_route;
+	unsigned rtc_gen;
+} rtcache_t;
+
 PRIVATE route_t route_table[ROUTE_NR];
+PRIVATE route_t *route_hash[ROUTE_HASH_NR];
+PRIVATE route_t *route_odd;		/* netmask is not a prefix */
+PRIVATE int route_plen_nr[33];		/* routes for each prefix length */
+PRIVATE rtcache_t route_cache[RTC_NR];
+PRIVATE unsigned route_gen;		/* changes with the table */
+PRIVATE time_t route_exp_tim;		/* a route expires, 0 if none */
 PRIVATE int fixed_routes;
 
 FORWARD route_t *get_route_ent ARGS(( ipaddr_t dest ));
+FORWARD route_t *ipr_lookup ARGS(( ipaddr_t dest ));
+FORWARD int ipr_prefer ARGS(( route_t *route, route_t *best ));
+FORWARD int ipr_expired ARGS(( route_t *route, time_t currtim ));
+FORWARD void ipr_expire_all ARGS(( time_t currtim ));
+FORWARD void ipr_link ARGS(( route_t *route ));
+FORWARD void ipr_unlink ARGS(( route_t *route ));
+FORWARD route_t **ipr_chain ARGS(( route_t *route ));
+FORWARD ipaddr_t ipr_mask ARGS(( int plen ));
+FORWARD unsigned ipr_hash ARGS(( ipaddr_t net, int plen ));
+FORWARD void ipr_flush ARGS(( void ));
 
 PUBLIC void ipr_init()
 {
@@ -26,6 +64,15 @@ PUBLIC void ipr_init()
 
 	for (i= 0, route_ind= route_table; i<ROUTE_NR; i++, route_ind++)
 		route_ind->rt_flags= RTF_EMPTY;
+	for (i= 0; i<ROUTE_HASH_NR; i++)
+		route_hash[i]= 0;
+	route_odd= 0;
+	for (i= 0; i<=32; i++)
+		route_plen_nr[i]= 0;
+	for (i= 0; i<RTC_NR; i++)
+		route_cache[i].rtc_gen= 0;
+	route_gen= 1;
+	route_exp_tim= 0;
 	fixed_routes= 0;
 }
 
@@ -49,68 +96,232 @@ int *port;
 PRIVATE route_t *get_route_ent(dest)
 ipaddr_t dest;
 {
-	route_t *route_ind, *route_hi;
-	route_t *bestroute, *sec_bestroute, tmproute;
+	rtcache_t *rtc;
+	route_t *route;
 	time_t currtim;
 
 	currtim= get_time();
+	if (route_exp_tim && route_exp_tim < currtim)
+		ipr_expire_all(currtim);
+
+	rtc= &route_cache[ipr_hash(dest, 32) % RTC_NR];
+	if (rtc->rtc_gen == route_gen && rtc->rtc_dest == dest)
+		return rtc->rtc_route;
+	route= ipr_lookup(dest);
+	rtc->rtc_dest= dest;
+	rtc->rtc_route= route;
+	rtc->rtc_gen= route_gen;
+#if DEBUG & 256
+ { where(); if (!route){ printf("no route to "); writeIpAddr(dest);
+	printf("\n"); } else { printf ("route to ");
+	writeIpAddr(route->rt_dest); printf(" via ");
+	writeIpAddr(route->rt_gateway); printf(" at distance %d\n",
+	route->rt_dist); } }
+#endif
+	return route;
+}
 
-	route_hi= &route_table[ROUTE_NR];
-	bestroute= 0;
-	for (route_ind= route_table; route_ind<route_hi; route_ind++)
-	{
-		if (!(route_ind->rt_flags & RTF_INUSE))
-			continue;
-		if (route_ind->rt_exp_tim && route_ind->rt_exp_tim<currtim)
-		{
-			route_ind->rt_flags &= ~RTF_INUSE;
-			continue;
-		}
-		if ((dest ^ route_ind->rt_dest) & route_ind->rt_netmask)
-			continue;
+/*
+ipr_lookup
 
-		if (!bestroute)
-		{
-			bestroute= route_ind;
+Find the route for dest, trying the longest prefixes first.  Expired routes
+are already removed.
+*/
+
+PRIVATE route_t *ipr_lookup(dest)
+ipaddr_t dest;
+{
+	route_t *route, *best;
+	ipaddr_t mask;
+	int plen;
+
+	for (plen= 32; plen >= 0; plen--)
+	{
+		if (!route_plen_nr[plen])
 			continue;
-		}
-		if (bestroute->rt_netmask != route_ind->rt_netmask)
+		mask= ipr_mask(plen);
+		best= 0;
+		for (route= route_hash[ipr_hash(dest & mask, plen) %
+			ROUTE_HASH_NR]; route; route= route->rt_next)
 		{
-			if (route_ind->rt_dist > bestroute->rt_dist ||
-				(route_ind->rt_dist == bestroute->
-				rt_dist && ntohl(route_ind->rt_netmask)>
-				ntohl(bestroute->rt_netmask)))
-				bestroute= route_ind;
-			continue;
+			if (route->rt_netmask != mask ||
+				((dest ^ route->rt_dest) & mask))
+			{
+				continue;
+			}
+			if (ipr_prefer(route, best))
+				best= route;
 		}
-		sec_bestroute= bestroute;
-		if (bestroute->rt_gateway == route_ind->rt_gateway)
+		for (route= route_odd; route; route= route->rt_next)
 		{
-			if (route_ind->rt_timestamp > 
-				bestroute->rt_timestamp)
-				bestroute= route_ind;
+			if (route->rt_plen != plen ||
+				((dest ^ route->rt_dest) & route->rt_netmask))
+			{
+				continue;
+			}
+			if (ipr_prefer(route, best))
+				best= route;
 		}
-		else
+		if (best)
+			return best;
+	}
+	return 0;
+}
+
+/*
+ipr_prefer
+
+Tell whether route is better than best, a route for the same network.  A
+newer route through the same gateway overrides route altogether, otherwise
+the shortest distance wins.
+*/
+
+PRIVATE int ipr_prefer(route, best)
+route_t *route;
+route_t *best;
+{
+	route_t *other;
+
+	for (other= *ipr_chain(route); other; other= other->rt_next)
+	{
+		if (other != route && other->rt_gateway == route->rt_gateway &&
+			other->rt_netmask == route->rt_netmask &&
+			!((other->rt_dest ^ route->rt_dest) &
+			route->rt_netmask) &&
+			other->rt_timestamp > route->rt_timestamp)
 		{
-			if (route_ind->rt_dist < bestroute->rt_dist)
-				bestroute= route_ind;
+			return FALSE;
 		}
-		if (bestroute->rt_dist > sec_bestroute->rt_dist)
+	}
+	if (!best)
+		return TRUE;
+	if (route->rt_dist != best->rt_dist)
+		return route->rt_dist < best->rt_dist;
+	return route->rt_timestamp > best->rt_timestamp;
+}
+
+PRIVATE int ipr_expired(route, currtim)
+route_t *route;
+time_t currtim;
+{
+	if (!route->rt_exp_tim || route->rt_exp_tim >= currtim)
+		return FALSE;
+	ipr_unlink(route);
+	return TRUE;
+}
+
+PRIVATE void ipr_expire_all(currtim)
+time_t currtim;
+{
+	int i;
+	route_t *route;
+
+	route_exp_tim= 0;
+	for (i= 0, route= route_table; i<ROUTE_NR; i++, route++)
+	{
+		if (!(route->rt_flags & RTF_INUSE) ||
+			ipr_expired(route, currtim) || !route->rt_exp_tim)
 		{
-			tmproute= *bestroute;
-			*bestroute= *sec_bestroute;
-			*sec_bestroute= tmproute;
-			route_ind= bestroute= sec_bestroute;
+			continue;
 		}
+		if (!route_exp_tim || route->rt_exp_tim < route_exp_tim)
+			route_exp_tim= route->rt_exp_tim;
 	}
-#if DEBUG & 256
- { where(); if (!bestroute){ printf("no route to "); writeIpAddr(dest);
-	printf("\n"); } else { printf ("route to ");
-	writeIpAddr(bestroute->rt_dest); printf(" via ");
-	writeIpAddr(bestroute->rt_gateway); printf(" at distance %d\n",
-	bestroute->rt_dist); } }
-#endif
-	return bestroute;
+}
+
+PRIVATE void ipr_link(route)
+route_t *route;
+{
+	route_t **chain;
+	u32_t mask;
+	int plen;
+
+	mask= ntohl(route->rt_netmask);
+	for (plen= 0; mask; mask <<= 1)
+	{
+		if (!(mask & 0x80000000L))
+			break;
+		plen++;
+	}
+	for (route->rt_plen= plen; mask; mask <<= 1)
+	{
+		if (mask & 0x80000000L)
+			route->rt_plen++;
+	}
+	chain= ipr_chain(route);
+	route->rt_next= *chain;
+	*chain= route;
+	route_plen_nr[route->rt_plen]++;
+	route->rt_flags |= RTF_INUSE;
+	if (route->rt_exp_tim && (!route_exp_tim ||
+		route->rt_exp_tim < route_exp_tim))
+	{
+		route_exp_tim= route->rt_exp_tim;
+	}
+	ipr_flush();
+}
+
+PRIVATE void ipr_unlink(route)
+route_t *route;
+{
+	route_t **chain;
+
+assert (route->rt_flags & RTF_INUSE);
+	for (chain= ipr_chain(route); *chain != route;
+		chain= &(*chain)->rt_next)
+	{
+assert (*chain);
+	}
+	*chain= route->rt_next;
+	route_plen_nr[route->rt_plen]--;
+	route->rt_flags &= ~RTF_INUSE;
+	ipr_flush();
+}
+
+PRIVATE route_t **ipr_chain(route)
+route_t *route;
+{
+	if (route->rt_netmask != ipr_mask(route->rt_plen))
+		return &route_odd;
+	return &route_hash[ipr_hash(route->rt_dest & route->rt_netmask,
+		route->rt_plen) % ROUTE_HASH_NR];
+}
+
+PRIVATE ipaddr_t ipr_mask(plen)
+int plen;
+{
+	if (!plen)
+		return 0;
+	return htonl((u32_t)0xffffffffL << (32-plen));
+}
+
+PRIVATE unsigned ipr_hash(net, plen)
+ipaddr_t net;
+int plen;
+{
+	u32_t h;
+
+	h= ntohl(net);
+	h ^= h >> 16;
+	h ^= h >> 8;
+	return (unsigned)h + plen;
+}
+
+/*
+ipr_flush
+
+Forget all cached lookups.
+*/
+
+PRIVATE void ipr_flush()
+{
+	int i;
+
+	if (++route_gen)
+		return;
+	for (i= 0; i<RTC_NR; i++)
+		route_cache[i].rtc_gen= 0;
+	route_gen= 1;
 }
 
 PUBLIC route_t *ipr_add_route(dest, netmask, gateway, port, timeout, dist,
@@ -126,7 +337,7 @@ i32_t preference;
 {
 	int i;
 	route_t *route_ind;
-	route_t *oldest_route;
+	route_t *oldest_route, *free_route;
 	time_t currtim;
 
 #if DEBUG & 256
@@ -142,19 +353,20 @@ i32_t preference;
 			return 0;
 		fixed_routes++;
 	}
+	/* Replace the route to the same place, or else take a free entry,
+	 * or else the oldest route that is not fixed.
+	 */
 	oldest_route= 0;
+	free_route= 0;
 	currtim= get_time();
 	for (i= 0, route_ind= route_table; i<ROUTE_NR; i++, route_ind++)
 	{
-		if (!(route_ind->rt_flags & RTF_INUSE))
-		{
-			oldest_route= route_ind;
-			break;
-		}
-		if (route_ind->rt_exp_tim && route_ind->rt_exp_tim < currtim)
+		if (!(route_ind->rt_flags & RTF_INUSE) ||
+			ipr_expired(route_ind, currtim))
 		{
-			oldest_route= route_ind;
-			break;
+			if (!free_route)
+				free_route= route_ind;
+			continue;
 		}
 		if (route_ind->rt_dest == dest &&
 			route_ind->rt_netmask == netmask &&
@@ -175,7 +387,11 @@ i32_t preference;
 		if (route_ind->rt_timestamp < oldest_route->rt_timestamp)
 			oldest_route= route_ind;
 	}
+	if (i == ROUTE_NR && free_route)
+		oldest_route= free_route;
 assert (oldest_route);
+	if (oldest_route->rt_flags & RTF_INUSE)
+		ipr_unlink(oldest_route);
 	oldest_route->rt_dest= dest;
 	oldest_route->rt_gateway= gateway;
 	oldest_route->rt_netmask= netmask;
@@ -186,10 +402,11 @@ assert (oldest_route);
 	oldest_route->rt_timestamp= currtim;
 	oldest_route->rt_dist= dist;
 	oldest_route->rt_port= port;
-	oldest_route->rt_flags= RTF_INUSE;
+	oldest_route->rt_flags= RTF_EMPTY;
 	oldest_route->rt_pref= preference;
 	if (fixed)
 		oldest_route->rt_flags |= RTF_FIXED;
+	ipr_link(oldest_route);
 	return oldest_route;
 }
 
@@ -208,19 +425,18 @@ time_t timeout;
 			continue;
 		if (route_ind->rt_gateway != gateway)
 			continue;
-		if (route_ind->rt_exp_tim && route_ind->rt_exp_tim < currtim)
-		{
-			route_ind->rt_flags &= ~RTF_INUSE;
+		if (ipr_expired(route_ind, currtim))
 			continue;
-		}
 		if (!(route_ind->rt_flags & RTF_FIXED))
 		{
+			ipr_unlink(route_ind);
 			route_ind->rt_timestamp= currtim;
 			if (timeout)
 				route_ind->rt_exp_tim= currtim+timeout;
 			else
 				route_ind->rt_exp_tim= 0;
 			route_ind->rt_dist= DIST_UNREACHABLE;
+			ipr_link(route_ind);
 			continue;
 		}
 #if DEBUG
@@ -367,8 +583,8 @@ nwio_route_t *route_ent;
 		return ENOENT;
 
 	route= &route_table[ent_no];
-	if (route->rt_exp_tim && route->rt_exp_tim < get_time())
-		route->rt_flags &= ~RTF_INUSE;
+	if (route->rt_flags & RTF_INUSE)
+		(void) ipr_expired(route, get_time());
 
 	route_ent->nwr_ent_count= ROUTE_NR;
 	route_ent->nwr_dest= route->rt_dest;
@@ -16,6 +16,8 @@ typedef struct route
 	int rt_port;
 	int rt_flags;
 	i32_t rt_pref;
+	int rt_plen;			/* number of bits in the netmask */
+	struct route *rt_next;		/* hash chain */
 } route_t;
 
 #define RTF_EMPTY	0
@@ -7,14 +7,17 @@ sr.h
 
 #define MAX_IOCTL_S	512
 
-#define ETH_DEV		ETH_DEV0
-#define IP_DEV		IP_DEV0
-
 #define ETH_DEV0	1
 #define IP_DEV0		2
 #define TCP_DEV0	3
 #define UDP_DEV0	4
 
+/* The devices of port n follow those of port n-1. */
+#define ETH_DEV(n)	(ETH_DEV0 + 4*(n))
+#define IP_DEV(n)	(IP_DEV0 + 4*(n))
+#define TCP_DEV(n)	(TCP_DEV0 + 4*(n))
+#define UDP_DEV(n)	(UDP_DEV0 + 4*(n))
+
 #define SR_CANCEL_IOCTL	1
 #define SR_CANCEL_READ	2
 #define SR_CANCEL_WRITE	3
@@ -35,10 +38,12 @@ typedef int (*sr_read_t) ARGS(( int fd, size_t count ));
 typedef int (*sr_write_t) ARGS(( int fd, size_t count ));
 typedef int  (*sr_ioctl_t) ARGS(( int fd, int req ));
 typedef int  (*sr_cancel_t) ARGS(( int fd, int which_operation ));
+typedef int  (*sr_select_t) ARGS(( int fd, int operations ));
 
 void sr_init ARGS(( void  ));
 int sr_add_minor ARGS(( int minor, int port, sr_open_t openf,
 	sr_close_t closef, sr_read_t sr_read, sr_write_t sr_write,
-	sr_ioctl_t ioctlf, sr_cancel_t cancelf ));
+	sr_ioctl_t ioctlf, sr_cancel_t cancelf, sr_select_t selectf ));
+void sr_select_check ARGS(( void ));
 
 #endif /* SR_H */
@@ -19,6 +19,7 @@ INIT_PANIC();
 PUBLIC tcp_port_t tcp_port_table[TCP_PORT_NR];
 PUBLIC tcp_fd_t tcp_fd_table[TCP_FD_NR];
 PUBLIC tcp_conn_t tcp_conn_table[TCP_CONN_NR];
+PUBLIC tcp_conn_t *tcp_conn_hash[TCP_HASH_NR+1];
 
 FORWARD void tcp_main ARGS(( tcp_port_t *port ));
 FORWARD acc_t *tcp_get_data ARGS(( int fd, size_t offset,
@@ -27,6 +28,7 @@ FORWARD int tcp_put_data ARGS(( int fd, size_t offset,
 	acc_t *data, int for_ioctl ));
 FORWARD void read_ip_packets ARGS(( tcp_port_t *port ));
 FORWARD int tcp_setconf ARGS(( tcp_fd_t *tcp_fd ));
+FORWARD int tcp_setopt ARGS(( tcp_fd_t *tcp_fd ));
 FORWARD int tcp_connect ARGS(( tcp_fd_t *tcp_fd ));
 FORWARD int tcp_listen ARGS(( tcp_fd_t *tcp_fd ));
 FORWARD int tcp_attache ARGS(( tcp_fd_t *tcp_fd ));
@@ -39,6 +41,7 @@ FORWARD void reply_thr_get ARGS(( tcp_fd_t *tcp_fd, int reply,
 FORWARD tcp_conn_t *find_conn_entry ARGS(( Tcpport_t locport,
 	ipaddr_t locaddr, Tcpport_t remport, ipaddr_t readaddr ));
 FORWARD tcp_conn_t *find_empty_conn ARGS(( void ));
+FORWARD void reset_queued ARGS(( tcp_conn_t *tcp_conn ));
 FORWARD void process_inc_fragm ARGS(( tcp_port_t *tcp_port,
 	acc_t *data ));
 FORWARD tcp_conn_t *find_best_conn ARGS(( ip_hdr_t *ip_hdr, 
@@ -50,6 +53,11 @@ FORWARD int tcp_su4connect ARGS(( tcp_fd_t *tcp_fd ));
 FORWARD void tcp_buffree ARGS(( int priority, size_t reqsize ));
 FORWARD void tcp_notreach ARGS(( acc_t *pack ));
 FORWARD void tcp_setup_conn ARGS(( tcp_conn_t *tcp_conn ));
+FORWARD void tcp_conn_unhash ARGS(( tcp_conn_t *tcp_conn ));
+FORWARD tcp_conn_t *queue_conn ARGS(( tcp_conn_t *listen_conn,
+	tcp_conn_t *tcp_conn ));
+FORWARD tcp_conn_t *find_queued_conn ARGS(( tcp_fd_t *tcp_fd ));
+FORWARD tcp_conn_t *find_idle_listen ARGS(( tcp_fd_t *tcp_fd ));
 
 PUBLIC void tcp_init()
 {
@@ -64,18 +72,16 @@ PUBLIC void tcp_init()
 	assert (BUF_S >= IP_MAX_HDR_SIZE);
 	assert (BUF_S >= TCP_MAX_HDR_SIZE);
 
-	tcp_port_table[0].tp_minor= TCP_DEV0;
-	tcp_port_table[0].tp_ipdev= IP0;
-
 	for (i=0, tcp_fd= tcp_fd_table; i<TCP_FD_NR; i++, tcp_fd++)
 	{
 		tcp_fd->tf_flags= TFF_EMPTY;
 	}
 
 	for (i=0, tcp_conn= tcp_conn_table; i<TCP_CONN_NR; i++,
-		tcp_fd++)
+		tcp_conn++)
 	{
 		tcp_conn->tc_flags= TCF_EMPTY;
+		tcp_conn->tc_hash_slot= TCP_NO_HASH;
 #if DEBUG & 256
  { where(); printf("tcp_conn_table[%d].tc_flags= 0x%x\n", 
 	tcp_conn-tcp_conn_table, tcp_conn->tc_flags); }
@@ -87,12 +93,15 @@ PUBLIC void tcp_init()
 	for (i=0, tcp_port= tcp_port_table; i<TCP_PORT_NR; i++,
 		tcp_port++)
 	{
+		tcp_port->tp_minor= TCP_DEV(i);
+		tcp_port->tp_ipdev= IP0+i;
 		tcp_port->tp_flags= TPF_EMPTY;
 		tcp_port->tp_state= TPS_EMPTY;
 
 		result= sr_add_minor (tcp_port->tp_minor,
 			tcp_port-tcp_port_table, tcp_open, tcp_close,
-			tcp_read, tcp_write, tcp_ioctl, tcp_cancel);
+			tcp_read, tcp_write, tcp_ioctl, tcp_cancel,
+			tcp_select);
 		assert (result>=0);
 
 		tcp_main(tcp_port);
@@ -216,7 +225,7 @@ tcp_port_t *tcp_port;
 		tcp_conn->tc_ett= 0;
 		tcp_conn->tc_mss= TCP_DEF_MSS;
 		tcp_conn->tc_error= NW_OK;
-		tcp_conn->tc_snd_wnd= TCP_MAX_WND_SIZE;
+		tcp_conn->tc_snd_wnd= TCP_MAX_SND_WND_SIZE;
 
 		for (i=0, tcp_fd= tcp_fd_table; i<TCP_FD_NR; i++,
 			tcp_fd++)
@@ -452,6 +461,7 @@ put_userdata_t put_userdata;
 	tcp_fd->tf_tcpconf.nwtc_flags= TCP_DEF_OPT;
 	tcp_fd->tf_tcpconf.nwtc_remaddr= 0;
 	tcp_fd->tf_tcpconf.nwtc_remport= 0;
+	tcp_fd->tf_tcpopt.nwto_flags= TCP_DEF_TCPOPT;
 	tcp_fd->tf_get_userdata= get_userdata;
 	tcp_fd->tf_put_userdata= put_userdata;
 	tcp_fd->tf_conn= 0;
@@ -466,7 +476,8 @@ int req;
 	tcp_port_t *tcp_port;
 	tcp_conn_t *tcp_conn;
 	nwio_tcpconf_t *tcp_conf;
-	acc_t *conf_acc;
+	nwio_tcpopt_t *tcp_opt;
+	acc_t *conf_acc, *opt_acc;
 	int type;
 	int result;
 
@@ -537,6 +548,35 @@ assert (conf_acc->acc_length == sizeof(*tcp_conf));
 		reply_thr_put(tcp_fd, result, TRUE);
 		result= NW_OK;
 		break;
+	case NWIOSTCPOPT & IOCTYPE_MASK:
+		if (req != NWIOSTCPOPT)
+		{
+			tcp_fd->tf_flags &= ~TFF_IOCTL_IP;
+			reply_thr_get (tcp_fd, EBADIOCTL, TRUE);
+			result= NW_OK;
+			break;
+		}
+		result= tcp_setopt(tcp_fd);
+		break;
+	case NWIOGTCPOPT & IOCTYPE_MASK:
+		if (req != NWIOGTCPOPT)
+		{
+			tcp_fd->tf_flags &= ~TFF_IOCTL_IP;
+			reply_thr_put (tcp_fd, EBADIOCTL, TRUE);
+			result= NW_OK;
+			break;
+		}
+		opt_acc= bf_memreq(sizeof(*tcp_opt));
+assert (opt_acc->acc_length == sizeof(*tcp_opt));
+		tcp_opt= (nwio_tcpopt_t *)ptr2acc_data(opt_acc);
+
+		*tcp_opt= tcp_fd->tf_tcpopt;
+		result= (*tcp_fd->tf_put_userdata)(tcp_fd->tf_srfd,
+			0, opt_acc, TRUE);
+		tcp_fd->tf_flags &= ~TFF_IOCTL_IP;
+		reply_thr_put(tcp_fd, result, TRUE);
+		result= NW_OK;
+		break;
 	case NWIOTCPCONN & IOCTYPE_MASK:
 		if (req != NWIOTCPCONN)
 		{
@@ -850,6 +890,70 @@ assert (new_di_flags & NWTC_REMPORT_MASK);
 	return NW_OK;
 }
 
+/*
+tcp_setopt
+
+Set the options of a fd.  NWTO_SND_NODELAY turns off the Nagle algorithm
+for the connection of the fd.
+*/
+
+PRIVATE int tcp_setopt(tcp_fd)
+tcp_fd_t *tcp_fd;
+{
+	nwio_tcpopt_t *tcpopt;
+	nwio_tcpopt_t oldopt, newopt;
+	acc_t *data;
+	unsigned int new_en_flags, new_di_flags,
+		old_en_flags, old_di_flags;
+
+	data= (*tcp_fd->tf_get_userdata)
+		(tcp_fd->tf_srfd, 0,
+		sizeof(nwio_tcpopt_t), TRUE);
+
+	if (!data)
+		return EFAULT;
+
+	data= bf_packIffLess(data, sizeof(nwio_tcpopt_t));
+assert (data->acc_length == sizeof(nwio_tcpopt_t));
+
+	tcpopt= (nwio_tcpopt_t *)ptr2acc_data(data);
+	oldopt= tcp_fd->tf_tcpopt;
+	newopt= *tcpopt;
+	bf_afree(data);
+
+	old_en_flags= oldopt.nwto_flags & 0xffff;
+	old_di_flags= (oldopt.nwto_flags >> 16) & 0xffff;
+	new_en_flags= newopt.nwto_flags & 0xffff;
+	new_di_flags= (newopt.nwto_flags >> 16) & 0xffff;
+	if (new_en_flags & new_di_flags)
+	{
+		tcp_fd->tf_flags &= ~TFF_IOCTL_IP;
+		reply_thr_get(tcp_fd, EBADMODE, TRUE);
+		return NW_OK;
+	}
+
+	/* NWTO_SND_DELAY_MASK */
+	if (!((new_en_flags | new_di_flags) & NWTO_SND_DELAY_MASK))
+	{
+		new_en_flags |= (old_en_flags & NWTO_SND_DELAY_MASK);
+		new_di_flags |= (old_di_flags & NWTO_SND_DELAY_MASK);
+	}
+
+	newopt.nwto_flags= ((unsigned long)new_di_flags << 16) |
+		new_en_flags;
+	tcp_fd->tf_tcpopt= newopt;
+
+	/* Send what was held back. */
+	if ((new_en_flags & NWTO_SND_NODELAY) &&
+		(tcp_fd->tf_flags & TFF_CONNECTED))
+	{
+		tcp_restart_write(tcp_fd->tf_conn);
+	}
+
+	tcp_fd->tf_flags &= ~TFF_IOCTL_IP;
+	reply_thr_get(tcp_fd, NW_OK, TRUE);
+	return NW_OK;
+}
 
 PRIVATE tcpport_t find_unused_port(fd)
 int fd;
@@ -991,6 +1095,11 @@ PRIVATE tcp_conn_t *find_empty_conn()
 			continue;
 		if (tcp_conn->tc_state != TCS_CLOSED)
 		{
+			if ((tcp_conn->tc_flags & TCF_QUEUED) &&
+				tcp_conn->tc_state != TCS_LISTEN)
+			{
+				reset_queued(tcp_conn);
+			}
 #if DEBUG
  { where(); printf("calling tcp_close_connection\n"); }
 #endif
@@ -1001,6 +1110,44 @@ PRIVATE tcp_conn_t *find_empty_conn()
 	return NULL;
 }
 
+/*
+reset_queued
+
+A connection on a backlog is dropped before a user took it.  The other side
+may think it is established already, so send it a RST.  The RST goes out
+through the connection reserved for RSTs, tcp_conn itself is reused.
+*/
+
+PRIVATE void reset_queued(tcp_conn)
+tcp_conn_t *tcp_conn;
+{
+	tcp_conn_t *rst_conn;
+	acc_t *RST_acc;
+	ip_hdr_t *RST_ip_hdr;
+	tcp_hdr_t *RST_tcp_hdr;
+	size_t pack_size;
+
+	rst_conn= &tcp_conn_table[tcp_conn->tc_port-tcp_port_table];
+	if (!(rst_conn->tc_flags & TCF_INUSE))
+		return;
+
+	RST_acc= tcp_make_header(tcp_conn, &RST_ip_hdr, &RST_tcp_hdr,
+		(acc_t *)0);
+	if (!RST_acc)
+		return;
+	RST_tcp_hdr->th_seq_nr= htonl(tcp_conn->tc_SND_NXT);
+	RST_tcp_hdr->th_flags= THF_RST;
+	pack_size= bf_bufsize(RST_acc);
+	RST_ip_hdr->ih_length= htons(pack_size);
+	RST_tcp_hdr->th_chksum= 0;
+	RST_tcp_hdr->th_chksum= ~tcp_pack_oneCsum (RST_acc, pack_size);
+
+	if (rst_conn->tc_frag2send)
+		bf_afree(rst_conn->tc_frag2send);
+	rst_conn->tc_frag2send= RST_acc;
+	tcp_restart_write(rst_conn);
+}
+
 
 /*
 find_conn_entry
@@ -1017,7 +1164,7 @@ tcpport_t remport;
 ipaddr_t remaddr;
 {
 	tcp_conn_t *tcp_conn;
-	int i, state;
+	int state;
 
 #if DEBUG & 256
  { where(); printf("find_conn_entry(locport= %u, locaddr= ", ntohs(locport)); 
@@ -1027,19 +1174,16 @@ ipaddr_t remaddr;
 #endif
 assert(remport);
 assert(remaddr);
-	for (i=TCP_PORT_NR, tcp_conn= tcp_conn_table+i; i<TCP_CONN_NR;
-		i++, tcp_conn++)
-		/* the first TCP_PORT_NR connection are reserved for
-			RSTs */
+	for (tcp_conn= tcp_conn_hash[tcp_hash(locport, remport, remaddr)];
+		tcp_conn; tcp_conn= tcp_conn->tc_hash_next)
 	{
-		if (tcp_conn->tc_flags == TCF_EMPTY)
-			continue;
+assert (tcp_conn->tc_flags & TCF_INUSE);
 		if (tcp_conn->tc_locport != locport ||
 			tcp_conn->tc_locaddr != locaddr ||
 			tcp_conn->tc_remport != remport ||
 			tcp_conn->tc_remaddr != remaddr)
 			continue;
-		if (tcp_conn->tc_mainuser)
+		if (tcp_conn->tc_mainuser || tcp_queued(tcp_conn))
 			return tcp_conn;
 		state= tcp_conn->tc_state;
 		if (state != TCS_CLOSED)
@@ -1117,7 +1261,13 @@ acc_t *data;
 	tcp_hdr= (tcp_hdr_t *)ptr2acc_data(tcp_pack);
 
 	tcp_conn= find_best_conn(ip_hdr, tcp_hdr);
-assert(tcp_conn);
+	if (!tcp_conn)
+	{
+		/* The backlog is full, the peer will send the SYN again. */
+		bf_afree(ip_pack);
+		bf_afree(tcp_pack);
+		return;
+	}
 #if DEBUG & 256
  { where(); tcp_print_pack(ip_hdr, tcp_hdr); printf("\n");
    tcp_print_conn(tcp_conn); printf("\n"); }
@@ -1132,6 +1282,10 @@ assert(tcp_conn);
 
 /*
 find_best_conn
+
+Return the connection for an incoming segment.  A SYN for a listen gets a
+connection of its own that is put on the backlog of the listen, NULL is
+returned if that is full.
 */
 
 PRIVATE tcp_conn_t *find_best_conn(ip_hdr, tcp_hdr)
@@ -1141,7 +1295,6 @@ tcp_hdr_t *tcp_hdr;
 	
 	int best_level, new_level;
 	tcp_conn_t *best_conn, *listen_conn, *tcp_conn;
-	tcp_fd_t *tcp_fd;
 	int i;
 	ipaddr_t locaddr;
 	ipaddr_t remaddr;
@@ -1166,79 +1319,66 @@ tcp_hdr_t *tcp_hdr;
 	best_level= 0;
 	best_conn= NULL;
 	listen_conn= NULL;
-	for (i= TCP_PORT_NR, tcp_conn= tcp_conn_table+i;
-		i<TCP_CONN_NR; i++, tcp_conn++)
-		/* the first TCP_PORT_NR connection are reserved for
-			RSTs */
-	{
-		if (!(tcp_conn->tc_flags & TCF_INUSE))
-			continue;
-		/* First fast check for open connections. */
-		if (tcp_conn->tc_locaddr == locaddr && 
-			tcp_conn->tc_locport == locport &&
-			tcp_conn->tc_remport == remport &&
-			tcp_conn->tc_remaddr == remaddr &&
-			tcp_conn->tc_mainuser)
-			return tcp_conn;
 
-		/* Now check for listens and abandoned connections. */
-		if (tcp_conn->tc_locaddr != locaddr)
+	/* First a fast check for open and abandoned connections. */
+	if (locport && remport && remaddr)
+	{
+		for (tcp_conn= tcp_conn_hash[tcp_hash(locport, remport,
+			remaddr)]; tcp_conn; tcp_conn= tcp_conn->tc_hash_next)
 		{
-#if DEBUG
- { where(); printf("conn %d: wrong locaddr\n",i); }
-#endif
-			continue;
+			if (tcp_conn->tc_locaddr != locaddr ||
+				tcp_conn->tc_locport != locport ||
+				tcp_conn->tc_remport != remport ||
+				tcp_conn->tc_remaddr != remaddr)
+				continue;
+			if (tcp_conn->tc_mainuser || tcp_queued(tcp_conn))
+				return tcp_conn;
+			/* We found an abandoned connection */
+assert (!best_conn);
+			best_conn= tcp_conn;
 		}
-		new_level= 0;
-		if (tcp_conn->tc_locport)
+	}
+
+	/* Now check for listens, they are only interested in SYNs. */
+	if (tcp_hdr->th_flags & THF_SYN)
+	{
+		for (tcp_conn= tcp_conn_hash[TCP_LISTEN_HASH]; tcp_conn;
+			tcp_conn= tcp_conn->tc_hash_next)
 		{
-			if (locport != tcp_conn->tc_locport)
-			{
-#if DEBUG & 256
- { where(); printf("conn %d: wrong locport(%u)\n",i,
-	ntohs(tcp_conn->tc_locport)); }
-#endif
+			if (tcp_conn->tc_state != TCS_LISTEN ||
+				tcp_conn->tc_locaddr != locaddr)
+				continue;
+			if (tcp_conn->tc_flags & TCF_QUEUED)
 				continue;
+			if (!tcp_conn->tc_mainuser &&
+				tcp_conn->tc_senddis <= get_time())
+			{
+				continue;	/* its server is gone */
 			}
-			new_level += 4;
-		}
-		if (tcp_conn->tc_remport)
-		{
-			if (remport != tcp_conn->tc_remport)
+			new_level= 0;
+			if (tcp_conn->tc_locport)
 			{
-#if DEBUG & 256
- { where(); printf("conn %d: wrong remport\n",i); }
-#endif
-				continue;
+				if (locport != tcp_conn->tc_locport)
+					continue;
+				new_level += 4;
 			}
-			new_level += 1;
-		}
-		if (tcp_conn->tc_remaddr)
-		{
-			if (remaddr != tcp_conn->tc_remaddr)
+			if (tcp_conn->tc_remport)
 			{
-#if DEBUG & 256
- { where(); printf("conn %d: wrong remaddr\n",i); }
-#endif
-				continue;
+				if (remport != tcp_conn->tc_remport)
+					continue;
+				new_level += 1;
 			}
-			new_level += 2;
-		}
-		if (new_level<best_level)
-			continue;
-		if (new_level != 7 && tcp_conn->tc_state != TCS_LISTEN)
-			continue;
-		if (new_level == 7 && !tcp_conn->tc_mainuser)
-			/* We found an abandoned connection */
-		{
-assert (!best_conn);
-			best_conn= tcp_conn;
-			continue;
+			if (tcp_conn->tc_remaddr)
+			{
+				if (remaddr != tcp_conn->tc_remaddr)
+					continue;
+				new_level += 2;
+			}
+			if (new_level<best_level)
+				continue;
+			best_level= new_level;
+			listen_conn= tcp_conn;
 		}
-		if (!(tcp_hdr->th_flags & THF_SYN))
-			continue;
-		best_level= new_level;
-		listen_conn= tcp_conn;
 	}
 	if (!best_conn && !listen_conn)
 	{
@@ -1273,30 +1413,115 @@ assert (!tcp_conn->tc_writeuser);
 assert(!best_conn->tc_mainuser);
 		if (!listen_conn)
 			return best_conn;
-		tcp_fd= listen_conn->tc_mainuser;
-
-assert(tcp_fd && tcp_fd == listen_conn->tc_connuser &&
-	tcp_fd->tf_conn == listen_conn);
-
 		if (best_conn->tc_state != TCS_CLOSED)
 			tcp_close_connection(best_conn, ENOCONN);
-		best_conn->tc_state= TCS_LISTEN;
-#if DEBUG
- { where(); tcp_write_state(best_conn); }
-#endif
-		best_conn->tc_mainuser= best_conn->tc_connuser=
-			tcp_fd;
-		best_conn->tc_flags= listen_conn->tc_flags;
-		tcp_fd->tf_conn= best_conn;
-		listen_conn->tc_flags= TCF_EMPTY;
-#if DEBUG & 16
- { where(); printf("tcp_conn_table[%d].tc_flags= 0x%x\n", 
-	listen_conn-tcp_conn_table, listen_conn->tc_flags); }
-#endif
-		return best_conn;
 	}
 assert (listen_conn);
-	return listen_conn;
+	if ((tcp_hdr->th_flags & (THF_SYN|THF_ACK|THF_RST)) != THF_SYN)
+		return listen_conn;	/* refused by the listen */
+	return queue_conn(listen_conn, best_conn);
+}
+
+/*
+queue_conn
+
+Set up a connection for a SYN that arrived for a listen.  The connection is
+a copy of the listen and stays on its backlog until a user listens for it.
+tcp_conn is a closed connection that may be reused, or NULL.
+*/
+
+PRIVATE tcp_conn_t *queue_conn(listen_conn, tcp_conn)
+tcp_conn_t *listen_conn;
+tcp_conn_t *tcp_conn;
+{
+	tcp_conn_t *conn;
+	time_t new_dis;
+	int i, n;
+
+	n= 0;
+	for (i= TCP_PORT_NR, conn= tcp_conn_table+i; i<TCP_CONN_NR;
+		i++, conn++)
+	{
+		if (tcp_queued(conn) && conn->tc_port == listen_conn->tc_port &&
+			conn->tc_locport == listen_conn->tc_locport)
+		{
+			n++;
+		}
+	}
+	if (n >= TCP_BACKLOG_NR)
+		return NULL;
+	if (!tcp_conn)
+	{
+		tcp_conn= find_empty_conn();
+		if (!tcp_conn)
+			return NULL;
+	}
+
+	tcp_conn->tc_locport= listen_conn->tc_locport;
+	tcp_conn->tc_locaddr= listen_conn->tc_locaddr;
+	tcp_conn->tc_remport= listen_conn->tc_remport;
+	tcp_conn->tc_remaddr= listen_conn->tc_remaddr;
+	tcp_setup_conn(tcp_conn);
+	tcp_conn->tc_port= listen_conn->tc_port;
+	tcp_conn->tc_orglisten= TRUE;
+	tcp_conn->tc_state= TCS_LISTEN;
+	tcp_conn->tc_flags |= TCF_QUEUED;
+
+	/* find_empty_conn() leaves the connection alone for a while. */
+	new_dis= get_time() + TCP_BACKLOG_TIME;
+	if (new_dis > tcp_conn->tc_senddis)
+		tcp_conn->tc_senddis= new_dis;
+#if DEBUG & 2
+ { where(); tcp_write_state(tcp_conn); }
+#endif
+	return tcp_conn;
+}
+
+/*
+tcp_accept_queued
+
+A connection on a backlog is established.  Hand it to a user that is
+waiting in a listen for it, the listen itself stays behind without a user
+to keep the backlog going until the next NWIOTCPLISTEN.
+*/
+
+PUBLIC void tcp_accept_queued(tcp_conn)
+tcp_conn_t *tcp_conn;
+{
+	tcp_conn_t *listen_conn;
+	tcp_fd_t *tcp_fd;
+	time_t new_dis;
+
+assert (tcp_conn->tc_flags & TCF_QUEUED);
+
+	for (listen_conn= tcp_conn_hash[TCP_LISTEN_HASH]; listen_conn;
+		listen_conn= listen_conn->tc_hash_next)
+	{
+		if (listen_conn->tc_state != TCS_LISTEN)
+			continue;
+		tcp_fd= listen_conn->tc_connuser;
+		if (tcp_fd && conn_right4fd(tcp_conn, tcp_fd))
+			break;
+	}
+	if (!listen_conn)
+	{
+		/* Stays on the backlog, tell a select on the listen. */
+		sr_select_check();
+		return;
+	}
+
+assert (tcp_fd->tf_conn == listen_conn);
+	listen_conn->tc_mainuser= 0;
+	listen_conn->tc_connuser= 0;
+	new_dis= get_time() + TCP_BACKLOG_TIME;
+	if (new_dis > listen_conn->tc_senddis)
+		listen_conn->tc_senddis= new_dis;
+
+	tcp_conn->tc_flags &= ~TCF_QUEUED;
+	tcp_conn->tc_mainuser= tcp_fd;
+	tcp_conn->tc_connuser= tcp_fd;
+	tcp_fd->tf_conn= tcp_conn;
+	tcp_restart_connect(tcp_fd);
 }
 
 
@@ -1490,6 +1715,69 @@ assert (!(tcp_fd->tf_flags & (TFF_IOCTL_IP|TFF_READ_IP|TFF_WRITE_IP)));
 	tcp_shutdown (tcp_conn);
 }
 
+/*
+tcp_select
+
+A read is ready when data or a FIN has arrived, a write when at least half
+of the send queue (tc_snd_wnd) is free.  A listen or connect in progress is
+not ready, a listen is readable when the backlog holds an established
+connection for it.  Everything that fails at once is ready.
+*/
+
+PUBLIC int tcp_select(fd, operations)
+int fd;
+int operations;
+{
+	tcp_fd_t *tcp_fd;
+	tcp_conn_t *tcp_conn;
+	u32_t max_seq;
+	int ready;
+
+	tcp_fd= &tcp_fd_table[fd];
+
+	assert (tcp_fd->tf_flags & TFF_INUSE);
+
+	if (!(tcp_fd->tf_flags & TFF_CONNECTED))
+	{
+		if ((tcp_fd->tf_flags & TFF_OPTSET) &&
+			(tcp_fd->tf_flags & TFF_IOCTL_IP))
+		{
+			return 0;
+		}
+		if (!(tcp_fd->tf_flags & TFF_OPTSET))
+			return operations & (SEL_RD | SEL_WR);
+
+		/* The next NWIOTCPLISTEN returns at once with a connection
+		 * from the backlog, or waits on the listen kept for it.
+		 */
+		if (find_queued_conn(tcp_fd))
+			return operations & SEL_RD;
+		if (find_idle_listen(tcp_fd))
+			return 0;
+		return operations & (SEL_RD | SEL_WR);
+	}
+	tcp_conn= tcp_fd->tf_conn;
+	if (tcp_conn->tc_state == TCS_CLOSED)
+		return operations & (SEL_RD | SEL_WR);
+
+	ready= 0;
+	if (tcp_conn->tc_RCV_NXT != tcp_conn->tc_RCV_LO ||
+		(tcp_conn->tc_flags & TCF_FIN_RECV))
+	{
+		ready |= SEL_RD;
+	}
+	max_seq= tcp_conn->tc_SND_UNA + tcp_conn->tc_snd_wnd;
+	if (tcp_conn->tc_flags & TCF_FIN_SENT)
+		ready |= SEL_WR;
+	else if (tcp_conn->tc_snd_wnd != 0 &&
+		tcp_GEmod4G(max_seq, tcp_conn->tc_SND_NXT +
+		tcp_conn->tc_snd_wnd/2))
+	{
+		ready |= SEL_WR;	/* as in fd_write() */
+	}
+	return ready & operations;
+}
+
 PUBLIC int tcp_cancel(fd, which_operation)
 int fd;
 int which_operation;
@@ -1544,9 +1832,11 @@ assert (tcp_fd->tf_flags & TFF_IOCTL_IP);
 		switch (type)
 		{
 		case NWIOGTCPCONF & IOCTYPE_MASK:
+		case NWIOGTCPOPT & IOCTYPE_MASK:
 			reply_thr_put (tcp_fd, EINTR, TRUE);
 			break;
 		case NWIOSTCPCONF & IOCTYPE_MASK:
+		case NWIOSTCPOPT & IOCTYPE_MASK:
 		case NWIOTCPSHUTDOWN & IOCTYPE_MASK:
 		case NWIOTCPATTACH & IOCTYPE_MASK:
 			reply_thr_get (tcp_fd, EINTR, TRUE);
@@ -1614,7 +1904,7 @@ assert(!tcp_fd->tf_conn);
 		tcp_fd->tf_tcpconf.nwtc_remaddr);
 	if (tcp_conn)
 	{
-		if (tcp_conn->tc_mainuser)
+		if (tcp_conn->tc_mainuser || tcp_queued(tcp_conn))
 		{
 			tcp_reply_ioctl(tcp_fd, EADDRINUSE);
 			return NW_OK;
@@ -1786,6 +2076,10 @@ tcp_fd_t *tcp_fd;
 
 /*
 tcp_listen
+
+A connection from the backlog that is already established is returned at
+once.  Otherwise the user takes over a listen that was left behind by
+tcp_accept_queued(), or a new one is started.
 */
 
 PRIVATE int tcp_listen(tcp_fd)
@@ -1812,6 +2106,25 @@ tcp_fd_t *tcp_fd;
 	}
 	tcp_conn= tcp_fd->tf_conn;
 assert(!tcp_conn);
+	tcp_conn= find_queued_conn(tcp_fd);
+	if (tcp_conn)
+	{
+		tcp_conn->tc_flags &= ~TCF_QUEUED;
+		tcp_conn->tc_mainuser= tcp_fd;
+		tcp_fd->tf_conn= tcp_conn;
+		tcp_fd->tf_flags |= TFF_CONNECTED;
+		tcp_fd->tf_flags &= ~TFF_IOCTL_IP;
+		reply_thr_get (tcp_fd, NW_OK, TRUE);
+		return NW_OK;
+	}
+	tcp_conn= find_idle_listen(tcp_fd);
+	if (tcp_conn)
+	{
+		tcp_conn->tc_mainuser= tcp_fd;
+		tcp_conn->tc_connuser= tcp_fd;
+		tcp_fd->tf_conn= tcp_conn;
+		return NW_SUSPEND;
+	}
 	if ((tcp_fd->tf_tcpconf.nwtc_flags & (NWTC_SET_RA|NWTC_SET_RP))
 		== (NWTC_SET_RA|NWTC_SET_RP))
 	{
@@ -1820,7 +2133,7 @@ assert(!tcp_conn);
 			tcp_fd->tf_port->tp_ipaddr,
 			tcp_fd->tf_tcpconf.nwtc_remport,
 			tcp_fd->tf_tcpconf.nwtc_remaddr);
-		if (tcp_conn)
+		if (tcp_conn && !tcp_queued(tcp_conn))
 		{
 			if (tcp_conn->tc_mainuser)
 			{
@@ -1847,6 +2160,71 @@ assert(!tcp_conn);
 	return tcp_su4listen(tcp_fd);
 }
 
+/*
+find_queued_conn
+
+Return an established connection from a backlog that the user of tcp_fd
+would have accepted, or NULL.
+*/
+
+PRIVATE tcp_conn_t *find_queued_conn(tcp_fd)
+tcp_fd_t *tcp_fd;
+{
+	tcp_conn_t *tcp_conn;
+	int i, state;
+
+	for (i= TCP_PORT_NR, tcp_conn= tcp_conn_table+i; i<TCP_CONN_NR;
+		i++, tcp_conn++)
+	{
+		if (!tcp_queued(tcp_conn))
+			continue;
+		state= tcp_conn->tc_state;
+		if (state == TCS_LISTEN || state == TCS_SYN_RECEIVED)
+			continue;
+		if (conn_right4fd(tcp_conn, tcp_fd))
+			return tcp_conn;
+	}
+	return NULL;
+}
+
+/*
+find_idle_listen
+
+Return a listen without a user that tcp_su4listen() would have set up for
+tcp_fd in the same way, or NULL.
+*/
+
+PRIVATE tcp_conn_t *find_idle_listen(tcp_fd)
+tcp_fd_t *tcp_fd;
+{
+	tcp_conn_t *tcp_conn;
+	unsigned long flags;
+	tcpport_t remport;
+	ipaddr_t remaddr;
+
+	flags= tcp_fd->tf_tcpconf.nwtc_flags;
+	remport= (flags & NWTC_SET_RP) ? tcp_fd->tf_tcpconf.nwtc_remport : 0;
+	remaddr= (flags & NWTC_SET_RA) ? tcp_fd->tf_tcpconf.nwtc_remaddr : 0;
+
+	for (tcp_conn= tcp_conn_hash[TCP_LISTEN_HASH]; tcp_conn;
+		tcp_conn= tcp_conn->tc_hash_next)
+	{
+		if (tcp_conn->tc_state != TCS_LISTEN || tcp_conn->tc_mainuser)
+			continue;
+		if (tcp_conn->tc_flags & TCF_QUEUED)
+			continue;
+		if (tcp_conn->tc_port == tcp_fd->tf_port &&
+			tcp_conn->tc_locport ==
+			tcp_fd->tf_tcpconf.nwtc_locport &&
+			tcp_conn->tc_remport == remport &&
+			tcp_conn->tc_remaddr == remaddr)
+		{
+			return tcp_conn;
+		}
+	}
+	return NULL;
+}
+
 PRIVATE void tcp_buffree (priority, reqsize)
 int priority;
 size_t reqsize;
@@ -2001,6 +2379,7 @@ assert (!tcp_conn->tc_send_data);
 	tcp_conn->tc_SND_PSH= tcp_conn->tc_ISS;
 	tcp_conn->tc_SND_WL2= tcp_conn->tc_ISS;
 	tcp_conn->tc_IRS= 0;
+	tcp_conn->tc_rcv_acked= tcp_conn->tc_IRS;
 	tcp_conn->tc_SND_WL1= tcp_conn->tc_IRS;
 	tcp_conn->tc_RCV_LO= tcp_conn->tc_IRS;
 	tcp_conn->tc_RCV_NXT= tcp_conn->tc_IRS;
@@ -2016,16 +2395,83 @@ assert (!tcp_conn->tc_send_data);
 	tcp_conn->tc_max_no_retrans= TCP_DEF_MAX_NO_RETRANS;
 	tcp_conn->tc_0wnd_to= 0;
 	tcp_conn->tc_rtt= TCP_DEF_RTT;
+	tcp_conn->tc_srtt= 0;
+	tcp_conn->tc_rttvar= 0;
+	tcp_conn->tc_rt_time= 0;
+	tcp_conn->tc_rt_seq= tcp_conn->tc_ISS;
 	tcp_conn->tc_ett= 0;
-	tcp_conn->tc_mss= TCP_DEF_MSS;
+	tcp_conn->tc_mss= tcp_max_mss(tcp_conn);
 	tcp_conn->tc_error= NW_OK;
 	tcp_conn->tc_snd_cwnd= tcp_conn->tc_SND_UNA + tcp_conn->tc_mss;
-	tcp_conn->tc_snd_cthresh= TCP_MAX_WND_SIZE;
-	tcp_conn->tc_snd_cinc= 0;
-	tcp_conn->tc_snd_wnd= TCP_MAX_WND_SIZE;
+	tcp_conn->tc_snd_cthresh= TCP_MAX_SND_WND_SIZE;
+	tcp_conn->tc_snd_cwsize= 2*tcp_conn->tc_mss;
+	tcp_conn->tc_snd_dupacks= 0;
+	tcp_conn->tc_snd_wnd= TCP_MAX_SND_WND_SIZE;
+	tcp_conn->tc_snd_wscale= 0;
+	tcp_conn->tc_rcv_wscale= 0;
+	tcp_conn->tc_ts_recent= 0;
+	tcp_conn->tc_ts_ecr= 0;
+	tcp_conn->tc_sack_nr= 0;
+	tcp_conn->tc_sack_recent= tcp_conn->tc_IRS;
+	tcp_conn->tc_snd_rxt= tcp_conn->tc_ISS;
+	tcp_conn->tc_snd_rxt_hi= tcp_conn->tc_ISS;
 	tcp_conn->tc_flags= TCF_INUSE;
 #if DEBUG & 256
  { where(); printf("tcp_conn_table[%d].tc_flags= 0x%x\n", 
 	tcp_conn-tcp_conn_table, tcp_conn->tc_flags); }
 #endif
+	tcp_conn_rehash(tcp_conn);
+}
+
+/*
+tcp_conn_rehash
+
+This function puts a connection in the hash chain that matches its current
+address.  It must be called whenever the address of a connection in use
+changes.
+*/
+
+PUBLIC void tcp_conn_rehash(tcp_conn)
+tcp_conn_t *tcp_conn;
+{
+	int slot;
+
+assert (tcp_conn >= tcp_conn_table+TCP_PORT_NR);
+assert (tcp_conn->tc_flags & TCF_INUSE);
+
+	if (tcp_conn->tc_locport && tcp_conn->tc_remport &&
+		tcp_conn->tc_remaddr)
+	{
+		slot= tcp_hash(tcp_conn->tc_locport, tcp_conn->tc_remport,
+			tcp_conn->tc_remaddr);
+	}
+	else
+		slot= TCP_LISTEN_HASH;
+	if (slot == tcp_conn->tc_hash_slot)
+		return;
+	tcp_conn_unhash(tcp_conn);
+	tcp_conn->tc_hash_slot= slot;
+	tcp_conn->tc_hash_next= tcp_conn_hash[slot];
+	tcp_conn_hash[slot]= tcp_conn;
+}
+
+/*
+tcp_conn_unhash
+*/
+
+PRIVATE void tcp_conn_unhash(tcp_conn)
+tcp_conn_t *tcp_conn;
+{
+	tcp_conn_t **conn_p;
+
+	if (tcp_conn->tc_hash_slot == TCP_NO_HASH)
+		return;
+	conn_p= &tcp_conn_hash[tcp_conn->tc_hash_slot];
+	while (*conn_p != tcp_conn)
+	{
+assert (*conn_p);
+		conn_p= &(*conn_p)->tc_hash_next;
+	}
+	*conn_p= tcp_conn->tc_hash_next;
+	tcp_conn->tc_hash_slot= TCP_NO_HASH;
 }
@@ -7,7 +7,18 @@ tcp.h
 
 #define ISS_INC_FREQ	250000L
 #define TCP_MAX_DATAGRAM	8192
+#if _WORD_SIZE == 2
 #define TCP_MAX_WND_SIZE	(4*1024)
+#define TCP_MAX_SND_WND_SIZE	(4*1024)
+#else
+#define TCP_MAX_WND_SIZE	(16*1024L)
+#define TCP_MAX_SND_WND_SIZE	(32*1024L)
+#endif
+	/* TCP_MAX_WND_SIZE is the receive window we offer.  It fits in
+	   16 bits, so the receive side stays unscaled until the buffer
+	   pool grows.  A peer may offer a scaled window of any size, we
+	   use as much of it as the send queue (TCP_MAX_SND_WND_SIZE)
+	   holds */
 #define SUN_0WND_BUG		1
 	/* the sun 4.x.y implementation of tcp/ip does not send zero
 	   windows but instead does not acknowledge new data */
@@ -24,15 +35,28 @@ tcp.h
 #define TCP_DEF_MAX_NO_RETRANS	10000
 #define TCP_DEF_RTT		15	/* initial retransmission time in
 					   ticks */
+#define TCP_MIN_RTT		(HZ/5)	/* bounds on the retransmission */
+#define TCP_MAX_RTT		(60*HZ)	/* time, in ticks */
+#define TCP_DUPACK_THRESH	3	/* duplicate ACKs before a fast
+					   retransmit */
 #define TCP_DEF_MSS		1400
+#if _WORD_SIZE == 2
+#define TCP_LOC_MSS		2048	/* for connections to this host */
+#else
+#define TCP_LOC_MSS		8192
+#endif
+#define TCP_BACKLOG_TIME	(10*HZ)	/* a listen without a user is kept
+					   this long for its backlog */
 #if SUN_TRANS_BUG
 #define TCP_ACK_DELAY		1	/* no delay */
 #else
-#define TCP_ACK_DELAY		(HZ/2)	/* .5 second is clock ticks */
+#define TCP_ACK_DELAY		(HZ/5)	/* .2 second in clock ticks, RFC 1122
+					   wants less than .5 second */
 #endif
 
 #define TCP_DEF_OPT		(NWTC_COPY | NWTC_LP_UNSET | NWTC_UNSET_RA | \
 					NWTC_UNSET_RP)
+#define TCP_DEF_TCPOPT		NWTO_SND_DELAY
 
 #define TCP0			0
 
@@ -48,6 +72,7 @@ int tcp_read ARGS(( int fd, size_t count));
 int tcp_write ARGS(( int fd, size_t count));
 int tcp_ioctl ARGS(( int fd, int req));
 int tcp_cancel ARGS(( int fd, int which_operation ));
+int tcp_select ARGS(( int fd, int operations ));
 void tcp_close ARGS(( int fd));
 
 #endif /* TCP_H */
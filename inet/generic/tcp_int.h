@@ -5,6 +5,18 @@ tcp_int.h
 #ifndef TCP_INT_H
 #define TCP_INT_H
 
+#define TCP_SACK_NR		4	/* SACK blocks remembered */
+
+/* TCP options. */
+#define TCP_OPT_EOL		0
+#define TCP_OPT_NOP		1
+#define TCP_OPT_MSS		2	/* maximum segment size */
+#define TCP_OPT_WSCALE		3	/* window scale (RFC 7323) */
+#define TCP_OPT_SACK_PERM	4	/* SACK permitted (RFC 2018) */
+#define TCP_OPT_SACK		5	/* SACK blocks */
+#define TCP_OPT_TS		8	/* timestamps (RFC 7323) */
+#define TCP_MAX_WSCALE		14
+
 typedef struct tcp_port
 {
 	int tp_minor;
@@ -41,6 +53,7 @@ typedef struct tcp_fd
 	int tf_srfd;
 	int tf_ioreq;
 	nwio_tcpconf_t tf_tcpconf;
+	nwio_tcpopt_t tf_tcpopt;
 	get_userdata_t tf_get_userdata;
 	put_userdata_t tf_put_userdata;
 	struct tcp_conn *tf_conn;
@@ -92,6 +105,7 @@ typedef struct tcp_conn
 	u32_t tc_RCV_HI;
 	u32_t tc_RCV_UP;
 	u32_t tc_IRS;
+	u32_t tc_rcv_acked;	/* RCV_NXT in the last ACK sent */
 	tcp_port_t *tc_port;
 	acc_t *tc_rcvd_data;
 	acc_t *tc_rcv_queue;
@@ -101,12 +115,16 @@ typedef struct tcp_conn
 	acc_t *tc_frag2send;
 	u8_t tc_tos;
 	u8_t tc_ttl;
-	u16_t tc_rcv_wnd;
+	u32_t tc_rcv_wnd;
 	u16_t tc_urg_wnd;
 	int tc_no_retrans;
 	int tc_max_no_retrans;
 	time_t tc_0wnd_to;
-	time_t tc_rtt;
+	time_t tc_rtt;		/* retransmission timeout */
+	time_t tc_srtt;		/* smoothed round trip time, times 8 */
+	time_t tc_rttvar;	/* round trip time variation, times 4 */
+	time_t tc_rt_time;	/* when the timed segment was sent, or 0 */
+	u32_t tc_rt_seq;	/* end of the timed segment */
 	time_t tc_ett;
 	struct timer tc_major_timer;
 	struct timer tc_minor_timer;
@@ -114,10 +132,24 @@ typedef struct tcp_conn
 	struct timer tc_time_wait_timer;
 	u16_t tc_mss;
 	u32_t tc_snd_cwnd;	/* highest sequence number to be sent */
-	u32_t tc_snd_cthresh;	/* threshold for send window */
-	u32_t tc_snd_cinc;	/* increment for send window threshold */
-	u16_t tc_snd_wnd;	/* max send queue size */
+	u32_t tc_snd_cthresh;	/* slow start threshold */
+	u32_t tc_snd_cwsize;	/* congestion window, in bytes */
+	u32_t tc_snd_recover;	/* fast recovery ends when this is acked */
+	int tc_snd_dupacks;	/* number of duplicate ACKs received */
+	u32_t tc_snd_wnd;	/* max send queue size */
+	u8_t tc_snd_wscale;	/* shift for windows the peer sends */
+	u8_t tc_rcv_wscale;	/* shift for windows we send */
+	u32_t tc_ts_recent;	/* timestamp to echo to the peer */
+	u32_t tc_ts_ecr;	/* timestamp echoed by the last segment */
+	int tc_sack_nr;		/* number of blocks in the scoreboard */
+	u32_t tc_sack_lo[TCP_SACK_NR];	/* data the peer holds beyond */
+	u32_t tc_sack_hi[TCP_SACK_NR];	/* SND_UNA, sorted */
+	u32_t tc_sack_recent;	/* last out of order segment received */
+	u32_t tc_snd_rxt;	/* hole to resend during fast recovery */
+	u32_t tc_snd_rxt_hi;
 	int tc_error;
+	int tc_hash_slot;	/* chain in tcp_conn_hash, or TCP_NO_HASH */
+	struct tcp_conn *tc_hash_next;
 } tcp_conn_t;
 
 #define TCF_EMPTY		0x0
@@ -128,6 +160,12 @@ typedef struct tcp_conn
 #define TCF_SEND_ACK		0x10
 #define TCF_FIN_SENT		0x20
 #define TCF_ACK_TIMER_SET	0x40
+#define TCF_FAST_RECOVERY	0x80
+#define TCF_FAST_RETRANS	0x100
+#define TCF_WSCALE		0x200	/* window scaling agreed on */
+#define TCF_TSTAMP		0x400	/* timestamps agreed on */
+#define TCF_SACK		0x800	/* SACK agreed on */
+#define TCF_QUEUED		0x1000	/* on the backlog of a listen */
 
 #define TCS_CLOSED		0
 #define TCS_LISTEN		1
@@ -150,7 +188,8 @@ void tcp_restart_fd_read ARGS(( tcp_conn_t *tcp_conn ));
 void tcp_restart_write ARGS(( tcp_conn_t *tcp_conn ));
 void tcp_set_ack_timer ARGS(( tcp_conn_t *tcp_conn ));
 void tcp_release_retrans ARGS(( tcp_conn_t *tcp_conn, u32_t seg_ack,
-	U16_t new_win ));
+	u32_t new_win ));
+void tcp_dup_ack ARGS(( tcp_conn_t *tcp_conn ));
 void tcp_set_time_wait_timer ARGS(( tcp_conn_t *tcp_conn ));
 void tcp_restart_fd_write ARGS(( tcp_conn_t *tcp_conn ));
 void tcp_close_connection ARGS(( tcp_conn_t *tcp_conn,
@@ -168,7 +207,7 @@ void tcp_write_state ARGS(( tcp_conn_t *tcp_conn ));
 
 void tcp_extract_ipopt ARGS(( tcp_conn_t *tcp_conn,
 	ip_hdr_t *ip_hdr ));
-void tcp_extract_tcpopt ARGS(( tcp_conn_t *tcp_conn,
+int tcp_extract_tcpopt ARGS(( tcp_conn_t *tcp_conn,
 	tcp_hdr_t *tcp_hdr ));
 void tcp_get_ipopt ARGS(( tcp_conn_t *tcp_conn, ip_hdropt_t
 	*ip_hdropt ));
@@ -178,6 +217,9 @@ acc_t *tcp_make_header ARGS(( tcp_conn_t *tcp_conn,
 	ip_hdr_t **ref_ip_hdr, tcp_hdr_t **ref_tcp_hdr, acc_t *data ));
 u16_t tcp_pack_oneCsum ARGS(( acc_t *pack,
 	size_t pack_length ));
+u16_t tcp_wnd_field ARGS(( tcp_conn_t *tcp_conn, u32_t wnd, int flags ));
+u16_t tcp_max_mss ARGS(( tcp_conn_t *tcp_conn ));
+void tcp_sack_purge ARGS(( tcp_conn_t *tcp_conn ));
 int tcp_check_conn ARGS(( tcp_conn_t *tcp_conn ));
 void tcp_print_pack ARGS(( ip_hdr_t *ip_hdr, tcp_hdr_t *tcp_hdr ));
 void tcp_print_conn ARGS(( tcp_conn_t *tcp_conn ));
@@ -188,13 +230,40 @@ int tcp_su4listen ARGS(( tcp_fd_t *tcp_fd ));
 void tcp_reply_ioctl ARGS(( tcp_fd_t *tcp_fd, int reply ));
 void tcp_reply_write ARGS(( tcp_fd_t *tcp_fd, size_t reply ));
 void tcp_reply_read ARGS(( tcp_fd_t *tcp_fd, size_t reply ));
+void tcp_conn_rehash ARGS(( tcp_conn_t *tcp_conn ));
+void tcp_accept_queued ARGS(( tcp_conn_t *tcp_conn ));
 
-#define TCP_PORT_NR	1
+#define TCP_PORT_NR	INET_PORT_NR
+#if _WORD_SIZE == 2
 #define TCP_FD_NR	20
 #define TCP_CONN_NR	20
+#define TCP_HASH_NR	16	/* must be a power of 2 */
+#define TCP_BACKLOG_NR	4	/* queued connections per listen */
+#else
+#define TCP_FD_NR	64
+#define TCP_CONN_NR	64
+#define TCP_HASH_NR	64	/* must be a power of 2 */
+#define TCP_BACKLOG_NR	8
+#endif
+
+/* Connections with a complete address (local port, remote port and remote
+ * address) are kept in the chain tcp_conn_hash[tcp_hash(...)], listens and
+ * other connections with a wildcard in the chain tcp_conn_hash[TCP_HASH_NR].
+ */
+#define TCP_LISTEN_HASH	TCP_HASH_NR
+#define TCP_NO_HASH	(-1)
+
+/* A connection that was set up for a listen and still waits for a user. */
+#define tcp_queued(conn) \
+	(((conn)->tc_flags & TCF_QUEUED) && (conn)->tc_state != TCS_CLOSED)
+
+#define tcp_hash(locport, remport, remaddr) \
+	((int) (((remaddr) ^ ((remaddr) >> 16) ^ (locport) ^ \
+	((remport) << 3)) & (TCP_HASH_NR-1)))
 
 EXTERN tcp_port_t tcp_port_table[TCP_PORT_NR];
 EXTERN tcp_conn_t tcp_conn_table[TCP_CONN_NR];
+EXTERN tcp_conn_t *tcp_conn_hash[TCP_HASH_NR+1];
 EXTERN tcp_fd_t tcp_fd_table[TCP_FD_NR];
 
 #endif /* TCP_INT_H */
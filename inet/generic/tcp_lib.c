@@ -9,10 +9,18 @@ tcp_lib.c
 #include "type.h"
 
 #include "assert.h"
+#include "tcp.h"
 #include "tcp_int.h"
 
 INIT_PANIC();
 
+FORWARD void sack_insert ARGS(( tcp_conn_t *tcp_conn, u32_t lo,
+	u32_t hi ));
+FORWARD int rcv_wscale ARGS(( void ));
+FORWARD u16_t get_u16 ARGS(( u8_t *ptr ));
+FORWARD u32_t get_u32 ARGS(( u8_t *ptr ));
+FORWARD u8_t *put_u32 ARGS(( u8_t *ptr, u32_t val ));
+
 PUBLIC int tcp_LEmod4G (n1, n2)
 u32_t n1;
 u32_t n2;
@@ -56,19 +64,258 @@ ip_hdr_t *ip_hdr;
 #endif
 }
 
-PUBLIC void tcp_extract_tcpopt(tcp_conn, tcp_hdr)
+/*
+tcp_extract_tcpopt
+
+This function processes the options of an incoming segment.  The options in a
+SYN decide whether window scaling, timestamps and SACK are used.  FALSE is
+returned if the timestamp shows the segment to be an old duplicate (PAWS).
+*/
+
+PUBLIC int tcp_extract_tcpopt(tcp_conn, tcp_hdr)
 tcp_conn_t *tcp_conn;
 tcp_hdr_t *tcp_hdr;
 {
-	int tcp_hdr_len;
+	int tcp_hdr_len, i, j, len, syn, has_ts;
+	u8_t *opt;
+	u32_t ts_val, ts_ecr, mss;
 
 	tcp_hdr_len= (tcp_hdr->th_data_off & TH_DO_MASK) >> 2;
-	if (tcp_hdr_len == TCP_MIN_HDR_SIZE)
+	syn= (tcp_hdr->th_flags & THF_SYN);
+	if (syn)
+	{
+		tcp_conn->tc_flags &= ~(TCF_WSCALE|TCF_TSTAMP|TCF_SACK);
+		tcp_conn->tc_snd_wscale= 0;
+		tcp_conn->tc_rcv_wscale= 0;
+	}
+	tcp_conn->tc_ts_ecr= 0;
+	has_ts= FALSE;
+	ts_val= ts_ecr= 0;
+
+	opt= (u8_t *)tcp_hdr + TCP_MIN_HDR_SIZE;
+	for (i= TCP_MIN_HDR_SIZE; i<tcp_hdr_len; i += len, opt += len)
+	{
+		if (opt[0] == TCP_OPT_EOL)
+			break;
+		len= 1;
+		if (opt[0] == TCP_OPT_NOP)
+			continue;
+		if (i+1 >= tcp_hdr_len)
+			break;
+		len= opt[1];
+		if (len < 2 || i+len > tcp_hdr_len)
+			break;
+		switch (opt[0])
+		{
+		case TCP_OPT_MSS:
+			if (!syn || len != 4)
+				break;
+			mss= get_u16(opt+2) + IP_MIN_HDR_SIZE +
+				TCP_MIN_HDR_SIZE;
+			if (mss < IP_MAX_HDR_SIZE + TCP_MAX_HDR_SIZE)
+				mss= IP_MAX_HDR_SIZE + TCP_MAX_HDR_SIZE;
+			if (mss < tcp_conn->tc_mss)
+				tcp_conn->tc_mss= mss;
+			break;
+		case TCP_OPT_WSCALE:
+			if (!syn || len != 3)
+				break;
+			tcp_conn->tc_flags |= TCF_WSCALE;
+			tcp_conn->tc_snd_wscale= opt[2];
+			if (opt[2] > TCP_MAX_WSCALE)
+				tcp_conn->tc_snd_wscale= TCP_MAX_WSCALE;
+			tcp_conn->tc_rcv_wscale= rcv_wscale();
+			break;
+		case TCP_OPT_SACK_PERM:
+			if (syn && len == 2)
+				tcp_conn->tc_flags |= TCF_SACK;
+			break;
+		case TCP_OPT_TS:
+			if (len != 10)
+				break;
+			has_ts= TRUE;
+			ts_val= get_u32(opt+2);
+			ts_ecr= get_u32(opt+6);
+			if (syn)
+			{
+				tcp_conn->tc_flags |= TCF_TSTAMP;
+				tcp_conn->tc_ts_recent= ts_val;
+			}
+			break;
+		case TCP_OPT_SACK:
+			if (syn || !(tcp_conn->tc_flags & TCF_SACK))
+				break;
+			for (j= 2; j+8 <= len; j += 8)
+				sack_insert(tcp_conn, get_u32(opt+j),
+					get_u32(opt+j+4));
+			break;
+		}
+	}
+	if (syn || !has_ts || !(tcp_conn->tc_flags & TCF_TSTAMP))
+		return TRUE;
+	if (tcp_Lmod4G(ts_val, tcp_conn->tc_ts_recent))
+		return FALSE;
+	tcp_conn->tc_ts_ecr= ts_ecr;
+	if (tcp_LEmod4G(ntohl(tcp_hdr->th_seq_nr), tcp_conn->tc_RCV_NXT))
+		tcp_conn->tc_ts_recent= ts_val;
+	return TRUE;
+}
+
+/*
+sack_insert
+
+Add a block reported by the peer to the SACK scoreboard, merging it with the
+blocks it touches.  When the scoreboard is full, the highest block is lost.
+*/
+
+PRIVATE void sack_insert(tcp_conn, lo, hi)
+tcp_conn_t *tcp_conn;
+u32_t lo;
+u32_t hi;
+{
+	int i, j, nr;
+
+	if (!tcp_Lmod4G(lo, hi) || tcp_LEmod4G(hi, tcp_conn->tc_SND_UNA) ||
+		tcp_Gmod4G(hi, tcp_conn->tc_SND_NXT))
 		return;
+	if (tcp_Lmod4G(lo, tcp_conn->tc_SND_UNA))
+		lo= tcp_conn->tc_SND_UNA;
 
-#if DEBUG  & 2
- { where(); printf("tcp_hdr options NOT supported (yet?)\n"); }
-#endif
+	nr= tcp_conn->tc_sack_nr;
+	for (i= 0; i<nr; )
+	{
+		if (tcp_Gmod4G(tcp_conn->tc_sack_lo[i], hi) ||
+			tcp_Lmod4G(tcp_conn->tc_sack_hi[i], lo))
+		{
+			i++;
+			continue;
+		}
+		if (tcp_Lmod4G(tcp_conn->tc_sack_lo[i], lo))
+			lo= tcp_conn->tc_sack_lo[i];
+		if (tcp_Gmod4G(tcp_conn->tc_sack_hi[i], hi))
+			hi= tcp_conn->tc_sack_hi[i];
+		for (j= i+1; j<nr; j++)
+		{
+			tcp_conn->tc_sack_lo[j-1]= tcp_conn->tc_sack_lo[j];
+			tcp_conn->tc_sack_hi[j-1]= tcp_conn->tc_sack_hi[j];
+		}
+		nr--;
+	}
+	for (i= 0; i<nr && tcp_Lmod4G(tcp_conn->tc_sack_lo[i], lo); i++)
+		;
+	if (nr == TCP_SACK_NR)
+	{
+		if (i == nr)
+			return;
+		nr--;
+	}
+	for (j= nr; j>i; j--)
+	{
+		tcp_conn->tc_sack_lo[j]= tcp_conn->tc_sack_lo[j-1];
+		tcp_conn->tc_sack_hi[j]= tcp_conn->tc_sack_hi[j-1];
+	}
+	tcp_conn->tc_sack_lo[i]= lo;
+	tcp_conn->tc_sack_hi[i]= hi;
+	tcp_conn->tc_sack_nr= nr+1;
+}
+
+/*
+tcp_sack_purge
+
+Remove what is acknowledged now from the SACK scoreboard.
+*/
+
+PUBLIC void tcp_sack_purge(tcp_conn)
+tcp_conn_t *tcp_conn;
+{
+	int i, j;
+
+	for (i= j= 0; i<tcp_conn->tc_sack_nr; i++)
+	{
+		if (tcp_LEmod4G(tcp_conn->tc_sack_hi[i], tcp_conn->tc_SND_UNA))
+			continue;
+		tcp_conn->tc_sack_lo[j]= tcp_conn->tc_sack_lo[i];
+		tcp_conn->tc_sack_hi[j]= tcp_conn->tc_sack_hi[i];
+		if (tcp_Lmod4G(tcp_conn->tc_sack_lo[j], tcp_conn->tc_SND_UNA))
+			tcp_conn->tc_sack_lo[j]= tcp_conn->tc_SND_UNA;
+		j++;
+	}
+	tcp_conn->tc_sack_nr= j;
+}
+
+/*
+tcp_max_mss
+
+The largest segment we want on a connection, headers included.  Segments
+to this host are handed from IP to IP without going near a network, so
+they need not fit an ethernet frame.
+*/
+
+PUBLIC u16_t tcp_max_mss(tcp_conn)
+tcp_conn_t *tcp_conn;
+{
+	ipaddr_t remaddr;
+
+	remaddr= tcp_conn->tc_remaddr;
+	if (remaddr && (remaddr == tcp_conn->tc_locaddr ||
+		(ntohl(remaddr) >> 24) == 127))
+	{
+		return TCP_LOC_MSS;
+	}
+	return TCP_DEF_MSS;
+}
+
+/*
+tcp_wnd_field
+
+Return the value for the window field of a segment that offers wnd bytes.
+The window in a SYN segment is never scaled (RFC 7323).
+*/
+
+PUBLIC u16_t tcp_wnd_field(tcp_conn, wnd, flags)
+tcp_conn_t *tcp_conn;
+u32_t wnd;
+int flags;			/* flags of the segment */
+{
+	if (!(flags & THF_SYN))
+		wnd >>= tcp_conn->tc_rcv_wscale;
+	if (wnd > 0xffff)
+		wnd= 0xffff;
+	return wnd;
+}
+
+PRIVATE int rcv_wscale()
+{
+	int shift;
+
+	for (shift= 0; shift < TCP_MAX_WSCALE &&
+		((u32_t)TCP_MAX_WND_SIZE >> shift) > 0xffff; shift++)
+		;
+	return shift;
+}
+
+PRIVATE u16_t get_u16(ptr)
+u8_t *ptr;
+{
+	return (ptr[0] << 8) | ptr[1];
+}
+
+PRIVATE u32_t get_u32(ptr)
+u8_t *ptr;
+{
+	return ((u32_t)ptr[0] << 24) | ((u32_t)ptr[1] << 16) |
+		((u32_t)ptr[2] << 8) | ptr[3];
+}
+
+PRIVATE u8_t *put_u32(ptr, val)
+u8_t *ptr;
+u32_t val;
+{
+	*ptr++= val >> 24;
+	*ptr++= val >> 16;
+	*ptr++= val >> 8;
+	*ptr++= val;
+	return ptr;
 }
 
 PUBLIC u16_t tcp_pack_oneCsum(ip_pack, ip_pack_size)
@@ -171,21 +418,113 @@ ip_hdropt_t *ip_hdropt;
 	return;
 }
 
+/*
+tcp_get_tcpopt
+
+This function builds the options for the next segment.  A SYN offers the
+maximum segment size, window scaling, SACK and timestamps; the other segments
+carry a timestamp and, while there is data out of order, SACK blocks.
+*/
+
 PUBLIC void tcp_get_tcpopt(tcp_conn, tcp_hdropt)
 tcp_conn_t *tcp_conn;
 tcp_hdropt_t *tcp_hdropt;
 {
-	if (!tcp_conn->tc_remtcpopt)
+	u8_t *opt, *lenp;
+	int offer, sack, ts, n, max_n, recent;
+	u16_t mss;
+	acc_t *acc;
+	tcp_hdr_t *tcp_hdr;
+	u32_t lo, hi;
+
+	opt= tcp_hdropt->tho_data;
+	if ((tcp_conn->tc_state == TCS_SYN_SENT ||
+		tcp_conn->tc_state == TCS_SYN_RECEIVED) &&
+		tcp_conn->tc_SND_TRM == tcp_conn->tc_ISS)
 	{
-		tcp_hdropt->tho_opt_siz= 0;
+		/* A SYN, answer what the peer offered. */
+		offer= (tcp_conn->tc_state == TCS_SYN_SENT);
+		mss= tcp_max_mss(tcp_conn)-IP_MIN_HDR_SIZE-TCP_MIN_HDR_SIZE;
+		*opt++= TCP_OPT_MSS;
+		*opt++= 4;
+		*opt++= mss >> 8;
+		*opt++= mss & 0xff;
+		if (offer || (tcp_conn->tc_flags & TCF_WSCALE))
+		{
+			*opt++= TCP_OPT_NOP;
+			*opt++= TCP_OPT_WSCALE;
+			*opt++= 3;
+			*opt++= rcv_wscale();
+		}
+		sack= (offer || (tcp_conn->tc_flags & TCF_SACK));
+		ts= (offer || (tcp_conn->tc_flags & TCF_TSTAMP));
+		if (!sack || !ts)
+		{
+			*opt++= TCP_OPT_NOP;
+			*opt++= TCP_OPT_NOP;
+		}
+		if (sack)
+		{
+			*opt++= TCP_OPT_SACK_PERM;
+			*opt++= 2;
+		}
+		if (ts)
+		{
+			*opt++= TCP_OPT_TS;
+			*opt++= 10;
+			opt= put_u32(opt, (u32_t)get_time());
+			opt= put_u32(opt, offer ? 0 : tcp_conn->tc_ts_recent);
+		}
+		if (!sack && !ts)
+			opt -= 2;
+		tcp_hdropt->tho_opt_siz= opt - tcp_hdropt->tho_data;
 		return;
 	}
 
-#if DEBUG
- { where(); printf("tcp_hdr options NOT supported (yet?)\n"); }
-#endif
-	tcp_hdropt->tho_opt_siz= 0;
-	return;
+	if (tcp_conn->tc_flags & TCF_TSTAMP)
+	{
+		*opt++= TCP_OPT_NOP;
+		*opt++= TCP_OPT_NOP;
+		*opt++= TCP_OPT_TS;
+		*opt++= 10;
+		opt= put_u32(opt, (u32_t)get_time());
+		opt= put_u32(opt, tcp_conn->tc_ts_recent);
+	}
+	if ((tcp_conn->tc_flags & TCF_SACK) && tcp_conn->tc_rcv_queue)
+	{
+		/* Each queued segment is a block of data out of order.  The
+		 * one that holds the last segment received goes first.
+		 */
+		max_n= (sizeof(tcp_hdropt->tho_data) - 4 -
+			(opt - tcp_hdropt->tho_data)) / 8;
+		*opt++= TCP_OPT_NOP;
+		*opt++= TCP_OPT_NOP;
+		*opt++= TCP_OPT_SACK;
+		lenp= opt++;
+		n= 0;
+		for (recent= 1; recent >= 0; recent--)
+		{
+			for (acc= tcp_conn->tc_rcv_queue; acc && n<max_n;
+				acc= acc->acc_ext_link)
+			{
+				tcp_hdr= (tcp_hdr_t *)ptr2acc_data(acc);
+				lo= tcp_hdr->th_seq_nr;	/* host order */
+				hi= lo + tcp_hdr->th_chksum -
+					((tcp_hdr->th_data_off & TH_DO_MASK)
+					>> 2);
+				if (recent != (tcp_LEmod4G(lo,
+					tcp_conn->tc_sack_recent) &&
+					tcp_Lmod4G(tcp_conn->tc_sack_recent,
+					hi)))
+					continue;
+				opt= put_u32(opt, lo);
+				opt= put_u32(opt, hi);
+				n++;
+			}
+		}
+		*lenp= 2 + 8*n;
+	}
+	tcp_hdropt->tho_opt_siz= opt - tcp_hdropt->tho_data;
 }
 
 PUBLIC acc_t *tcp_make_header(tcp_conn, ref_ip_hdr, ref_tcp_hdr, data)
@@ -302,8 +641,8 @@ assert (!(tcp_hdropt.tho_opt_siz & 3));
 	tcp_hdr->th_flags= 0;
 	tcp_hdr->th_data_off= (TCP_MIN_HDR_SIZE+
 		tcp_hdropt.tho_opt_siz) << 2;
-	tcp_hdr->th_window= htons(tcp_conn->tc_RCV_HI-
-		tcp_conn->tc_RCV_LO);
+	tcp_hdr->th_window= htons(tcp_wnd_field(tcp_conn,
+		tcp_conn->tc_RCV_HI-tcp_conn->tc_RCV_LO, tcp_hdr->th_flags));
 	tcp_hdr->th_chksum= 0;
 	*ref_ip_hdr= ip_hdr;
 	*ref_tcp_hdr= tcp_hdr;
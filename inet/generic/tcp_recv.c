@@ -37,9 +37,9 @@ acc_t *tcp_pack;
 	ip_hdr_t *ip_hdr;
 	tcp_hdr_t *tcp_hdr;
 	int ip_hdr_len, tcp_hdr_len;
-	u32_t seg_ack, seg_seq, rcv_hi;
-	u16_t data_length, seg_wnd;
-	int acceptable_ACK, segm_acceptable;
+	u32_t seg_ack, seg_seq, rcv_hi, seg_wnd;
+	u16_t data_length;
+	int acceptable_ACK, segm_acceptable, dup_ack, in_order, holes;
 
 #if DEBUG & 256
  { where(); printf("tcp_frag2conn(&tcp_conn_table[%d],..) called\n",
@@ -73,6 +73,8 @@ acc_t *tcp_pack;
 	seg_ack= ntohl(tcp_hdr->th_ack_nr);
 	seg_seq= ntohl(tcp_hdr->th_seq_nr);
 	seg_wnd= ntohs(tcp_hdr->th_window);
+	if (!(tcp_hdr_flags & THF_SYN))
+		seg_wnd <<= tcp_conn->tc_snd_wscale;
 
 	switch (tcp_conn->tc_state)
 	{
@@ -135,6 +137,9 @@ LISTEN:
 		}
 		if (tcp_hdr_flags & THF_SYN)
 		{
+			tcp_conn->tc_locaddr= ip_hdr->ih_dst;
+			tcp_conn->tc_remaddr= ip_hdr->ih_src;
+			tcp_conn->tc_mss= tcp_max_mss(tcp_conn);
 			tcp_extract_ipopt(tcp_conn, ip_hdr);
 			tcp_extract_tcpopt(tcp_conn, tcp_hdr);
 			tcp_conn->tc_RCV_LO= seg_seq+1;
@@ -155,10 +160,9 @@ assert (tcp_check_conn(tcp_conn));
 #if DEBUG & 2
  { where(); tcp_write_state(tcp_conn); }
 #endif
-			tcp_conn->tc_locaddr= ip_hdr->ih_dst;
 			tcp_conn->tc_locport= tcp_hdr->th_dstport;
-			tcp_conn->tc_remaddr= ip_hdr->ih_src;
 			tcp_conn->tc_remport= tcp_hdr->th_srcport;
+			tcp_conn_rehash(tcp_conn);
 #if DEBUG & 256
  { where(); printf("calling tcp_restart_write(&tcp_conn_table[%d])\n",
 	tcp_conn-tcp_conn_table); }
@@ -251,6 +255,7 @@ SYN-SENT:
 		}
 		if (tcp_hdr_flags & THF_SYN)
 		{
+			tcp_extract_tcpopt(tcp_conn, tcp_hdr);
 			tcp_conn->tc_RCV_LO= seg_seq+1;
 			tcp_conn->tc_RCV_NXT= seg_seq+1;
 			tcp_conn->tc_RCV_HI= tcp_conn->tc_RCV_LO +
@@ -333,6 +338,13 @@ TIME-WAIT:
 #if DEBUG & 256
  { where(); printf("\n"); }
 #endif
+		if (!tcp_extract_tcpopt(tcp_conn, tcp_hdr) &&
+			!(tcp_hdr_flags & THF_RST))
+		{
+			/* An old duplicate, rejected by its timestamp. */
+			tcp_set_ack_timer(tcp_conn);
+			break;
+		}
 		rcv_hi= tcp_conn->tc_RCV_HI;
 		if (tcp_hdr_flags & THF_URG)
 			rcv_hi= tcp_conn->tc_RCV_LO + tcp_conn->tc_rcv_wnd +
@@ -558,8 +570,12 @@ assert (tcp_check_conn(tcp_conn));
 #if DEBUG & 2
  { where(); tcp_write_state(tcp_conn); }
 #endif
-assert(tcp_conn->tc_connuser);
-			tcp_restart_connect(tcp_conn->tc_connuser);
+assert(tcp_conn->tc_connuser ||
+	(tcp_conn->tc_flags & TCF_QUEUED));
+			if (tcp_conn->tc_connuser)
+				tcp_restart_connect(tcp_conn->tc_connuser);
+			else
+				tcp_accept_queued(tcp_conn);
 			if (tcp_conn->tc_state == TCS_CLOSED)
 			{
 #if DEBUG
@@ -609,20 +625,25 @@ assert(tcp_conn->tc_connuser);
 				&& tcp_LEmod4G(seg_ack, tcp_conn->
 				tc_SND_NXT))
 			{
+				dup_ack= (seg_ack == tcp_conn->tc_SND_UNA &&
+					tcp_Lmod4G(seg_ack, tcp_conn->
+					tc_SND_TRM) && !data_length &&
+					!(tcp_hdr_flags & (THF_SYN|THF_FIN)));
 				if (tcp_Lmod4G(tcp_conn->tc_SND_WL1,
 					seg_seq) || (tcp_conn->
 					tc_SND_WL1==seg_seq &&
 					tcp_LEmod4G(tcp_conn->
 					tc_SND_WL2, seg_ack)))
 				{
-					if (seg_wnd > TCP_MAX_WND_SIZE)
-						seg_wnd= TCP_MAX_WND_SIZE;
+					if (seg_wnd > tcp_conn->tc_snd_wnd)
+						seg_wnd= tcp_conn->tc_snd_wnd;
 					if (!seg_wnd)
 						seg_wnd++;
 					tcp_conn->tc_SND_WL1= seg_seq;
 					tcp_conn->tc_SND_WL2= seg_ack;
 #if SUN_0WND_BUG
-					if (seg_wnd && seg_ack == tcp_conn->
+					if (!dup_ack && seg_wnd &&
+						seg_ack == tcp_conn->
 						tc_SND_UNA && tcp_LEmod4G(
 						seg_ack + seg_wnd,
 						tcp_conn->tc_SND_NXT) &&
@@ -637,6 +658,8 @@ assert(tcp_conn->tc_connuser);
 					/* assume 1 segment if not a valid
 					 * window */
 				}
+				if (dup_ack)
+					tcp_dup_ack(tcp_conn);
 				tcp_release_retrans(tcp_conn, seg_ack, seg_wnd);
 				if (tcp_conn->tc_state == TCS_CLOSED)
 				{
@@ -744,7 +767,8 @@ assert (tcp_check_conn(tcp_conn));
 				tcp_close_connection(tcp_conn, ENOCONN);
 				break;
 			}
-			if (!tcp_conn->tc_mainuser)
+			if (!tcp_conn->tc_mainuser &&
+				!(tcp_conn->tc_flags & TCF_QUEUED))
 			{
 				tcp_close_connection(tcp_conn, ENOCONN);
 				break;
@@ -763,11 +787,12 @@ assert (tcp_check_conn(tcp_conn));
  { where(); printf("\n"); }
 #endif
 		tcp_extract_ipopt(tcp_conn, ip_hdr);
-		tcp_extract_tcpopt(tcp_conn, tcp_hdr);
 
 		if (data_length)
 		{
-			if (tcp_LEmod4G(seg_seq, tcp_conn->tc_RCV_NXT))
+			in_order= tcp_LEmod4G(seg_seq, tcp_conn->tc_RCV_NXT);
+			holes= (tcp_conn->tc_rcv_queue != 0);
+			if (in_order)
 				process_data (tcp_conn, tcp_hdr,
 					tcp_hdr_len, tcp_pack,
 					data_length);
@@ -777,14 +802,31 @@ assert (tcp_check_conn(tcp_conn));
 					data_length);
 			if (tcp_conn->tc_state == TCS_CLOSED)
 				break;
-			tcp_conn->tc_flags |= TCF_SEND_ACK;
+
+			/* Delayed ACK (RFC 1122): in order data is acked
+			 * for every second full segment or when the ACK
+			 * timer goes off, unless an outgoing segment takes
+			 * the ACK along first.  Data out of order, or data
+			 * that fills a hole, is acked at once for the fast
+			 * retransmit of the sender.
+			 */
+			if (in_order && !holes && tcp_conn->tc_RCV_NXT -
+				tcp_conn->tc_rcv_acked < 2*(tcp_conn->tc_mss -
+				IP_MIN_HDR_SIZE - TCP_MIN_HDR_SIZE))
+			{
+				tcp_set_ack_timer(tcp_conn);
+			}
+			else
+			{
+				tcp_conn->tc_flags |= TCF_SEND_ACK;
 #if DEBUG & 256
  { where(); printf("tcp_conn_table[%d].tc_flags= 0x%x\n", 
 	tcp_conn-tcp_conn_table, tcp_conn->tc_flags); }
 #endif
-			tcp_restart_write (tcp_conn);
-			if (tcp_conn->tc_state == TCS_CLOSED)
-				break;
+				tcp_restart_write (tcp_conn);
+				if (tcp_conn->tc_state == TCS_CLOSED)
+					break;
+			}
 		}
 /*
 	FIN ?
@@ -1000,7 +1042,7 @@ assert (tcp_check_conn(tcp_conn));
 assert (tcp_check_conn(tcp_conn));
 	if (tcp_conn->tc_readuser)
 		tcp_restart_fd_read(tcp_conn);
-	else if (!tcp_conn->tc_mainuser)
+	else if (!tcp_conn->tc_mainuser && !(tcp_conn->tc_flags & TCF_QUEUED))
 	{
 #if DEBUG
  { where(); printf("calling tcp_close_connection\n"); }
@@ -1049,6 +1091,7 @@ int data_len;
 
 	seg_seq= ntohl(tcp_hdr->th_seq_nr);
 	tcp_hdr->th_seq_nr= seg_seq;	/* seq_nr in host format */
+	tcp_conn->tc_sack_recent= seg_seq;
 
 	if (tcp_hdr->th_flags & THF_URG)
 	{
@@ -1267,7 +1310,6 @@ tcp_hdr_t *tcp_hdr;
 		tmp_tcpopt->acc_linkC++;
 
 	tcp_extract_ipopt (tcp_conn, ip_hdr);
-	tcp_extract_tcpopt (tcp_conn, tcp_hdr);
 
 	RST_acc= tcp_make_header (tcp_conn, &RST_ip_hdr, &RST_tcp_hdr,
 		(acc_t *)0);
@@ -1309,7 +1351,8 @@ tcp_hdr_t *tcp_hdr;
 
 	pack_size= bf_bufsize(RST_acc);
 	RST_ip_hdr->ih_length= htons(pack_size);
-	RST_tcp_hdr->th_window= htons(tcp_conn->tc_rcv_wnd);
+	RST_tcp_hdr->th_window= htons(tcp_wnd_field(tcp_conn,
+		tcp_conn->tc_rcv_wnd, RST_tcp_hdr->th_flags));
 	RST_tcp_hdr->th_chksum= 0;
 	RST_tcp_hdr->th_chksum= ~tcp_pack_oneCsum (RST_acc, pack_size);
 	
@@ -33,6 +33,8 @@ FORWARD void ack_to ARGS(( int conn, struct timer *timer ));
 FORWARD void time_wait_to ARGS(( int conn,
 	struct timer *timer ));
 FORWARD acc_t *make_pack ARGS(( tcp_conn_t *tcp_conn ));
+FORWARD int find_hole ARGS(( tcp_conn_t *tcp_conn ));
+FORWARD void rtt_update ARGS(( tcp_conn_t *tcp_conn, time_t rtt ));
 FORWARD void fd_write ARGS(( tcp_fd_t *tcp_fd ));
 FORWARD void switch_write_fd ARGS(( tcp_conn_t *tcp_conn,
 	tcp_fd_t *new_fd, tcp_fd_t **ref_urgent_fd,
@@ -215,6 +217,8 @@ tcp_conn_t *tcp_conn;
 	time_t new_dis;
 	size_t pack_size;
 	time_t major_timeout, minor_timeout;
+	int fast_retrans, send_ack;
+	tcp_fd_t *tcp_fd;
 
 #if DEBUG & 256
  { where(); printf("make_pack called\n"); }
@@ -265,12 +269,16 @@ tcp_conn_t *tcp_conn;
 			if (!tcp_conn->tc_ett)
 				tcp_conn->tc_ett= get_time();
 				/* fill in estimated transmition time field */
+			tcp_conn->tc_rt_seq= seg_seq;
+			tcp_conn->tc_rt_time= 0;
+				/* round trip timing starts after the SYN */
 
 			major_timeout= get_time() + (tcp_conn->tc_rtt *
 				(tcp_conn->tc_no_retrans + 2));
 		}
 		tcp_hdr->th_seq_nr= htonl(seg_seq);
 		tcp_hdr->th_ack_nr= htonl(tcp_conn->tc_RCV_NXT);
+		tcp_conn->tc_rcv_acked= tcp_conn->tc_RCV_NXT;
 		tcp_hdr->th_flags= seg_flags;
 		tcp_hdr->th_window= htons(tcp_conn->tc_mss);
 			/* Initially we allow one segment */
@@ -325,7 +333,7 @@ assert (tcp_LEmod4G(tcp_conn->tc_SND_TRM, tcp_conn->tc_SND_NXT));
 
 		if ((tcp_conn->tc_SND_TRM == tcp_conn->tc_snd_cwnd ||
 			tcp_conn->tc_SND_TRM == tcp_conn->tc_SND_NXT) &&
-			!(tcp_conn->tc_flags & TCF_SEND_ACK))
+			!(tcp_conn->tc_flags & (TCF_SEND_ACK|TCF_FAST_RETRANS)))
 		{
 #if DEBUG & 256
  { where(); printf("nothing to do\n"); }
@@ -337,7 +345,9 @@ assert (tcp_LEmod4G(tcp_conn->tc_SND_TRM, tcp_conn->tc_SND_NXT));
 		}
 
 		major_timeout= 0;
-		tcp_conn->tc_flags &= ~TCF_SEND_ACK;
+		fast_retrans= (tcp_conn->tc_flags & TCF_FAST_RETRANS);
+		send_ack= (tcp_conn->tc_flags & TCF_SEND_ACK);
+		tcp_conn->tc_flags &= ~(TCF_SEND_ACK|TCF_FAST_RETRANS);
 #if DEBUG & 256
  { where(); printf("tcp_conn_table[%d].tc_flags= 0x%x\n", 
 	tcp_conn-tcp_conn_table, tcp_conn->tc_flags); }
@@ -355,7 +365,15 @@ assert (tcp_LEmod4G(tcp_conn->tc_SND_TRM, tcp_conn->tc_SND_NXT));
 		}
 bf_chkbuf(pack2write);
 		tot_hdr_size= bf_bufsize(pack2write);
-		seg_seq= tcp_conn->tc_SND_TRM;
+		if (fast_retrans)
+		{
+			/* Resend (part of) the hole find_hole() found. */
+			seg_seq= tcp_conn->tc_snd_rxt;
+			if (tcp_Lmod4G(seg_seq, tcp_conn->tc_SND_UNA))
+				seg_seq= tcp_conn->tc_SND_UNA;
+		}
+		else
+			seg_seq= tcp_conn->tc_SND_TRM;
 		seg_flags= THF_ACK;
 assert(tcp_Gmod4G(seg_seq, tcp_conn->tc_ISS));
 
@@ -391,7 +409,17 @@ assert (tcp_check_conn(tcp_conn));
 #endif
 			seg_flags &= ~THF_FIN;
 		}
-		if (tcp_Gmod4G(seg_hi_data, tcp_conn->tc_snd_cwnd))
+		if (fast_retrans)
+		{
+			if (tcp_Gmod4G(seg_hi, tcp_conn->tc_snd_rxt_hi))
+			{
+				seg_hi_data= tcp_conn->tc_snd_rxt_hi;
+				seg_hi= seg_hi_data;
+				seg_flags &= ~THF_FIN;
+			}
+			tcp_conn->tc_snd_rxt= seg_hi;
+		}
+		else if (tcp_Gmod4G(seg_hi_data, tcp_conn->tc_snd_cwnd))
 		{
 			seg_hi_data= tcp_conn->tc_snd_cwnd;
 			seg_hi= seg_hi_data;
@@ -416,13 +444,45 @@ assert (tcp_check_conn(tcp_conn));
 			seg_flags |= THF_PSH;
 		}
 
-		tcp_conn->tc_SND_TRM= seg_hi;
+		/* Nagle (RFC 896): while data is unacknowledged, a segment
+		 * that is not full waits for the ACK or for more data.  An
+		 * ACK that has to go out goes without the data.
+		 */
+		tcp_fd= tcp_conn->tc_mainuser;
+		if (!fast_retrans && seg_seq != tcp_conn->tc_SND_UNA &&
+			seg_hi_data-seg_lo_data < tcp_conn->tc_mss -
+			tot_hdr_size && !(seg_flags & (THF_FIN|THF_URG)) &&
+			!(tcp_fd && (tcp_fd->tf_tcpopt.nwto_flags &
+			NWTO_SND_NODELAY)))
+		{
+			if (!send_ack)
+			{
+				bf_afree(pack2write);
+				return 0;
+			}
+			seg_hi= seg_seq;
+			seg_hi_data= seg_lo_data;
+			seg_flags &= ~THF_PSH;
+		}
+
+		if (tcp_Gmod4G(seg_hi, tcp_conn->tc_SND_TRM))
+			tcp_conn->tc_SND_TRM= seg_hi;
 
 		if (seg_hi-seg_seq)
 		{
 			if (!tcp_conn->tc_ett)
 				tcp_conn->tc_ett= get_time();
 
+			/* Time one segment per round trip, but never a
+			 * retransmission (Karn).
+			 */
+			if (!tcp_conn->tc_rt_time &&
+				tcp_GEmod4G(seg_seq, tcp_conn->tc_rt_seq))
+			{
+				tcp_conn->tc_rt_time= get_time();
+				tcp_conn->tc_rt_seq= seg_hi;
+			}
+
 			if (seg_seq == tcp_conn->tc_SND_UNA)
 				major_timeout= get_time() + (tcp_conn->tc_rtt *
 				(tcp_conn->tc_no_retrans + 1));
@@ -442,9 +502,11 @@ bf_chkbuf(pack2write);
 
 		tcp_hdr->th_seq_nr= htonl(seg_seq);
 		tcp_hdr->th_ack_nr= htonl(tcp_conn->tc_RCV_NXT);
+		tcp_conn->tc_rcv_acked= tcp_conn->tc_RCV_NXT;
 		tcp_hdr->th_flags= seg_flags;
-		tcp_hdr->th_window= htons(tcp_conn->tc_RCV_HI -
-			tcp_conn->tc_RCV_NXT);
+		tcp_hdr->th_window= htons(tcp_wnd_field(tcp_conn,
+			tcp_conn->tc_RCV_HI - tcp_conn->tc_RCV_NXT,
+			seg_flags));
 		tcp_hdr->th_urgptr= htons(seg_up);
 
 		pack_size= bf_bufsize(pack2write);
@@ -541,7 +603,7 @@ int conn;
 struct timer *timer;
 {
 	tcp_conn_t *tcp_conn;
-	u16_t mss, mss2;
+	u32_t flight, mss2;
 
 #if DEBUG & 256
  { where(); printf("in major_to\n"); }
@@ -557,20 +619,29 @@ struct timer *timer;
 		tcp_conn->tc_state != TCS_LISTEN);
 
 	clck_untimer(&tcp_conn->tc_minor_timer);
-	tcp_conn->tc_SND_TRM= tcp_conn->tc_SND_UNA;
 
-	mss= tcp_conn->tc_mss;
-	mss2= 2*mss;
+	/* Everything in flight is resent, so none of it may be timed. */
+	flight= tcp_conn->tc_SND_TRM - tcp_conn->tc_SND_UNA;
+	if (tcp_Gmod4G(tcp_conn->tc_SND_TRM, tcp_conn->tc_rt_seq))
+		tcp_conn->tc_rt_seq= tcp_conn->tc_SND_TRM;
+	tcp_conn->tc_rt_time= 0;
+	tcp_conn->tc_SND_TRM= tcp_conn->tc_SND_UNA;
 
+	/* Half the data in flight is the new slow start threshold, the
+	 * congestion window starts small again.
+	 */
+	mss2= 2*tcp_conn->tc_mss;
+	tcp_conn->tc_snd_cthresh= flight/2;
+	if (tcp_conn->tc_snd_cthresh < mss2)
+		tcp_conn->tc_snd_cthresh= mss2;
+	tcp_conn->tc_snd_cwsize= mss2;
 	tcp_conn->tc_snd_cwnd= tcp_conn->tc_SND_TRM + mss2;
 #if DEBUG & 256
  { where(); printf("snd_cwnd is now %d\n", tcp_conn->tc_snd_cwnd); }
 #endif
-	tcp_conn->tc_snd_cthresh /= 2;
-	if (tcp_conn->tc_snd_cthresh < mss2)
-		tcp_conn->tc_snd_cthresh= mss2;
-	tcp_conn->tc_snd_cinc= ((unsigned long)mss*mss)/tcp_conn->
-		tc_snd_cthresh;
+	tcp_conn->tc_snd_dupacks= 0;
+	tcp_conn->tc_flags &= ~(TCF_FAST_RECOVERY|TCF_FAST_RETRANS);
+	tcp_conn->tc_sack_nr= 0;	/* the receiver may renege */
 
 	tcp_restart_write(tcp_conn);
 }
@@ -595,13 +666,11 @@ struct timer *timer;
 PUBLIC void tcp_release_retrans(tcp_conn, seg_ack, new_win)
 tcp_conn_t *tcp_conn;
 u32_t seg_ack;
-u16_t new_win;
+u32_t new_win;
 {
 	size_t size, offset;
 	acc_t *old_pack, *new_pack;
-	time_t retrans_time, curr_time;
-	u32_t queue_lo, queue_hi;
-	u16_t cwnd, incr, mss, mss2, cthresh;
+	u32_t queue_lo, queue_hi, acked, mss, wnd;
 
 #if DEBUG & 256
  { where(); printf("in release_retrans(&tcp_conn_table[%d], 0x%x, %d)\n",
@@ -610,23 +679,26 @@ u16_t new_win;
 assert (tcp_GEmod4G(seg_ack, tcp_conn->tc_SND_UNA));
 assert (tcp_LEmod4G(seg_ack, tcp_conn->tc_SND_NXT));
 
-	if (tcp_Gmod4G(seg_ack, tcp_conn->tc_SND_UNA))
+	mss= tcp_conn->tc_mss;
+	acked= seg_ack - tcp_conn->tc_SND_UNA;
+	if (acked)
 	{
 		tcp_conn->tc_no_retrans= 0;
-		curr_time= get_time();
-		if (curr_time < tcp_conn->tc_ett)
-			retrans_time= 0;
-		else
-			retrans_time= curr_time-tcp_conn->tc_ett;
-		if (tcp_conn->tc_rtt*2 < retrans_time)
+
+		/* With timestamps every ACK for new data is a sample, the
+		 * echoed time tells when the data left.  Otherwise only the
+		 * one segment timed per round trip is.
+		 */
+		if ((tcp_conn->tc_flags & TCF_TSTAMP) && tcp_conn->tc_ts_ecr)
 		{
-			tcp_conn->tc_rtt *= 2;
-assert (tcp_conn->tc_rtt);
+			rtt_update(tcp_conn, get_time() - tcp_conn->tc_ts_ecr);
+			tcp_conn->tc_rt_time= 0;
 		}
-		else if (tcp_conn->tc_rtt > retrans_time*2)
+		else if (tcp_conn->tc_rt_time &&
+			tcp_GEmod4G(seg_ack, tcp_conn->tc_rt_seq))
 		{
-			tcp_conn->tc_rtt= tcp_conn->tc_rtt/2+1;
-assert (tcp_conn->tc_rtt);
+			rtt_update(tcp_conn, get_time() - tcp_conn->tc_rt_time);
+			tcp_conn->tc_rt_time= 0;
 		}
 
 		if (seg_ack == tcp_conn->tc_SND_NXT)
@@ -642,6 +714,7 @@ assert (tcp_conn->tc_rtt);
 		queue_hi= tcp_conn->tc_SND_NXT;
 
 		tcp_conn->tc_SND_UNA= seg_ack;
+		tcp_sack_purge(tcp_conn);
 		if (tcp_Lmod4G(tcp_conn->tc_SND_TRM, seg_ack))
 			tcp_conn->tc_SND_TRM= seg_ack;
 		if (tcp_Lmod4G(tcp_conn->tc_snd_cwnd, seg_ack))
@@ -670,15 +743,7 @@ assert (tcp_conn->tc_rtt);
 		tcp_conn->tc_send_data= 0;
 
 		if (!size)
-		{
 			new_pack= 0;
-			tcp_conn->tc_snd_cwnd= tcp_conn->tc_SND_UNA + 
-				2*tcp_conn->tc_mss;
-			/* Reset window if a write is completed */
-#if DEBUG & 256
- { where(); printf("snd_cwnd is now %d\n", tcp_conn->tc_snd_cwnd); }
-#endif
-		}
 		else
 			new_pack= bf_cut(old_pack, offset, size);
 		bf_afree(old_pack);
@@ -700,57 +765,75 @@ assert (tcp_check_conn(tcp_conn));
 			tcp_conn->tc_ett + tcp_conn->tc_rtt,
 			major_to, tcp_conn-tcp_conn_table);
 		}
-	}
 
-	mss= tcp_conn->tc_mss;
-	cthresh= tcp_conn->tc_snd_cthresh;
-	mss2= 2*mss;
-
-	if (new_win < mss2)
-	{
-		cwnd= 0;
-		if (new_win >= mss)
-			incr= mss;
-		else
+		/* Open the congestion window: a segment per ACK in slow
+		 * start, a segment per window in congestion avoidance.
+		 * During fast recovery (NewReno) a partial ACK resends the
+		 * next hole, a full ACK ends the recovery.
+		 */
+		if (tcp_conn->tc_flags & TCF_FAST_RECOVERY)
 		{
-			if (new_win)
-				incr= new_win;
+			if (tcp_GEmod4G(tcp_conn->tc_SND_UNA,
+				tcp_conn->tc_snd_recover))
+			{
+				tcp_conn->tc_flags &= ~TCF_FAST_RECOVERY;
+				tcp_conn->tc_snd_cwsize=
+					tcp_conn->tc_snd_cthresh;
+			}
 			else
-				incr= 1;
+			{
+				if (acked < tcp_conn->tc_snd_cwsize)
+					tcp_conn->tc_snd_cwsize -= acked;
+				else
+					tcp_conn->tc_snd_cwsize= 0;
+				tcp_conn->tc_snd_cwsize += mss;
+				if (!(tcp_conn->tc_flags & TCF_SACK))
+					tcp_conn->tc_snd_rxt=
+						tcp_conn->tc_SND_UNA;
+				if (find_hole(tcp_conn))
+				{
+					tcp_conn->tc_flags |=
+						TCF_FAST_RETRANS;
+				}
+			}
 		}
-	}
-	else
-	{
-		cwnd= tcp_conn->tc_snd_cwnd - tcp_conn->tc_SND_UNA;
-		incr= mss2;
-		if (cwnd+incr > new_win)
+		else if (tcp_conn->tc_snd_cwsize < tcp_conn->tc_snd_cthresh)
+			tcp_conn->tc_snd_cwsize += mss;
+		else
 		{
-			incr= mss;
-			if (cwnd+incr > new_win)
-				incr= 0;
+			tcp_conn->tc_snd_cwsize += mss*mss /
+				tcp_conn->tc_snd_cwsize + 1;
 		}
+		if (tcp_conn->tc_snd_cwsize > tcp_conn->tc_snd_wnd)
+			tcp_conn->tc_snd_cwsize= tcp_conn->tc_snd_wnd;
+		tcp_conn->tc_snd_dupacks= 0;
 	}
 
-assert (cthresh >= mss2);
-
-	if (incr && cwnd+incr >  cthresh)
-	{
-		incr -= mss;
-		if (incr && cwnd+incr >  cthresh)
-			incr -= mss;
-	}
-	if (cwnd+incr+mss>cthresh && cthresh<tcp_conn->tc_snd_wnd)
-		tcp_conn->tc_snd_cthresh += tcp_conn->tc_snd_cinc;
-
-	tcp_conn->tc_snd_cwnd= tcp_conn->tc_SND_UNA+cwnd+incr;
+	/* We may send what both the congestion window and the window
+	 * offered by the peer allow.  Data already in flight beyond that is
+	 * only sent again if the peer shrank its window.
+	 */
+	wnd= tcp_conn->tc_snd_cwsize;
+	if (wnd > new_win)
+		wnd= new_win;
+	if (!wnd)
+		wnd= 1;
+	tcp_conn->tc_snd_cwnd= tcp_conn->tc_SND_UNA + wnd;
 #if DEBUG & 256
  { where(); printf("snd_cwnd is now 0x%x\n", tcp_conn->tc_snd_cwnd); }
 #endif
 	if (tcp_Gmod4G(tcp_conn->tc_SND_TRM, tcp_conn->tc_snd_cwnd))
-		tcp_conn->tc_SND_TRM= tcp_conn->tc_snd_cwnd;
+	{
+		if (tcp_Gmod4G(tcp_conn->tc_SND_TRM, tcp_conn->tc_SND_UNA +
+			new_win))
+			tcp_conn->tc_SND_TRM= tcp_conn->tc_snd_cwnd;
+		else
+			tcp_conn->tc_snd_cwnd= tcp_conn->tc_SND_TRM;
+	}
 
-	if (tcp_Gmod4G(tcp_conn->tc_snd_cwnd, tcp_conn->tc_SND_TRM) &&
-		tcp_Gmod4G(tcp_conn->tc_SND_NXT, tcp_conn->tc_SND_TRM))
+	if ((tcp_Gmod4G(tcp_conn->tc_snd_cwnd, tcp_conn->tc_SND_TRM) &&
+		tcp_Gmod4G(tcp_conn->tc_SND_NXT, tcp_conn->tc_SND_TRM)) ||
+		(tcp_conn->tc_flags & TCF_FAST_RETRANS))
 		tcp_restart_write(tcp_conn);
 
 	if (tcp_conn->tc_writeuser)
@@ -760,6 +843,134 @@ assert (tcp_check_conn(tcp_conn));
 
 }
 
+/*
+tcp_dup_ack
+
+This function is called for each duplicate ACK, an ACK without data that does
+not acknowledge anything new while data is outstanding.  Enough of them mean a
+segment was lost: it is resent at once, and the connection enters fast
+recovery.  tcp_release_retrans() does the actual sending.
+*/
+
+PUBLIC void tcp_dup_ack(tcp_conn)
+tcp_conn_t *tcp_conn;
+{
+	u32_t flight, mss;
+
+	mss= tcp_conn->tc_mss;
+	if (tcp_conn->tc_flags & TCF_FAST_RECOVERY)
+	{
+		/* Another segment has left the network. */
+		tcp_conn->tc_snd_cwsize += mss;
+		if (tcp_conn->tc_snd_cwsize > tcp_conn->tc_snd_wnd)
+			tcp_conn->tc_snd_cwsize= tcp_conn->tc_snd_wnd;
+
+		/* The SACK blocks may show more holes to fill. */
+		if ((tcp_conn->tc_flags & TCF_SACK) && find_hole(tcp_conn))
+			tcp_conn->tc_flags |= TCF_FAST_RETRANS;
+		return;
+	}
+	if (++tcp_conn->tc_snd_dupacks != TCP_DUPACK_THRESH)
+		return;
+
+	flight= tcp_conn->tc_SND_TRM - tcp_conn->tc_SND_UNA;
+	tcp_conn->tc_snd_cthresh= flight/2;
+	if (tcp_conn->tc_snd_cthresh < 2*mss)
+		tcp_conn->tc_snd_cthresh= 2*mss;
+	tcp_conn->tc_snd_cwsize= tcp_conn->tc_snd_cthresh +
+		TCP_DUPACK_THRESH*mss;
+	if (tcp_conn->tc_snd_cwsize > tcp_conn->tc_snd_wnd)
+		tcp_conn->tc_snd_cwsize= tcp_conn->tc_snd_wnd;
+
+	tcp_conn->tc_snd_recover= tcp_conn->tc_SND_TRM;
+	if (tcp_Gmod4G(tcp_conn->tc_rt_seq, tcp_conn->tc_snd_recover))
+		tcp_conn->tc_snd_recover= tcp_conn->tc_rt_seq;
+	tcp_conn->tc_rt_seq= tcp_conn->tc_snd_recover;
+	tcp_conn->tc_rt_time= 0;
+	tcp_conn->tc_snd_rxt= tcp_conn->tc_SND_UNA;
+	find_hole(tcp_conn);
+	tcp_conn->tc_flags |= TCF_FAST_RECOVERY|TCF_FAST_RETRANS;
+}
+
+/*
+find_hole
+
+Find the next range to retransmit during fast recovery, starting at
+tc_snd_rxt.  Without SACK information that is the first unacknowledged
+segment, once.  With it, it is the next gap below a block the receiver has
+reported, tc_snd_rxt_hi is set to the end of the gap.
+*/
+
+PRIVATE int find_hole(tcp_conn)
+tcp_conn_t *tcp_conn;
+{
+	u32_t seq;
+	int i;
+
+	seq= tcp_conn->tc_snd_rxt;
+	if (tcp_Lmod4G(seq, tcp_conn->tc_SND_UNA))
+		seq= tcp_conn->tc_SND_UNA;
+
+	if (!(tcp_conn->tc_flags & TCF_SACK) || !tcp_conn->tc_sack_nr)
+	{
+		if (seq != tcp_conn->tc_SND_UNA)
+			return FALSE;
+		tcp_conn->tc_snd_rxt= seq;
+		tcp_conn->tc_snd_rxt_hi= tcp_conn->tc_SND_NXT;
+		return TRUE;
+	}
+
+	for (i= 0; i<tcp_conn->tc_sack_nr; i++)
+	{
+		if (tcp_Lmod4G(seq, tcp_conn->tc_sack_lo[i]))
+		{
+			tcp_conn->tc_snd_rxt= seq;
+			tcp_conn->tc_snd_rxt_hi= tcp_conn->tc_sack_lo[i];
+			return TRUE;
+		}
+		if (tcp_Lmod4G(seq, tcp_conn->tc_sack_hi[i]))
+			seq= tcp_conn->tc_sack_hi[i];
+	}
+	return FALSE;
+}
+
+/*
+rtt_update
+
+Fold a round trip time sample into the estimate (Jacobson/Karels).  srtt is
+kept times 8 and rttvar times 4, the timeout is srtt + 4*rttvar.
+*/
+
+PRIVATE void rtt_update(tcp_conn, rtt)
+tcp_conn_t *tcp_conn;
+time_t rtt;
+{
+	time_t delta;
+
+	if (rtt < 1)
+		rtt= 1;
+	if (!tcp_conn->tc_srtt)
+	{
+		tcp_conn->tc_srtt= rtt << 3;
+		tcp_conn->tc_rttvar= rtt << 1;
+	}
+	else
+	{
+		delta= rtt - (tcp_conn->tc_srtt >> 3);
+		tcp_conn->tc_srtt += delta;
+		if (delta < 0)
+			delta= -delta;
+		tcp_conn->tc_rttvar += delta - (tcp_conn->tc_rttvar >> 2);
+	}
+	rtt= (tcp_conn->tc_srtt >> 3) + tcp_conn->tc_rttvar;
+	if (rtt < TCP_MIN_RTT)
+		rtt= TCP_MIN_RTT;
+	if (rtt > TCP_MAX_RTT)
+		rtt= TCP_MAX_RTT;
+	tcp_conn->tc_rtt= rtt;
+assert (tcp_conn->tc_rtt);
+}
+
 PUBLIC void tcp_restart_fd_write(tcp_conn)
 tcp_conn_t *tcp_conn;
 {
@@ -15,7 +15,7 @@ udp.c
 
 INIT_PANIC();
 
-#define UDP_PORT_NR	1
+#define UDP_PORT_NR	INET_PORT_NR
 #define UDP_FD_NR	32
 
 typedef struct udp_port
@@ -59,6 +59,8 @@ typedef struct udp_fd
 	size_t uf_rd_count;
 	size_t uf_wr_count;
 	time_t uf_exp_tim;
+	struct udp_fd **uf_chain;	/* list this fd is on, if any */
+	struct udp_fd *uf_next;
 } udp_fd_t;
 
 #define UFF_EMPTY	0x0
@@ -68,6 +70,13 @@ typedef struct udp_fd
 #define UFF_WRITE_IP	0x8
 #define UFF_OPTSET	0x10
 
+/* Incoming datagrams are matched against the fds bound to their
+ * destination port, found through a hash table, and against the fds
+ * that accept any port.
+ */
+#define UDP_PORT_HASH_NR	16
+#define UDP_PORT_HASH(p)	(ntohs(p) & (UDP_PORT_HASH_NR-1))
+
 FORWARD void read_ip_packets ARGS(( udp_port_t *udp_port ));
 FORWARD void udp_buffree ARGS(( int priority, size_t reqsize ));
 FORWARD void udp_main ARGS(( udp_port_t *udp_port ));
@@ -87,9 +96,13 @@ FORWARD int is_unused_port ARGS(( Udpport_t port ));
 FORWARD int udp_packet2user ARGS(( udp_fd_t *udp_fd ));
 FORWARD void restart_write_fd ARGS(( udp_fd_t *udp_fd ));
 FORWARD u16_t pack_oneCsum ARGS(( acc_t *pack ));
+FORWARD void udp_link_fd ARGS(( udp_fd_t *udp_fd ));
+FORWARD void udp_unlink_fd ARGS(( udp_fd_t *udp_fd ));
 
 PRIVATE udp_port_t udp_port_table[UDP_PORT_NR];
 PRIVATE udp_fd_t udp_fd_table[UDP_FD_NR];
+PRIVATE udp_fd_t *udp_port_hash[UDP_PORT_HASH_NR];
+PRIVATE udp_fd_t *udp_any_fds;
 
 PUBLIC void udp_init()
 {
@@ -104,18 +117,21 @@ PUBLIC void udp_init()
 	assert (UDP_HDR_SIZE == sizeof(udp_hdr_t));
 	assert (UDP_IO_HDR_SIZE == sizeof(udp_io_hdr_t));
 
-	udp_port_table[0].up_minor= UDP_DEV0;
-	udp_port_table[0].up_ipdev= IP0;
-
 	for (i= 0, udp_fd= udp_fd_table; i<UDP_FD_NR; i++, udp_fd++)
 	{
 		udp_fd->uf_flags= UFF_EMPTY;
+		udp_fd->uf_chain= 0;
 	}
+	for (i= 0; i<UDP_PORT_HASH_NR; i++)
+		udp_port_hash[i]= 0;
+	udp_any_fds= 0;
 
 	bf_logon(udp_buffree);
 
 	for (i= 0, udp_port= udp_port_table; i<UDP_PORT_NR; i++, udp_port++)
 	{
+		udp_port->up_minor= UDP_DEV(i);
+		udp_port->up_ipdev= IP0+i;
 		udp_port->up_flags= UPF_EMPTY;
 		udp_port->up_state= UPS_EMPTY;
 		udp_port->up_next_fd= udp_fd_table;
@@ -123,7 +139,7 @@ PUBLIC void udp_init()
 
 		result= sr_add_minor (udp_port->up_minor,
 			udp_port-udp_port_table, udp_open, udp_close, udp_read,
-			udp_write, udp_ioctl, udp_cancel);
+			udp_write, udp_ioctl, udp_cancel, udp_select);
 		assert (result >= 0);
 
 		udp_main(udp_port);
@@ -655,10 +671,14 @@ assert (data->acc_length == sizeof(nwio_udpopt_t));
 		(all_flags & NWUO_REMADDR_MASK) &&
 		(all_flags & NWUO_RW_MASK) &&
 		(all_flags & NWUO_IPOPT_MASK))
+	{
 		udp_fd->uf_flags |= UFF_OPTSET;
+		udp_link_fd(udp_fd);
+	}
 	else
 	{
 		udp_fd->uf_flags &= ~UFF_OPTSET;
+		udp_unlink_fd(udp_fd);
 	}
 
 	reply_thr_get(udp_fd, NW_OK, TRUE);
@@ -866,7 +886,7 @@ acc_t *pack;
 	unsigned long dst_type, flags;
 	time_t  exp_tim;
 	udpport_t src_port, dst_port;
-	int i;
+	int i, any;
 
 #if DEBUG & 256
  { where(); printf("in process_inc_fragm\n"); }
@@ -940,22 +960,18 @@ assert (pack->acc_length >= IP_MIN_HDR_SIZE);
 	ipopt_pack= 0;
 	no_ipopt_pack= 0;
 
-	for (i=0, udp_fd=udp_fd_table; i<UDP_FD_NR; i++, udp_fd++)
+	udp_fd= udp_port_hash[UDP_PORT_HASH(dst_port)];
+	for (any= FALSE;; udp_fd= udp_fd->uf_next)
 	{
-		if (!(udp_fd->uf_flags & UFF_INUSE))
+		if (!udp_fd && !any)
 		{
-#if DEBUG & 256
- { where(); printf("%d: not inuse\n", i); }
-#endif
-			continue;
-		}
-		if (!(udp_fd->uf_flags & UFF_OPTSET))
-		{
-#if DEBUG
- { where(); printf("%d: options not set\n", i); }
-#endif
-			continue;
+			udp_fd= udp_any_fds;
+			any= TRUE;
 		}
+		if (!udp_fd)
+			break;
+		i= udp_fd-udp_fd_table;
+assert (udp_fd->uf_flags & UFF_OPTSET);
 		flags= udp_fd->uf_udpopt.nwuo_flags;
 		if (!(flags & dst_type))
 		{
@@ -1130,6 +1146,7 @@ int fd;
 
 	assert (udp_fd->uf_flags & UFF_INUSE);
 
+	udp_unlink_fd(udp_fd);
 	udp_fd->uf_flags= UFF_EMPTY;
 	if (udp_fd->uf_rd_buf)
 	{
@@ -1445,6 +1462,24 @@ assert (!(udp_port->up_flags & (UPF_WRITE_IP|UPF_WRITE_SP)));
 	}
 }
 
+PUBLIC int udp_select(fd, operations)
+int fd;
+int operations;
+{
+	udp_fd_t *udp_fd;
+	int ready;
+
+	udp_fd= &udp_fd_table[fd];
+
+	ready= SEL_WR;
+	if (!(udp_fd->uf_flags & UFF_OPTSET) || (udp_fd->uf_rd_buf &&
+		get_time() <= udp_fd->uf_exp_tim))
+	{
+		ready |= SEL_RD;
+	}
+	return ready & operations;
+}
+
 PUBLIC int udp_cancel(fd, which_operation)
 int fd;
 int which_operation;
@@ -1523,3 +1558,44 @@ size_t reqsize;
 		}
 	}
 }
+
+/*
+udp_link_fd
+
+Put an fd on the list that incoming datagrams for it are looked up in,
+after taking it off the list it was on.
+*/
+
+PRIVATE void udp_link_fd (udp_fd)
+udp_fd_t *udp_fd;
+{
+	udp_fd_t **chain;
+
+	udp_unlink_fd(udp_fd);
+	if (udp_fd->uf_udpopt.nwuo_flags & (NWUO_LP_SEL|NWUO_LP_SET))
+	{
+		chain= &udp_port_hash[UDP_PORT_HASH(udp_fd->uf_udpopt.
+			nwuo_locport)];
+	}
+	else
+		chain= &udp_any_fds;
+	udp_fd->uf_chain= chain;
+	udp_fd->uf_next= *chain;
+	*chain= udp_fd;
+}
+
+PRIVATE void udp_unlink_fd (udp_fd)
+udp_fd_t *udp_fd;
+{
+	udp_fd_t **chain;
+
+	if (!udp_fd->uf_chain)
+		return;
+	for (chain= udp_fd->uf_chain; *chain != udp_fd;
+		chain= &(*chain)->uf_next)
+	{
+		assert(*chain);
+	}
+	*chain= udp_fd->uf_next;
+	udp_fd->uf_chain= 0;
+}
@@ -27,6 +27,7 @@ int udp_read ARGS(( int fd, size_t count ));
 int udp_write ARGS(( int fd, size_t count ));
 void udp_close ARGS(( int fd ));
 int udp_cancel ARGS(( int fd, int which_operation ));
+int udp_select ARGS(( int fd, int operations ));
 
 #endif /* UDP_H */
 
@@ -93,6 +93,9 @@ PUBLIC void main()
 			sr_rec(mq);
 			break;
 		case DL_ETH:
+#if ENABLE_PCI_ETH
+		case RTL8139:
+#endif
 #if DEBUG & 256
  { where(); printf("calling eth_rec\n"); }
 #endif
@@ -107,6 +110,7 @@ PUBLIC void main()
 			ip_panic(("message from unknown source: %d",
 				mq->mq_mess.m_source));
 		}
+		sr_select_check();
 	}
 	ip_panic(("task is not allowed to terminate"));
 }
@@ -16,22 +16,42 @@ Created:	Jan 2, 1992 by Philip Homburg
 
 INIT_PANIC();
 
+FORWARD _PROTOTYPE( void eth_init_port, (eth_port_t *eth_port) );
 FORWARD _PROTOTYPE( void setup_read, (eth_port_t *eth_port) );
 FORWARD _PROTOTYPE( int do_sendrec, (int task, message *m1, message *m2) );
 FORWARD _PROTOTYPE( void read_int, (eth_port_t *eth_port, int count) );
-FORWARD _PROTOTYPE( void write_int, (eth_port_t *eth_port) );
+FORWARD _PROTOTYPE( void read_done, (eth_port_t *eth_port, int count) );
+FORWARD _PROTOTYPE( void write_int, (eth_port_t *eth_port, int sent) );
+FORWARD _PROTOTYPE( void write_done, (eth_port_t *eth_port, int sent) );
 
-PUBLIC void eth_init0()
+PUBLIC void osdep_eth_init()
 {
-	int result;
+	int i;
 	eth_port_t *eth_port;
-	static message mess, repl_mess;
 
-	eth_port= &eth_port_table[0];
+	/* Port i of inet is port i of the RTL8139 task if it has a card for
+	 * it, otherwise port i of the dp8390 task.
+	 */
+	for (i=0, eth_port= eth_port_table; i<ETH_PORT_NR; i++, eth_port++)
+	{
+		eth_port->etp_osdep.etp_port= i;
+		eth_port->etp_osdep.etp_minor= ETH_DEV(i);
+#if ENABLE_PCI_ETH
+		eth_port->etp_osdep.etp_task= RTL8139;
+		eth_init_port(eth_port);
+		if (eth_port->etp_flags & EPF_ENABLED)
+			continue;
+#endif
+		eth_port->etp_osdep.etp_task= DL_ETH;
+		eth_init_port(eth_port);
+	}
+}
 
-	eth_port->etp_osdep.etp_port= 0;
-	eth_port->etp_osdep.etp_task= DL_ETH;
-	eth_port->etp_osdep.etp_minor= ETH_DEV;
+PRIVATE void eth_init_port(eth_port)
+eth_port_t *eth_port;
+{
+	int result;
+	static message mess, repl_mess;
 
 #if XXX
 	mess.m_type= DL_STOP;
@@ -44,7 +64,7 @@ assert (eth_port->etp_osdep.etp_task != MM_PROC_NR);
 	if (result < 0)
 	{
 		printf("send failed with error %d\n",result);
-		printf("eth_init0: unable to stop ethernet task\n");
+		printf("eth_init_port: unable to stop ethernet task\n");
 		return;
 	}
 #endif
@@ -61,7 +81,7 @@ assert (eth_port->etp_osdep.etp_task != MM_PROC_NR);
 	if (result<0)
 	{
 		printf(
-		"eth_init0: unable to send to ethernet task, error= %d\n",
+		"eth_init_port: unable to send to ethernet task, error= %d\n",
 			result);
 		return;
 	}
@@ -69,9 +89,14 @@ assert (eth_port->etp_osdep.etp_task != MM_PROC_NR);
 	if (receive(eth_port->etp_osdep.etp_task, &mess)<0)
 		ip_panic(("unable to receive"));
 
+	if (mess.m3_i1 == ENXIO)
+	{
+		/* No card for this port, it stays disabled. */
+		return;
+	}
 	if (mess.m3_i1 != eth_port->etp_osdep.etp_port)
 	{
-		printf("eth_init0: got reply for wrong port\n");
+		printf("eth_init_port: got reply for wrong port\n");
 		return;
 	}
 
@@ -79,12 +104,15 @@ assert (eth_port->etp_osdep.etp_task != MM_PROC_NR);
 
 	if (sr_add_minor (eth_port->etp_osdep.etp_minor, 
 		eth_port- eth_port_table, eth_open, eth_close, eth_read, 
-		eth_write, eth_ioctl, eth_cancel)<0)
+		eth_write, eth_ioctl, eth_cancel, eth_select)<0)
 		ip_panic(("can't sr_init"));
 
 	eth_port->etp_flags |= EPF_ENABLED;
 	eth_port->etp_wr_pack= 0;
+	eth_port->etp_wr_nr= 0;
+	eth_port->etp_osdep.etp_wr_busy= 0;
 	eth_port->etp_rd_pack= 0;
+	eth_port->etp_rd_nr= 0;
 	setup_read (eth_port);
 }
 
@@ -92,9 +120,9 @@ PUBLIC void eth_write_port(eth_port)
 eth_port_t *eth_port;
 {
 	static message mess1, mess2;
-	int i, pack_size, result;
-	acc_t *pack, *pack_ptr;
-	iovec_t *iovec;
+	int i, n, nr, pack_size, result;
+	acc_t *pack, *pack_ptr, **pack_pp;
+	iovec_t *iovec, *frame;
 
 #if DEBUG & 256
  { where(); bf_check_all_bufs(); }
@@ -105,73 +133,77 @@ eth_port_t *eth_port;
 #endif
 assert (!(eth_port->etp_flags & EPF_WRITE_IP));
 
-	eth_port->etp_flags |= EPF_WRITE_IP;
-
-	pack= eth_port->etp_wr_pack;
-	eth_port->etp_wr_pack= 0;
-
-	iovec= eth_port->etp_osdep.etp_wr_iovec;
-	pack_size= 0;
-#if DEBUG & 256
- { where(); printf("bf_bufsize= %d\n", bf_bufsize(pack)); }
-#endif
-	for (i=0, pack_ptr= pack; i<IOVEC_NR && pack_ptr; i++,
-		pack_ptr= pack_ptr->acc_next)
-	{
-		iovec[i].iov_addr= (vir_bytes)ptr2acc_data(
-			pack_ptr);
-		pack_size += iovec[i].iov_size=
-			pack_ptr->acc_length;
-	}
-	if (i>= IOVEC_NR)
+	do
 	{
+assert (eth_port->etp_wr_pack);
+		eth_port->etp_flags |= EPF_WRITE_IP;
+
+		/* Describe all queued frames, each one with a header entry
+		 * followed by its fragments.
+		 */
+		iovec= eth_port->etp_osdep.etp_wr_iovec;
+		n= 0;
+		nr= 0;
+		for (pack_pp= &eth_port->etp_wr_pack; *pack_pp;
+			pack_pp= &(*pack_pp)->acc_ext_link)
+		{
+			pack= *pack_pp;
+			frame= &iovec[n++];
+			pack_size= 0;
+			for (i=0, pack_ptr= pack; i<IOVEC_NR && pack_ptr; i++,
+				pack_ptr= pack_ptr->acc_next)
+			{
+				iovec[n+i].iov_addr= (vir_bytes)ptr2acc_data(
+					pack_ptr);
+				pack_size += iovec[n+i].iov_size=
+					pack_ptr->acc_length;
+			}
+			if (pack_ptr)
+			{
 #if DEBUG
  { where(); printf("compacting fragment\n"); }
 #endif
-		pack= bf_pack(pack);		/* packet is too fragmented */
-		pack_size= 0;
-		for (i=0, pack_ptr= pack; i<IOVEC_NR &&
-			pack_ptr; i++, pack_ptr= pack_ptr->
-			acc_next)
-		{
-			iovec[i].iov_addr= (vir_bytes)
-				ptr2acc_data(pack_ptr);
-			pack_size += iovec[i].iov_size=
-				pack_ptr->acc_length;
-		}
-	}
-#if DEBUG & 256
- { where(); printf("bf_bufsize= %d\n", bf_bufsize(pack));
-	where(); printf("i= %d\n", i); }
-#endif
-assert (i< IOVEC_NR);
+				/* packet is too fragmented */
+				pack_ptr= pack->acc_ext_link;
+				pack= bf_pack(pack);
+				pack->acc_ext_link= pack_ptr;
+				*pack_pp= pack;
+				if (!pack_ptr)
+					eth_port->etp_wr_tail= pack;
+				pack_size= 0;
+				for (i=0, pack_ptr= pack; i<IOVEC_NR &&
+					pack_ptr; i++, pack_ptr= pack_ptr->
+					acc_next)
+				{
+					iovec[n+i].iov_addr= (vir_bytes)
+						ptr2acc_data(pack_ptr);
+					pack_size += iovec[n+i].iov_size=
+						pack_ptr->acc_length;
+				}
+			}
+assert (!pack_ptr);
 assert (pack_size >= ETH_MIN_PACK_SIZE);
+			frame->iov_addr= 0;
+			frame->iov_size= i;
+			n += i;
+			nr++;
+		}
+assert (nr == eth_port->etp_wr_nr && nr <= ETH_WR_NR);
+		eth_port->etp_osdep.etp_wr_busy= nr;
 
-	if (i==1)
-	/* simple packets can be sent using DL_WRITE instead of DL_WRITEV */
-	{
-		mess1.DL_COUNT= iovec[0].iov_size;
-		mess1.DL_ADDR= (char *)iovec[0].iov_addr;
-		mess1.m_type= DL_WRITE;
-	}
-	else
-	{
-		mess1.DL_COUNT= i;
+		mess1.DL_COUNT= n;
 		mess1.DL_ADDR= (char *)iovec;
-		mess1.m_type= DL_WRITEV;
-	}
-	mess1.DL_PORT= eth_port->etp_osdep.etp_port;
-	mess1.DL_PROC= THIS_PROC;
-	mess1.DL_MODE= DL_NOMODE;
+		mess1.m_type= DL_WRITEB;
+		mess1.DL_PORT= eth_port->etp_osdep.etp_port;
+		mess1.DL_PROC= THIS_PROC;
+		mess1.DL_MODE= DL_NOMODE;
 
 #if DEBUG & 256
  { where(); printf("calling do_sendrec\n"); }
 #endif
 assert (eth_port->etp_osdep.etp_task != MM_PROC_NR);
-	result= do_sendrec (eth_port->etp_osdep.etp_task, &mess1, &mess2);
-#if DEBUG & 256
- { where(); printf("do_sendrec done\n"); }
-#endif
+		result= do_sendrec (eth_port->etp_osdep.etp_task, &mess1,
+			&mess2);
 
 #if DEBUG & 256
  { where(); printf("got reply from DLL\n"); }
@@ -190,37 +222,38 @@ assert (mess1.m_type == DL_TASK_REPLY && mess1.DL_PORT == mess1.DL_PORT &&
 
 assert((mess1.DL_STAT >> 16) == OK);
 
-	if (!(mess1.DL_STAT & DL_PACK_SEND))
-	/* packet is not sent, suspend */
-	{
+		if (!(mess1.DL_STAT & DL_PACK_SEND))
+		/* no buffers free on the card, suspend */
+		{
 #if DEBUG & 256
  { where(); printf("setting EPF_WRITE_SP\n"); }
 #endif
-		eth_port->etp_flags |= EPF_WRITE_SP;
-		eth_port->etp_wr_pack= pack;
-	}
-	else
-	/* packet is sent */
-	{
-		eth_port->etp_flags &= ~EPF_WRITE_IP;
-		eth_arrive(eth_port, pack);
+			eth_port->etp_flags |= EPF_WRITE_SP;
+		}
+		else
+		/* some or all of the frames are sent */
+		{
+			write_done(eth_port, DL_SENT(mess1.DL_STAT));
 #if DEBUG & 256
  { where(); printf("write done\n"); }
 #endif
-	}
+		}
 
-	if (result == 1)	/* got an INT_TASK */
-	{
-assert(mess2.DL_STAT == DL_PACK_RECV);
+		if (result == 1)	/* got an INT_TASK */
+		{
+assert(mess2.DL_STAT & DL_PACK_RECV);
+assert(!(mess2.DL_STAT & DL_PACK_SEND));
 assert(!(mess1.DL_STAT & DL_PACK_RECV));
 compare(mess2.DL_PORT, ==, eth_port->etp_osdep.etp_port);
 compare(mess2.DL_PROC, ==, THIS_PROC);
-		read_int(eth_port, mess2.DL_COUNT);
-	}
-	else if (mess1.DL_STAT & DL_PACK_RECV)
-	{
-		read_int(eth_port, mess1.DL_COUNT);
-	}
+			read_int(eth_port, mess2.DL_COUNT);
+		}
+		else if (mess1.DL_STAT & DL_PACK_RECV)
+		{
+			read_int(eth_port, mess1.DL_COUNT);
+		}
+	} while (eth_port->etp_wr_pack &&
+		!(eth_port->etp_flags & EPF_WRITE_IP));
 }
 
 PUBLIC void eth_rec(m)
@@ -230,7 +263,11 @@ message *m;
 	eth_port_t *loc_port;
 	int stat;
 
+#if ENABLE_PCI_ETH
+assert (m->m_source == DL_ETH || m->m_source == RTL8139);
+#else
 assert (m->m_source == DL_ETH);
+#endif
 
 	set_time (m->DL_CLCK);
 
@@ -248,7 +285,7 @@ assert (i<ETH_PORT_NR);
 assert(stat & (DL_PACK_SEND|DL_PACK_RECV));
 	if (stat & DL_PACK_SEND)
 	{
-		write_int(loc_port);
+		write_int(loc_port, DL_SENT(stat));
 	}
 	if (stat & DL_PACK_RECV)
 	{
@@ -395,39 +432,64 @@ assert (mptr1->m_type == DL_TASK_REPLY);
 	return extra;
 }
 
-PRIVATE void write_int(eth_port)
+PRIVATE void write_int(eth_port, sent)
 eth_port_t *eth_port;
+int sent;
 {
-	acc_t *pack;
-
 #if DEBUG & 256
  { where(); printf("write_int called\n"); }
 #endif
 
-assert(eth_port->etp_flags & (EPF_WRITE_IP|EPF_WRITE_SP) ==
+assert((eth_port->etp_flags & (EPF_WRITE_IP|EPF_WRITE_SP)) ==
 	(EPF_WRITE_IP|EPF_WRITE_SP));
 
-	pack= eth_port->etp_wr_pack;
-	eth_port->etp_wr_pack= NULL;
-	eth_arrive(eth_port, pack);
-	eth_port->etp_flags &= ~(EPF_WRITE_IP|EPF_WRITE_SP);
+	write_done(eth_port, sent);
+	if (eth_port->etp_wr_pack && !(eth_port->etp_flags & EPF_WRITE_IP))
+		eth_write_port(eth_port);
 	while (eth_get_work(eth_port))
 		;
 }
 
-PRIVATE void read_int(eth_port, count)
+/*
+write_done
+
+The driver took the first `sent' frames of the send queue.  Frames that were
+not taken are sent again by the caller.
+*/
+
+PRIVATE void write_done(eth_port, sent)
 eth_port_t *eth_port;
-int count;
+int sent;
 {
-	acc_t *pack, *cut_pack;
+	acc_t *pack, *done;
 
-	pack= eth_port->etp_rd_pack;
-	eth_port->etp_rd_pack= NULL;
+assert (sent > 0 && sent <= eth_port->etp_osdep.etp_wr_busy);
 
-	cut_pack= bf_cut(pack, 0, count);
-	bf_afree(pack);
+	/* Take the frames off the queue before eth_arrive() can queue
+	 * new ones.
+	 */
+	done= eth_port->etp_wr_pack;
+	eth_port->etp_wr_nr -= sent;
+	for (pack= done; --sent > 0; pack= pack->acc_ext_link)
+		;
+	eth_port->etp_wr_pack= pack->acc_ext_link;
+	pack->acc_ext_link= 0;
+	eth_port->etp_osdep.etp_wr_busy= 0;
+	eth_port->etp_flags &= ~(EPF_WRITE_IP|EPF_WRITE_SP);
 
-	eth_arrive(eth_port, cut_pack);
+	while (done)
+	{
+		pack= done;
+		done= done->acc_ext_link;
+		eth_arrive(eth_port, pack);
+	}
+}
+
+PRIVATE void read_int(eth_port, count)
+eth_port_t *eth_port;
+int count;
+{
+	read_done(eth_port, count);
 	
 	if (!(eth_port->etp_flags & EPF_READ_SP))
 	{
@@ -438,41 +500,98 @@ int count;
 	setup_read(eth_port);
 }
 
+/*
+read_done
+
+The first `count' receive buffers are filled, the length of each frame is in
+its header entry of the iovec.
+*/
+
+PRIVATE void read_done(eth_port, count)
+eth_port_t *eth_port;
+int count;
+{
+	acc_t *pack, *cut_pack;
+	iovec_t *frame;
+
+assert (count > 0 && count <= eth_port->etp_rd_nr);
+
+	frame= eth_port->etp_osdep.etp_rd_iovec;
+	while (count--)
+	{
+		pack= eth_port->etp_rd_pack;
+		eth_port->etp_rd_pack= pack->acc_ext_link;
+		eth_port->etp_rd_nr--;
+
+		cut_pack= bf_cut(pack, 0, (size_t)frame->iov_addr);
+		bf_afree(pack);
+		frame += 1 + frame->iov_size;
+
+		eth_arrive(eth_port, cut_pack);
+	}
+}
+
 PRIVATE void setup_read(eth_port)
 eth_port_t *eth_port;
 {
 	acc_t *pack, *pack_ptr;
 	static message mess1, mess2;
-	iovec_t *iovec;
-	int i, result;
+	iovec_t *iovec, *frame;
+	int i, n, result;
 
 assert(!(eth_port->etp_flags & (EPF_READ_IP|EPF_READ_SP)));
 
 	do
 	{
-
-assert (!eth_port->etp_rd_pack);
+		/* Keep ETH_RD_NR buffers with the driver.  Buffers that were
+		 * not filled by the previous request are handed out again.
+		 */
+		while (eth_port->etp_rd_nr < ETH_RD_NR)
+		{
+			pack= bf_memreq (ETH_MAX_PACK_SIZE);
+			pack->acc_ext_link= 0;
+			if (!eth_port->etp_rd_pack)
+				eth_port->etp_rd_pack= pack;
+			else
+			{
+				for (pack_ptr= eth_port->etp_rd_pack;
+					pack_ptr->acc_ext_link;
+					pack_ptr= pack_ptr->acc_ext_link)
+					;
+				pack_ptr->acc_ext_link= pack;
+			}
+			eth_port->etp_rd_nr++;
+		}
 
 		iovec= eth_port->etp_osdep.etp_rd_iovec;
-		pack= bf_memreq (ETH_MAX_PACK_SIZE);
-
-		for (i=0, pack_ptr= pack; i<RD_IOVEC && pack_ptr;
-			i++, pack_ptr= pack_ptr->acc_next)
+		n= 0;
+		for (pack= eth_port->etp_rd_pack; pack;
+			pack= pack->acc_ext_link)
 		{
-			iovec[i].iov_addr= (vir_bytes)ptr2acc_data(pack_ptr);
-			iovec[i].iov_size= (vir_bytes)pack_ptr->acc_length;
+			frame= &iovec[n++];
+			for (i=0, pack_ptr= pack; i<RD_IOVEC && pack_ptr;
+				i++, pack_ptr= pack_ptr->acc_next)
+			{
+				iovec[n+i].iov_addr= (vir_bytes)
+					ptr2acc_data(pack_ptr);
+				iovec[n+i].iov_size= (vir_bytes)
+					pack_ptr->acc_length;
 #if DEBUG & 256
  { where(); printf("filling iovec[%d] with iov_addr= %x, iov_size= %x\n",
-	i, iovec[i].iov_addr, iovec[i].iov_size); }
+	n+i, iovec[n+i].iov_addr, iovec[n+i].iov_size); }
 #endif
-		}
+			}
 
 assert (!pack_ptr);
+			frame->iov_addr= 0;
+			frame->iov_size= i;
+			n += i;
+		}
 
-		mess1.m_type= DL_READV;
+		mess1.m_type= DL_READB;
 		mess1.DL_PORT= eth_port->etp_osdep.etp_port;
 		mess1.DL_PROC= THIS_PROC;
-		mess1.DL_COUNT= i;
+		mess1.DL_COUNT= n;
 		mess1.DL_ADDR= (char *)iovec;
 
 		result= do_sendrec (eth_port->etp_osdep.etp_task, &mess1, 
@@ -492,33 +611,30 @@ assert (mess1.m_type == DL_TASK_REPLY && mess1.DL_PORT == mess1.DL_PORT &&
 compare((mess1.DL_STAT >> 16), ==, OK);
 
 		if (mess1.DL_STAT & DL_PACK_RECV)
-		/* packet received */
+		/* frames received */
 		{
-			pack_ptr= bf_cut(pack, 0, mess1.DL_COUNT);
-			bf_afree(pack);
-
 assert(!(eth_port->etp_flags & EPF_READ_IP));
-			eth_arrive(eth_port, pack_ptr);
+			read_done(eth_port, mess1.DL_COUNT);
 assert(!(eth_port->etp_flags & EPF_READ_IP));
 		}
 		else
-		/* no packet received */
+		/* no frames received */
 		{
-			eth_port->etp_rd_pack= pack;
 			eth_port->etp_flags |= EPF_READ_IP;
 		}
 
 		if (result == 1)	/* got an INT_TASK */
 		{
-assert(mess2.DL_STAT == DL_PACK_SEND);
+assert(mess2.DL_STAT & DL_PACK_SEND);
+assert(!(mess2.DL_STAT & DL_PACK_RECV));
 assert(!(mess1.DL_STAT & DL_PACK_SEND));
 assert (mess2.DL_PORT == mess2.DL_PORT &&
 	mess2.DL_PROC == THIS_PROC);
-			write_int(eth_port);
+			write_int(eth_port, DL_SENT(mess2.DL_STAT));
 		}
 		else if (mess1.DL_STAT & DL_PACK_SEND)
 		{
-			write_int(eth_port);
+			write_int(eth_port, DL_SENT(mess1.DL_STAT));
 		}
 	} while (!(eth_port->etp_flags & EPF_READ_IP));
 	eth_port->etp_flags |= EPF_READ_SP;
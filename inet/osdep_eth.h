@@ -10,13 +10,25 @@ Created:	Dec 30, 1991 by Philip Homburg
 #define IOVEC_NR	16
 #define RD_IOVEC	((ETH_MAX_PACK_SIZE + BUF_S -1)/BUF_S)
 
+/* Frames go to and from the ethernet task in batches (DL_READB, DL_WRITEB).
+ * Each frame takes a header entry and its fragments in the iovec.
+ */
+#if _WORD_SIZE == 2
+#define ETH_RD_NR	2	/* receive buffers handed to the task */
+#define ETH_WR_NR	2	/* frames queued for sending */
+#else
+#define ETH_RD_NR	4
+#define ETH_WR_NR	4
+#endif
+
 typedef struct osdep_eth_port
 {
 	int etp_minor;
 	int etp_task;
 	int etp_port;
-	iovec_t etp_wr_iovec[IOVEC_NR];
-	iovec_t etp_rd_iovec[RD_IOVEC];
+	int etp_wr_busy;	/* frames in the pending DL_WRITEB */
+	iovec_t etp_wr_iovec[ETH_WR_NR * (1+IOVEC_NR)];
+	iovec_t etp_rd_iovec[ETH_RD_NR * (1+RD_IOVEC)];
 } osdep_eth_port_t;
 
 #endif /* INET__OSDEP_ETH_H */
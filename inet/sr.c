@@ -25,6 +25,13 @@ The valid messages and their parameters are:
 |		|           |         |       |          |         |
 | NW_CANCEL	| minor dev | proc nr |       |          |         |
 |_______________|___________|_________|_______|__________|_________|
+|		|           |         |       |          |         |
+| NW_SELECT	| minor dev | proc nr |  ops  |          |         |
+|_______________|___________|_________|_______|__________|_________|
+
+NW_SELECT is answered with the operations that are ready.  If none are and
+SEL_NOTIFY is set, a DEV_READY message carrying the minor device is sent to
+FS as soon as one of them is.
 
 */
 
@@ -39,7 +46,7 @@ The valid messages and their parameters are:
 
 INIT_PANIC();
 
-#define FD_NR			32
+#define FD_NR			(28 + 4*INET_PORT_NR)
 
 typedef struct sr_fd
 {
@@ -52,6 +59,9 @@ typedef struct sr_fd
 	sr_read_t srf_read;
 	sr_ioctl_t srf_ioctl;
 	sr_cancel_t srf_cancel;
+	sr_select_t srf_select;
+	int srf_selops;
+	int srf_selsrc;
 	mq_t *srf_ioctl_q, *srf_ioctl_q_tail;
 	mq_t *srf_read_q, *srf_read_q_tail;
 	mq_t *srf_write_q, *srf_write_q_tail;
@@ -75,6 +85,8 @@ FORWARD _PROTOTYPE ( int sr_open, (message *m) );
 FORWARD _PROTOTYPE ( void sr_close, (message *m) );
 FORWARD _PROTOTYPE ( int sr_rwio, (mq_t *m) );
 FORWARD _PROTOTYPE ( int sr_cancel, (message *m) );
+FORWARD _PROTOTYPE ( int sr_select, (message *m) );
+FORWARD _PROTOTYPE ( int sr_select_try, (sr_fd_t *sr_fd, int ops) );
 FORWARD _PROTOTYPE ( void sr_reply, (message *mes_ptr, int reply) );
 FORWARD _PROTOTYPE ( void sr_revive, (mq_t *mes_ptr, int reply) );
 FORWARD _PROTOTYPE ( sr_fd_t *sr_getchannel, (int minor));
@@ -93,6 +105,7 @@ FORWARD _PROTOTYPE ( int cp_b2u, (acc_t *acc_ptr, int proc, char *dest) );
 
 PRIVATE sr_fd_t sr_fd_table[FD_NR];
 PRIVATE mq_t *repl_queue, *repl_queue_tail;
+PRIVATE int sr_select_pending;
 PRIVATE cpvec_t cpvec[CPVEC_NR];
 
 PUBLIC void sr_init()
@@ -161,6 +174,11 @@ assert(result == OK || result == EINTR);
 		send_reply= (result == EINTR);
 		free_mess= 1;
 		break;
+	case NW_SELECT:
+		result= sr_select(&m->mq_mess);
+		send_reply= 1;
+		free_mess= 1;
+		break;
 	default:
 		ip_panic(("unknown message, type= %d", m->mq_mess.m_type));
 	}
@@ -180,7 +198,7 @@ assert(result == OK || result == EINTR);
 }
 
 PUBLIC int sr_add_minor(minor, port, openf, closef, readf, writef,
-	ioctlf, cancelf)
+	ioctlf, cancelf, selectf)
 int minor;
 int port;
 sr_open_t openf;
@@ -189,6 +207,7 @@ sr_read_t readf;
 sr_write_t writef;
 sr_ioctl_t ioctlf;
 sr_cancel_t cancelf;
+sr_select_t selectf;
 {
 	sr_fd_t *sr_fd;
 
@@ -207,6 +226,8 @@ sr_cancel_t cancelf;
 	sr_fd->srf_read= readf;
 	sr_fd->srf_ioctl= ioctlf;
 	sr_fd->srf_cancel= cancelf;
+	sr_fd->srf_select= selectf;
+	sr_fd->srf_selops= 0;
 
 	return OK;
 }
@@ -284,6 +305,7 @@ message *m;
  { where(); printf("srf_close: 0x%x(%d)\n", sr_fd->srf_close, sr_fd->srf_fd); }
 #endif
 	sr_fd->srf_flags= SFF_FREE;
+	sr_fd->srf_selops= 0;
 }
 
 PRIVATE int sr_rwio(m)
@@ -415,6 +437,87 @@ assert (sr_fd);
 	ip_panic(("request not found"));
 }
 
+PRIVATE int sr_select(m)
+message *m;
+{
+	sr_fd_t *sr_fd;
+	int ops, ready;
+
+	sr_fd= sr_getchannel(m->DEVICE);
+assert (sr_fd);
+
+	ops= m->COUNT & (SEL_RD | SEL_WR | SEL_ERR);
+	ready= sr_select_try(sr_fd, ops);
+	if (!ready && (m->COUNT & SEL_NOTIFY))
+	{
+		sr_fd->srf_selops |= ops;
+		sr_fd->srf_selsrc= m->m_source;
+		sr_select_pending= TRUE;
+	}
+	return ready;
+}
+
+PRIVATE int sr_select_try(sr_fd, ops)
+sr_fd_t *sr_fd;
+int ops;
+{
+	/* A new request would be queued behind one that is in progress. */
+	if (sr_fd->srf_flags & SFF_READ_IP)
+		ops &= ~SEL_RD;
+	if (sr_fd->srf_flags & SFF_WRITE_IP)
+		ops &= ~SEL_WR;
+	if (!ops)
+		return 0;
+
+	/* Without a select function the request itself has to find out. */
+	if (!sr_fd->srf_select)
+		return ops & (SEL_RD | SEL_WR);
+	return (*sr_fd->srf_select)(sr_fd->srf_fd, ops) & ops;
+}
+
+/*
+sr_select_check
+
+Called after each message, sends DEV_READY for channels that FS is waiting
+on and that have become ready.
+*/
+
+PUBLIC void sr_select_check()
+{
+	sr_fd_t *sr_fd;
+	message mess;
+	int i, ready, result;
+
+	if (!sr_select_pending)
+		return;
+	sr_select_pending= FALSE;
+
+	for (i=0, sr_fd= sr_fd_table; i<FD_NR; i++, sr_fd++)
+	{
+		if (!sr_fd->srf_selops)
+			continue;
+		ready= sr_select_try(sr_fd, sr_fd->srf_selops);
+		if (!ready)
+		{
+			sr_select_pending= TRUE;
+			continue;
+		}
+		mess.m_type= DEV_READY;
+		mess.DEVICE= i;
+		mess.REP_STATUS= ready;
+		result= send(sr_fd->srf_selsrc, &mess);
+		if (result == ELOCKED)
+		{
+			/* FS is sending to us, try again after that. */
+			sr_select_pending= TRUE;
+			continue;
+		}
+		if (result != OK)
+			ip_panic(("unable to send: %d", result));
+		sr_fd->srf_selops= 0;
+	}
+}
+
 PRIVATE int walk_queue(sr_fd, q_head, q_tail_ptr, type, proc_nr)
 sr_fd_t *sr_fd;
 mq_t *q_head, **q_tail_ptr;
@@ -22,6 +22,10 @@
  * |------------|----------|---------|----------|---------|---------|
  * | DL_GETSTAT	| port nr  | proc nr |          |         | address |
  * |------------|----------|---------|----------|---------|---------|
+ * | DL_READB	| port nr  | proc nr | count    |         | address |
+ * |------------|----------|---------|----------|---------|---------|
+ * | DL_WRITEB	| port nr  | proc nr | count    |         | address |
+ * |------------|----------|---------|----------|---------|---------|
  * | DL_STOP	| port_nr  |         |          |         |	    |
  * |------------|----------|---------|----------|---------|---------|
  *
@@ -32,6 +36,10 @@
  * |DL_TASK_REPL| port nr  | proc nr | rd-count | err|stat| clock   |
  * |------------|----------|---------|----------|---------|---------|
  *
+ * The batched requests DL_READB and DL_WRITEB are described in <minix/com.h>.
+ * For a DL_READB rd-count is the number of frames, the number of frames
+ * taken from a DL_WRITEB is in the stat field.
+ *
  *   m_type	  m3_i1     m3_i2       m3_ca1
  * |------------+---------+-----------+---------------|
  * |DL_INIT_REPL| port nr | last port | ethernet addr |
@@ -62,7 +70,7 @@ INIT_ASSERT
 #define debug		0
 #endif
 
-#define DE_PORT_NR	1	
+#define DE_PORT_NR	2
 
 static dpeth_t de_table[DE_PORT_NR];
 static int int_pending[NR_IRQ_VECTORS];
@@ -82,7 +90,8 @@ typedef struct dp_conf
 dp_conf_t dp_conf[]=	/* Card addresses */
 {
 	/* I/O port, IRQ,  Buffer address,  Env. var,   Buf selector. */
-	{  0x280,     3,    0xC0000,        "DPETH0",  DP_ETH0_SELECTOR }
+	{  0x280,     3,    0xC0000,        "DPETH0",  DP_ETH0_SELECTOR },
+	{  0x300,     5,    0xC4000,        "DPETH1",  DP_ETH1_SELECTOR }
 };
 
 /* Test if dp_conf has exactly DE_PORT_NR entries.  If not then you will see
@@ -93,7 +102,11 @@ extern int ___dummy[DE_PORT_NR == sizeof(dp_conf)/sizeof(dp_conf[0]) ? 1 : -1];
 
 _PROTOTYPE( static void do_vwrite, (message *mp, int from_int,
 							int vectored)	);
+_PROTOTYPE( static void do_bwrite, (message *mp, int from_int)	);
 _PROTOTYPE( static void do_vread, (message *mp, int vectored)		);
+_PROTOTYPE( static void do_bread, (message *mp)				);
+_PROTOTYPE( static void dp_queue_send, (dpeth_t *dep, int size)	);
+_PROTOTYPE( static void dp_batch_frame, (dpeth_t *dep)			);
 _PROTOTYPE( static void do_init, (message *mp)				);
 _PROTOTYPE( static void do_int, (dpeth_t *dep)				);
 _PROTOTYPE( static void do_getstat, (message *mp)			);
@@ -166,6 +179,8 @@ void dp8390_task()
 		case DL_WRITEV:	do_vwrite(&m, FALSE, TRUE);	break;
 		case DL_READ:	do_vread(&m, FALSE);		break;
 		case DL_READV:	do_vread(&m, TRUE);		break;
+		case DL_WRITEB:	do_bwrite(&m, FALSE);		break;
+		case DL_READB:	do_bread(&m);			break;
 		case DL_INIT:	do_init(&m);			break;
 		case DL_GETSTAT: do_getstat(&m);		break;
 		case DL_STOP:	do_stop(&m);			break;
@@ -327,10 +342,118 @@ int vectored;
 		dep->de_write_iovec.iod_iovec_addr = 0;
 		size= mp->DL_COUNT;
 	}
+	dp_queue_send(dep, size);
+
+	dep->de_flags |= DEF_PACK_SEND;
+
+	/* If the interrupt handler called, don't send a reply. The reply
+	 * will be sent after all interrupts are handled. 
+	 */
+	if (from_int)
+		return;
+	reply(dep, OK, FALSE);
+
+	assert(dep->de_mode == DEM_ENABLED);
+	assert(dep->de_flags & DEF_ENABLED);
+}
+
+
+/*===========================================================================*
+ *				do_bwrite				     *
+ *===========================================================================*/
+static void do_bwrite(mp, from_int)
+message *mp;
+int from_int;
+{
+/* Copy as many frames of a DL_WRITEB as there are free transmit buffers on
+ * the card.  If there are none, the request waits for a transmit interrupt.
+ */
+	int port, left, size;
+	vir_bytes addr;
+	iovec_t frame;
+	dpeth_t *dep;
+
+	port = mp->DL_PORT;
+	if (port < 0 || port >= DE_PORT_NR)
+		panic("dp8390: illegal port", port);
+	dep= &de_table[port];
+	dep->de_client= mp->DL_PROC;
+
+	if (dep->de_flags & DEF_SEND_AVAIL)
+		panic("dp8390: send already in progress", NO_NUM);
+
+	addr= (vir_bytes) mp->DL_ADDR;
+	dep->de_send_s= 0;
+	for (left= mp->DL_COUNT; left > 0; left -= 1 + frame.iov_size)
+	{
+		if (dep->de_mode != DEM_SINK &&
+			dep->de_sendq[dep->de_sendq_head].sq_filled)
+		{
+			break;
+		}
+		get_userdata(mp->DL_PROC, addr, (vir_bytes) sizeof(frame),
+			&frame);
+		addr += sizeof(frame);
+		if (frame.iov_size < 1 || frame.iov_size >= left)
+			panic("dp8390: bad DL_WRITEB frame", frame.iov_size);
+
+		dep->de_write_iovec.iod_iovec_s = frame.iov_size;
+		dep->de_write_iovec.iod_proc_nr = mp->DL_PROC;
+		dep->de_write_iovec.iod_iovec_addr = addr;
+		addr += frame.iov_size * sizeof(iovec_t);
+		dep->de_send_s++;
+		if (dep->de_mode == DEM_SINK)
+			continue;
+		assert(dep->de_mode == DEM_ENABLED);
+		assert(dep->de_flags & DEF_ENABLED);
+
+		get_userdata(mp->DL_PROC, dep->de_write_iovec.iod_iovec_addr,
+			(frame.iov_size > IOVEC_NR ? IOVEC_NR :
+			frame.iov_size) * sizeof(iovec_t),
+			dep->de_write_iovec.iod_iovec);
+		dep->de_tmp_iovec = dep->de_write_iovec;
+		size = calc_iovec_size(&dep->de_tmp_iovec);
+		dp_queue_send(dep, size);
+	}
+
+	if (!dep->de_send_s)
+	{
+		if (from_int)
+			panic("dp8390: should not be sending\n", NO_NUM);
+		dep->de_sendmsg= *mp;
+		dep->de_flags |= DEF_SEND_AVAIL;
+		reply(dep, OK, FALSE);
+		return;
+	}
+	dep->de_flags |= DEF_PACK_SEND;
+
+	/* From the interrupt handler, the reply is sent after all interrupts
+	 * are handled.
+	 */
+	if (from_int)
+		return;
+	reply(dep, OK, FALSE);
+}
+
+
+/*===========================================================================*
+ *				dp_queue_send				     *
+ *===========================================================================*/
+static void dp_queue_send(dep, size)
+dpeth_t *dep;
+int size;
+{
+/* Copy the frame in de_write_iovec to the next free transmit buffer, and
+ * start sending it if the card is idle.
+ */
+	int sendq_head;
+
 	if (size < ETH_MIN_PACK_SIZE || size > ETH_MAX_PACK_SIZE)
 	{
 		panic("dp8390: invalid packet size", size);
 	}
+	sendq_head= dep->de_sendq_head;
+	assert(!dep->de_sendq[sendq_head].sq_filled);
 	(dep->de_user2nicf)(dep, &dep->de_write_iovec, 0,
 		dep->de_sendq[sendq_head].sq_sendpage * DP_PAGESIZE,
 		size);
@@ -349,18 +472,6 @@ int vectored;
 		sendq_head= 0;
 	assert(sendq_head < SENDQ_NR);
 	dep->de_sendq_head= sendq_head;
-
-	dep->de_flags |= DEF_PACK_SEND;
-
-	/* If the interrupt handler called, don't send a reply. The reply
-	 * will be sent after all interrupts are handled. 
-	 */
-	if (from_int)
-		return;
-	reply(dep, OK, FALSE);
-
-	assert(dep->de_mode == DEM_ENABLED);
-	assert(dep->de_flags & DEF_ENABLED);
 }
 
 
@@ -433,6 +544,55 @@ int vectored;
 }
 
 
+/*===========================================================================*
+ *				do_bread				     *
+ *===========================================================================*/
+static void do_bread(mp)
+message *mp;
+{
+/* Fill the buffers of a DL_READB with the frames that have arrived.  If there
+ * are none, the request waits.  Frames that arrive while it waits are all
+ * delivered with a single reply when the interrupts are handled.
+ */
+	int port;
+	dpeth_t *dep;
+
+	port = mp->DL_PORT;
+	if (port < 0 || port >= DE_PORT_NR)
+		panic("dp8390: illegal port", port);
+	dep= &de_table[port];
+	dep->de_client= mp->DL_PROC;
+	if (dep->de_mode == DEM_SINK)
+	{
+		reply(dep, OK, FALSE);
+		return;
+	}
+	assert(dep->de_mode == DEM_ENABLED);
+	assert(dep->de_flags & DEF_ENABLED);
+
+	if(dep->de_flags & DEF_READING)
+		panic("dp8390: read already in progress", NO_NUM);
+
+	dep->de_read_iovec.iod_proc_nr = mp->DL_PROC;
+	dep->de_batch_addr= (vir_bytes) mp->DL_ADDR;
+	dep->de_batch_left= mp->DL_COUNT;
+	dep->de_read_s= 0;
+	dep->de_flags |= DEF_READING | DEF_READ_BATCH;
+
+	dp_recv(dep);
+
+	if ((dep->de_flags & (DEF_READING|DEF_STOPPED)) ==
+		(DEF_READING|DEF_STOPPED))
+	{
+		/* The chip is stopped, and all arrived packets are 
+		 * delivered.
+		 */
+		dp_reset(dep);
+	}
+	reply(dep, OK, FALSE);
+}
+
+
 /*===========================================================================*
  *				do_init					     *
  *===========================================================================*/
@@ -975,7 +1135,7 @@ dpeth_t *dep;
 
 		pageno = next;
 	}
-	while (!packet_processed);
+	while (!packet_processed || (dep->de_flags & DEF_READING));
 }
 
 
@@ -993,6 +1153,7 @@ dpeth_t *dep;
 	{
 	case DL_WRITE:	do_vwrite(&dep->de_sendmsg, TRUE, FALSE);	break;
 	case DL_WRITEV:	do_vwrite(&dep->de_sendmsg, TRUE, TRUE);	break;
+	case DL_WRITEB:	do_bwrite(&dep->de_sendmsg, TRUE);		break;
 	default:
 		panic("dp8390: wrong type:", dep->de_sendmsg.m_type);
 		break;
@@ -1085,10 +1246,17 @@ static int dp_pkt2user(dep, page, length)
 dpeth_t *dep;
 int page, length;
 {
-	int last, count;
+	int last, count, nfrag;
+	iovec_t frame;
 
 	if (!(dep->de_flags & DEF_READING))
 		return EGENERIC;
+	nfrag= 0;
+	if (dep->de_flags & DEF_READ_BATCH)
+	{
+		dp_batch_frame(dep);
+		nfrag= dep->de_read_iovec.iod_iovec_s;
+	}
 
 	last = page + (length - 1) / DP_PAGESIZE;
 	if (last >= dep->de_stoppage)
@@ -1109,14 +1277,56 @@ int page, length;
 			sizeof(dp_rcvhdr_t), &dep->de_read_iovec, 0, length);
 	}
 
-	dep->de_read_s = length;
 	dep->de_flags |= DEF_PACK_RECV;
+	if (dep->de_flags & DEF_READ_BATCH)
+	{
+		/* Tell the length, and go on with the next buffer. */
+		frame.iov_addr= length;
+		frame.iov_size= nfrag;
+		put_userdata(dep->de_read_iovec.iod_proc_nr,
+			dep->de_batch_addr, (vir_bytes) sizeof(frame), &frame);
+		dep->de_batch_addr += (1 + nfrag) * sizeof(iovec_t);
+		dep->de_batch_left -= 1 + nfrag;
+		dep->de_read_s++;
+		if (dep->de_batch_left <= 0)
+			dep->de_flags &= ~(DEF_READING | DEF_READ_BATCH);
+		return OK;
+	}
+	dep->de_read_s = length;
 	dep->de_flags &= ~DEF_READING;
 
 	return OK;
 }
 
 
+/*===========================================================================*
+ *				dp_batch_frame				     *
+ *===========================================================================*/
+static void dp_batch_frame(dep)
+dpeth_t *dep;
+{
+/* Set up de_read_iovec for the next buffer of a DL_READB. */
+	iovec_t frame;
+	int proc;
+	vir_bytes addr;
+
+	proc= dep->de_read_iovec.iod_proc_nr;
+	addr= dep->de_batch_addr;
+	get_userdata(proc, addr, (vir_bytes) sizeof(frame), &frame);
+	if (frame.iov_size < 1 || frame.iov_size >= dep->de_batch_left)
+		panic("dp8390: bad DL_READB frame", frame.iov_size);
+
+	dep->de_read_iovec.iod_iovec_s = frame.iov_size;
+	dep->de_read_iovec.iod_iovec_addr = addr + sizeof(frame);
+	get_userdata(proc, dep->de_read_iovec.iod_iovec_addr,
+		(frame.iov_size > IOVEC_NR ? IOVEC_NR : frame.iov_size) *
+		sizeof(iovec_t), dep->de_read_iovec.iod_iovec);
+	dep->de_tmp_iovec = dep->de_read_iovec;
+	if (calc_iovec_size(&dep->de_tmp_iovec) < ETH_MAX_PACK_SIZE)
+		panic("dp8390: wrong packet size", NO_NUM);
+}
+
+
 /*===========================================================================*
  *				dp_user2nic				     *
  *===========================================================================*/
@@ -1609,8 +1819,11 @@ dp_conf_t *dcp;
 	long v;
 	static char dpc_fmt[] = "x:d:x";
 
-	/* Get the default settings and modify them from the environment. */
-	dep->de_mode= DEM_SINK;
+	/* Get the default settings and modify them from the environment.
+	 * Only the first port is a sink if it isn't configured, the others
+	 * are off.
+	 */
+	dep->de_mode= (dep == &de_table[0]) ? DEM_SINK : DEM_DISABLED;
 	v= dcp->dpc_port;
 	switch (env_parse(dcp->dpc_envvar, dpc_fmt, 0, &v, 0x000L, 0x3FFL)) {
 	case EP_OFF:
@@ -1673,14 +1886,19 @@ int err;
 int may_block;
 {
 	message reply;
-	int status;
+	long status;
 	int r;
 
 	status = 0;
 	if (dep->de_flags & DEF_PACK_SEND)
 		status |= DL_PACK_SEND;
 	if (dep->de_flags & DEF_PACK_RECV)
+	{
+		/* This completes a DL_READB too. */
 		status |= DL_PACK_RECV;
+		dep->de_flags &= ~(DEF_READING | DEF_READ_BATCH);
+	}
+	status |= (long) dep->de_send_s << DL_SENT_SHIFT;
 
 	reply.m_type = DL_TASK_REPLY;
 	reply.DL_PORT = dep - de_table;
@@ -1698,6 +1916,7 @@ int may_block;
 		panic("dp8390: send failed:", r);
 	
 	dep->de_read_s = 0;
+	dep->de_send_s = 0;
 	dep->de_flags &= ~(DEF_PACK_SEND | DEF_PACK_RECV);
 }
 
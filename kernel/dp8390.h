@@ -196,7 +196,7 @@ typedef struct iovec_dat
   vir_bytes iod_iovec_addr;
 } iovec_dat_t;
 
-#define SENDQ_NR	2	/* Maximum size of the send queue */
+#define SENDQ_NR	4	/* Maximum size of the send queue */
 #define SENDQ_PAGES	6	/* 6 * DP_PAGESIZE >= 1514 bytes */
 
 typedef struct dpeth
@@ -252,6 +252,9 @@ typedef struct dpeth
 	iovec_dat_t de_write_iovec;
 	iovec_dat_t de_tmp_iovec;
 	vir_bytes de_read_s;
+	vir_bytes de_batch_addr;	/* next frame entry of a DL_READB */
+	int de_batch_left;		/* entries left in the DL_READB */
+	int de_send_s;			/* frames taken from a DL_WRITEB */
 	int de_client;
 	message de_sendmsg;
 	dp_user2nicf_t de_user2nicf; 
@@ -271,6 +274,7 @@ typedef struct dpeth
 #define DEF_BROAD	0x100
 #define DEF_ENABLED	0x200
 #define DEF_STOPPED	0x400
+#define DEF_READ_BATCH	0x800
 
 #define DEM_DISABLED	0x0
 #define DEM_SINK	0x1
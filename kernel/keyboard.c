@@ -432,6 +432,9 @@ int scode;			/* scan code for a function key */
 
 #if ENABLE_NETWORKING
   case F5:	dp_dump(); break;		/* network statistics */
+#endif
+#if ENABLE_PCI_ETH
+  case F6:	rtl_dump(); break;		/* RTL8139 statistics */
 #endif
   case F10:	toggle_beeping(); break; /* Toggle the ability to beep on 007 */
 /* Keep compatible with MINIX */
@@ -481,6 +484,9 @@ int how;		/* 0 = halt, 1 = reboot, 2 = panic!, ... */
   cons_stop();
 #if ENABLE_NETWORKING
   dp8390_stop();
+#endif
+#if ENABLE_PCI_ETH
+  rtl8139_stop();
 #endif
   floppy_stop();
   clock_stop();
@@ -21,8 +21,10 @@
 .define	___main		! dummy for GCC
 .define	_in_byte	! read a byte from a port and return it
 .define	_in_word	! read a word from a port and return it
+.define	_in_long	! read a longword from a port and return it
 .define	_out_byte	! write a byte to a port
 .define	_out_word	! write a word to a port
+.define	_out_long	! write a longword to a port
 .define	_port_read	! transfer data from (disk controller) port to memory
 .define	_port_read_byte	! likewise byte by byte
 .define	_port_write	! transfer data from memory to (disk controller) port
@@ -311,6 +313,19 @@ _in_word:
 	ret
 
 
+!*===========================================================================*
+!*				in_long					     *
+!*===========================================================================*
+! PUBLIC u32_t in_long(port_t port);
+! Read a longword from the i/o port  port  and return it.
+
+	.align	16
+_in_long:
+	mov	edx, 4(esp)		! port
+	in	dx			! read 1 longword
+	ret
+
+
 !*===========================================================================*
 !*				out_byte				     *
 !*===========================================================================*
@@ -339,6 +354,20 @@ _out_word:
 	ret
 
 
+!*===========================================================================*
+!*				out_long				     *
+!*===========================================================================*
+! PUBLIC void out_long(port_t port, u32_t value);
+! Write  value  to the I/O port  port.
+
+	.align	16
+_out_long:
+	mov	edx, 4(esp)		! port
+	mov	eax, 4+4(esp)		! value
+	out	dx			! output 1 longword
+	ret
+
+
 !*===========================================================================*
 !*				port_read				     *
 !*===========================================================================*
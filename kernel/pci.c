@@ -0,0 +1,147 @@
+/* This file contains the routines that read and write the configuration
+ * space of PCI devices, using configuration mechanism #1.  The entry points
+ * into this file are:
+ *   pci_find_dev:	find a device by vendor and device id
+ *   pci_attr_r8:	read an 8 bit register of a device
+ *   pci_attr_r16:	read a 16 bit register
+ *   pci_attr_r32:	read a 32 bit register
+ *   pci_attr_w16:	write a 16 bit register
+ */
+
+#include "kernel.h"
+#include "pci.h"
+
+#if ENABLE_PCI
+
+#define PCI_CONF_ADDR	0xCF8	/* configuration address port */
+#define PCI_CONF_DATA	0xCFC	/* configuration data port */
+#define PCI_CONF_EN	0x80000000L	/* enable a configuration cycle */
+
+#define PCI_BUS_NR	256
+#define PCI_DEV_NR	32
+#define PCI_FUNC_NR	8
+
+FORWARD _PROTOTYPE( int pci_present, (void)				);
+FORWARD _PROTOTYPE( void pci_select, (int devind, int reg)		);
+
+
+/*===========================================================================*
+ *				pci_present				     *
+ *===========================================================================*/
+PRIVATE int pci_present()
+{
+/* Check once if the configuration address register is there. */
+
+  static int present = -1;
+  u32_t saved;
+
+  if (present == -1) {
+	saved = in_long(PCI_CONF_ADDR);
+	out_long(PCI_CONF_ADDR, PCI_CONF_EN);
+	present = (in_long(PCI_CONF_ADDR) == PCI_CONF_EN);
+	out_long(PCI_CONF_ADDR, saved);
+  }
+  return(present);
+}
+
+
+/*===========================================================================*
+ *				pci_select				     *
+ *===========================================================================*/
+PRIVATE void pci_select(devind, reg)
+int devind;			/* bus, device and function */
+int reg;			/* register in the configuration space */
+{
+  out_long(PCI_CONF_ADDR, PCI_CONF_EN | ((u32_t) devind << 8) | (reg & 0xFC));
+}
+
+
+/*===========================================================================*
+ *				pci_find_dev				     *
+ *===========================================================================*/
+PUBLIC int pci_find_dev(vid, did, nr, devindp)
+u16_t vid;			/* vendor id */
+u16_t did;			/* device id */
+int nr;				/* find the nr-th such device, from 0 */
+int *devindp;			/* the device found */
+{
+/* Scan the buses for a device.  Return TRUE if found. */
+
+  int bus, dev, func, devind;
+  u32_t id;
+
+  if (!pci_present()) return(FALSE);
+
+  for (bus = 0; bus < PCI_BUS_NR; bus++) {
+	for (dev = 0; dev < PCI_DEV_NR; dev++) {
+		for (func = 0; func < PCI_FUNC_NR; func++) {
+			devind = (bus << 8) | (dev << 3) | func;
+			id = pci_attr_r32(devind, PCI_VID);
+			if ((id & 0xFFFF) == 0xFFFF) {
+				if (func == 0) break;	/* no device */
+				continue;
+			}
+			if ((id & 0xFFFF) == vid && (id >> 16) == did
+							&& nr-- == 0) {
+				*devindp = devind;
+				return(TRUE);
+			}
+			if (func == 0 && !(pci_attr_r8(devind, PCI_HEADT)
+							& PCI_HEADT_MULTI))
+				break;
+		}
+	}
+  }
+  return(FALSE);
+}
+
+
+/*===========================================================================*
+ *				pci_attr_r8				     *
+ *===========================================================================*/
+PUBLIC unsigned pci_attr_r8(devind, reg)
+int devind;
+int reg;
+{
+  pci_select(devind, reg);
+  return(in_byte(PCI_CONF_DATA + (reg & 3)));
+}
+
+
+/*===========================================================================*
+ *				pci_attr_r16				     *
+ *===========================================================================*/
+PUBLIC unsigned pci_attr_r16(devind, reg)
+int devind;
+int reg;
+{
+  pci_select(devind, reg);
+  return(in_word(PCI_CONF_DATA + (reg & 2)));
+}
+
+
+/*===========================================================================*
+ *				pci_attr_r32				     *
+ *===========================================================================*/
+PUBLIC u32_t pci_attr_r32(devind, reg)
+int devind;
+int reg;
+{
+  pci_select(devind, reg);
+  return(in_long(PCI_CONF_DATA));
+}
+
+
+/*===========================================================================*
+ *				pci_attr_w16				     *
+ *===========================================================================*/
+PUBLIC void pci_attr_w16(devind, reg, value)
+int devind;
+int reg;
+unsigned value;
+{
+  pci_select(devind, reg);
+  out_word(PCI_CONF_DATA + (reg & 2), value);
+}
+
+#endif /* ENABLE_PCI */
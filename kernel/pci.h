@@ -0,0 +1,24 @@
+/*
+pci.h
+
+Registers in the configuration space of a PCI device.
+*/
+
+#define PCI_VID		0x00	/* Vendor ID, 16 bit               */
+#define PCI_DID		0x02	/* Device ID, 16 bit               */
+#define PCI_CR		0x04	/* Command Register, 16 bit        */
+#define		PCI_CR_MAST_EN	0x0004	/* Enable Bus Master       */
+#define		PCI_CR_MEM_EN	0x0002	/* Enable Memory Cycles    */
+#define		PCI_CR_IO_EN	0x0001	/* Enable I/O Cycles       */
+#define PCI_HEADT	0x0E	/* Header Type, 8 bit              */
+#define		PCI_HEADT_MULTI	0x80	/* Multiple functions      */
+#define PCI_BAR		0x10	/* Base Address Register 0, 32 bit */
+#define		PCI_BAR_IO	0x00000001L	/* I/O space       */
+#define PCI_ILR		0x3C	/* Interrupt Line Register, 8 bit  */
+
+/* A device is known by a number made of its bus, device and function
+ * number, as used in a configuration address.
+ */
+#define PCI_BUS(d)	(((d) >> 8) & 0xFF)
+#define PCI_DEV(d)	(((d) >> 3) & 0x1F)
+#define PCI_FUNC(d)	((d) & 0x07)
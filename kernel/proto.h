@@ -144,6 +144,7 @@ _PROTOTYPE( void cp_mess, (int src,phys_clicks src_clicks,vir_bytes src_offset,
 		phys_clicks dst_clicks, vir_bytes dst_offset)		);
 _PROTOTYPE( int in_byte, (port_t port)					);
 _PROTOTYPE( int in_word, (port_t port)					);
+_PROTOTYPE( u32_t in_long, (port_t port)				);
 _PROTOTYPE( void lock, (void)						);
 _PROTOTYPE( void unlock, (void)						);
 _PROTOTYPE( void enable_irq, (unsigned irq)				);
@@ -151,6 +152,7 @@ _PROTOTYPE( int disable_irq, (unsigned irq)				);
 _PROTOTYPE( u16_t mem_rdw, (segm_t segm, vir_bytes offset)		);
 _PROTOTYPE( void out_byte, (port_t port, int value)			);
 _PROTOTYPE( void out_word, (port_t port, int value)			);
+_PROTOTYPE( void out_long, (port_t port, u32_t value)			);
 _PROTOTYPE( void phys_copy, (phys_bytes source, phys_bytes dest,
 		phys_bytes count)					);
 _PROTOTYPE( void port_read, (unsigned port, phys_bytes destination,
@@ -234,9 +236,23 @@ _PROTOTYPE( void init_dataseg, (struct segdesc_s *segdp, phys_bytes base,
 _PROTOTYPE( phys_bytes seg2phys, (U16_t seg)				);
 _PROTOTYPE( void enable_iop, (struct proc *pp)				);
 
+/* pci.c */
+_PROTOTYPE( int pci_find_dev, (U16_t vid, U16_t did, int nr,
+		int *devindp)						);
+_PROTOTYPE( unsigned pci_attr_r8, (int devind, int reg)		);
+_PROTOTYPE( unsigned pci_attr_r16, (int devind, int reg)		);
+_PROTOTYPE( u32_t pci_attr_r32, (int devind, int reg)			);
+_PROTOTYPE( void pci_attr_w16, (int devind, int reg, unsigned value)	);
+
 /* pty.c */
 _PROTOTYPE( void do_pty, (struct tty *tp, message *m_ptr)		);
 _PROTOTYPE( void pty_init, (struct tty *tp)				);
+_PROTOTYPE( void pty_select_retry, (struct tty *tp)			);
+
+/* rtl8139.c */
+_PROTOTYPE( void rtl8139_task, (void)					);
+_PROTOTYPE( void rtl_dump, (void)					);
+_PROTOTYPE( void rtl8139_stop, (void)					);
 
 /* system.c */
 _PROTOTYPE( void alloc_segments, (struct proc *rp)			);
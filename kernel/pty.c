@@ -47,6 +47,11 @@ typedef struct pty {
   int		wrleft;		/* # bytes yet to be written */
   int		wrcum;		/* # bytes written so far */
 
+  /* Select call on /dev/ptypX. */
+  char		selops;		/* operations FS waits for (SEL_RD...) */
+  char		selcaller;	/* process to tell (usually FS) */
+  int		selminor;	/* minor device of the pty */
+
   /* Output buffer. */
   int		ocount;		/* # characters in the buffer */
   char		*ohead, *otail;	/* head and tail of the circular buffer */
@@ -68,6 +73,7 @@ FORWARD _PROTOTYPE( void pty_read, (tty_t *tp)				);
 FORWARD _PROTOTYPE( void pty_close, (tty_t *tp)				);
 FORWARD _PROTOTYPE( void pty_icancel, (tty_t *tp)			);
 FORWARD _PROTOTYPE( void pty_ocancel, (tty_t *tp)			);
+FORWARD _PROTOTYPE( int pty_select_try, (pty_t *pp, int ops)		);
 
 
 /*==========================================================================*
@@ -160,6 +166,16 @@ message *m_ptr;
 	r = ENOTTY;
 	break;
 
+    case DEV_SELECT:
+	/* Tell which operations are ready, remember the rest if asked to. */
+	r = pty_select_try(pp, m_ptr->COUNT & (SEL_RD | SEL_WR | SEL_ERR));
+	if (r == 0 && (m_ptr->COUNT & SEL_NOTIFY)) {
+		pp->selops |= m_ptr->COUNT & (SEL_RD | SEL_WR | SEL_ERR);
+		pp->selcaller = m_ptr->m_source;
+		pp->selminor = m_ptr->TTY_LINE;
+	}
+	break;
+
     case DEV_OPEN:
 	r = pp->state != 0 ? EIO : OK;
 	pp->state |= PTY_ACTIVE;
@@ -391,6 +407,9 @@ tty_t *tp;
   }
 
   if (pp->state & PTY_CLOSED) pp->state = 0; else pp->state |= TTY_CLOSED;
+
+  /* A pty reader or writer selecting now finds end of file or EIO. */
+  pty_select_retry(tp);
 }
 
 
@@ -425,6 +444,49 @@ tty_t *tp;
 }
 
 
+/*==========================================================================*
+ *				pty_select_try				    *
+ *==========================================================================*/
+PRIVATE int pty_select_try(pp, ops)
+pty_t *pp;
+int ops;
+{
+/* Check which of the operations 'ops' on the pty side would not block. */
+  tty_t *tp = pp->tty;
+  int ready = 0;
+
+  if (ops & SEL_RD) {
+	if (pp->ocount > 0 || pp->rdleft > 0 || (pp->state & TTY_CLOSED))
+		ready |= SEL_RD;
+  }
+  if (ops & SEL_WR) {
+	if (pp->wrleft > 0 || (pp->state & TTY_CLOSED)
+		|| tp->tty_incount < buflen(tp->tty_inbuf)
+		|| (tp->tty_termios.c_lflag & ICANON)) ready |= SEL_WR;
+  }
+  return(ready);
+}
+
+
+/*==========================================================================*
+ *				pty_select_retry			    *
+ *==========================================================================*/
+PUBLIC void pty_select_retry(tp)
+tty_t *tp;
+{
+/* Send DEV_READY to FS if an operation it is selecting on is now possible. */
+  pty_t *pp = tp->tty_priv;
+  int ready;
+
+  if (pp->selops == 0) return;
+
+  if ((ready = pty_select_try(pp, pp->selops)) != 0) {
+	tty_reply(DEV_READY, pp->selcaller, pp->selminor, ready);
+	pp->selops = 0;
+  }
+}
+
+
 /*==========================================================================*
  *				pty_init				    *
  *==========================================================================*/
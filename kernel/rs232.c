@@ -1,5 +1,5 @@
 /*==========================================================================*
- *		rs232.c - serial driver for 8250 and 16450 UARTs	    *
+ *		rs232.c - serial driver for 8250, 16450 and 16550A UARTs    *
  *		Added support for Atari ST M68901 and YM-2149	--kub	    *
  *==========================================================================*/
 
@@ -40,6 +40,23 @@
 #define IS_TRANSMITTER_READY    2
 #define IS_RECEIVER_READY       4
 #define IS_LINE_STATUS_CHANGE   6
+#define IS_CHAR_TIMEOUT      0x0C	/* 16550: bytes waiting below trigger */
+#define IS_MASK              0x0F	/* the upper bits tell if FIFOs are on */
+#define IS_FIFOS_ENABLED     0xC0	/* both set on a 16550A with FIFOs on */
+
+/* FIFO control bits (16550), written to the interrupt id port. */
+#define FC_ENABLE            0x01
+#define FC_RX_RESET          0x02
+#define FC_TX_RESET          0x04
+#define FC_TRIGGER_1         0x00	/* receive interrupt after 1 byte */
+#define FC_TRIGGER_4         0x40
+#define FC_TRIGGER_8         0x80
+#define FC_TRIGGER_14        0xC0
+#define UART_FIFO_SIZE         16	/* bytes in each FIFO of a 16550A */
+
+/* FIFO control bits for a receive trigger level of about n bytes. */
+#define fifo_trigger(n)	((n) >= 14 ? FC_TRIGGER_14 : (n) >= 8 ? FC_TRIGGER_8 \
+			: (n) >= 4 ? FC_TRIGGER_4 : FC_TRIGGER_1)
 
 /* Line control bits. */
 #define LC_2STOP_BITS        0x04
@@ -49,6 +66,7 @@
 #define LC_ADDRESS_DIVISOR   0x80
 
 /* Line status bits. */
+#define LS_DATA_READY           1
 #define LS_OVERRUN_ERR          2
 #define LS_PARITY_ERR           4
 #define LS_FRAMING_ERR          8
@@ -87,8 +105,8 @@
 #define DATA_BITS_SHIFT         8	/* amount data bits shifted in mode */
 #define DEF_BAUD             1200	/* default baud rate */
 
-#define RS_IBUFSIZE          1024	/* RS232 input buffer size */
-#define RS_OBUFSIZE          1024	/* RS232 output buffer size */
+#define RS_IBUFSIZE    RS_BUFSIZE	/* RS232 input buffer size */
+#define RS_OBUFSIZE    RS_BUFSIZE	/* RS232 output buffer size */
 
 /* Input buffer watermarks.
  * The external device is asked to stop sending when the buffer
@@ -131,6 +149,9 @@
 /* Macro to tell if transmitter is ready. */
 #define txready(rs) (in_byte(rs->line_status_port) & LS_TRANSMITTER_READY)
 
+/* Macro to tell if there is more received data, the FIFO may hold more. */
+#define rxready(rs) (in_byte(rs->line_status_port) & LS_DATA_READY)
+
 /* Macro to tell if carrier has dropped.
  * The RS232 Carrier Detect (CD) line is usually connected to the 8250
  * Received Line Signal Detect pin, reflected by bit MS_RLSD in the Modem
@@ -169,6 +190,9 @@
 /* Transmitter ready test */
 #define txready(rs)          (MFP->mf_tsr & (T_EMPTY | T_UE))
 
+/* The USART has no receive FIFO, one byte per interrupt. */
+#define rxready(rs)          FALSE
+
 #endif /* MACHINE == ATARI */
 
 /* Types. */
@@ -216,6 +240,8 @@ typedef struct rs232 {
   port_t modem_ctl_port;
   port_t line_status_port;
   port_t modem_status_port;
+  int ofifo;			/* # bytes the transmitter takes at once */
+  bool_t fifo;			/* nonzero if 16550A FIFOs are enabled */
 #endif
 
   unsigned char lstatus;	/* last line status */
@@ -448,6 +474,14 @@ rs232_t *rs;			/* which line */
   /* Change the line controls and reselect the usual registers. */
   out_byte(rs->line_ctl_port, line_controls);
 
+  /* Fast lines let the receive FIFO fill up a bit before interrupting, slow
+   * lines interrupt for every byte.
+   */
+  if (rs->fifo) {
+	out_byte(rs->int_id_port, FC_ENABLE | (divisor <= UART_FREQ / 19200
+		? fifo_trigger(RS_FIFO_TRIGGER) : FC_TRIGGER_1));
+  }
+
   rs->ostate |= ORAW;
   if ((tp->tty_termios.c_lflag & IXON) && rs->oxoff != _POSIX_VDISABLE)
 	rs->ostate &= ~ORAW;
@@ -514,6 +548,19 @@ tty_t *tp;			/* which TTY */
   rs->modem_ctl_port = this_8250 + 4;
   rs->line_status_port = this_8250 + 5;
   rs->modem_status_port = this_8250 + 6;
+
+  /* Try to turn on the FIFOs.  Only a 16550A reports both FIFO bits in the
+   * interrupt id register, the FIFOs of the original 16550 are broken.
+   */
+  out_byte(rs->int_id_port, FC_ENABLE | FC_RX_RESET | FC_TX_RESET);
+  if ((in_byte(rs->int_id_port) & IS_FIFOS_ENABLED) == IS_FIFOS_ENABLED) {
+	rs->fifo = TRUE;
+	rs->ofifo = UART_FIFO_SIZE;
+  } else {
+	out_byte(rs->int_id_port, 0);
+	rs->fifo = FALSE;
+	rs->ofifo = 1;
+  }
 #endif
 
   /* Set up the hardware to a base state, in particular
@@ -714,8 +761,9 @@ int irq;
 	 * (and then we have to worry about being stuck in the loop too long).
 	 * Unfortunately, some serial cards lock up without this.
 	 */
-	switch (in_byte(rs->int_id_port)) {
+	switch (in_byte(rs->int_id_port) & IS_MASK) {
 	case IS_RECEIVER_READY:
+	case IS_CHAR_TIMEOUT:
 		in_int(rs);
 		continue;
 	case IS_TRANSMITTER_READY:
@@ -746,8 +794,9 @@ int irq;
   register rs232_t *rs = &rs_lines[1];
 
   while (TRUE) {
-	switch (in_byte(rs->int_id_port)) {
+	switch (in_byte(rs->int_id_port) & IS_MASK) {
 	case IS_RECEIVER_READY:
+	case IS_CHAR_TIMEOUT:
 		in_int(rs);
 		continue;
 	case IS_TRANSMITTER_READY:
@@ -813,7 +862,7 @@ int    type;	       /* interrupt type */
 PRIVATE void in_int(rs)
 register rs232_t *rs;		/* line with input interrupt */
 {
-/* Read the data which just arrived.
+/* Read the data which just arrived, all of it if the FIFO holds more.
  * If it is the oxoff char, clear OSWREADY, else if OSWREADY was clear, set
  * it and restart output (any char does this, not just xon).
  * Put data in the buffer if room, otherwise discard it.
@@ -822,31 +871,33 @@ register rs232_t *rs;		/* line with input interrupt */
 
   int c;
 
+  do {
 #if (MACHINE == IBM_PC)
-  c = in_byte(rs->recv_port);
+	c = in_byte(rs->recv_port);
 #else /* MACHINE == ATARI */
-  c = MFP->mf_udr;
+	c = MFP->mf_udr;
 #endif
 
-  if (!(rs->ostate & ORAW)) {
-	if (c == rs->oxoff) {
-		rs->ostate &= ~OSWREADY;
-	} else
-	if (!(rs->ostate & OSWREADY)) {
-		rs->ostate |= OSWREADY;
-		if (txready(rs)) out_int(rs);
+	if (!(rs->ostate & ORAW)) {
+		if (c == rs->oxoff) {
+			rs->ostate &= ~OSWREADY;
+		} else
+		if (!(rs->ostate & OSWREADY)) {
+			rs->ostate |= OSWREADY;
+			if (txready(rs)) out_int(rs);
+		}
 	}
-  }
 
-  if (rs->icount == buflen(rs->ibuf)) return;	/* input buffer full, discard */
+	if (rs->icount == buflen(rs->ibuf)) continue;	/* full, discard */
 
-  if (++rs->icount == RS_IHIGHWATER && rs->idevready) istop(rs);
-  *rs->ihead = c;
-  if (++rs->ihead == bufend(rs->ibuf)) rs->ihead = rs->ibuf;
-  if (rs->icount == 1) {
-	rs->tty->tty_events = 1;
-	force_timeout();
-  }
+	if (++rs->icount == RS_IHIGHWATER && rs->idevready) istop(rs);
+	*rs->ihead = c;
+	if (++rs->ihead == bufend(rs->ibuf)) rs->ihead = rs->ibuf;
+	if (rs->icount == 1) {
+		rs->tty->tty_events = 1;
+		force_timeout();
+	}
+  } while (rxready(rs));
 }
 
 
@@ -910,24 +961,38 @@ PRIVATE void out_int(rs)
 register rs232_t *rs;		/* line with output interrupt */
 {
 /* If there is output to do and everything is ready, do it (local device is
- * known ready).
+ * known ready).  A 16550A takes a FIFO full at once.
  * Notify TTY when the buffer goes empty.
  */
 
+  int ocount;
+#if (MACHINE == IBM_PC)
+  int n;
+#endif
+
   if (rs->ostate >= (ODEVREADY | OQUEUED | OSWREADY)) {
 	/* Bit test allows ORAW and requires the others. */
+	ocount = rs->ocount;
 #if (MACHINE == IBM_PC)
-	out_byte(rs->xmit_port, *rs->otail);
+	n = rs->ofifo;
+	if (n > ocount) n = ocount;
+	rs->ocount -= n;
+	do {
+		out_byte(rs->xmit_port, *rs->otail);
+		if (++rs->otail == bufend(rs->obuf)) rs->otail = rs->obuf;
+	} while (--n > 0);
 #else /* MACHINE == ATARI */
 	MFP->mf_udr = *rs->otail;
-#endif
 	if (++rs->otail == bufend(rs->obuf)) rs->otail = rs->obuf;
-	if (--rs->ocount == 0) {
+	rs->ocount--;
+#endif
+	if (rs->ocount == 0) {
 		rs->ostate ^= (ODONE | OQUEUED);  /* ODONE on, OQUEUED off */
 		rs->tty->tty_events = 1;
 		force_timeout();
 	} else
-	if (rs->ocount == RS_OLOWWATER) {	/* running low? */
+	if (ocount > RS_OLOWWATER && rs->ocount <= RS_OLOWWATER) {
+		/* Running low. */
 		rs->tty->tty_events = 1;
 		force_timeout();
 	}
@@ -0,0 +1,1321 @@
+/*
+ * rtl8139.c
+ *
+ * This file contains an ethernet device driver for Realtek RTL8139 based
+ * PCI ethernet cards.  The card moves the frames itself: it writes arriving
+ * frames into a ring in memory, and fetches the frames to send from four
+ * transmit buffers.  The driver copies frames between these buffers and
+ * its clients with phys_copy, no data passes through I/O ports.
+ *
+ * The driver is a separate task, RTL8139, that takes the same messages as
+ * the dp8390 task (see dp8390.c).  Ports that have no card are refused with
+ * ENXIO, so the network server can fall back on the dp8390 task.  The card
+ * used for port n is the n-th RTL8139 on the PCI bus, or the one given by
+ * the RTLETHn boot variable; RTLETHn=off disables port n.
+ */
+
+#include "kernel.h"
+#include <stdlib.h>
+#include <minix/com.h>
+#include <net/hton.h>
+#include <net/gen/ether.h>
+#include <net/gen/eth_io.h>
+#include "assert.h"
+INIT_ASSERT
+#include "pci.h"
+#include "rtl8139.h"
+#include "proc.h"
+
+#if ENABLE_PCI_ETH
+
+static re_t re_table[RE_PORT_NR];
+static int int_pending[NR_IRQ_VECTORS];
+static int rl_tasknr= ANY;
+
+/* The receive rings and transmit buffers. */
+static char rl_buffers[RE_PORT_NR][RL_BUF_SIZE];
+
+/* PCI ids of the RTL8139 and cards that are the same to the driver. */
+static struct rl_pcitab
+{
+	u16_t vid;
+	u16_t did;
+} rl_pcitab[]=
+{
+	{ RL_VENDOR,	RL_DEVICE },	/* Realtek RTL8139 */
+	{ 0x1113,	0x1211 },	/* Accton EN1207D */
+	{ 0x1186,	0x1300 },	/* D-Link DFE-538TX */
+};
+
+static char *rl_envvar[RE_PORT_NR]= { "RTLETH0", "RTLETH1" };
+
+
+_PROTOTYPE( static void do_vwrite, (message *mp, int from_int,
+							int vectored)	);
+_PROTOTYPE( static void do_bwrite, (message *mp, int from_int)	);
+_PROTOTYPE( static void do_vread, (message *mp, int vectored)		);
+_PROTOTYPE( static void do_bread, (message *mp)				);
+_PROTOTYPE( static void rl_queue_send, (re_t *rep, int size)		);
+_PROTOTYPE( static void rl_batch_frame, (re_t *rep)			);
+_PROTOTYPE( static void do_init, (message *mp)				);
+_PROTOTYPE( static void do_int, (re_t *rep)				);
+_PROTOTYPE( static void do_getstat, (message *mp)			);
+_PROTOTYPE( static void do_stop, (message *mp)				);
+_PROTOTYPE( static void rl_init, (re_t *rep)				);
+_PROTOTYPE( static void rl_confaddr, (re_t *rep)			);
+_PROTOTYPE( static void rl_rec_mode, (re_t *rep)			);
+_PROTOTYPE( static void rl_reset, (re_t *rep)				);
+_PROTOTYPE( static void rl_check_ints, (re_t *rep)			);
+_PROTOTYPE( static void rl_tx_done, (re_t *rep)				);
+_PROTOTYPE( static void rl_recv, (re_t *rep)				);
+_PROTOTYPE( static void rl_rx_reset, (re_t *rep)			);
+_PROTOTYPE( static void rl_send, (re_t *rep)				);
+_PROTOTYPE( static void rl_pkt2user, (re_t *rep, phys_bytes phys,
+							int length)	);
+_PROTOTYPE( static void rl_user2buf, (iovec_dat_t *iovp,
+				phys_bytes phys_buf, vir_bytes count)	);
+_PROTOTYPE( static void rl_buf2user, (phys_bytes phys_buf,
+				iovec_dat_t *iovp, vir_bytes count)	);
+_PROTOTYPE( static void rl_next_iovec, (iovec_dat_t *iovp)		);
+_PROTOTYPE( static int rl_handler, (int irq)				);
+_PROTOTYPE( static void conf_hw, (re_t *rep)				);
+_PROTOTYPE( static int rl_probe, (re_t *rep, int nr)			);
+_PROTOTYPE( static int calc_iovec_size, (iovec_dat_t *iovp)		);
+_PROTOTYPE( static void reply, (re_t *rep, int err)			);
+_PROTOTYPE( static void mess_reply, (message *req, message *reply)	);
+_PROTOTYPE( static void get_userdata, (int user_proc,
+		vir_bytes user_addr, vir_bytes count, void *loc_addr)	);
+_PROTOTYPE( static void put_userdata, (int user_proc,
+		vir_bytes user_addr, vir_bytes count, void *loc_addr)	);
+
+/*===========================================================================*
+ *				rtl8139_task				     *
+ *===========================================================================*/
+void rtl8139_task()
+{
+	message m;
+	int i, irq, r;
+	re_t *rep;
+
+	rl_tasknr= proc_number(proc_ptr);
+
+	while (TRUE)
+	{
+		if ((r= receive(ANY, &m)) != OK)
+			panic("rtl8139: receive failed", r);
+
+		switch (m.m_type)
+		{
+		case DL_WRITE:	do_vwrite(&m, FALSE, FALSE);	break;
+		case DL_WRITEV:	do_vwrite(&m, FALSE, TRUE);	break;
+		case DL_READ:	do_vread(&m, FALSE);		break;
+		case DL_READV:	do_vread(&m, TRUE);		break;
+		case DL_WRITEB:	do_bwrite(&m, FALSE);		break;
+		case DL_READB:	do_bread(&m);			break;
+		case DL_INIT:	do_init(&m);			break;
+		case DL_GETSTAT: do_getstat(&m);		break;
+		case DL_STOP:	do_stop(&m);			break;
+		case HARD_INT:
+			for (i= 0, rep= &re_table[0]; i<RE_PORT_NR; i++, rep++)
+			{
+				if (rep->re_mode != REM_ENABLED)
+					continue;
+				assert(rep->re_flags & REF_ENABLED);
+				if (int_pending[rep->re_irq])
+				{
+					rl_check_ints(rep);
+					do_int(rep);
+				}
+			}
+
+			/* The interrupts are acknowledged at the card, the
+			 * IRQ lines can be enabled again.
+			 */
+			for (i= 0, rep= &re_table[0]; i<RE_PORT_NR; i++, rep++)
+			{
+				if (rep->re_mode != REM_ENABLED)
+					continue;
+				irq= rep->re_irq;
+				if (int_pending[irq])
+				{
+					int_pending[irq]= 0;
+					enable_irq(irq);
+				}
+			}
+			break;
+		default:
+			panic("rtl8139: illegal message", m.m_type);
+		}
+	}
+}
+
+
+/*===========================================================================*
+ *				rtl_dump				     *
+ *===========================================================================*/
+void rtl_dump()
+{
+	re_t *rep;
+	int i;
+
+	printf("\n");
+	for (i= 0, rep = &re_table[0]; i<RE_PORT_NR; i++, rep++)
+	{
+		if (rep->re_mode != REM_ENABLED)
+			continue;
+
+		printf("rtl8139 statistics of port %d:\n", i);
+
+		printf("recvErr    :%8ld\t", rep->re_stat.ets_recvErr);
+		printf("sendErr    :%8ld\t", rep->re_stat.ets_sendErr);
+		printf("OVW        :%8ld\n", rep->re_stat.ets_OVW);
+
+		printf("CRCerr     :%8ld\t", rep->re_stat.ets_CRCerr);
+		printf("frameAll   :%8ld\t", rep->re_stat.ets_frameAll);
+		printf("missedP    :%8ld\n", rep->re_stat.ets_missedP);
+
+		printf("packetR    :%8ld\t", rep->re_stat.ets_packetR);
+		printf("packetT    :%8ld\t", rep->re_stat.ets_packetT);
+		printf("transDef   :%8ld\n", rep->re_stat.ets_transDef);
+
+		printf("collision  :%8ld\t", rep->re_stat.ets_collision);
+		printf("transAb    :%8ld\t", rep->re_stat.ets_transAb);
+		printf("carrSense  :%8ld\n", rep->re_stat.ets_carrSense);
+
+		printf("fifoUnder  :%8ld\t", rep->re_stat.ets_fifoUnder);
+		printf("fifoOver   :%8ld\t", rep->re_stat.ets_fifoOver);
+		printf("OWC        :%8ld\n", rep->re_stat.ets_OWC);
+
+		printf("isr = 0x%x, re_flags = 0x%x\n",
+			in_word(rep->re_base_port + RL_ISR), rep->re_flags);
+	}
+}
+
+
+/*===========================================================================*
+ *				rtl8139_stop				     *
+ *===========================================================================*/
+void rtl8139_stop()
+{
+/* Stop the cards, they must not write to memory after a reboot. */
+	message mess;
+	int i;
+
+	for (i= 0; i<RE_PORT_NR; i++)
+	{
+		if (re_table[i].re_mode != REM_ENABLED)
+			continue;
+		mess.m_type= DL_STOP;
+		mess.DL_PORT= i;
+		do_stop(&mess);
+	}
+}
+
+
+/*===========================================================================*
+ *				do_vwrite				     *
+ *===========================================================================*/
+static void do_vwrite(mp, from_int, vectored)
+message *mp;
+int from_int;
+int vectored;
+{
+	int port, count, size;
+	re_t *rep;
+
+	port = mp->DL_PORT;
+	count = mp->DL_COUNT;
+	if (port < 0 || port >= RE_PORT_NR)
+		panic("rtl8139: illegal port", port);
+	rep= &re_table[port];
+	rep->re_client= mp->DL_PROC;
+
+	assert(rep->re_mode == REM_ENABLED);
+	assert(rep->re_flags & REF_ENABLED);
+	if (rep->re_flags & REF_SEND_AVAIL)
+		panic("rtl8139: send already in progress", NO_NUM);
+
+	if (rep->re_tx_busy[rep->re_tx_head])
+	{
+		if (from_int)
+			panic("rtl8139: should not be sending\n", NO_NUM);
+		rep->re_sendmsg= *mp;
+		rep->re_flags |= REF_SEND_AVAIL;
+		reply(rep, OK);
+		return;
+	}
+	assert(!(rep->re_flags & REF_PACK_SEND));
+
+	if (vectored)
+	{
+		get_userdata(mp->DL_PROC, (vir_bytes) mp->DL_ADDR,
+			(count > IOVEC_NR ? IOVEC_NR : count) *
+			sizeof(iovec_t), rep->re_write_iovec.iod_iovec);
+		rep->re_write_iovec.iod_iovec_s = count;
+		rep->re_write_iovec.iod_proc_nr = mp->DL_PROC;
+		rep->re_write_iovec.iod_iovec_addr = (vir_bytes) mp->DL_ADDR;
+
+		rep->re_tmp_iovec = rep->re_write_iovec;
+		size = calc_iovec_size(&rep->re_tmp_iovec);
+	}
+	else
+	{
+		rep->re_write_iovec.iod_iovec[0].iov_addr =
+			(vir_bytes) mp->DL_ADDR;
+		rep->re_write_iovec.iod_iovec[0].iov_size =
+			mp->DL_COUNT;
+		rep->re_write_iovec.iod_iovec_s = 1;
+		rep->re_write_iovec.iod_proc_nr = mp->DL_PROC;
+		rep->re_write_iovec.iod_iovec_addr = 0;
+		size= mp->DL_COUNT;
+	}
+	rl_queue_send(rep, size);
+
+	rep->re_flags |= REF_PACK_SEND;
+
+	/* If the interrupt handler called, don't send a reply. The reply
+	 * will be sent after all interrupts are handled.
+	 */
+	if (from_int)
+		return;
+	reply(rep, OK);
+}
+
+
+/*===========================================================================*
+ *				do_bwrite				     *
+ *===========================================================================*/
+static void do_bwrite(mp, from_int)
+message *mp;
+int from_int;
+{
+/* Copy as many frames of a DL_WRITEB as there are free transmit buffers.
+ * If there are none, the request waits for a transmit interrupt.
+ */
+	int port, left, size;
+	vir_bytes addr;
+	iovec_t frame;
+	re_t *rep;
+
+	port = mp->DL_PORT;
+	if (port < 0 || port >= RE_PORT_NR)
+		panic("rtl8139: illegal port", port);
+	rep= &re_table[port];
+	rep->re_client= mp->DL_PROC;
+
+	assert(rep->re_mode == REM_ENABLED);
+	assert(rep->re_flags & REF_ENABLED);
+	if (rep->re_flags & REF_SEND_AVAIL)
+		panic("rtl8139: send already in progress", NO_NUM);
+
+	addr= (vir_bytes) mp->DL_ADDR;
+	rep->re_send_s= 0;
+	for (left= mp->DL_COUNT; left > 0; left -= 1 + frame.iov_size)
+	{
+		if (rep->re_tx_busy[rep->re_tx_head])
+			break;
+		get_userdata(mp->DL_PROC, addr, (vir_bytes) sizeof(frame),
+			&frame);
+		addr += sizeof(frame);
+		if (frame.iov_size < 1 || frame.iov_size >= left)
+			panic("rtl8139: bad DL_WRITEB frame", frame.iov_size);
+
+		rep->re_write_iovec.iod_iovec_s = frame.iov_size;
+		rep->re_write_iovec.iod_proc_nr = mp->DL_PROC;
+		rep->re_write_iovec.iod_iovec_addr = addr;
+		addr += frame.iov_size * sizeof(iovec_t);
+		rep->re_send_s++;
+
+		get_userdata(mp->DL_PROC, rep->re_write_iovec.iod_iovec_addr,
+			(frame.iov_size > IOVEC_NR ? IOVEC_NR :
+			frame.iov_size) * sizeof(iovec_t),
+			rep->re_write_iovec.iod_iovec);
+		rep->re_tmp_iovec = rep->re_write_iovec;
+		size = calc_iovec_size(&rep->re_tmp_iovec);
+		rl_queue_send(rep, size);
+	}
+
+	if (!rep->re_send_s)
+	{
+		if (from_int)
+			panic("rtl8139: should not be sending\n", NO_NUM);
+		rep->re_sendmsg= *mp;
+		rep->re_flags |= REF_SEND_AVAIL;
+		reply(rep, OK);
+		return;
+	}
+	rep->re_flags |= REF_PACK_SEND;
+
+	/* From the interrupt handler, the reply is sent after all interrupts
+	 * are handled.
+	 */
+	if (from_int)
+		return;
+	reply(rep, OK);
+}
+
+
+/*===========================================================================*
+ *				rl_queue_send				     *
+ *===========================================================================*/
+static void rl_queue_send(rep, size)
+re_t *rep;
+int size;
+{
+/* Copy the frame in re_write_iovec to the next transmit buffer, and hand it
+ * to the card.  The card sends the buffers in turn.
+ */
+	int head;
+
+	if (size < ETH_MIN_PACK_SIZE || size > ETH_MAX_PACK_SIZE)
+		panic("rtl8139: invalid packet size", size);
+
+	head= rep->re_tx_head;
+	assert(!rep->re_tx_busy[head]);
+	rl_user2buf(&rep->re_write_iovec, rep->re_tx_phys[head],
+							(vir_bytes) size);
+	rep->re_tx_busy[head]= TRUE;
+	out_long(rep->re_base_port + RL_TSD0 + 4*head,
+		(u32_t) size | ((u32_t) RL_TX_THRESH << RL_TSD_ERTXTH_SHIFT));
+
+	if (++head == RL_TXBUF_NR)
+		head= 0;
+	rep->re_tx_head= head;
+}
+
+
+/*===========================================================================*
+ *				do_vread				     *
+ *===========================================================================*/
+static void do_vread(mp, vectored)
+message *mp;
+int vectored;
+{
+	int port, count;
+	int size;
+	re_t *rep;
+
+	port = mp->DL_PORT;
+	count = mp->DL_COUNT;
+	if (port < 0 || port >= RE_PORT_NR)
+		panic("rtl8139: illegal port", port);
+	rep= &re_table[port];
+	rep->re_client= mp->DL_PROC;
+
+	assert(rep->re_mode == REM_ENABLED);
+	assert(rep->re_flags & REF_ENABLED);
+
+	if(rep->re_flags & REF_READING)
+		panic("rtl8139: read already in progress", NO_NUM);
+
+	if (vectored)
+	{
+		get_userdata(mp->DL_PROC, (vir_bytes) mp->DL_ADDR,
+			(count > IOVEC_NR ? IOVEC_NR : count) *
+			sizeof(iovec_t), rep->re_read_iovec.iod_iovec);
+		rep->re_read_iovec.iod_iovec_s = count;
+		rep->re_read_iovec.iod_proc_nr = mp->DL_PROC;
+		rep->re_read_iovec.iod_iovec_addr = (vir_bytes) mp->DL_ADDR;
+
+		rep->re_tmp_iovec = rep->re_read_iovec;
+		size= calc_iovec_size(&rep->re_tmp_iovec);
+	}
+	else
+	{
+		rep->re_read_iovec.iod_iovec[0].iov_addr =
+			(vir_bytes) mp->DL_ADDR;
+		rep->re_read_iovec.iod_iovec[0].iov_size =
+			mp->DL_COUNT;
+		rep->re_read_iovec.iod_iovec_s = 1;
+		rep->re_read_iovec.iod_proc_nr = mp->DL_PROC;
+		rep->re_read_iovec.iod_iovec_addr = 0;
+		size= count;
+	}
+	if (size < ETH_MAX_PACK_SIZE)
+		panic("rtl8139: wrong packet size", size);
+	rep->re_flags |= REF_READING;
+
+	rl_recv(rep);
+	reply(rep, OK);
+}
+
+
+/*===========================================================================*
+ *				do_bread				     *
+ *===========================================================================*/
+static void do_bread(mp)
+message *mp;
+{
+/* Fill the buffers of a DL_READB with the frames in the receive ring.  If
+ * there are none, the request waits.  Frames that arrive while it waits are
+ * all delivered with a single reply when the interrupts are handled.
+ */
+	int port;
+	re_t *rep;
+
+	port = mp->DL_PORT;
+	if (port < 0 || port >= RE_PORT_NR)
+		panic("rtl8139: illegal port", port);
+	rep= &re_table[port];
+	rep->re_client= mp->DL_PROC;
+
+	assert(rep->re_mode == REM_ENABLED);
+	assert(rep->re_flags & REF_ENABLED);
+
+	if(rep->re_flags & REF_READING)
+		panic("rtl8139: read already in progress", NO_NUM);
+
+	rep->re_read_iovec.iod_proc_nr = mp->DL_PROC;
+	rep->re_batch_addr= (vir_bytes) mp->DL_ADDR;
+	rep->re_batch_left= mp->DL_COUNT;
+	rep->re_read_s= 0;
+	rep->re_flags |= REF_READING | REF_READ_BATCH;
+
+	rl_recv(rep);
+	reply(rep, OK);
+}
+
+
+/*===========================================================================*
+ *				do_init					     *
+ *===========================================================================*/
+static void do_init(mp)
+message *mp;
+{
+	int port;
+	re_t *rep;
+	message reply_mess;
+
+	port = mp->DL_PORT;
+	if (port < 0 || port >= RE_PORT_NR)
+	{
+		reply_mess.m_type= DL_INIT_REPLY;
+		reply_mess.m3_i1= ENXIO;
+		mess_reply(mp, &reply_mess);
+		return;
+	}
+	rep= &re_table[port];
+	if (rep->re_mode == REM_DISABLED)
+	{
+		/* This is the default, try to (re)locate the device. */
+		conf_hw(rep);
+		if (rep->re_mode == REM_DISABLED)
+		{
+			/* No card, or the port is configured off. */
+			reply_mess.m_type= DL_INIT_REPLY;
+			reply_mess.m3_i1= ENXIO;
+			mess_reply(mp, &reply_mess);
+			return;
+		}
+		rl_init(rep);
+	}
+	assert(rep->re_mode == REM_ENABLED);
+	assert(rep->re_flags & REF_ENABLED);
+
+	rep->re_flags &= ~(REF_PROMISC | REF_MULTI | REF_BROAD);
+
+	if (mp->DL_MODE & DL_PROMISC_REQ)
+		rep->re_flags |= REF_PROMISC | REF_MULTI | REF_BROAD;
+	if (mp->DL_MODE & DL_MULTI_REQ)
+		rep->re_flags |= REF_MULTI;
+	if (mp->DL_MODE & DL_BROAD_REQ)
+		rep->re_flags |= REF_BROAD;
+
+	rep->re_client = mp->m_source;
+	rl_rec_mode(rep);
+
+	reply_mess.m_type = DL_INIT_REPLY;
+	reply_mess.m3_i1 = mp->DL_PORT;
+	reply_mess.m3_i2 = RE_PORT_NR;
+	*(ether_addr_t *) reply_mess.m3_ca1 = rep->re_address;
+
+	mess_reply(mp, &reply_mess);
+}
+
+
+/*===========================================================================*
+ *				do_int					     *
+ *===========================================================================*/
+static void do_int(rep)
+re_t *rep;
+{
+	if (rep->re_flags & (REF_PACK_SEND | REF_PACK_RECV))
+		reply(rep, OK);
+}
+
+
+/*===========================================================================*
+ *				do_getstat				     *
+ *===========================================================================*/
+static void do_getstat(mp)
+message *mp;
+{
+	int port;
+	re_t *rep;
+
+	port = mp->DL_PORT;
+	if (port < 0 || port >= RE_PORT_NR)
+		panic("rtl8139: illegal port", port);
+	rep= &re_table[port];
+	rep->re_client= mp->DL_PROC;
+
+	assert(rep->re_mode == REM_ENABLED);
+	assert(rep->re_flags & REF_ENABLED);
+
+	rep->re_stat.ets_missedP +=
+			in_long(rep->re_base_port + RL_MPC) & 0xFFFFFFL;
+	out_long(rep->re_base_port + RL_MPC, 0);
+
+	put_userdata(mp->DL_PROC, (vir_bytes) mp->DL_ADDR,
+		(vir_bytes) sizeof(rep->re_stat), &rep->re_stat);
+	reply(rep, OK);
+}
+
+
+/*===========================================================================*
+ *				do_stop					     *
+ *===========================================================================*/
+static void do_stop(mp)
+message *mp;
+{
+	int port;
+	re_t *rep;
+
+	port = mp->DL_PORT;
+
+	if (port < 0 || port >= RE_PORT_NR)
+		panic("rtl8139: illegal port", port);
+	rep= &re_table[port];
+	if (rep->re_mode != REM_ENABLED)
+		return;
+
+	if (!(rep->re_flags & REF_ENABLED))
+		return;
+
+	out_word(rep->re_base_port + RL_IMR, 0);
+	out_byte(rep->re_base_port + RL_CR, 0);
+
+	rep->re_flags= REF_EMPTY;
+}
+
+
+/*===========================================================================*
+ *				rl_init					     *
+ *===========================================================================*/
+static void rl_init(rep)
+re_t *rep;
+{
+	port_t port;
+	phys_bytes phys;
+	int i;
+
+	port= rep->re_base_port;
+
+	/* Find the buffers, aligned at 16 bytes. */
+	phys= vir2phys(rl_buffers[rep - re_table]);
+	phys= (phys + 15) & ~(phys_bytes) 15;
+	rep->re_rx_phys= phys;
+	phys += RL_RXBUF_ALLOC;
+	for (i= 0; i<RL_TXBUF_NR; i++)
+	{
+		rep->re_tx_phys[i]= phys;
+		phys += RL_TXBUF_SIZE;
+	}
+
+	/* Wake the card up and reset it.  The reset loads the ethernet
+	 * address from the EEPROM.
+	 */
+	out_byte(port + RL_CONFIG1, 0);
+	out_byte(port + RL_CR, RL_CR_RST);
+	for (i= 0; i < 0x10000 && (in_byte(port + RL_CR) & RL_CR_RST); i++)
+		; /* Do nothing */
+	if (in_byte(port + RL_CR) & RL_CR_RST)
+		printf("rtl8139: reset of port %d failed\n",
+							(int) (rep - re_table));
+
+	for (i= 0; i < 6; i++)
+		rep->re_address.ea_addr[i]= in_byte(port + RL_IDR + i);
+	rl_confaddr(rep);
+
+	/* The receive ring and transmit buffers.  Both engines must be
+	 * enabled before they can be configured.
+	 */
+	out_long(port + RL_RBSTART, rep->re_rx_phys);
+	for (i= 0; i<RL_TXBUF_NR; i++)
+	{
+		out_long(port + RL_TSAD0 + 4*i, rep->re_tx_phys[i]);
+		rep->re_tx_busy[i]= FALSE;
+	}
+	rep->re_tx_head= 0;
+	rep->re_tx_tail= 0;
+	rep->re_rx_offset= 0;
+
+	out_byte(port + RL_CR, RL_CR_RE | RL_CR_TE);
+	out_long(port + RL_TCR, RL_TCR_IFG_STD | RL_TCR_MXDMA_1K);
+	rep->re_flags |= REF_ENABLED;
+	rl_rec_mode(rep);
+	out_long(port + RL_MPC, 0);
+
+	out_word(port + RL_ISR, 0xFFFF);
+	out_word(port + RL_IMR, RL_INTS);
+
+	/* set the interrupt handler */
+	put_irq_handler(rep->re_irq, rl_handler);
+	enable_irq(rep->re_irq);
+}
+
+
+/*===========================================================================*
+ *				rl_confaddr				     *
+ *===========================================================================*/
+static void rl_confaddr(rep)
+re_t *rep;
+{
+	int i;
+	char eakey[16];
+	static char eafmt[]= "x:x:x:x:x:x";
+	long v;
+	port_t port;
+	u8_t *ea;
+
+	/* User defined ethernet address? */
+	strcpy(eakey, rl_envvar[rep - re_table]);
+	strcat(eakey, "_EA");
+
+	for (i= 0; i < 6; i++)
+	{
+		v= rep->re_address.ea_addr[i];
+		if (env_parse(eakey, eafmt, i, &v, 0x00L, 0xFFL) != EP_SET)
+			break;
+		rep->re_address.ea_addr[i]= v;
+	}
+
+	if (i != 0 && i != 6)
+	{
+		/* It's all or nothing; force a panic. */
+		(void) env_parse(eakey, "?", 0, &v, 0L, 0L);
+	}
+	if (i == 0)
+		return;
+
+	/* The ID registers can only be written 32 bits at a time, and only
+	 * with the configuration registers unlocked.
+	 */
+	port= rep->re_base_port;
+	ea= rep->re_address.ea_addr;
+	out_byte(port + RL_9346CR, RL_9346CR_EEM_CONFIG);
+	out_long(port + RL_IDR, ea[0] | ((u32_t) ea[1] << 8) |
+				((u32_t) ea[2] << 16) | ((u32_t) ea[3] << 24));
+	out_long(port + RL_IDR + 4, ea[4] | ((u32_t) ea[5] << 8));
+	out_byte(port + RL_9346CR, RL_9346CR_EEM_NORMAL);
+}
+
+
+/*===========================================================================*
+ *				rl_rec_mode				     *
+ *===========================================================================*/
+static void rl_rec_mode(rep)
+re_t *rep;
+{
+	port_t port;
+	u32_t rcr;
+	int i;
+
+	port= rep->re_base_port;
+	rcr= RL_RCR_RXFTH_NONE | RL_RCR_RBLEN_8K | RL_RCR_MXDMA_ANY |
+		RL_RCR_WRAP | RL_RCR_APM;
+	if (rep->re_flags & REF_PROMISC)
+		rcr |= RL_RCR_AB | RL_RCR_AAP | RL_RCR_AM;
+	if (rep->re_flags & REF_BROAD)
+		rcr |= RL_RCR_AB;
+	if (rep->re_flags & REF_MULTI)
+		rcr |= RL_RCR_AM;
+	for (i= 0; i < 8; i++)
+		out_byte(port + RL_MAR + i, 0xFF);
+	out_long(port + RL_RCR, rcr);
+}
+
+
+/*===========================================================================*
+ *				rl_reset				     *
+ *===========================================================================*/
+static void rl_reset(rep)
+re_t *rep;
+{
+/* Start the card afresh.  Frames that were being sent are taken to be
+ * sent, higher layers will retransmit if they weren't.  Frames in the
+ * receive ring are lost.
+ */
+	int flags;
+
+	flags= rep->re_flags;
+	out_word(rep->re_base_port + RL_IMR, 0);
+	rl_init(rep);
+	rep->re_flags= flags;
+	rl_send(rep);
+}
+
+
+/*===========================================================================*
+ *				rl_check_ints				     *
+ *===========================================================================*/
+static void rl_check_ints(rep)
+re_t *rep;
+{
+	port_t port;
+	int isr;
+
+	if (!(rep->re_flags & REF_ENABLED))
+		panic("rtl8139: got premature interrupt", NO_NUM);
+
+	port= rep->re_base_port;
+	for (;;)
+	{
+		isr = in_word(port + RL_ISR);
+		if (!(isr & RL_INTS))
+			break;
+		out_word(port + RL_ISR, isr);
+
+		if (isr & RL_INT_SERR)
+		{
+			printf("rtl8139: PCI system error, resetting\n");
+			rl_reset(rep);
+			continue;
+		}
+		if (isr & (RL_INT_TOK | RL_INT_TER))
+			rl_tx_done(rep);
+
+		if (isr & RL_INT_RER) rep->re_stat.ets_recvErr++;
+		if (isr & RL_INT_RXOVW) rep->re_stat.ets_OVW++;
+		if (isr & RL_INT_FOVW) rep->re_stat.ets_fifoOver++;
+		if (isr & (RL_INT_ROK | RL_INT_RER | RL_INT_RXOVW |
+			RL_INT_FOVW))
+		{
+			/* Frames that nobody is waiting for stay in the
+			 * ring until the next read request.
+			 */
+			if (rep->re_flags & REF_READING)
+				rl_recv(rep);
+		}
+	}
+}
+
+
+/*===========================================================================*
+ *				rl_tx_done				     *
+ *===========================================================================*/
+static void rl_tx_done(rep)
+re_t *rep;
+{
+/* Free the transmit buffers the card is done with. */
+	int tail;
+	u32_t tsd;
+
+	tail= rep->re_tx_tail;
+	while (rep->re_tx_busy[tail])
+	{
+		tsd= in_long(rep->re_base_port + RL_TSD0 + 4*tail);
+		if (!(tsd & (RL_TSD_TOK | RL_TSD_TUN | RL_TSD_TABT)))
+			break;
+
+		if (tsd & RL_TSD_TOK) rep->re_stat.ets_packetT++;
+		rep->re_stat.ets_collision +=
+				(tsd & RL_TSD_NCC) >> RL_TSD_NCC_SHIFT;
+		if (tsd & RL_TSD_CRS) rep->re_stat.ets_carrSense++;
+		if (tsd & RL_TSD_OWC) rep->re_stat.ets_OWC++;
+		if (tsd & RL_TSD_TUN
+			&& ++rep->re_stat.ets_fifoUnder <= 10)
+		{
+			printf("rtl8139: fifo underrun\n");
+		}
+		if (tsd & RL_TSD_TABT)
+		{
+			/* The transmitter stops after an abort. */
+			rep->re_stat.ets_sendErr++;
+			rep->re_stat.ets_transAb++;
+			rl_reset(rep);
+			return;
+		}
+
+		rep->re_tx_busy[tail]= FALSE;
+		if (++tail == RL_TXBUF_NR)
+			tail= 0;
+	}
+	rep->re_tx_tail= tail;
+
+	if (rep->re_flags & REF_SEND_AVAIL)
+		rl_send(rep);
+}
+
+
+/*===========================================================================*
+ *				rl_recv					     *
+ *===========================================================================*/
+static void rl_recv(rep)
+re_t *rep;
+{
+	rl_rxhdr_t header;
+	port_t port;
+	phys_bytes phys;
+	unsigned offset;
+
+	port= rep->re_base_port;
+	while (rep->re_flags & REF_READING)
+	{
+		if (in_byte(port + RL_CR) & RL_CR_BUFE)
+			break;			/* ring is empty */
+
+		offset= rep->re_rx_offset;
+		phys= rep->re_rx_phys + offset;
+		phys_copy(phys, vir2phys(&header), (phys_bytes) sizeof(header));
+
+		if (!(header.rh_status & RL_RXS_ROK) ||
+			header.rh_len < ETH_MIN_PACK_SIZE + 4 ||
+			header.rh_len > ETH_MAX_PACK_SIZE + 4)
+		{
+			if (header.rh_status & RL_RXS_CRC)
+				rep->re_stat.ets_CRCerr++;
+			else if (header.rh_status & RL_RXS_FAE)
+				rep->re_stat.ets_frameAll++;
+			else
+				rep->re_stat.ets_recvErr++;
+			rl_rx_reset(rep);
+			break;
+		}
+
+		rl_pkt2user(rep, phys + sizeof(header), header.rh_len - 4);
+		rep->re_stat.ets_packetR++;
+
+		/* Frames start at a longword boundary.  CAPR trails the
+		 * read offset by 16 bytes.
+		 */
+		offset= (offset + sizeof(header) + header.rh_len + 3) & ~3;
+		if (offset >= RL_RXBUF_SIZE)
+			offset -= RL_RXBUF_SIZE;
+		rep->re_rx_offset= offset;
+		out_word(port + RL_CAPR, (offset - 16) & 0xFFFF);
+	}
+}
+
+
+/*===========================================================================*
+ *				rl_rx_reset				     *
+ *===========================================================================*/
+static void rl_rx_reset(rep)
+re_t *rep;
+{
+/* A bad frame header means the receive ring can't be trusted, restart the
+ * receiver with an empty ring.
+ */
+	port_t port;
+
+	port= rep->re_base_port;
+	out_byte(port + RL_CR, RL_CR_TE);
+	out_byte(port + RL_CR, RL_CR_RE | RL_CR_TE);
+	rl_rec_mode(rep);
+	out_long(port + RL_RBSTART, rep->re_rx_phys);
+	rep->re_rx_offset= 0;
+	out_word(port + RL_CAPR, (0 - 16) & 0xFFFF);
+}
+
+
+/*===========================================================================*
+ *				rl_send					     *
+ *===========================================================================*/
+static void rl_send(rep)
+re_t *rep;
+{
+	if (!(rep->re_flags & REF_SEND_AVAIL))
+		return;
+
+	rep->re_flags &= ~REF_SEND_AVAIL;
+	switch(rep->re_sendmsg.m_type)
+	{
+	case DL_WRITE:	do_vwrite(&rep->re_sendmsg, TRUE, FALSE);	break;
+	case DL_WRITEV:	do_vwrite(&rep->re_sendmsg, TRUE, TRUE);	break;
+	case DL_WRITEB:	do_bwrite(&rep->re_sendmsg, TRUE);		break;
+	default:
+		panic("rtl8139: wrong type:", rep->re_sendmsg.m_type);
+		break;
+	}
+}
+
+
+/*===========================================================================*
+ *				rl_pkt2user				     *
+ *===========================================================================*/
+static void rl_pkt2user(rep, phys, length)
+re_t *rep;
+phys_bytes phys;
+int length;
+{
+	int nfrag;
+	iovec_t frame;
+
+	assert(rep->re_flags & REF_READING);
+	nfrag= 0;
+	if (rep->re_flags & REF_READ_BATCH)
+	{
+		rl_batch_frame(rep);
+		nfrag= rep->re_read_iovec.iod_iovec_s;
+	}
+
+	/* The card doesn't wrap frames around the end of the ring. */
+	rl_buf2user(phys, &rep->re_read_iovec, (vir_bytes) length);
+
+	rep->re_flags |= REF_PACK_RECV;
+	if (rep->re_flags & REF_READ_BATCH)
+	{
+		/* Tell the length, and go on with the next buffer. */
+		frame.iov_addr= length;
+		frame.iov_size= nfrag;
+		put_userdata(rep->re_read_iovec.iod_proc_nr,
+			rep->re_batch_addr, (vir_bytes) sizeof(frame), &frame);
+		rep->re_batch_addr += (1 + nfrag) * sizeof(iovec_t);
+		rep->re_batch_left -= 1 + nfrag;
+		rep->re_read_s++;
+		if (rep->re_batch_left <= 0)
+			rep->re_flags &= ~(REF_READING | REF_READ_BATCH);
+		return;
+	}
+	rep->re_read_s = length;
+	rep->re_flags &= ~REF_READING;
+}
+
+
+/*===========================================================================*
+ *				rl_batch_frame				     *
+ *===========================================================================*/
+static void rl_batch_frame(rep)
+re_t *rep;
+{
+/* Set up re_read_iovec for the next buffer of a DL_READB. */
+	iovec_t frame;
+	int proc;
+	vir_bytes addr;
+
+	proc= rep->re_read_iovec.iod_proc_nr;
+	addr= rep->re_batch_addr;
+	get_userdata(proc, addr, (vir_bytes) sizeof(frame), &frame);
+	if (frame.iov_size < 1 || frame.iov_size >= rep->re_batch_left)
+		panic("rtl8139: bad DL_READB frame", frame.iov_size);
+
+	rep->re_read_iovec.iod_iovec_s = frame.iov_size;
+	rep->re_read_iovec.iod_iovec_addr = addr + sizeof(frame);
+	get_userdata(proc, rep->re_read_iovec.iod_iovec_addr,
+		(frame.iov_size > IOVEC_NR ? IOVEC_NR : frame.iov_size) *
+		sizeof(iovec_t), rep->re_read_iovec.iod_iovec);
+	rep->re_tmp_iovec = rep->re_read_iovec;
+	if (calc_iovec_size(&rep->re_tmp_iovec) < ETH_MAX_PACK_SIZE)
+		panic("rtl8139: wrong packet size", NO_NUM);
+}
+
+
+/*===========================================================================*
+ *				rl_user2buf				     *
+ *===========================================================================*/
+static void rl_user2buf(iovp, phys_buf, count)
+iovec_dat_t *iovp;
+phys_bytes phys_buf;
+vir_bytes count;
+{
+	phys_bytes phys_user;
+	vir_bytes bytes;
+	int i;
+
+	i= 0;
+	while (count > 0)
+	{
+		if (i >= IOVEC_NR)
+		{
+			rl_next_iovec(iovp);
+			i= 0;
+			continue;
+		}
+		assert(i < iovp->iod_iovec_s);
+		bytes = iovp->iod_iovec[i].iov_size;
+		if (bytes > count)
+			bytes = count;
+
+		phys_user = numap(iovp->iod_proc_nr,
+			iovp->iod_iovec[i].iov_addr, bytes);
+		if (!phys_user)
+			panic("rtl8139: umap failed\n", NO_NUM);
+		phys_copy(phys_user, phys_buf, (phys_bytes) bytes);
+		count -= bytes;
+		phys_buf += bytes;
+		i++;
+	}
+}
+
+
+/*===========================================================================*
+ *				rl_buf2user				     *
+ *===========================================================================*/
+static void rl_buf2user(phys_buf, iovp, count)
+phys_bytes phys_buf;
+iovec_dat_t *iovp;
+vir_bytes count;
+{
+	phys_bytes phys_user;
+	vir_bytes bytes;
+	int i;
+
+	i= 0;
+	while (count > 0)
+	{
+		if (i >= IOVEC_NR)
+		{
+			rl_next_iovec(iovp);
+			i= 0;
+			continue;
+		}
+		assert(i < iovp->iod_iovec_s);
+		bytes = iovp->iod_iovec[i].iov_size;
+		if (bytes > count)
+			bytes = count;
+
+		phys_user = numap(iovp->iod_proc_nr,
+			iovp->iod_iovec[i].iov_addr, bytes);
+		if (!phys_user)
+			panic("rtl8139: umap failed\n", NO_NUM);
+		phys_copy(phys_buf, phys_user, (phys_bytes) bytes);
+		count -= bytes;
+		phys_buf += bytes;
+		i++;
+	}
+}
+
+
+/*===========================================================================*
+ *				rl_next_iovec				     *
+ *===========================================================================*/
+static void rl_next_iovec(iovp)
+iovec_dat_t *iovp;
+{
+	assert(iovp->iod_iovec_s > IOVEC_NR);
+
+	iovp->iod_iovec_s -= IOVEC_NR;
+
+	iovp->iod_iovec_addr += IOVEC_NR * sizeof(iovec_t);
+
+	get_userdata(iovp->iod_proc_nr, iovp->iod_iovec_addr,
+		(iovp->iod_iovec_s > IOVEC_NR ? IOVEC_NR : iovp->iod_iovec_s) *
+		sizeof(iovec_t), iovp->iod_iovec);
+}
+
+
+/*===========================================================================*
+ *				rl_handler				     *
+ *===========================================================================*/
+static int rl_handler(irq)
+int irq;
+{
+/* RTL8139 interrupt, send a message to the task.  PCI interrupts stay
+ * asserted until the card is told, so the IRQ is left disabled until the
+ * task has done so.
+ */
+
+	assert(irq >= 0 && irq < NR_IRQ_VECTORS);
+	int_pending[irq]= 1;
+	interrupt(rl_tasknr);
+	return 0;
+}
+
+/*===========================================================================*
+ *				conf_hw					     *
+ *===========================================================================*/
+static void conf_hw(rep)
+re_t *rep;
+{
+	static eth_stat_t empty_stat = {0, 0, 0, 0, 0, 0 	/* ,... */ };
+
+	int ifnr;
+	long v;
+
+	rep->re_mode= REM_DISABLED;
+	ifnr= rep-re_table;
+
+	/* Port n takes the n-th card, unless told otherwise. */
+	v= ifnr;
+	if (env_parse(rl_envvar[ifnr], "d", 0, &v, 0L, 255L) == EP_OFF)
+		return;
+	if (!rl_probe(rep, (int) v))
+		return;
+
+	rep->re_mode= REM_ENABLED;
+	rep->re_flags = REF_EMPTY;
+	rep->re_stat = empty_stat;
+}
+
+
+/*===========================================================================*
+ *				rl_probe				     *
+ *===========================================================================*/
+static int rl_probe(rep, nr)
+re_t *rep;
+int nr;
+{
+/* Find the nr-th card on the PCI bus, and enable its I/O and bus mastering.
+ * Return TRUE if found.
+ */
+	struct rl_pcitab *tp;
+	int i, devind;
+	u32_t bar;
+	unsigned irq;
+
+	for (tp= rl_pcitab; tp < rl_pcitab + sizeof(rl_pcitab) /
+						sizeof(rl_pcitab[0]); tp++)
+	{
+		for (i= 0; pci_find_dev(tp->vid, tp->did, i, &devind); i++)
+		{
+			if (nr-- == 0)
+				goto found;
+		}
+	}
+	return FALSE;
+
+found:
+	bar= pci_attr_r32(devind, PCI_BAR);
+	irq= pci_attr_r8(devind, PCI_ILR);
+	if (!(bar & PCI_BAR_IO))
+	{
+		printf("rtl8139: card at %d.%d.%d has no I/O base\n",
+			PCI_BUS(devind), PCI_DEV(devind), PCI_FUNC(devind));
+		return FALSE;
+	}
+	if (irq == 0 || irq >= NR_IRQ_VECTORS)
+	{
+		printf("rtl8139: card at %d.%d.%d has no IRQ\n",
+			PCI_BUS(devind), PCI_DEV(devind), PCI_FUNC(devind));
+		return FALSE;
+	}
+	rep->re_pcidev= devind;
+	rep->re_base_port= bar & 0xFFFC;
+	rep->re_irq= irq;
+	pci_attr_w16(devind, PCI_CR, pci_attr_r16(devind, PCI_CR) |
+					PCI_CR_MAST_EN | PCI_CR_IO_EN);
+	printf("rtl8139: port %d at %d.%d.%d, I/O 0x%x, IRQ %d\n",
+		(int) (rep - re_table), PCI_BUS(devind), PCI_DEV(devind),
+		PCI_FUNC(devind), rep->re_base_port, rep->re_irq);
+	return TRUE;
+}
+
+
+/*===========================================================================*
+ *				calc_iovec_size				     *
+ *===========================================================================*/
+static int calc_iovec_size(iovp)
+iovec_dat_t *iovp;
+{
+	/* Calculate the size of a request. Note that the iovec_dat
+	 * structure will be unusable after calc_iovec_size.
+	 */
+	int size;
+	int i;
+
+	size= 0;
+	i= 0;
+	while (i < iovp->iod_iovec_s)
+	{
+		if (i >= IOVEC_NR)
+		{
+			rl_next_iovec(iovp);
+			i= 0;
+			continue;
+		}
+		size += iovp->iod_iovec[i].iov_size;
+		i++;
+	}
+	return size;
+}
+
+
+/*===========================================================================*
+ *				reply					     *
+ *===========================================================================*/
+static void reply(rep, err)
+re_t *rep;
+int err;
+{
+	message reply;
+	long status;
+	int r;
+
+	status = 0;
+	if (rep->re_flags & REF_PACK_SEND)
+		status |= DL_PACK_SEND;
+	if (rep->re_flags & REF_PACK_RECV)
+	{
+		/* This completes a DL_READB too. */
+		status |= DL_PACK_RECV;
+		rep->re_flags &= ~(REF_READING | REF_READ_BATCH);
+	}
+	status |= (long) rep->re_send_s << DL_SENT_SHIFT;
+
+	reply.m_type = DL_TASK_REPLY;
+	reply.DL_PORT = rep - re_table;
+	reply.DL_PROC = rep->re_client;
+	reply.DL_STAT = status | ((u32_t) err << 16);
+	reply.DL_COUNT = rep->re_read_s;
+	reply.DL_CLCK = get_uptime();
+	r= send(rep->re_client, &reply);
+	if (r < 0)
+		panic("rtl8139: send failed:", r);
+
+	rep->re_read_s = 0;
+	rep->re_send_s = 0;
+	rep->re_flags &= ~(REF_PACK_SEND | REF_PACK_RECV);
+}
+
+
+/*===========================================================================*
+ *				mess_reply				     *
+ *===========================================================================*/
+static void mess_reply(req, reply_mess)
+message *req;
+message *reply_mess;
+{
+	if (send(req->m_source, reply_mess) != OK)
+		panic("rtl8139: unable to mess_reply", NO_NUM);
+}
+
+
+/*===========================================================================*
+ *				get_userdata				     *
+ *===========================================================================*/
+static void get_userdata(user_proc, user_addr, count, loc_addr)
+int user_proc;
+vir_bytes user_addr;
+vir_bytes count;
+void *loc_addr;
+{
+	phys_bytes src;
+
+	src = numap(user_proc, user_addr, count);
+	if (!src)
+		panic("rtl8139: umap failed", NO_NUM);
+
+	phys_copy(src, vir2phys(loc_addr), (phys_bytes) count);
+}
+
+
+/*===========================================================================*
+ *				put_userdata				     *
+ *===========================================================================*/
+static void put_userdata(user_proc, user_addr, count, loc_addr)
+int user_proc;
+vir_bytes user_addr;
+vir_bytes count;
+void *loc_addr;
+{
+	phys_bytes dst;
+
+	dst = numap(user_proc, user_addr, count);
+	if (!dst)
+		panic("rtl8139: umap failed", NO_NUM);
+
+	phys_copy(vir2phys(loc_addr), dst, (phys_bytes) count);
+}
+
+#endif /* ENABLE_PCI_ETH */
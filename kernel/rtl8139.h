@@ -0,0 +1,161 @@
+/*
+rtl8139.h
+
+Realtek RTL8139 PCI Fast Ethernet controller.
+*/
+
+#define RL_VENDOR	0x10EC	/* PCI vendor and device id of the RTL8139 */
+#define RL_DEVICE	0x8139
+
+				/* Registers, offsets from the I/O base --- */
+#define RL_IDR		0x00	/* ID Registers (ethernet address), 6 bytes */
+#define RL_MAR		0x08	/* Multicast Address Registers, 8 bytes    */
+#define RL_TSD0		0x10	/* Transmit Status of Descriptor 0..3, 32 b */
+#define RL_TSAD0	0x20	/* Transmit Start Address of Desc. 0..3    */
+#define RL_RBSTART	0x30	/* Receive Buffer Start Address, 32 bit    */
+#define RL_CR		0x37	/* Command Register, 8 bit                 */
+#define RL_CAPR		0x38	/* Current Address of Packet Read, 16 bit  */
+#define RL_CBR		0x3A	/* Current Buffer Address, 16 bit          */
+#define RL_IMR		0x3C	/* Interrupt Mask Register, 16 bit         */
+#define RL_ISR		0x3E	/* Interrupt Status Register, 16 bit       */
+#define RL_TCR		0x40	/* Transmit Configuration Register, 32 bit */
+#define RL_RCR		0x44	/* Receive Configuration Register, 32 bit  */
+#define RL_MPC		0x4C	/* Missed Packet Counter, 24 bit           */
+#define RL_9346CR	0x50	/* 93C46 Command Register, 8 bit           */
+#define RL_CONFIG1	0x52	/* Configuration Register 1, 8 bit         */
+
+/* Bits in RL_CR. */
+#define RL_CR_RST	0x10	/* Reset                                   */
+#define RL_CR_RE	0x08	/* Receiver Enable                         */
+#define RL_CR_TE	0x04	/* Transmitter Enable                      */
+#define RL_CR_BUFE	0x01	/* Receive Buffer Empty                    */
+
+/* Bits in RL_IMR and RL_ISR. */
+#define RL_INT_SERR	0x8000	/* System Error (PCI bus)                  */
+#define RL_INT_FOVW	0x0040	/* Receive FIFO Overflow                   */
+#define RL_INT_PUN	0x0020	/* Packet Underrun / Link Change           */
+#define RL_INT_RXOVW	0x0010	/* Receive Buffer Overflow                 */
+#define RL_INT_TER	0x0008	/* Transmit Error                          */
+#define RL_INT_TOK	0x0004	/* Transmit OK                             */
+#define RL_INT_RER	0x0002	/* Receive Error                           */
+#define RL_INT_ROK	0x0001	/* Receive OK                              */
+#define RL_INTS		(RL_INT_SERR | RL_INT_FOVW | RL_INT_RXOVW | \
+			RL_INT_TER | RL_INT_TOK | RL_INT_RER | RL_INT_ROK)
+
+/* Bits in RL_TSD0..3. */
+#define RL_TSD_CRS	0x80000000L	/* Carrier Sense Lost              */
+#define RL_TSD_TABT	0x40000000L	/* Transmit Abort                  */
+#define RL_TSD_OWC	0x20000000L	/* Out of Window Collision         */
+#define RL_TSD_NCC	0x0F000000L	/* Number of Collision Count       */
+#define RL_TSD_NCC_SHIFT	24
+#define RL_TSD_ERTXTH_SHIFT	16	/* Early Tx Threshold, 32 bytes    */
+#define RL_TSD_TOK	0x00008000L	/* Transmit OK                     */
+#define RL_TSD_TUN	0x00004000L	/* Transmit FIFO Underrun          */
+#define RL_TSD_OWN	0x00002000L	/* DMA to the FIFO completed       */
+
+/* Bits in RL_TCR. */
+#define RL_TCR_IFG_STD	0x03000000L	/* Standard Interframe Gap         */
+#define RL_TCR_MXDMA_1K	0x00000600L	/* Max DMA Burst 1024 bytes        */
+#define RL_TCR_CLRABT	0x00000001L	/* Retransmit an aborted packet    */
+
+/* Bits in RL_RCR. */
+#define RL_RCR_RXFTH_NONE 0x0000E000L	/* Rx FIFO threshold: whole packet */
+#define RL_RCR_RBLEN_8K	0x00000000L	/* Rx Buffer Length 8K + 16        */
+#define RL_RCR_MXDMA_ANY 0x00000700L	/* Max DMA Burst unlimited         */
+#define RL_RCR_WRAP	0x00000080L	/* Frames run past the ring end  */
+#define RL_RCR_AB	0x00000008L	/* Accept Broadcast                */
+#define RL_RCR_AM	0x00000004L	/* Accept Multicast                */
+#define RL_RCR_APM	0x00000002L	/* Accept Physical Match           */
+#define RL_RCR_AAP	0x00000001L	/* Accept All Packets              */
+
+/* Bits in RL_9346CR. */
+#define RL_9346CR_EEM_CONFIG 0xC0	/* Config registers write enable   */
+#define RL_9346CR_EEM_NORMAL 0x00
+
+/* The header the card puts in front of each frame in the receive ring. */
+typedef struct rl_rxhdr
+{
+	u16_t rh_status;
+	u16_t rh_len;		/* including the 4 byte CRC */
+} rl_rxhdr_t;
+
+/* Bits in rh_status. */
+#define RL_RXS_MAR	0x8000	/* Multicast Address Received              */
+#define RL_RXS_PAM	0x4000	/* Physical Address Matched                */
+#define RL_RXS_BAR	0x2000	/* Broadcast Address Received              */
+#define RL_RXS_ISE	0x0020	/* Invalid Symbol Error                    */
+#define RL_RXS_RUNT	0x0010	/* Runt Packet                             */
+#define RL_RXS_LONG	0x0008	/* Long Packet                             */
+#define RL_RXS_CRC	0x0004	/* CRC Error                               */
+#define RL_RXS_FAE	0x0002	/* Frame Alignment Error                   */
+#define RL_RXS_ROK	0x0001	/* Receive OK                              */
+
+/* The receive ring is 8K plus 16 bytes, with room behind it for a frame that
+ * the card doesn't wrap around (RL_RCR_WRAP).  There are four transmit
+ * buffers, the card uses them in turn.  All are 16 byte aligned.
+ */
+#define RL_RXBUF_SIZE	8192
+#define RL_RXBUF_ALLOC	(RL_RXBUF_SIZE + 16 + RL_TXBUF_SIZE)
+#define RL_TXBUF_NR	4
+#define RL_TXBUF_SIZE	1536
+#define RL_BUF_SIZE	(16 + RL_RXBUF_ALLOC + RL_TXBUF_NR * RL_TXBUF_SIZE)
+
+/* Start sending when this much of a frame is in the FIFO. */
+#define RL_TX_THRESH	(256 / 32)
+
+/* iovectors are handled IOVEC_NR entries at a time. */
+#define IOVEC_NR	16
+
+typedef struct iovec_dat
+{
+  iovec_t iod_iovec[IOVEC_NR];
+  int iod_iovec_s;
+  int iod_proc_nr;
+  vir_bytes iod_iovec_addr;
+} iovec_dat_t;
+
+#define RE_PORT_NR	2
+
+typedef struct re
+{
+	port_t re_base_port;
+	int re_irq;
+	int re_pcidev;			/* PCI bus/device/function */
+	ether_addr_t re_address;
+	int re_mode;
+	int re_flags;
+	int re_client;
+	eth_stat_t re_stat;
+
+	/* The DMA buffers, and their physical addresses. */
+	phys_bytes re_rx_phys;
+	unsigned re_rx_offset;		/* next frame in the receive ring */
+	phys_bytes re_tx_phys[RL_TXBUF_NR];
+	int re_tx_busy[RL_TXBUF_NR];
+	int re_tx_head;			/* next buffer to fill */
+	int re_tx_tail;			/* oldest buffer being sent */
+
+	/* Requests. */
+	iovec_dat_t re_read_iovec;
+	iovec_dat_t re_write_iovec;
+	iovec_dat_t re_tmp_iovec;
+	vir_bytes re_batch_addr;	/* next frame of a DL_READB */
+	int re_batch_left;		/* iovec_t entries left of it */
+	vir_bytes re_read_s;
+	int re_send_s;			/* frames taken from a DL_WRITEB */
+	message re_sendmsg;
+} re_t;
+
+#define REM_DISABLED	0x0
+#define REM_ENABLED	0x1
+
+#define REF_EMPTY	0x000
+#define REF_PACK_SEND	0x001
+#define REF_PACK_RECV	0x002
+#define REF_SEND_AVAIL	0x004
+#define REF_READING	0x008
+#define REF_PROMISC	0x010
+#define REF_MULTI	0x020
+#define REF_BROAD	0x040
+#define REF_ENABLED	0x080
+#define REF_READ_BATCH	0x100
@@ -41,6 +41,7 @@
 #define SYN_ALRM_STACK	SMALL_STACK
 
 #define DP8390_STACK	(SMALL_STACK * ENABLE_NETWORKING)
+#define RTL8139_STACK	(SMALL_STACK * ENABLE_PCI_ETH)
 
 #if (CHIP == INTEL)
 #define	IDLE_STACK	((3+3+4) * sizeof(char *))  /* 3 intr, 3 temps, 4 db */
@@ -77,7 +78,7 @@
 
 
 #define	TOT_STACK_SPACE		(TTY_STACK + \
-    	DP8390_STACK + SCSI_STACK + \
+    	DP8390_STACK + RTL8139_STACK + SCSI_STACK + \
 	SYN_ALRM_STACK + IDLE_STACK + HARDWARE_STACK + PRINTER_STACK + \
 	WINCH_STACK + FLOP_STACK + MEM_STACK + CLOCK_STACK + SYS_STACK + \
 	FBDEV_STACK + CDROM_STACK + AUDIO_STACK + MIXER_STACK)
@@ -118,6 +119,9 @@ PUBLIC struct tasktab tasktab[] = {
 #if ENABLE_WINI
 	{ winchester_task,	WINCH_STACK,	"WINCH"		},
 #endif
+#if ENABLE_PCI_ETH
+	{ rtl8139_task,		RTL8139_STACK,	"RTL8139"	},
+#endif
 #if ENABLE_NETWORKING
 	{ dp8390_task,		DP8390_STACK,	"DP8390"	},
 #endif
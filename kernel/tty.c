@@ -24,6 +24,7 @@
  *   DEV_IOCTL:    a process wants to change a terminal's parameters
  *   DEV_OPEN:     a tty line has been opened
  *   DEV_CLOSE:    a tty line has been closed
+ *   DEV_SELECT:   FS wants to know if a read or write would block
  *   CANCEL:       terminate a previous incomplete system call immediately
  *
  *    m_type      TTY_LINE   PROC_NR    COUNT   TTY_SPEK  TTY_FLAGS  ADDRESS
@@ -40,6 +41,8 @@
  * |-------------+---------+---------+---------+---------+---------+---------|
  * | DEV_CLOSE   |minor dev| proc nr |         |         |         |         |
  * |-------------+---------+---------+---------+---------+---------+---------|
+ * | DEV_SELECT  |minor dev| proc nr |   ops   |         |         |         |
+ * |-------------+---------+---------+---------+---------+---------+---------|
  * | CANCEL      |minor dev| proc nr |         |         |         |         |
  * ---------------------------------------------------------------------------
  */
@@ -71,6 +74,7 @@
 
 /* Macros for magic tty types. */
 #define isconsole(tp)	((tp) < tty_addr(NR_CONS))
+#define ispty(tp)	((tp) >= tty_addr(NR_CONS+NR_RS_LINES))
 
 /* Macros for magic tty structure pointers. */
 #define FIRST_TTY	tty_addr(0)
@@ -86,6 +90,7 @@
 #if NR_PTYS == 0
 #define pty_init(tp)	((void) 0)
 #define do_pty(tp, mp)	((void) 0)
+#define pty_select_retry(tp)	((void) 0)
 #endif
 
 FORWARD _PROTOTYPE( void do_cancel, (tty_t *tp, message *m_ptr)		);
@@ -94,6 +99,9 @@ FORWARD _PROTOTYPE( void do_open, (tty_t *tp, message *m_ptr)		);
 FORWARD _PROTOTYPE( void do_close, (tty_t *tp, message *m_ptr)		);
 FORWARD _PROTOTYPE( void do_read, (tty_t *tp, message *m_ptr)		);
 FORWARD _PROTOTYPE( void do_write, (tty_t *tp, message *m_ptr)		);
+FORWARD _PROTOTYPE( void do_select, (tty_t *tp, message *m_ptr)		);
+FORWARD _PROTOTYPE( int select_try, (tty_t *tp, int ops)			);
+FORWARD _PROTOTYPE( void select_retry, (tty_t *tp)			);
 FORWARD _PROTOTYPE( void in_transfer, (tty_t *tp)			);
 FORWARD _PROTOTYPE( int echo, (tty_t *tp, int ch)			);
 FORWARD _PROTOTYPE( void rawecho, (tty_t *tp, int ch)			);
@@ -203,6 +211,7 @@ PUBLIC void tty_task()
 	    case DEV_IOCTL:	do_ioctl(tp, &tty_mess);	break;
 	    case DEV_OPEN:	do_open(tp, &tty_mess);		break;
 	    case DEV_CLOSE:	do_close(tp, &tty_mess);	break;
+	    case DEV_SELECT:	do_select(tp, &tty_mess);	break;
 	    case CANCEL:	do_cancel(tp, &tty_mess);	break;
 	    default:		tty_reply(TASK_REPLY, tty_mess.m_source,
 						tty_mess.PROC_NR, EINVAL);
@@ -587,6 +596,72 @@ message *m_ptr;			/* pointer to message sent to task */
 }
 
 
+/*===========================================================================*
+ *				do_select				     *
+ *===========================================================================*/
+PRIVATE void do_select(tp, m_ptr)
+register tty_t *tp;		/* pointer to tty struct */
+message *m_ptr;			/* pointer to message sent to the task */
+{
+/* FS wants to know whether a read or write would block.  Return the
+ * operations that are ready.  If none are and FS asks to be notified, remember
+ * the request; select_retry() sends DEV_READY when things change.
+ */
+  int ops, ready;
+
+  ops = m_ptr->COUNT & (SEL_RD | SEL_WR | SEL_ERR);
+  ready = select_try(tp, ops);
+  if (ready == 0 && (m_ptr->COUNT & SEL_NOTIFY)) {
+	tp->tty_selops |= ops;
+	tp->tty_selcaller = m_ptr->m_source;
+	tp->tty_selminor = m_ptr->TTY_LINE;
+  }
+  tty_reply(TASK_REPLY, m_ptr->m_source, m_ptr->PROC_NR, ready);
+}
+
+
+/*===========================================================================*
+ *				select_try				     *
+ *===========================================================================*/
+PRIVATE int select_try(tp, ops)
+register tty_t *tp;		/* pointer to tty struct */
+int ops;			/* SEL_RD and/or SEL_WR */
+{
+/* Check which of the operations 'ops' would not block right now.  A call that
+ * fails at once, like a second read while another is hanging, counts as ready.
+ */
+  int ready = 0;
+
+  if (ops & SEL_RD) {
+	if (tp->tty_inleft > 0 || tp->tty_eotct > 0) ready |= SEL_RD;
+	if (!(tp->tty_termios.c_lflag & ICANON)
+		&& tp->tty_termios.c_cc[VMIN] == 0) ready |= SEL_RD;
+  }
+  if (ops & SEL_WR) {
+	if (tp->tty_outleft > 0 || !tp->tty_inhibited) ready |= SEL_WR;
+  }
+  return(ready);
+}
+
+
+/*===========================================================================*
+ *				select_retry				     *
+ *===========================================================================*/
+PRIVATE void select_retry(tp)
+register tty_t *tp;		/* pointer to tty struct */
+{
+/* Send DEV_READY to FS if an operation it is selecting on is now possible.
+ * The minor device goes in the REP_PROC_NR field, which is FS's DEVICE field.
+ */
+  int ready;
+
+  if ((ready = select_try(tp, tp->tty_selops)) != 0) {
+	tty_reply(DEV_READY, tp->tty_selcaller, tp->tty_selminor, ready);
+	tp->tty_selops = 0;
+  }
+}
+
+
 /*===========================================================================*
  *				do_cancel				     *
  *===========================================================================*/
@@ -667,6 +742,10 @@ tty_t *tp;			/* TTY to check for events. */
 								tp->tty_incum);
 	tp->tty_inleft = tp->tty_incum = 0;
   }
+
+  /* Tell FS about selects that can now be satisfied. */
+  if (tp->tty_selops != 0) select_retry(tp);
+  if (ispty(tp)) pty_select_retry(tp);
 }
 
 
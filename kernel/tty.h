@@ -57,6 +57,9 @@ typedef struct tty {
   char tty_ioproc;		/* process that wants to do an ioctl */
   int tty_ioreq;		/* ioctl request code */
   vir_bytes tty_iovir;		/* virtual address of ioctl buffer */
+  char tty_selops;		/* select operations FS waits for (SEL_RD...) */
+  char tty_selcaller;		/* process to tell (usually FS) */
+  int tty_selminor;		/* minor device the select was done on */
 
   /* Miscellaneous. */
   devfun_t tty_ioctl;		/* set line speed, etc. at the device level */
@@ -9,6 +9,7 @@
 #include	<errno.h>
 
 #ifdef DEBUG
+static assert_failed();
 #define	ASSERT(b)	if (!(b)) assert_failed();
 #else
 #define	ASSERT(b)	/* empty */
@@ -25,177 +26,260 @@
 #else
 #define BRKSIZE		4096
 #endif
-#define	PTRSIZE		((int) sizeof(void *))
+#define	WSIZE		sizeof(size_t)
+#define	ALIGNMENT	(2 * WSIZE)
+#define	MINCHUNK	(4 * WSIZE)	/* header, two links, footer */
+#define	MAXREQ		((size_t) -1 >> 1)
 #define Align(x,a)	(((x) + (a - 1)) & ~(a - 1))
-#define NextSlot(p)	(* (void **) ((p) - PTRSIZE))
-#define NextFree(p)	(* (void **) (p))
 
 /*
  * A short explanation of the data structure and algorithms.
- * An area returned by malloc() is called a slot. Each slot
- * contains the number of bytes requested, but preceeded by
- * an extra pointer to the next the slot in memory.
- * '_bottom' and '_top' point to the first/last slot.
- * More memory is asked for using brk() and appended to top.
- * The list of free slots is maintained to keep malloc() fast.
- * '_empty' points the the first free slot. Free slots are
- * linked together by a pointer at the start of the
- * user visable part, so just after the next-slot pointer.
- * Free slots are merged together by free().
+ * Memory is cut into chunks.  Each chunk starts with a header
+ * word holding its size, a multiple of ALIGNMENT, and two flags:
+ * C_INUSE if the chunk is handed out, C_PINUSE if the chunk just
+ * below it is.  malloc() returns the address just after the
+ * header, so the next chunk is found by adding the size.
+ * A free chunk also keeps its size in its last word, its
+ * footer, so free() finds a free chunk below in one step.  Free
+ * chunks are always merged, no two of them are ever adjacent.
+ * More memory is asked for using sbrk().  Every area obtained
+ * ends in a header of size 0 marked in use, '_top' points at the
+ * last one.  An area that follows on '_top' is added to it.
+ * Free chunks are kept in doubly linked lists, one per size
+ * class, so a chunk is taken out of its list without a search.
+ * Classes below NSMALL * ALIGNMENT bytes hold one size each,
+ * above it a class holds a power of two range of sizes.  The
+ * bits in '_binmap' tell which lists are not empty.
  */
 
+#define	C_INUSE		1
+#define	C_PINUSE	2
+#define	C_FLAGS		(C_INUSE | C_PINUSE)
+
+#define	Head(c)		(* (size_t *) (c))
+#define	Size(c)		(Head(c) & ~(size_t) C_FLAGS)
+#define	Foot(c)		(* (size_t *) ((c) + Size(c) - WSIZE))
+#define	PrevSize(c)	(* (size_t *) ((c) - WSIZE))
+#define	NextFree(c)	(* (char **) ((c) + WSIZE))
+#define	PrevFree(c)	(* (char **) ((c) + 2 * WSIZE))
+#define	Mem(c)		((void *) ((c) + WSIZE))
+#define	Chunk(p)	((char *) (p) - WSIZE)
+
+#define	NSMALL		64
+#define	NBINS		(NSMALL + 8 * sizeof(size_t))
+#define	MAPBITS		(8 * sizeof(unsigned))
+#define	MAPWORDS	((NBINS + MAPBITS - 1) / MAPBITS)
+
 extern void *_sbrk(int);
-extern int _brk(void *);
-static void *_bottom, *_top, *_empty;
+static char *_top, *_brkend;
+static char *_bins[NBINS];
+static unsigned _binmap[MAPWORDS];
+
+static int binof(size_t size)
+{
+  register size_t units = size / ALIGNMENT;
+  register int b;
+
+  if (units < NSMALL) return (int) units;
+  b = NSMALL;
+  for (units /= 2 * NSMALL; units != 0; units >>= 1)
+	b++;
+  return b;
+}
+
+static int nextbin(int b)
+{
+  register int i = b / MAPBITS;
+  register unsigned m;
+
+  if (i >= MAPWORDS) return -1;
+  m = _binmap[i] & (~0U << (b % MAPBITS));
+  while (m == 0) {
+	if (++i == MAPWORDS) return -1;
+	m = _binmap[i];
+  }
+  for (b = i * MAPBITS; (m & 1) == 0; m >>= 1)
+	b++;
+  return b;
+}
+
+static void link_free(char *c)
+{
+  register int b = binof(Size(c));
+
+  NextFree(c) = _bins[b];
+  PrevFree(c) = 0;
+  if (_bins[b]) PrevFree(_bins[b]) = c;
+  _bins[b] = c;
+  _binmap[b / MAPBITS] |= 1U << (b % MAPBITS);
+}
+
+static void unlink_free(char *c)
+{
+  register int b;
+
+  if (PrevFree(c))
+	NextFree(PrevFree(c)) = NextFree(c);
+  else {
+	b = binof(Size(c));
+	ASSERT(_bins[b] == c);
+	if ((_bins[b] = NextFree(c)) == 0)
+		_binmap[b / MAPBITS] &= ~(1U << (b % MAPBITS));
+  }
+  if (NextFree(c))
+	PrevFree(NextFree(c)) = PrevFree(c);
+}
+
+/*
+ * Turn chunk 'c' into a free chunk, merged with its free neighbours.
+ */
+static void release(register char *c)
+{
+  register size_t size = Size(c);
+  register char *next = c + size;
+
+  if (!(Head(c) & C_PINUSE)) {		/* merge with the chunk below */
+	c -= PrevSize(c);
+	unlink_free(c);
+	size += Size(c);
+  }
+  if (!(Head(next) & C_INUSE)) {	/* merge with the chunk above */
+	unlink_free(next);
+	size += Size(next);
+  }
+  Head(c) = size | C_PINUSE;
+  Foot(c) = size;
+  Head(c + size) &= ~C_PINUSE;
+  link_free(c);
+}
 
-static int grow(size_t len)
+/*
+ * Cut the chunk in use 'c' down to 'size' bytes, if the rest is big
+ * enough to be a chunk of its own.
+ */
+static void split(register char *c, size_t size)
+{
+  register char *rest;
+
+  if (Size(c) - size < MINCHUNK) return;
+  rest = c + size;
+  Head(rest) = (Size(c) - size) | C_INUSE | C_PINUSE;
+  Head(c) = size | (Head(c) & C_FLAGS);
+  release(rest);
+}
+
+static int grow(size_t size)
 {
-  register char *p;
-
-  ASSERT(NextSlot((char *)_top) == 0);
-  errno = ENOMEM;
-  if ((char *) _top + len < (char *) _top
-      || (p = (char *)Align((ptrint)_top + len, BRKSIZE)) < (char *) _top 
-      || _brk(p) != 0)
-	return(0);
-  NextSlot((char *)_top) = p;
-  NextSlot(p) = 0;
-  free(_top);
-  _top = p;
+  register char *p, *c, *end;
+  register size_t len;
+
+  if ((len = size + 2 * ALIGNMENT) < size) return 0;
+  len = Align(len, BRKSIZE);
+  if ((int) len <= 0 || (p = _sbrk((int) len)) == (char *) -1)
+	return 0;
+  end = p + len;
+  if (p == _brkend) {
+	c = _top;		/* the old end becomes the new chunk */
+  } else {
+	c = (char *) Align((ptrint) p + WSIZE, ALIGNMENT) - WSIZE;
+	Head(c) = C_PINUSE;
+  }
+  _top = c + (end - WSIZE - c) / ALIGNMENT * ALIGNMENT;
+  _brkend = end;
+  Head(c) = (_top - c) | C_INUSE | (Head(c) & C_PINUSE);
+  Head(_top) = C_INUSE;
+  release(c);
   return 1;
 }
 
 void *
 malloc(size_t size)
 {
-  register char *prev, *p, *next, *new;
-  register unsigned len, ntries;
+  register char *c;
+  register size_t n;
+  register int b;
 
   if (size == 0) return NULL;
-  errno = ENOMEM;
-  for (ntries = 0; ntries < 2; ntries++) {
-	if ((len = Align(size, PTRSIZE) + PTRSIZE) < 2 * PTRSIZE)
+  if (size > MAXREQ) {
+	errno = ENOMEM;
+	return NULL;
+  }
+  n = Align(size + WSIZE, ALIGNMENT);
+  if (n < MINCHUNK) n = MINCHUNK;
+  for (;;) {
+	b = binof(n);
+	c = _bins[b];
+	if (b >= NSMALL)	/* first fit within a class of sizes */
+		while (c != 0 && Size(c) < n)
+			c = NextFree(c);
+	if (c == 0 && (b = nextbin(b + 1)) >= 0)
+		c = _bins[b];	/* anything in a larger class fits */
+	if (c != 0)
+		break;
+	if (grow(n) == 0) {
+		errno = ENOMEM;
 		return NULL;
-	if (_bottom == 0) {
-		if ((p = _sbrk(2 * PTRSIZE)) == (char *) -1)
-			return NULL;
-		p = (char *) Align((ptrint)p, PTRSIZE);
-		p += PTRSIZE;
-		_top = _bottom = p;
-		NextSlot(p) = 0;
 	}
+  }
 #ifdef SLOWDEBUG
-	for (p = _bottom; (next = NextSlot(p)) != 0; p = next)
-		ASSERT(next > p);
-	ASSERT(p == _top);
+  ASSERT(!(Head(c) & C_INUSE) && Foot(c) == Size(c));
 #endif
-	for (prev = 0, p = _empty; p != 0; prev = p, p = NextFree(p)) {
-		next = NextSlot(p);
-		new = p + len;	/* easily overflows!! */
-		if (new > next || new <= p)
-			continue;		/* too small */
-		if (new + PTRSIZE < next) {	/* too big, so split */
-			/* + PTRSIZE avoids tiny slots on free list */
-			NextSlot(new) = next;
-			NextSlot(p) = new;
-			NextFree(new) = NextFree(p);
-			NextFree(p) = new;
-		}
-		if (prev)
-			NextFree(prev) = NextFree(p);
-		else
-			_empty = NextFree(p);
-		return p;
-	}
-	if (grow(len) == 0)
-		break;
-  }
-  ASSERT(ntries != 2);
-  return NULL;
+  unlink_free(c);
+  Head(c) |= C_INUSE;
+  Head(c + Size(c)) |= C_PINUSE;
+  split(c, n);
+  return Mem(c);
 }
 
 void *
 realloc(void *oldp, size_t size)
 {
-  register char *prev, *p, *next, *new;
-  char *old = oldp;
-  register size_t len, n;
+  register char *c, *next;
+  register size_t n, len;
+  void *new;
 
-  if (!old) return malloc(size);
+  if (!oldp) return malloc(size);
   else if (!size) {
 	free(oldp);
 	return NULL;
   }
-  len = Align(size, PTRSIZE) + PTRSIZE;
-  next = NextSlot(old);
-  n = (int)(next - old);			/* old length */
-  /*
-   * extend old if there is any free space just behind it
-   */
-  for (prev = 0, p = _empty; p != 0; prev = p, p = NextFree(p)) {
-	if (p > next)
-		break;
-	if (p == next) {	/* 'next' is a free slot: merge */
-		NextSlot(old) = NextSlot(p);
-		if (prev)
-			NextFree(prev) = NextFree(p);
-		else
-			_empty = NextFree(p);
-		next = NextSlot(old);
-		break;
-	}
+  if (size > MAXREQ) {
+	errno = ENOMEM;
+	return NULL;
   }
-  new = old + len;
+  n = Align(size + WSIZE, ALIGNMENT);
+  if (n < MINCHUNK) n = MINCHUNK;
+  c = Chunk(oldp);
+  ASSERT(Head(c) & C_INUSE);
+  len = Size(c);				/* old length */
   /*
-   * Can we use the old, possibly extended slot?
+   * extend old if there is a free chunk just behind it
    */
-  if (new <= next && new >= old) {		/* it does fit */
-	if (new + PTRSIZE < next) {		/* too big, so split */
-		/* + PTRSIZE avoids tiny slots on free list */
-		NextSlot(new) = next;
-		NextSlot(old) = new;
-		free(new);
-	}
-	return old;
+  next = c + len;
+  if (len < n && !(Head(next) & C_INUSE) && len + Size(next) >= n) {
+	unlink_free(next);
+	len += Size(next);
+	Head(c) = len | (Head(c) & C_FLAGS);
+	Head(c + len) |= C_PINUSE;
+  }
+  if (len >= n) {				/* it does fit */
+	split(c, n);
+	return oldp;
   }
   if ((new = malloc(size)) == NULL)		/* it didn't fit */
 	return NULL;
-  memcpy(new, old, n);				/* n < size */
-  free(old);
+  memcpy(new, oldp, len - WSIZE);		/* len - WSIZE < size */
+  free(oldp);
   return new;
 }
 
 void
 free(void *ptr)
 {
-  register char *prev, *next;
-  char *p = ptr;
-
-  if (!p) return;
+  if (!ptr) return;
 
-  ASSERT(NextSlot(p) > p);
-  for (prev = 0, next = _empty; next != 0; prev = next, next = NextFree(next))
-	if (p < next)
-		break;
-  NextFree(p) = next;
-  if (prev)
-	NextFree(prev) = p;
-  else
-	_empty = p;
-  if (next) {
-	ASSERT(NextSlot(p) <= next);
-	if (NextSlot(p) == next) {		/* merge p and next */
-		NextSlot(p) = NextSlot(next);
-		NextFree(p) = NextFree(next);
-	}
-  }
-  if (prev) {
-	ASSERT(NextSlot(prev) <= p);
-	if (NextSlot(prev) == p) {		/* merge prev and p */
-		NextSlot(prev) = NextSlot(p);
-		NextFree(prev) = NextFree(p);
-	}
-  }
+  ASSERT(Head(Chunk(ptr)) & C_INUSE);
+  release(Chunk(ptr));
 }
 
 #ifdef DEBUG
@@ -0,0 +1,92 @@
+!	oneC_sum() - One complement's checksum
+! See RFC 1071, "Computing the Internet checksum"
+! See also the C version in src/lib/ip/oneC_sum.c.
+
+.sect .text; .sect .rom; .sect .data; .sect .bss
+.sect .text
+
+! u16_t oneC_sum(U16_t prev, void *data, size_t size)
+!	Add the 16 bit words of a block to a one's complement sum.  The block
+!	is summed 32 bits at a time, 16 bytes per loop.  If the block starts
+!	on an odd address then the sum is computed byte swapped.
+
+.define	_oneC_sum
+	.align	16
+_oneC_sum:
+	push	ebp
+	mov	ebp, esp
+	push	esi
+	push	edi
+	movzx	eax, 8(ebp)	! Previous sum
+	mov	esi, 12(ebp)	! Data
+	mov	ecx, 16(ebp)	! Length
+	xor	edi, edi	! Not swapped
+	test	esi, 1
+	jz	even
+	inc	edi		! Odd address, sum byte swapped
+	xchgb	al, ah
+	test	ecx, ecx
+	jz	fold
+	movzxb	edx, (esi)	! First byte is the high byte of a word
+	shl	edx, 8
+	add	eax, edx
+	inc	esi
+	dec	ecx
+even:	cmp	ecx, 2
+	jb	tail
+	test	esi, 2
+	jz	aligned
+	movzx	edx, (esi)	! One word to get longword alignment
+	add	eax, edx
+	add	esi, 2
+	sub	ecx, 2
+aligned:mov	edx, ecx
+	shr	ecx, 4		! Number of 16 byte blocks
+	jz	longs
+	clc
+sum16:	adc	eax, 0(esi)
+	adc	eax, 4(esi)
+	adc	eax, 8(esi)
+	adc	eax, 12(esi)
+	lea	esi, 16(esi)
+	dec	ecx		! Keeps the carry
+	jnz	sum16
+	adc	eax, 0
+longs:	mov	ecx, edx
+	and	ecx, 15
+	shr	ecx, 2		! Number of longwords left
+	jz	word
+sum4:	add	eax, (esi)
+	adc	eax, 0
+	lea	esi, 4(esi)
+	dec	ecx
+	jnz	sum4
+word:	mov	ecx, edx
+	and	ecx, 3
+tail:	cmp	ecx, 2
+	jb	byte
+	movzx	edx, (esi)	! Last word
+	add	eax, edx
+	adc	eax, 0
+	add	esi, 2
+	sub	ecx, 2
+byte:	test	ecx, ecx
+	jz	fold
+	movzxb	edx, (esi)	! Last byte is the low byte of a word
+	add	eax, edx
+	adc	eax, 0
+fold:	mov	edx, eax	! Fold 32 bits into 16
+	shr	edx, 16
+	and	eax, 0xFFFF
+	add	eax, edx
+	mov	edx, eax
+	shr	edx, 16
+	add	eax, edx
+	and	eax, 0xFFFF
+	test	edi, edi
+	jz	done
+	xchgb	al, ah		! Undo the byte swap
+done:	pop	edi
+	pop	esi
+	pop	ebp
+	ret
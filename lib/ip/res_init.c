@@ -23,6 +23,8 @@ static char sccsid[] = "@(#)res_init.c	6.14 (Berkeley) 6/27/90";
 
 #if _MINIX
 #include <sys/types.h>
+#include <errno.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -51,6 +53,26 @@ static char sccsid[] = "@(#)res_init.c	6.14 (Berkeley) 6/27/90";
  */
 struct state _res;
 
+#if _MINIX
+/*
+ * Is the caching name daemon nonamed running on this machine?
+ */
+static int
+nonamed_running()
+{
+	FILE *fp;
+	long pid;
+	int r;
+
+	if ((fp = fopen(_PATH_NONAMED, "r")) == NULL)
+		return 0;
+	r = fscanf(fp, "%ld", &pid) == 1 && pid > 0 &&
+		(kill((pid_t) pid, 0) == 0 || errno == EPERM);
+	(void) fclose(fp);
+	return r;
+}
+#endif
+
 /*
  * Set up default settings.  If the configuration file exist, the values
  * there will have precedence.  Otherwise, the server address is set to
@@ -164,6 +186,20 @@ res_init()
 	    }
 	    (void) fclose(fp);
 	}
+#if _MINIX
+	if (_res.nscount > 0 && _res.nsaddr_list[0] != HTONL(0x7F000001)
+						&& nonamed_running()) {
+		/* Ask the local cache first, the others if it fails. */
+		for (n = MAXNS-1; n > 0; n--) {
+			_res.nsaddr_list[n]= _res.nsaddr_list[n-1];
+			_res.nsport_list[n]= _res.nsport_list[n-1];
+		}
+		_res.nsaddr_list[0]= HTONL(0x7F000001);
+		_res.nsport_list[0]= nameserver_port;
+		if (_res.nscount < MAXNS)
+			_res.nscount++;
+	}
+#endif
 	if (_res.nscount == 0) {
 		/* "localhost" is the default nameserver. */
 		_res.nsaddr_list[0]= HTONL(0x7F000001);
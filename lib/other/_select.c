@@ -0,0 +1,27 @@
+/* select.c - Systemcall interface to fs/select.c::do_select() */
+
+#include <lib.h>
+#define select	_select
+#include <sys/select.h>
+#include <limits.h>
+
+int select(nfds, readfds, writefds, exceptfds, timeout)
+int nfds;
+fd_set *readfds, *writefds, *exceptfds;
+struct timeval *timeout;
+{
+  message m;
+
+  m.m1_i1 = nfds;
+  m.m1_p1 = (char *) readfds;
+  m.m1_p2 = (char *) writefds;
+  m.m1_p3 = (char *) exceptfds;
+  if (timeout == NULL) {
+	m.m1_i2 = -1;			/* wait forever */
+	m.m1_i3 = 0;
+  } else {
+	m.m1_i2 = timeout->tv_sec > INT_MAX ? INT_MAX : (int) timeout->tv_sec;
+	m.m1_i3 = (int) ((timeout->tv_usec + 999) / 1000);
+  }
+  return(_syscall(FS, SELECT, &m));
+}
@@ -30,13 +30,13 @@ __fillbuf(register FILE *stream)
 		stream->_flags |= _IOREADING;
 	
 	if (!io_testflag(stream, _IONBF) && !stream->_buf) {
-		stream->_buf = (unsigned char *) malloc(BUFSIZ);
+		stream->_buf = (unsigned char *) malloc(_IOBUFSIZ);
 		if (!stream->_buf) {
 			stream->_flags |= _IONBF;
 		}
 		else {
 			stream->_flags |= _IOMYBUF;
-			stream->_bufsiz = BUFSIZ;
+			stream->_bufsiz = _IOBUFSIZ;
 		}
 	}
 
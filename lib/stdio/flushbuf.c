@@ -52,13 +52,13 @@ __flushbuf(int c, FILE * stream)
 				}
 			} else {
 				if (!(stream->_buf =
-					    (unsigned char *) malloc(BUFSIZ))) {
+					(unsigned char *) malloc(_IOBUFSIZ))) {
 					stream->_flags |= _IONBF;
 				} else {
 					stream->_flags |= _IOMYBUF;
-					stream->_bufsiz = BUFSIZ;
+					stream->_bufsiz = _IOBUFSIZ;
 					if (!io_testflag(stream, _IOLBF))
-						stream->_count = BUFSIZ - 1;
+						stream->_count = _IOBUFSIZ - 1;
 					else	stream->_count = -1;
 				}
 			}
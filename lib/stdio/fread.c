@@ -3,27 +3,73 @@
  */
 /* $Header: fread.c,v 1.2 89/12/18 15:02:09 eck Exp $ */
 
+#include	<sys/types.h>
 #include	<stdio.h>
+#include	<string.h>
+#include	<limits.h>
+#include	"loc_incl.h"
+
+ssize_t _read(int d, char *buf, size_t nbytes);
 
 size_t
 fread(void *ptr, size_t size, size_t nmemb, register FILE *stream)
 {
 	register char *cp = ptr;
-	register int c;
-	size_t ndone = 0;
-	register size_t s;
-
-	if (size)
-		while ( ndone < nmemb ) {
-			s = size;
-			do {
-				if ((c = getc(stream)) != EOF)
-					*cp++ = c;
+	register size_t n, left;
+	size_t total;
+	ssize_t r;
+	int c, i;
+
+	if (size == 0 || nmemb == 0)
+		return 0;
+	if (nmemb > (size_t) -1 / size)
+		nmemb = (size_t) -1 / size;
+	total = left = size * nmemb;
+
+	while (left > 0) {
+		if (!io_testflag(stream, _IOREADING)
+		    || io_testflag(stream, (_IOEOF | _IOERR))) {
+			/* let __fillbuf() check and set up the stream */
+		} else if (stream->_count > 0) {
+			/* take what the buffer holds */
+			n = left;
+			if (n > stream->_count) n = stream->_count;
+			memcpy(cp, stream->_ptr, n);
+			stream->_ptr += n;
+			stream->_count -= n;
+			cp += n;
+			left -= n;
+			continue;
+		} else if (left >= stream->_bufsiz) {
+			/* read whole buffers directly into the array */
+			n = left;
+			if (stream->_bufsiz > 1) n -= n % stream->_bufsiz;
+			if (n > INT_MAX) n = INT_MAX;
+
+			/* flush line-buffered output, as __fillbuf() does */
+			for (i = 0; i < FOPEN_MAX; i++) {
+				if (__iotab[i]
+				    && io_testflag(__iotab[i], _IOLBF)
+				    && io_testflag(__iotab[i], _IOWRITING))
+					(void) fflush(__iotab[i]);
+			}
+
+			if ((r = _read(stream->_fd, cp, n)) <= 0) {
+				if (r == 0)
+					stream->_flags |= _IOEOF;
 				else
-					return ndone;
-			} while (--s);
-			ndone++;
+					stream->_flags |= _IOERR;
+				break;
+			}
+			cp += r;
+			left -= r;
+			continue;
 		}
+		if ((c = __fillbuf(stream)) == EOF)
+			break;
+		*cp++ = c;
+		left--;
+	}
 
-	return ndone;
+	return (total - left) / size;
 }
@@ -3,27 +3,74 @@
  */
 /* $Header: fwrite.c,v 1.3 89/12/18 15:02:39 eck Exp $ */
 
+#include	<sys/types.h>
 #include	<stdio.h>
+#include	<string.h>
+#include	<limits.h>
+#include	"loc_incl.h"
+
+ssize_t _write(int d, const char *buf, size_t nbytes);
+off_t _lseek(int fildes, off_t offset, int whence);
 
 size_t
 fwrite(const void *ptr, size_t size, size_t nmemb,
 	    register FILE *stream)
 {
 	register const unsigned char *cp = ptr;
-	register size_t s;
-	size_t ndone = 0;
+	register size_t n, left;
+	size_t total;
+	ssize_t r;
+
+	if (size == 0 || nmemb == 0)
+		return 0;
+	if (nmemb > (size_t) -1 / size)
+		nmemb = (size_t) -1 / size;
+	total = left = size * nmemb;
 
-	if (size)
-		while ( ndone < nmemb ) {
-			s = size;
-			do {
-				if (putc((int)*cp, stream)
-					== EOF)
-					return ndone;
-				cp++;
-			} 
-			while (--s);
-			ndone++;
+	while (left > 0) {
+		if (!io_testflag(stream, _IOWRITING)
+		    || io_testflag(stream, _IOLBF)) {
+			/* let __flushbuf() check the stream, and look
+			 * for newlines
+			 */
+		} else if (stream->_count > 0) {
+			/* fill the buffer */
+			n = left;
+			if (n > stream->_count) n = stream->_count;
+			memcpy(stream->_ptr, cp, n);
+			stream->_ptr += n;
+			stream->_count -= n;
+			cp += n;
+			left -= n;
+			continue;
+		} else if (io_testflag(stream, _IONBF)
+			   || left >= stream->_bufsiz) {
+			/* write whole buffers directly from the array */
+			if (fflush(stream) == EOF)
+				break;
+			n = left;
+			if (stream->_bufsiz > 1) n -= n % stream->_bufsiz;
+			if (n > INT_MAX) n = INT_MAX;
+			if (io_testflag(stream, _IOAPPEND)) {
+				if (_lseek(fileno(stream), 0L,
+							SEEK_END) == -1) {
+					stream->_flags |= _IOERR;
+					break;
+				}
+			}
+			if ((r = _write(stream->_fd, (char *)cp, n)) <= 0) {
+				stream->_flags |= _IOERR;
+				break;
+			}
+			cp += r;
+			left -= r;
+			continue;
 		}
-	return ndone;
+		if (putc((int)*cp, stream) == EOF)
+			break;
+		cp++;
+		left--;
+	}
+
+	return (total - left) / size;
 }
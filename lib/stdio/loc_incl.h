@@ -7,6 +7,15 @@
 
 #define	io_testflag(p,x)	((p)->_flags & (x))
 
+/* The size of the buffers stdio allocates for files.  FS reads and writes
+ * several blocks in one request, so a bigger buffer means fewer requests.
+ */
+#if	_EM_WSIZE == 2
+#define	_IOBUFSIZ	BUFSIZ
+#else
+#define	_IOBUFSIZ	(8 * BUFSIZ)
+#endif
+
 #include	<stdarg.h>
 
 #ifdef _ANSI
@@ -0,0 +1,7 @@
+.sect .text
+.extern	__select
+.define	_select
+.align 2
+
+_select:
+	jmp	__select
@@ -309,7 +309,7 @@ phys_bytes tot_bytes;		/* total memory to allocate, including gap */
   phys_clicks base, size;
 #else
   static char zero[1024];		/* used to zero bss */
-  phys_bytes bytes, base, count, bss_offset;
+  phys_bytes bytes, base, count, done, bss_offset;
 #endif
 
   /* No need to allocate text if it can be shared. */
@@ -382,21 +382,30 @@ phys_bytes tot_bytes;		/* total memory to allocate, including gap */
 #if (SHADOWING == 0)
   sys_newmap(who, rmp->mp_seg);   /* report new map to the kernel */
 
-  /* Zero the bss, gap, and stack segment. */
+  /* Zero the bss, gap, and stack segment.  Only the first chunk comes from
+   * the zero buffer in MM.  After that the part of the new image that is
+   * already zero is copied onto the part following it, so the zeroed area
+   * doubles with each call.  A program with a large gap used to cost one
+   * kernel call per kilobyte before it could execute its first instruction,
+   * now it costs a handful.
+   */
   bytes = (phys_bytes)(data_clicks + gap_clicks + stack_clicks) << CLICK_SHIFT;
   base = (phys_bytes) rmp->mp_seg[D].mem_phys << CLICK_SHIFT;
   bss_offset = (data_bytes >> CLICK_SHIFT) << CLICK_SHIFT;
   base += bss_offset;
   bytes -= bss_offset;
 
-  while (bytes > 0) {
+  if (bytes > 0) {
 	count = MIN(bytes, (phys_bytes) sizeof(zero));
 	if (sys_copy(MM_PROC_NR, D, (phys_bytes) zero,
 						ABS, 0, base, count) != OK) {
 		panic("new_mem can't zero", NO_NUM);
 	}
-	base += count;
-	bytes -= count;
+	for (done = count; done < bytes; done += count) {
+		count = MIN(bytes - done, done);
+		if (sys_copy(ABS, 0, base, ABS, 0, base + done, count) != OK)
+			panic("new_mem can't zero", NO_NUM);
+	}
   }
 #endif
 
@@ -0,0 +1,150 @@
+/* test41: pipe() data transfer */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+
+#define MAX_ERROR	4
+#define BIGSIZE		100000L	/* bytes pushed through the pipe in test41a */
+
+#include "common.c"
+
+char buf[PIPE_BUF + 1];
+
+_PROTOTYPE(int main, (int argc, char *argv []));
+_PROTOTYPE(void test41a, (void));
+_PROTOTYPE(void test41b, (void));
+_PROTOTYPE(void test41c, (void));
+
+int main(argc, argv)
+int argc;
+char *argv[];
+{
+  int i, m = 0xFFFF;
+
+  start(41);
+  if (argc == 2) m = atoi(argv[1]);
+  for (i = 0; i < 3; i++) {
+	if (m & 0001) test41a();
+	if (m & 0002) test41b();
+	if (m & 0004) test41c();
+  }
+  quit();
+  return(-1);			/* impossible */
+}
+
+void test41a()
+{
+/* Push a lot of data through a pipe in odd sized pieces, so the data wraps
+ * around in the pipe many times, and check that it arrives intact.
+ */
+  int fds[2], i, n, chunk, status;
+  long sent, got;
+
+  subtest = 1;
+  if (pipe(fds) != 0) e(1);
+  switch (fork()) {
+      case -1:	e(2);	break;
+      case 0:
+	alarm(60);
+	close(fds[0]);
+	chunk = 1;
+	for (sent = 0; sent < BIGSIZE; sent += n) {
+		n = chunk;
+		if (n > BIGSIZE - sent) n = (int) (BIGSIZE - sent);
+		for (i = 0; i < n; i++) buf[i] = (char) (sent + i);
+		if (write(fds[1], buf, n) != n) exit(1);
+		chunk = (chunk * 7 + 13) % PIPE_BUF + 1;
+	}
+	exit(0);
+      default:
+	close(fds[1]);
+	got = 0;
+	chunk = 3;
+	while ((n = read(fds[0], buf, chunk)) > 0) {
+		for (i = 0; i < n; i++)
+			if (buf[i] != (char) (got + i)) e(3);
+		got += n;
+		chunk = (chunk * 5 + 11) % PIPE_BUF + 1;
+	}
+	if (n != 0) e(4);
+	if (got != BIGSIZE) e(5);
+	if (wait(&status) == -1) e(6);
+	if (status != 0) e(7);
+	if (close(fds[0]) != 0) e(8);
+  }
+}
+
+void test41b()
+{
+/* Non-blocking writes: a pipe holds at least PIPE_BUF bytes, a write of at
+ * most PIPE_BUF bytes is all or nothing, and fstat() tells what is in it.
+ */
+  int fds[2], n;
+  long total;
+  struct stat st;
+
+  subtest = 2;
+  if (pipe(fds) != 0) e(1);
+  if (fcntl(fds[1], F_SETFL, O_NONBLOCK) != 0) e(2);
+  memset(buf, 'x', sizeof(buf));
+  total = 0;
+  while ((n = write(fds[1], buf, 100)) == 100) total += n;
+  if (n != -1 || errno != EAGAIN) e(3);
+  if (total < PIPE_BUF) e(4);
+  if (fstat(fds[0], &st) != 0) e(5);
+  if (st.st_size != total) e(6);
+
+  /* Make room for less than PIPE_BUF bytes. */
+  if (read(fds[0], buf, 50) != 50) e(7);
+  if (write(fds[1], buf, PIPE_BUF) != -1) e(8);
+  if (errno != EAGAIN) e(9);
+  if (write(fds[1], buf, 50) != 50) e(10);
+
+  /* Drain the pipe. */
+  if (fcntl(fds[0], F_SETFL, O_NONBLOCK) != 0) e(11);
+  while ((n = read(fds[0], buf, sizeof(buf))) > 0) total -= n;
+  if (n != -1 || errno != EAGAIN) e(12);
+  if (total != 0) e(13);
+  if (close(fds[0]) != 0) e(14);
+  if (close(fds[1]) != 0) e(15);
+}
+
+void test41c()
+{
+/* A reader that is waiting gets what a writer writes at once, a reader that
+ * finds no writer gets end of file, and a writer without readers gets EPIPE.
+ */
+  int fds[2], status;
+
+  subtest = 3;
+  if (pipe(fds) != 0) e(1);
+  switch (fork()) {
+      case -1:	e(2);	break;
+      case 0:
+	alarm(20);
+	close(fds[0]);
+	sleep(1);		/* let the parent block on the read */
+	if (write(fds[1], "hello", 5) != 5) exit(1);
+	exit(0);
+      default:
+	close(fds[1]);
+	if (read(fds[0], buf, sizeof(buf)) != 5) e(3);
+	if (strncmp(buf, "hello", 5) != 0) e(4);
+	if (read(fds[0], buf, sizeof(buf)) != 0) e(5);
+	if (wait(&status) == -1) e(6);
+	if (status != 0) e(7);
+	if (close(fds[0]) != 0) e(8);
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+  if (pipe(fds) != 0) e(9);
+  if (close(fds[0]) != 0) e(10);
+  if (write(fds[1], "x", 1) != -1) e(11);
+  if (errno != EPIPE) e(12);
+  if (close(fds[1]) != 0) e(13);
+  signal(SIGPIPE, SIG_DFL);
+}
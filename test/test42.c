@@ -0,0 +1,134 @@
+/* test42: select() */
+
+#include <sys/types.h>
+#include <sys/select.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+
+#define MAX_ERROR	4
+
+#include "common.c"
+
+char buf[PIPE_BUF + 1];
+
+_PROTOTYPE(int main, (int argc, char *argv []));
+_PROTOTYPE(void test42a, (void));
+_PROTOTYPE(void test42b, (void));
+_PROTOTYPE(void test42c, (void));
+
+int main(argc, argv)
+int argc;
+char *argv[];
+{
+  int i, m = 0xFFFF;
+
+  start(42);
+  if (argc == 2) m = atoi(argv[1]);
+  for (i = 0; i < 3; i++) {
+	if (m & 0001) test42a();
+	if (m & 0002) test42b();
+	if (m & 0004) test42c();
+  }
+  quit();
+  return(-1);			/* impossible */
+}
+
+void test42a()
+{
+/* Polling a pipe with a zero timeout: an empty pipe can be written but not
+ * read, a full one can be read but not written.
+ */
+  int fds[2];
+  fd_set rd, wr;
+  struct timeval tv;
+
+  subtest = 1;
+  if (pipe(fds) != 0) e(1);
+  FD_ZERO(&rd); FD_SET(fds[0], &rd);
+  FD_ZERO(&wr); FD_SET(fds[1], &wr);
+  tv.tv_sec = tv.tv_usec = 0;
+  if (select(fds[1] + 1, &rd, &wr, (fd_set *) NULL, &tv) != 1) e(2);
+  if (FD_ISSET(fds[0], &rd)) e(3);
+  if (!FD_ISSET(fds[1], &wr)) e(4);
+
+  /* Fill the pipe. */
+  if (fcntl(fds[1], F_SETFL, O_NONBLOCK) != 0) e(5);
+  memset(buf, 'x', sizeof(buf));
+  while (write(fds[1], buf, PIPE_BUF) == PIPE_BUF) ;
+  FD_ZERO(&rd); FD_SET(fds[0], &rd);
+  FD_ZERO(&wr); FD_SET(fds[1], &wr);
+  if (select(fds[1] + 1, &rd, &wr, (fd_set *) NULL, &tv) != 1) e(6);
+  if (!FD_ISSET(fds[0], &rd)) e(7);
+  if (FD_ISSET(fds[1], &wr)) e(8);
+
+  /* A closed writer makes the read side ready. */
+  if (close(fds[1]) != 0) e(9);
+  while (read(fds[0], buf, sizeof(buf)) > 0) ;
+  FD_ZERO(&rd); FD_SET(fds[0], &rd);
+  if (select(fds[0] + 1, &rd, (fd_set *) NULL, (fd_set *) NULL, &tv) != 1)
+	e(10);
+  if (close(fds[0]) != 0) e(11);
+
+  /* Bad descriptors. */
+  FD_ZERO(&rd); FD_SET(fds[0], &rd);
+  if (select(fds[0] + 1, &rd, (fd_set *) NULL, (fd_set *) NULL, &tv) != -1)
+	e(12);
+  if (errno != EBADF) e(13);
+  if (select(-1, (fd_set *) NULL, (fd_set *) NULL, (fd_set *) NULL, &tv)
+	!= -1) e(14);
+  if (errno != EINVAL) e(15);
+}
+
+void test42b()
+{
+/* A select that finds nothing ready times out and clears the sets. */
+  int fds[2];
+  fd_set rd;
+  struct timeval tv;
+  time_t t0;
+
+  subtest = 2;
+  if (pipe(fds) != 0) e(1);
+  FD_ZERO(&rd); FD_SET(fds[0], &rd);
+  tv.tv_sec = 2;
+  tv.tv_usec = 0;
+  t0 = time((time_t *) NULL);
+  if (select(fds[0] + 1, &rd, (fd_set *) NULL, (fd_set *) NULL, &tv) != 0)
+	e(2);
+  if (time((time_t *) NULL) - t0 < 1) e(3);
+  if (FD_ISSET(fds[0], &rd)) e(4);
+  if (close(fds[0]) != 0) e(5);
+  if (close(fds[1]) != 0) e(6);
+}
+
+void test42c()
+{
+/* A process waiting in select is woken up when another writes on the pipe. */
+  int fds[2], status;
+  fd_set rd;
+
+  subtest = 3;
+  if (pipe(fds) != 0) e(1);
+  switch (fork()) {
+      case -1:	e(2);	break;
+      case 0:
+	alarm(20);
+	close(fds[0]);
+	sleep(1);		/* let the parent block in select */
+	if (write(fds[1], "x", 1) != 1) exit(1);
+	exit(0);
+      default:
+	close(fds[1]);
+	FD_ZERO(&rd); FD_SET(fds[0], &rd);
+	if (select(fds[0] + 1, &rd, (fd_set *) NULL, (fd_set *) NULL,
+		(struct timeval *) NULL) != 1) e(3);
+	if (!FD_ISSET(fds[0], &rd)) e(4);
+	if (read(fds[0], buf, 1) != 1) e(5);
+	if (wait(&status) == -1) e(6);
+	if (status != 0) e(7);
+	if (close(fds[0]) != 0) e(8);
+  }
+}
@@ -0,0 +1,136 @@
+/* test43: fcntl() record locks on many regions */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <signal.h>
+
+#define MAX_ERROR	4
+#define NLOCKS		12	/* more than the lock table used to hold */
+
+#include "common.c"
+
+_PROTOTYPE(int main, (int argc, char *argv []));
+_PROTOTYPE(void test43a, (void));
+_PROTOTYPE(void test43b, (void));
+_PROTOTYPE(int setlock, (int fd, int cmd, int type, long start, long len));
+
+int main(argc, argv)
+int argc;
+char *argv[];
+{
+  int i, m = 0xFFFF;
+
+  start(43);
+  if (argc == 2) m = atoi(argv[1]);
+  for (i = 0; i < 3; i++) {
+	if (m & 0001) test43a();
+	if (m & 0002) test43b();
+  }
+  quit();
+  return(-1);			/* impossible */
+}
+
+int setlock(fd, cmd, type, start, len)
+int fd, cmd, type;
+long start, len;
+{
+  struct flock fl;
+
+  fl.l_type = type;
+  fl.l_whence = SEEK_SET;
+  fl.l_start = start;
+  fl.l_len = len;
+  return(fcntl(fd, cmd, &fl));
+}
+
+void test43a()
+{
+/* Lock many separate bytes, split a lock, and check what another process
+ * sees.  Closing the file drops all locks.
+ */
+  int fd, i, status;
+  struct flock fl;
+
+  subtest = 1;
+  if ((fd = open("T43a", O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0) e(1);
+  for (i = 0; i < NLOCKS; i++)
+	if (setlock(fd, F_SETLK, F_WRLCK, 2L * i, 1L) != 0) e(2);
+  if (setlock(fd, F_SETLK, F_WRLCK, 1000L, 100L) != 0) e(3);
+  if (setlock(fd, F_SETLK, F_UNLCK, 1040L, 10L) != 0) e(4);
+
+  switch (fork()) {
+      case -1:	e(5);	break;
+      case 0:
+	alarm(20);
+	fd = open("T43a", O_RDWR);
+	for (i = 0; i < NLOCKS; i++) {
+		if (setlock(fd, F_SETLK, F_WRLCK, 2L * i, 1L) != -1) exit(1);
+		if (errno != EAGAIN) exit(2);
+		if (setlock(fd, F_SETLK, F_WRLCK, 2L * i + 1, 1L) != 0)
+			exit(3);
+	}
+	fl.l_type = F_WRLCK;
+	fl.l_whence = SEEK_SET;
+	fl.l_start = 1045;
+	fl.l_len = 1;
+	if (fcntl(fd, F_GETLK, &fl) != 0) exit(4);
+	if (fl.l_type != F_UNLCK) exit(5);
+	fl.l_start = 1055;
+	if (fcntl(fd, F_GETLK, &fl) != 0) exit(6);
+	if (fl.l_type != F_WRLCK) exit(7);
+	if (fl.l_start != 1050 || fl.l_len != 50) exit(8);
+	if (fl.l_pid != getppid()) exit(9);
+	exit(0);
+      default:
+	if (wait(&status) == -1) e(6);
+	if (status != 0) e(7);
+  }
+
+  /* All locks are gone after a close. */
+  if (close(fd) != 0) e(8);
+  switch (fork()) {
+      case -1:	e(9);	break;
+      case 0:
+	alarm(20);
+	fd = open("T43a", O_RDWR);
+	if (setlock(fd, F_SETLK, F_WRLCK, 0L, 0L) != 0) exit(1);
+	exit(0);
+      default:
+	if (wait(&status) == -1) e(10);
+	if (status != 0) e(11);
+  }
+  if (unlink("T43a") != 0) e(12);
+}
+
+void test43b()
+{
+/* A process waiting for a lock gets it when the region is unlocked, and not
+ * when some other region is.
+ */
+  int fd, status, pid;
+
+  subtest = 2;
+  if ((fd = open("T43b", O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0) e(1);
+  if (setlock(fd, F_SETLK, F_WRLCK, 0L, 10L) != 0) e(2);
+  if (setlock(fd, F_SETLK, F_WRLCK, 20L, 10L) != 0) e(3);
+
+  switch (pid = fork()) {
+      case -1:	e(4);	break;
+      case 0:
+	alarm(20);
+	fd = open("T43b", O_RDWR);
+	if (setlock(fd, F_SETLKW, F_WRLCK, 20L, 10L) != 0) exit(1);
+	exit(0);
+      default:
+	sleep(1);		/* let the child block */
+	if (setlock(fd, F_SETLK, F_UNLCK, 0L, 10L) != 0) e(5);
+	sleep(1);
+	if (waitpid(pid, &status, WNOHANG) != 0) e(6);
+	if (setlock(fd, F_SETLK, F_UNLCK, 20L, 10L) != 0) e(7);
+	if (waitpid(pid, &status, 0) != pid) e(8);
+	if (status != 0) e(9);
+  }
+  if (close(fd) != 0) e(10);
+  if (unlink("T43b") != 0) e(11);
+}
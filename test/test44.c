@@ -0,0 +1,134 @@
+/* test44: malloc(), realloc() and free() under load.  Time it to compare
+ * allocators.
+ */
+
+#include <sys/types.h>
+
+#define MAX_ERROR	4
+#define NSLOTS		200
+#define ROUNDS		20000
+#define BLOCK		32
+
+#include "common.c"
+
+char *slot[NSLOTS];
+size_t slotsize[NSLOTS];
+unsigned long seed = 1;
+
+_PROTOTYPE(int main, (int argc, char *argv []));
+_PROTOTYPE(void test44a, (void));
+_PROTOTYPE(void test44b, (void));
+_PROTOTYPE(unsigned rnd, (void));
+_PROTOTYPE(size_t rndsize, (void));
+_PROTOTYPE(void fill, (int i));
+_PROTOTYPE(int check, (int i, size_t n));
+
+int main(argc, argv)
+int argc;
+char *argv[];
+{
+  int i, m = 0xFFFF;
+
+  start(44);
+  if (argc == 2) m = atoi(argv[1]);
+  for (i = 0; i < 3; i++) {
+	if (m & 0001) test44a();
+	if (m & 0002) test44b();
+  }
+  quit();
+  return(-1);			/* impossible */
+}
+
+unsigned rnd()
+{
+  seed = seed * 1103515245L + 12345;
+  return((unsigned) (seed >> 16) & 0x7FFF);
+}
+
+size_t rndsize()
+{
+/* Mostly small blocks, now and then a larger one. */
+  if (rnd() % 8 == 0) return(rnd() % 500 + 1);
+  return(rnd() % 40 + 1);
+}
+
+void fill(i)
+int i;
+{
+  memset(slot[i], i & 0xFF, slotsize[i]);
+}
+
+int check(i, n)
+int i;
+size_t n;
+{
+  while (n > 0)
+	if ((slot[i][--n] & 0xFF) != (i & 0xFF)) return(0);
+  return(1);
+}
+
+void test44a()
+{
+/* Random allocations, reallocations and frees.  No block may change while
+ * it is in use.
+ */
+  int i;
+  long r;
+  size_t n;
+  char *p;
+
+  subtest = 1;
+  for (r = 0; r < ROUNDS; r++) {
+	i = rnd() % NSLOTS;
+	n = rndsize();
+	if (slot[i] == NULL) {
+		if ((slot[i] = malloc(n)) == NULL) e(1);
+		if ((long) slot[i] % sizeof(int) != 0) e(2);
+		slotsize[i] = n;
+		fill(i);
+		continue;
+	}
+	if (!check(i, slotsize[i])) e(3);
+	if (rnd() % 4 != 0) {
+		free(slot[i]);
+		slot[i] = NULL;
+		continue;
+	}
+	if ((p = realloc(slot[i], n)) == NULL) e(4);
+	slot[i] = p;
+	if (!check(i, n < slotsize[i] ? n : slotsize[i])) e(5);
+	slotsize[i] = n;
+	fill(i);
+  }
+  for (i = 0; i < NSLOTS; i++) {
+	if (slot[i] != NULL && !check(i, slotsize[i])) e(6);
+	free(slot[i]);
+	slot[i] = NULL;
+  }
+}
+
+void test44b()
+{
+/* Freed neighbours merge: after freeing many small blocks their space can
+ * be handed out again as one block, without growing the data segment.
+ */
+  int i;
+  char *brk0, *p;
+
+  subtest = 2;
+  for (i = 0; i < NSLOTS; i++)
+	if ((slot[i] = malloc(BLOCK)) == NULL) e(1);
+  brk0 = sbrk(0);
+  for (i = 0; i < NSLOTS; i += 2) free(slot[i]);
+  for (i = 1; i < NSLOTS; i += 2) free(slot[i]);
+  if ((p = malloc(NSLOTS / 2 * BLOCK)) == NULL) e(2);
+  if ((char *) sbrk(0) != brk0) e(3);
+
+  /* Growing it keeps its contents. */
+  memset(p, 'x', NSLOTS / 2 * BLOCK);
+  if ((p = realloc(p, NSLOTS * BLOCK)) == NULL) e(4);
+  for (i = 0; i < NSLOTS / 2 * BLOCK; i++)
+	if (p[i] != 'x') e(5);
+  free(p);
+  for (i = 0; i < NSLOTS; i++) slot[i] = NULL;
+}
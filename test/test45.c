@@ -0,0 +1,129 @@
+/* test45: fread() and fwrite() in small and large pieces.  Time it to
+ * measure stdio throughput.
+ */
+
+#include <sys/types.h>
+
+#define MAX_ERROR	4
+#define DATASIZE	20000
+#define PASSES		20
+
+#include "common.c"
+
+char src[DATASIZE], dst[DATASIZE];
+/* Some pieces are over twice the stdio buffer size, so part of them goes
+ * past the buffer and the buffer is filled again after that.
+ */
+int pieces[] = { 1, 7, 1000, 3, 17000, 512, 2048, 9 };
+
+_PROTOTYPE(int main, (int argc, char *argv []));
+_PROTOTYPE(void test45a, (void));
+_PROTOTYPE(void test45b, (void));
+
+int main(argc, argv)
+int argc;
+char *argv[];
+{
+  int i, m = 0xFFFF;
+
+  start(45);
+  for (i = 0; i < DATASIZE; i++) src[i] = (i * 7 + i / 253) & 0xFF;
+  if (argc == 2) m = atoi(argv[1]);
+  for (i = 0; i < 3; i++) {
+	if (m & 0001) test45a();
+	if (m & 0002) test45b();
+  }
+  quit();
+  return(-1);			/* impossible */
+}
+
+void test45a()
+{
+/* Write and read back a file in pieces of many sizes, mixed with putc(),
+ * getc() and ungetc().
+ */
+  FILE *fp;
+  int i, k, n, c;
+
+  subtest = 1;
+  if ((fp = fopen("T45a", "w")) == NULL) e(1);
+  for (i = 0, k = 0; i < DATASIZE; i += n, k++) {
+	n = pieces[k % 8];
+	if (n > DATASIZE - i) n = DATASIZE - i;
+	if (k % 5 == 4) {
+		if (putc(src[i], fp) == EOF) e(2);
+		n = 1;
+	} else {
+		if (fwrite(src + i, 1, n, fp) != n) e(3);
+	}
+  }
+  if (fclose(fp) != 0) e(4);
+
+  if ((fp = fopen("T45a", "r")) == NULL) e(5);
+  for (i = 0, k = 3; i < DATASIZE; i += n, k++) {
+	n = pieces[k % 8];
+	if (n > DATASIZE - i) n = DATASIZE - i;
+	if (k % 6 == 5) {
+		if ((c = getc(fp)) == EOF) e(6);
+		if (ungetc(c, fp) != c) e(7);
+		dst[i] = getc(fp);
+		n = 1;
+	} else {
+		if (fread(dst + i, 1, n, fp) != n) e(8);
+	}
+  }
+  if (memcmp(src, dst, DATASIZE) != 0) e(9);
+  if (fread(dst, 1, 10, fp) != 0) e(10);
+  if (!feof(fp)) e(11);
+
+  /* Seek back, read whole members, and a short count at the end. */
+  if (fseek(fp, 123L, SEEK_SET) != 0) e(12);
+  if (fread(dst, 100, 50, fp) != 50) e(13);
+  if (memcmp(src + 123, dst, 5000) != 0) e(14);
+  if (ftell(fp) != 5123L) e(15);
+  if (fread(dst, 100, DATASIZE / 100, fp) != (DATASIZE - 5123) / 100)
+	e(16);
+  if (fclose(fp) != 0) e(17);
+
+  /* Appending goes to the end, also when bypassing the buffer. */
+  if ((fp = fopen("T45a", "a")) == NULL) e(18);
+  if (fwrite(src, 1, DATASIZE, fp) != DATASIZE) e(19);
+  if (fclose(fp) != 0) e(20);
+  if ((fp = fopen("T45a", "r")) == NULL) e(21);
+  if (fseek(fp, (long) DATASIZE, SEEK_SET) != 0) e(22);
+  if (fread(dst, 1, DATASIZE, fp) != DATASIZE) e(23);
+  if (memcmp(src, dst, DATASIZE) != 0) e(24);
+  if (fclose(fp) != 0) e(25);
+  if (unlink("T45a") != 0) e(26);
+}
+
+void test45b()
+{
+/* Throughput: large writes and reads, then the same file one character at
+ * a time.
+ */
+  FILE *fp;
+  int i, c;
+  long n;
+
+  subtest = 2;
+  if ((fp = fopen("T45b", "w")) == NULL) e(1);
+  for (i = 0; i < PASSES; i++)
+	if (fwrite(src, 1, DATASIZE, fp) != DATASIZE) e(2);
+  if (fclose(fp) != 0) e(3);
+
+  if ((fp = fopen("T45b", "r")) == NULL) e(4);
+  for (i = 0; i < PASSES; i++) {
+	if (fread(dst, 1, DATASIZE, fp) != DATASIZE) e(5);
+	if (memcmp(src, dst, DATASIZE) != 0) e(6);
+  }
+  rewind(fp);
+  n = 0;
+  while ((c = getc(fp)) != EOF) {
+	if (c != (src[n % DATASIZE] & 0xFF)) e(7);
+	n++;
+  }
+  if (n != (long) PASSES * DATASIZE) e(8);
+  if (fclose(fp) != 0) e(9);
+  if (unlink("T45b") != 0) e(10);
+}